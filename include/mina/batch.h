@@ -0,0 +1,65 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Batch execution of many independent emulation cores on pinned worker threads.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/cartridge.h>
+#include <mina/core.h>
+#include <psh/fat_ptr.h>
+#include <psh/memory_manager.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Upper bound on the amount of worker threads of a batch.
+    constexpr u32 MAX_BATCH_WORKERS = 256;
+
+    /// Memory reserved for each instance of a batch, enough for its core.
+    constexpr usize BATCH_INSTANCE_MEMORY_SIZE = psh_kibibytes(80);
+
+    struct BatchInstance {
+        psh::Arena       arena   = {};       ///< Memory owned by the instance.
+        Cartridge const* cart    = nullptr;  ///< Shared, read-only, by every instance of the ROM.
+        u64              seed    = 0;        ///< Work RAM seed, zero keeps it cleared.
+        Core*            core    = nullptr;  ///< Allocated by the worker running the instance.
+        u32              worker  = 0;
+        f64              seconds = 0.0;      ///< Time spent running the instance.
+    };
+
+    struct BatchConfig {
+        u32 worker_count = 0;    ///< Zero uses one worker per hardware thread.
+        u64 frame_count  = 600;  ///< Frames run by each instance.
+        u64 cycle_count  = 0;    ///< When non-zero, takes precedence over the frame count.
+    };
+
+    /// Resolve the amount of workers that a batch of a given size would use.
+    u32 batch_worker_count(BatchConfig const& config, usize instance_count) noexcept;
+
+    /// Run every instance of the batch to completion.
+    ///
+    /// Instance `idx` is run by worker `idx % worker_count`. Workers are pinned to the hardware
+    /// threads the process may run on, alternating between NUMA nodes and filling every physical
+    /// core of a node before its SMT siblings, as far as the platform tells the topology.
+    /// Each core is allocated and cleared from its instance's arena by the worker that runs it,
+    /// after pinning, so that the first touch places its pages on the worker's node.
+    ///
+    /// Returns the wall clock time taken by the whole batch, in seconds.
+    f64 run_batch(psh::FatPtr<BatchInstance> instances, BatchConfig const& config) noexcept;
+}  // namespace mina
@@ -0,0 +1,88 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Emulation core, holding everything needed to run a cartridge without any windowing
+///              or graphics system.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/cartridge.h>
+#include <mina/cpu/dmg.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Machine cycles of a whole LCD frame: 154 lines of 456 dots, with 4 dots per machine cycle.
+    constexpr u32 MACHINE_CYCLES_PER_FRAME = 17556;
+
+    /// Frame rate of the DMG, a clock of 4194304 Hz over 70224 dots per frame.
+    constexpr f64 DMG_FRAME_RATE = 59.7275;
+
+    // Joypad buttons, each one a bit of the buttons held by the core. The action buttons take
+    // the low nibble and the directions the high one, in the order of the P1 input lines.
+    constexpr u8 BUTTON_A      = 1 << 0;
+    constexpr u8 BUTTON_B      = 1 << 1;
+    constexpr u8 BUTTON_SELECT = 1 << 2;
+    constexpr u8 BUTTON_START  = 1 << 3;
+    constexpr u8 BUTTON_RIGHT  = 1 << 4;
+    constexpr u8 BUTTON_LEFT   = 1 << 5;
+    constexpr u8 BUTTON_UP     = 1 << 6;
+    constexpr u8 BUTTON_DOWN   = 1 << 7;
+
+    struct ForkedState;
+
+    struct Core {
+        CPU              cpu         = {};
+        Cartridge const* cart        = nullptr;  ///< Only ever read, may be shared between cores.
+        u64              cart_hash   = 0;        ///< Hash of the cartridge contents.
+        u64              cycle_count = 0;
+        u64              frame_count = 0;
+        u8               buttons     = 0;  ///< Buttons held by the player, see `BUTTON_A` etc.
+
+        /// Forked state the dirty pages of the CPU are relative to, see `fork_state`. Paths
+        /// rewriting the whole memory map outside of the bus mark every page as dirty instead.
+        ForkedState const* synced_state = nullptr;
+    };
+
+    /// Attach a loaded cartridge to the core and reset it to the state it has right after the
+    /// boot ROM.
+    void init_core(Core& core, Cartridge const& cart) noexcept;
+
+    /// Restart the loaded cartridge with the register values left by the DMG boot ROM.
+    void reset_core(Core& core) noexcept;
+
+    /// Fill the work RAM with pseudo-random contents, as the DMG has no defined values for it at
+    /// power up. Distinct seeds give distinct runs of the same cartridge.
+    void scramble_work_ram(Core& core, u64 seed) noexcept;
+
+    /// Present the buttons held by the core to the game through the P1 register, if they changed
+    /// since they were last presented.
+    void sync_core_buttons(Core& core) noexcept;
+
+    /// Run the CPU for a given amount of machine cycles, with the buttons held by the core.
+    ///
+    /// NOTE(luiz): the buttons are sampled once at the start of the call, so changing them in
+    ///             between requires splitting the run into several calls.
+    ///
+    /// NOTE(luiz): the CPU still doesn't account the machine cycles taken by each instruction, so
+    ///             each call to `run_cpu_cycle` is counted as a single machine cycle.
+    void run_core_cycles(Core& core, u64 cycle_count) noexcept;
+
+    /// Run the CPU for the duration of a single LCD frame.
+    void run_core_frame(Core& core) noexcept;
+}  // namespace mina
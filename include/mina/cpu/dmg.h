@@ -54,6 +54,13 @@ namespace mina {
         u16 pc    = 0x0000;
     };
 
+    /// Pages of the memory map tracked by the dirty page bitmap of the CPU.
+    constexpr u32   MEMORY_PAGE_SHIFT = 10;
+    constexpr usize MEMORY_PAGE_SIZE  = usize{1} << MEMORY_PAGE_SHIFT;
+    constexpr u32   MEMORY_PAGE_COUNT = sizeof(MemoryMap) >> MEMORY_PAGE_SHIFT;
+
+    static_assert(MEMORY_PAGE_COUNT == 64, "The dirty page bitmap should fit a single word");
+
     /// DMG, the original Game Boy CPU.
     ///
     /// The DMG is an SoC containing a Sharp SM83 CPU, which is based on the Zilog Z80 and
@@ -63,7 +70,21 @@ namespace mina {
         MemoryMap    mmap     = {};
         u16          bus_addr = 0x0000;
         u16          clock    = 0x0000;
+
+        /// Bit `k` is set once an instruction writes to the page `k` of the memory map. Only ever
+        /// cleared by the owner of the CPU.
+        u64 dirty_pages = 0;
+
+        /// Buttons presented to the game through the P1 register, one bit per button, with the
+        /// directional pad on the high nibble.
+        u8 buttons = 0;
     };
 
     void run_cpu_cycle(CPU& cpu) noexcept;
+
+    /// Hold the given buttons in the joypad of the CPU, refreshing the input lines of P1.
+    ///
+    /// NOTE(luiz): the lines are otherwise only refreshed when the game writes to P1, selecting
+    ///             which half of the buttons it reads. The lines are active low.
+    void set_cpu_buttons(CPU& cpu, u8 buttons) noexcept;
 }  // namespace mina
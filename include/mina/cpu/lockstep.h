@@ -0,0 +1,96 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Lockstep execution of many instances of the same cartridge, with their register
+///              files laid out as a structure of arrays.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/cartridge.h>
+#include <mina/core.h>
+#include <mina/cpu/dmg.h>
+#include <psh/memory_manager.h>
+#include <psh/types.h>
+
+#include <cstddef>
+
+namespace mina {
+    /// Amount of bytes of the register file preceding the program counter.
+    constexpr usize LOCKSTEP_REG8_COUNT = offsetof(RegisterFile, pc);
+
+    /// Maximum amount of distinct lane groups executed by the vector path in a single cycle, lanes
+    /// left after that execute through the scalar path.
+    constexpr u32 MAX_LOCKSTEP_GROUPS = 16;
+
+    /// Instances of a single cartridge stepped in lockstep.
+    ///
+    /// Each lane owns a core, whose memory map is used in place. The register files of the lanes
+    /// are kept in `regs`, `pc` and `bus_addr` instead, where `regs[idx][lane]` is the byte at
+    /// offset `idx` of the `RegisterFile` of the lane. The register file of the lane's core is
+    /// only up to date after `store_lockstep_registers`.
+    ///
+    /// Every cycle, lanes at the same program counter and with the same instruction bytes form a
+    /// group that runs a single opcode handler over all of its lanes. When every lane belongs to
+    /// the same group, the handler loops over contiguous arrays and is vectorized by the compiler.
+    /// Opcodes without a lockstep handler run through `run_cpu_cycle` one lane at a time.
+    ///
+    /// The instruction bytes of lanes running from the cartridge ROM are only compared for the
+    /// lanes that ever wrote to their ROM, every other lane shares the same code.
+    struct LockstepGroup {
+        Core* lanes                     = nullptr;
+        u32   lane_count                = 0;
+        u8*   regs[LOCKSTEP_REG8_COUNT] = {};
+        u16*  pc                        = nullptr;
+        u16*  bus_addr                  = nullptr;
+        bool* rom_diverged              = nullptr;  ///< Whether the lane wrote to its ROM.
+        u32   rom_diverged_count        = 0;
+        u8*   rom_reference             = nullptr;  ///< ROM of a lane right after reset.
+        u32*  group_lanes               = nullptr;  ///< Scratch list of the lanes of a group.
+        u32*  pending_lanes             = nullptr;  ///< Scratch list of the lanes yet to run.
+        u64   cycle_count               = 0;
+        u64   frame_count               = 0;
+        u64   vector_lane_steps         = 0;  ///< Instructions run by the lockstep handlers.
+        u64   scalar_lane_steps         = 0;  ///< Instructions run by `run_cpu_cycle`.
+    };
+
+    /// Allocate a group of lanes running the given cartridge, all of them reset to the state
+    /// right after the boot ROM.
+    void init_lockstep(
+        LockstepGroup&   group,
+        psh::Arena*      arena,
+        Cartridge const& cart,
+        u32              lane_count) noexcept;
+
+    /// Load the state of the lane cores into the group, after they were changed through
+    /// `group.lanes`, presenting the buttons held by each of them.
+    void load_lockstep_lanes(LockstepGroup& group) noexcept;
+
+    /// Write the register files and cycle counters of the group back to the lane cores.
+    void store_lockstep_lanes(LockstepGroup& group) noexcept;
+
+    /// Run a single instruction on every lane of the group.
+    void run_lockstep_cycle(LockstepGroup& group) noexcept;
+
+    /// Run every lane of the group for a given amount of machine cycles, with the same caveat of
+    /// `run_core_cycles` about instruction timings.
+    void run_lockstep_cycles(LockstepGroup& group, u64 cycle_count) noexcept;
+
+    /// Run every lane of the group for the duration of a single LCD frame.
+    void run_lockstep_frame(LockstepGroup& group) noexcept;
+}  // namespace mina
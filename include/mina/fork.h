@@ -0,0 +1,80 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Copy-on-write branching of the state of a core, for searches exploring many
+///              continuations of the same state.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/core.h>
+#include <mina/cpu/dmg.h>
+#include <psh/memory_manager.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// State of a core whose memory map is a table of pages, each either owned by the state or
+    /// shared with the state it was forked from. Forked states are immutable, so that any amount
+    /// of children may share the pages of the same parent.
+    ///
+    /// The pages written since the core was last synchronized with a state, which the core keeps
+    /// track of, are known from the dirty page bitmap of its CPU. The bitmap is kept by the bus
+    /// write path, while paths rewriting the whole memory map, such as `load_state` and
+    /// `reset_core`, mark every page as dirty. Forking copies those and shares every other page
+    /// with the parent, so that a state costs the size of its page table plus the pages that
+    /// changed, rather than the whole memory map.
+    struct ForkedState {
+        ForkedState const* parent      = nullptr;
+        u64                cart_hash   = 0;
+        RegisterFile       regfile     = {};
+        u16                bus_addr    = 0x0000;
+        u16                clock       = 0x0000;
+        u8                 buttons     = 0;  ///< Buttons held by the player.
+        u64                cycle_count = 0;
+        u64                frame_count = 0;
+        u64                owned_pages = 0;  ///< Bit `k` is set if the state owns page `k`.
+
+        u8 const* pages[MEMORY_PAGE_COUNT] = {};
+    };
+
+    /// Capture the whole state of the core as the root of a tree of forked states.
+    ///
+    /// The core becomes synchronized with the root. Returns null if the arena has no room for it.
+    ForkedState* capture_root_state(psh::Arena* arena, Core& core) noexcept;
+
+    /// Capture the state of the core as a child of `parent`, which has to be either the state the
+    /// core was last synchronized with or one of its ancestors. Only the pages written since then
+    /// are copied.
+    ///
+    /// The core becomes synchronized with the child. Returns null if the arena has no room for it.
+    ForkedState* fork_state(psh::Arena* arena, ForkedState const& parent, Core& core) noexcept;
+
+    /// Restore the core to any state of a tree running the same cartridge, copying every page.
+    ///
+    /// The core becomes synchronized with the state, as it does with `revert_forked_state`.
+    void restore_forked_state(Core& core, ForkedState const& state) noexcept;
+
+    /// Restore the core to the state it was last synchronized with, or to one of its ancestors,
+    /// copying back only the pages written since then. Much cheaper than `restore_forked_state`
+    /// when exploring many continuations of the same state.
+    void revert_forked_state(Core& core, ForkedState const& state) noexcept;
+
+    /// Bytes taken by the pages owned by a state.
+    usize forked_state_owned_size(ForkedState const& state) noexcept;
+}  // namespace mina
@@ -25,12 +25,35 @@
 #include <vulkan/vulkan_core.h>
 
 namespace mina {
-    void create_buffers(VmaAllocator alloc, BufferManager& bufs, QueueFamilies& queues) noexcept;
+    void create_buffers(
+        VmaAllocator   alloc,
+        BufferManager& bufs,
+        QueueFamilies& queues,
+        u32            max_frames_in_flight) noexcept;
 
     void destroy_buffers(VmaAllocator alloc, BufferManager& bufs) noexcept;
 
+    void create_lcd_texture(VkDevice dev, VmaAllocator alloc, LcdTexture& lcd) noexcept;
+
+    void destroy_lcd_texture(VkDevice dev, VmaAllocator alloc, LcdTexture& lcd) noexcept;
+
+    /// Create the image of the native target. The frame buffer is only created afterwards by
+    /// `create_native_frame_buffer`, once the native render pass exists.
+    void create_native_target(VkDevice dev, VmaAllocator alloc, NativeTarget& target) noexcept;
+
+    void create_native_frame_buffer(
+        VkDevice          dev,
+        NativeTarget&     target,
+        RenderPass const& native_pass) noexcept;
+
+    void destroy_native_target(VkDevice dev, VmaAllocator alloc, NativeTarget& target) noexcept;
+
+    /// Write the staged data to its slice of the persistently mapped staging ring.
+    ///
+    /// The slice must not be in use by the GPU, that is, the frame in flight owning it must have
+    /// already been waited on.
     void stage_host_data(
         VmaAllocator       alloc,
-        Buffer const&      staging_buf,
+        HostBuffer const&  staging_buf,
         StagingInfo const& staging_info) noexcept;
 }  // namespace mina
@@ -33,7 +33,8 @@ namespace mina {
         CommandManager&      cmds,
         QueueFamilies const& queues,
         psh::Arena*          arena,
-        u32                  max_frames_in_flight) noexcept;
+        u32                  max_frames_in_flight,
+        u32                  image_count) noexcept;
 
     void destroy_command_buffers(VkDevice dev, CommandManager& cmds) noexcept;
 
@@ -41,35 +42,62 @@ namespace mina {
     // - Data transfer commands -
     // -----------------------------------------------------------------------------
 
-    TransferInfo transfer_whole_info(
-        VkBuffer src,
-        VkBuffer dst,
-        usize    vertex_buf_size,
-        usize    uniform_buf_size) noexcept;
+    /// Transfer of the data staged in a slice of the staging ring to its GPU destinations.
+    TransferInfo transfer_info(
+        BufferManager const& buffers,
+        QueueFamilies const& queues,
+        StagingInfo const&   staging_info) noexcept;
 
     void record_transfer_commands(VkCommandBuffer transf_cmd, TransferInfo const& info) noexcept;
 
+    /// Submit the transfer commands, signalling `transf_sema` once the copies are done. There's no
+    /// host-side wait: the graphics submission of the same frame waits on the semaphore instead.
+    ///
+    /// With a dedicated transfer queue, `prev_gfx_sema` is the semaphore signalled by the graphics
+    /// submission of the previous frame (or null), which orders the copies after its reads.
     void submit_transfer_commands(
         VkQueue         transf_queue,
         VkCommandBuffer transf_cmd,
-        VkFence         transf_fence) noexcept;
-
-    void wait_transfer_completion(VkDevice dev, VkFence transf_fence) noexcept;
+        VkSemaphore     prev_gfx_sema,
+        VkSemaphore     transf_sema) noexcept;
 
     // -----------------------------------------------------------------------------
     // - Graphics rendering commands -
     // -----------------------------------------------------------------------------
 
+    /// Largest viewport that scales the LCD by an integer factor and fits in the surface, centered.
+    VkViewport integer_scaled_viewport(VkExtent2D surface_extent) noexcept;
+
+    /// Record the composition and scaling passes, with dynamic rendering when enabled or with the
+    /// render pass and frame buffer objects of `info` otherwise.
     void record_graphics_commands(
-        VkCommandBuffer        cmd_buf,
-        QueueFamilies const&   queues,
-        GraphicsCmdInfo const& info,
-        RenderDataInfo const&  data_info) noexcept;
+        VkCommandBuffer         cmd_buf,
+        QueueFamilies const&    queues,
+        DynamicRendering const& rendering,
+        GraphicsCmdInfo const&  info,
+        RenderDataInfo const&   data_info) noexcept;
+
+    /// Graphics commands of the given frame in flight and swap chain image. The command buffer is
+    /// only re-recorded when the information differs from the one it was last recorded with.
+    VkCommandBuffer graphics_commands(
+        CommandManager&         cmds,
+        QueueFamilies const&    queues,
+        DynamicRendering const& rendering,
+        u32                     frame_index,
+        u32                     image_index,
+        GraphicsCmdInfo const&  info,
+        RenderDataInfo const&   data_info) noexcept;
+
+    /// Force every graphics command buffer to be re-recorded on its next use. Required whenever
+    /// the handles they reference are destroyed, since new handles may reuse the same values.
+    void invalidate_graphics_commands(CommandManager& cmds) noexcept;
 
     void submit_graphics_commands(
         VkQueue         gfx_queue,
         VkCommandBuffer gfx_cmd,
         VkSemaphore     swc_sema,
+        VkSemaphore     transf_sema,
         VkSemaphore     render_pass_sema,
+        VkSemaphore     gfx_sema,
         VkFence         frame_fence) noexcept;
 }  // namespace mina
@@ -48,17 +48,20 @@ namespace mina {
         SwapChain            swap_chain      = {};
         QueueFamilies        queues          = {};
         DescriptorSetManager descriptor_sets = {};
+        PipelineCache        pipeline_cache  = {};
         PipelineManager      pipelines       = {};
         CommandManager       commands        = {};
         SynchronizerManager  sync            = {};
+        DynamicRendering     rendering       = {};
     };
 
     /// Initialize the graphics context instance according to the given configurations.
     void init_graphics_system(
-        GraphicsContext& ctx,
-        WindowHandle*    win_handle,
-        psh::Arena*      persistent_arena,
-        psh::Arena*      work_arena) noexcept;
+        GraphicsContext&     ctx,
+        WindowHandle*        win_handle,
+        psh::Arena*          persistent_arena,
+        psh::Arena*          work_arena,
+        PresentConfig const& present_config = {}) noexcept;
 
     /// Destroy all resources attached and managed by the graphics context.
     void destroy_graphics_system(GraphicsContext& ctx) noexcept;
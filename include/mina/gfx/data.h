@@ -22,60 +22,96 @@
 #pragma once
 
 #include <mina/gfx/types.h>
+#include <mina/ppu/palette.h>
+#include <mina/ppu/tile_data.h>
 #include <psh/assert.h>
 #include <psh/buffer.h>
 #include <psh/fat_ptr.h>
 #include <psh/memory_manager.h>
-#include <psh/vec.h>
 
 namespace mina {
-    struct Vertex {
-        psh::Vec3 position = {};
-        psh::Vec3 color    = {};
-    };
+    constexpr u32 LCD_DIRTY_WORD_COUNT = (LCD_HEIGHT + 63) / 64;
 
-    struct VertexData {
-        psh::FatPtr<Vertex> data;
-    };
+    struct FrameMemory {
+        psh::Arena arena;
 
-    constexpr VkVertexInputBindingDescription VERTEX_BINDING_DESCRIPTION{
-        .binding   = 0,
-        .stride    = sizeof(Vertex),
-        .inputRate = VK_VERTEX_INPUT_RATE_VERTEX,
-    };
+        /// Colors of the palettes in effect, used to convert the LCD pixels to host colors.
+        PaletteTable* palette = nullptr;
 
-    constexpr psh::Buffer<VkVertexInputAttributeDescription, 2> VERTEX_ATTRIBUTE_DESCRIPTION{
-        // Vertex position.
-        VkVertexInputAttributeDescription{
-            .location = 0,
-            .binding  = VERTEX_BINDING_DESCRIPTION.binding,
-            .format   = static_cast<VkFormat>(AttribFormat::VEC3_F32),
-            .offset   = 0,
-        },
-        // Vertex color.
-        VkVertexInputAttributeDescription{
-            .location = 1,
-            .binding  = VERTEX_BINDING_DESCRIPTION.binding,
-            .format   = static_cast<VkFormat>(AttribFormat::VEC3_F32),
-            .offset   = sizeof(Vertex::position),
-        },
-    };
+        /// Pixel IDs of the LCD, only converted to host RGBA colors as they are staged.
+        u8* lcd_pixels = nullptr;
 
-    static constexpr usize VERTEX_BUF_SIZE  = psh_kibibytes(1);
-    static constexpr usize UNIFORM_BUF_SIZE = 0;
+        /// Bitset of the LCD lines that changed since they were last staged.
+        u64 lcd_dirty_rows[LCD_DIRTY_WORD_COUNT] = {};
 
-    struct FrameMemory {
-        psh::Arena arena;
-        u32        vertex_count;
-        u8*        vertex_buf;
-        bool       vertex_buf_dirty;
+        /// Ranges of dirty lines collected for the frame currently being staged.
+        LcdRowRange lcd_ranges[LCD_MAX_ROW_RANGES] = {};
+        u32         lcd_range_count                = 0;
+
+        /// Whether the LCD texture holds a previous frame, otherwise its contents are undefined
+        /// and the whole frame has to be uploaded.
+        bool lcd_texture_valid = false;
+
+        /// Raw video memory snapshot consumed by the GPU tile renderer, only staged if
+        /// `uses_tile_renderer` is set, in which case the LCD frame buffer isn't staged at all.
+        TileRendererInput* tile_input         = nullptr;
+        bool               uses_tile_renderer = false;
+
+        /// Hash of the contents of the last frame that was successfully presented.
+        u64  presented_hash       = 0;
+        bool presented_hash_valid = false;
+
+        /// Number of frames whose upload and presentation were skipped for being identical to the
+        /// last presented frame.
+        u64 skipped_frame_count = 0;
     };
 
-    FrameMemory create_frame_memory(psh::MemoryManager& memory_manager, f32 aspect) noexcept;
+    FrameMemory create_frame_memory(psh::MemoryManager& memory_manager) noexcept;
+
+    inline void
+    mark_lcd_rows_dirty(FrameMemory& frame_memory, u32 first_line, u32 line_count) noexcept {
+        for (u32 line = first_line; line < first_line + line_count; ++line) {
+            frame_memory.lcd_dirty_rows[line / 64] |= (u64{1} << (line % 64));
+        }
+    }
+
+    /// Write the `LCD_WIDTH` pixel IDs of a line of the LCD, only marking it as dirty if it
+    /// changed.
+    void write_lcd_row(FrameMemory& frame_memory, u32 line, u8 const* pixel_ids) noexcept;
+
+    /// Update the DMG palettes from the palette registers, marking the whole LCD as dirty if any
+    /// of them changed, since every line then has different host colors.
+    void update_lcd_palette(FrameMemory& frame_memory, HwRegisterBank const& reg) noexcept;
+
+    /// Gather the dirty lines into the `lcd_ranges` of the frame memory and clear their dirty
+    /// state. If the LCD texture isn't valid yet, the whole screen is collected.
+    void collect_dirty_lcd_rows(FrameMemory& frame_memory) noexcept;
+
+    /// Compute the hash of the frame contents that would be staged to the GPU.
+    u64 frame_memory_hash(FrameMemory const& frame_memory) noexcept;
+
+    /// Check whether a frame with the given hash is pixel-identical to the last presented one, in
+    /// which case the whole upload and presentation of the frame can be skipped.
+    inline bool frame_is_identical(FrameMemory const& frame_memory, u64 frame_hash) noexcept {
+        return frame_memory.presented_hash_valid && (frame_memory.presented_hash == frame_hash);
+    }
+
+    /// Record the hash of the frame that was just presented.
+    inline void mark_frame_presented(FrameMemory& frame_memory, u64 frame_hash) noexcept {
+        frame_memory.presented_hash       = frame_hash;
+        frame_memory.presented_hash_valid = true;
+    }
+
+    /// Force the next frame to be presented regardless of its contents, which is required
+    /// whenever the presentation surface itself changes (e.g. swap chain recreation).
+    inline void invalidate_presented_frame(FrameMemory& frame_memory) noexcept {
+        frame_memory.presented_hash_valid = false;
+    }
 
-    VertexData vertex_data(FrameMemory const& frame_memory) noexcept;
-    Vertex*    vertex_buffer_ptr(FrameMemory const& frame_memory) noexcept;
+    StagingInfo    memory_staging_info(FrameMemory const& frame_memory, u32 frame_index) noexcept;
 
-    StagingInfo    memory_staging_info(FrameMemory const& frame_memory) noexcept;
+    /// Convert the lines of the LCD being staged to host colors, writing them directly to the
+    /// LCD frame of the mapped staging slice.
+    void convert_staged_lcd_rows(StagingInfo const& info, u8* lcd_frame) noexcept;
     RenderDataInfo render_data_info(FrameMemory const& frame_memory) noexcept;
 }  // namespace mina
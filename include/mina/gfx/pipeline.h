@@ -28,43 +28,106 @@ namespace mina {
     // - Shader catalog -
     // -----------------------------------------------------------------------------
 
+    /// Shaders embedded in the binary as SPIR-V at compile time.
     enum struct ShaderCatalog {
-        TRIANGLE_VERTEX,
-        TRIANGLE_FRAGMENT,
+        FULLSCREEN_VERTEX,
+        LCD_FRAGMENT,
+        LCD_BUFFER_FRAGMENT,
+        LCD_TILES_FRAGMENT,
+        SCALE_FRAGMENT,
         SHADER_COUNT,
     };
-
-    constexpr strptr shader_path(ShaderCatalog s) noexcept {
-        strptr path;
-        switch (s) {
-            case ShaderCatalog::TRIANGLE_VERTEX:   path = "build/bin/triangle.vert.spv"; break;
-            case ShaderCatalog::TRIANGLE_FRAGMENT: path = "build/bin/triangle.frag.spv"; break;
-            default:                               psh_unreachable();
-        }
-        return path;
-    }
     // -----------------------------------------------------------------------------
     // - Descriptor set management -
     // -----------------------------------------------------------------------------
 
+    /// Create the descriptor sets of the sampled images and the tile renderer data. When the
+    /// staging ring is zero-copy, each frame in flight also gets sets reading its slice in place.
     void create_descriptor_sets(
         VkDevice              dev,
+        psh::Arena*           persistent_arena,
         DescriptorSetManager& descriptor_sets,
-        Buffer const&         uniform_buf) noexcept;
+        BufferManager const&  buffers) noexcept;
 
     void destroy_descriptor_sets(VkDevice dev, DescriptorSetManager& descriptor_sets) noexcept;
 
+    // -----------------------------------------------------------------------------
+    // - Pipeline cache -
+    // -----------------------------------------------------------------------------
+
+    /// Path of the cache file of a device, formatted with its vendor and device IDs.
+    constexpr strptr PIPELINE_CACHE_PATH_FMT = "build/bin/pipeline_cache_%04x_%04x.bin";
+
+    /// Create the pipeline cache, seeded with the cache file of the device when the file exists
+    /// and its header matches the vendor ID, device ID and pipeline cache UUID of the driver.
+    void create_pipeline_cache(
+        VkDevice         dev,
+        VkPhysicalDevice pdev,
+        psh::Arena*      work_arena,
+        PipelineCache&   cache) noexcept;
+
+    /// Write the pipeline cache to the cache file of the device, if it grew since it was loaded or
+    /// last saved.
+    void save_pipeline_cache(
+        VkDevice         dev,
+        VkPhysicalDevice pdev,
+        psh::Arena*      work_arena,
+        PipelineCache&   cache) noexcept;
+
+    /// Save the pipeline cache, then destroy it.
+    void destroy_pipeline_cache(
+        VkDevice         dev,
+        VkPhysicalDevice pdev,
+        psh::Arena*      work_arena,
+        PipelineCache&   cache) noexcept;
+
     // -----------------------------------------------------------------------------
     // - Graphics pipeline context lifetime management -
     // -----------------------------------------------------------------------------
 
+    /// Create the pipeline scaling the native target to the swap chain image. The render pass is
+    /// only created without dynamic rendering.
     void create_graphics_pipeline_context(
         VkDevice              dev,
-        psh::Arena*           persistent_arena,
+        VkPipelineCache       cache,
         Pipeline&             graphics_pip,
         DescriptorSetManager& descriptor_sets,
         VkFormat              surf_fmt,
-        VkExtent2D            surf_ext) noexcept;
+        bool                  dynamic_rendering) noexcept;
 
     void destroy_graphics_pipeline_context(VkDevice dev, Pipeline& graphics_pip) noexcept;
+
+    /// Create the render pass targeting the native resolution of the LCD, unless rendering
+    /// dynamically, together with the pipeline composing the uploaded LCD texture. Destroyed by
+    /// `destroy_graphics_pipeline_context`.
+    void create_native_pipeline_context(
+        VkDevice              dev,
+        VkPipelineCache       cache,
+        Pipeline&             compose_pip,
+        DescriptorSetManager& descriptor_sets,
+        bool                  dynamic_rendering) noexcept;
+
+    /// Create the pipeline of the GPU tile renderer, which composes the LCD in a fragment shader
+    /// directly from the raw video memory. The pipeline is drawn within the given render pass,
+    /// which isn't owned by the tile renderer.
+    void create_tile_renderer_pipeline(
+        VkDevice                    dev,
+        VkPipelineCache             cache,
+        Pipeline&                   tile_pip,
+        RenderPass                  render_pass,
+        DescriptorSetManager const& descriptor_sets) noexcept;
+
+    /// Create the pipeline composing the LCD frame read in place from a storage buffer, used
+    /// instead of the `compose` pipeline when the staging ring is zero-copy. Drawn within the
+    /// given render pass, which isn't owned by the pipeline.
+    void create_lcd_buffer_pipeline(
+        VkDevice                    dev,
+        VkPipelineCache             cache,
+        Pipeline&                   lcd_buf_pip,
+        RenderPass                  render_pass,
+        DescriptorSetManager const& descriptor_sets) noexcept;
+
+    /// Destroy a pipeline created by `create_tile_renderer_pipeline` or
+    /// `create_lcd_buffer_pipeline`, leaving the borrowed render pass alive.
+    void destroy_native_pipeline(VkDevice dev, Pipeline& native_pip) noexcept;
 }  // namespace mina
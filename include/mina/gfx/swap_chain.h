@@ -34,6 +34,8 @@ namespace mina {
         psh::Arena*      arena,
         SwapChainInfo&   swc_info) noexcept;
 
+    /// Create the swap chain with the present mode of `swc.present_config`, or the closest
+    /// available one with a higher latency.
     void create_swap_chain(
         VkDevice             dev,
         VkSurfaceKHR         surf,
@@ -42,12 +44,23 @@ namespace mina {
         WindowHandle*        win_handle,
         SwapChainInfo const& swc_info) noexcept;
 
+    /// Destroy the swap chain together with every retired one. The device should be idle.
     void destroy_swap_chain(VkDevice dev, SwapChain& swc) noexcept;
 
+    /// Move the swap chain and its image views and frame buffers to the retired list, where they
+    /// stay until every frame in flight of the `pending_frames` bit mask retires. The handle is
+    /// kept as the `oldSwapchain` of the next `create_swap_chain`.
+    void retire_swap_chain(SwapChain& swc, u32 pending_frames) noexcept;
+
+    /// Mark the frames in flight of the `retired_frames` bit mask as retired, destroying the
+    /// retired swap chains no longer used by any pending frame.
+    void release_retired_swap_chains(VkDevice dev, SwapChain& swc, u32 retired_frames) noexcept;
+
     void create_image_views(VkDevice dev, SwapChain& swc, psh::Arena* persistent_arena) noexcept;
 
     void recreate_image_views(VkDevice dev, SwapChain& swc) noexcept;
 
+    /// Create a frame buffer per image. Not needed with dynamic rendering.
     void create_frame_buffers(
         VkDevice          dev,
         SwapChain&        swc,
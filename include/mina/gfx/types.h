@@ -22,6 +22,7 @@
 #pragma once
 
 #include <mina/gfx/vma.h>
+#include <mina/ppu/lcd.h>
 #include <psh/array.h>
 #include <psh/buffer.h>
 #include <psh/dyn_array.h>
@@ -64,51 +65,76 @@ namespace mina {
 
     struct SynchronizerManager {
         FrameFences     frame_in_flight      = {};
-        FrameFences     finished_transfer    = {};
+        FrameSemaphores finished_transfer    = {};
         FrameSemaphores image_available      = {};
         FrameSemaphores finished_render_pass = {};
+
+        /// Signalled by the graphics submission of each frame so that the transfer of the next one
+        /// only starts after the LCD resources were released. Only used with a dedicated transfer
+        /// queue family.
+        FrameSemaphores finished_graphics      = {};
+        VkSemaphore     pending_graphics_ended = nullptr;
     };
 
     // -----------------------------------------------------------------------------
     // - Data buffers -
     // -----------------------------------------------------------------------------
 
-    // TODO: fill these buffer infos with meaningful numbers.
-
-    // Host buffer information.
-    [[maybe_unused]] constexpr usize HOST_BUFFER_SIZE             = 65536;
-    [[maybe_unused]] constexpr usize VERTEX_STAGING_BUFFER_OFFSET = 0;
-    [[maybe_unused]] constexpr usize VERTEX_STAGING_BUFFER_SIZE   = 1024;
-    [[maybe_unused]] constexpr usize UNIFORM_STAGING_BUFFER_OFFSET =
-        VERTEX_STAGING_BUFFER_SIZE + VERTEX_STAGING_BUFFER_OFFSET;
-    [[maybe_unused]] constexpr usize UNIFORM_STAGING_BUFFER_SIZE = 1024;
+    /// Size of the raw video memory snapshot read by the GPU tile renderer, matching
+    /// `sizeof(TileRendererInput)`: VRAM, OAM and 8 bytes of registers for each of the 144 lines.
+    [[maybe_unused]] constexpr usize TILE_DATA_BUFFER_SIZE = 0x2000 + 0xA0 + 144 * 8;
+
+    // Host staging ring information.
+    //
+    // The staging buffer is split into one slice per frame in flight, each slice holding the LCD
+    // frame followed by the tile renderer data.
+    [[maybe_unused]] constexpr usize STAGING_LCD_FRAME_OFFSET = 0;
+    [[maybe_unused]] constexpr usize STAGING_TILE_DATA_OFFSET =
+        STAGING_LCD_FRAME_OFFSET + LCD_FRAME_SIZE;
+    [[maybe_unused]] constexpr usize STAGING_SLICE_ALIGNMENT = 256;
+    [[maybe_unused]] constexpr usize STAGING_SLICE_SIZE =
+        (STAGING_TILE_DATA_OFFSET + TILE_DATA_BUFFER_SIZE + STAGING_SLICE_ALIGNMENT - 1) &
+        ~(STAGING_SLICE_ALIGNMENT - 1);
 
     // Device buffer information.
-    [[maybe_unused]] constexpr usize DEVICE_BUFFER_SIZE   = 65536;
-    [[maybe_unused]] constexpr usize VERTEX_BUFFER_OFFSET = 0;
-    [[maybe_unused]] constexpr usize VERTEX_BUFFER_SIZE   = 1024;
-    [[maybe_unused]] constexpr usize UNIFORM_BUFFER_OFFSET =
-        VERTEX_BUFFER_SIZE + VERTEX_BUFFER_OFFSET;
-    [[maybe_unused]] constexpr usize UNIFORM_BUFFER_SIZE = 1024;
-
-    /// Information regarding the staging of CPU data to the host staging buffer.
+    [[maybe_unused]] constexpr usize TILE_DATA_BUFFER_OFFSET = 0;
+    [[maybe_unused]] constexpr usize DEVICE_BUFFER_SIZE      = TILE_DATA_BUFFER_SIZE;
+
+    /// Contiguous range of lines of the LCD.
+    struct LcdRowRange {
+        u32 first_line;
+        u32 line_count;
+    };
+
+    /// Maximum number of disjoint ranges of lines, attained when every other line is dirty.
+    [[maybe_unused]] constexpr u32 LCD_MAX_ROW_RANGES = (LCD_HEIGHT + 1) / 2;
+
+    struct PaletteTable;
+
+    /// Information regarding the staging of CPU data to a slice of the host staging buffer.
     struct StagingInfo {
-        u8 const* src_ptr;
-        usize     vertex_buf_size;
-        usize     vertex_buf_src_offset;
-        usize     vertex_buf_dst_offset;
-        usize     uniform_buf_size;
-        usize     uniform_buf_src_offset;
-        usize     uniform_buf_dst_offset;
+        u8 const*           src_ptr;
+        usize               dst_slice_offset;
+        u8 const*           lcd_pixels;  ///< Pixel IDs, converted to host colors when staged.
+        PaletteTable const* palette;
+        LcdRowRange const*  lcd_ranges;
+        u32                 lcd_range_count;
+        bool                lcd_discard;  ///< Whether the previous LCD texture contents are unused.
+        usize               tile_data_size;
+        usize               tile_data_src_offset;
     };
 
     struct TransferInfo {
-        VkBuffer src_buf_handle;
-        VkBuffer dst_buf_handle;
-        usize    src_buf_offset;
-        usize    dst_buf_offset;
-        usize    vertex_buf_size;
-        usize    uniform_buf_size;
+        VkBuffer           src_buf_handle;
+        VkBuffer           dst_buf_handle;
+        VkImage            lcd_image;
+        usize              src_slice_offset;
+        LcdRowRange const* lcd_ranges;
+        u32                lcd_range_count;
+        bool               lcd_discard;
+        usize              tile_data_size;
+        u32                transfer_queue_index;
+        u32                graphics_queue_index;
     };
 
     struct Buffer {
@@ -119,9 +145,11 @@ namespace mina {
     };
 
     struct HostBuffer {
-        VkBuffer      handle     = nullptr;
-        VmaAllocation allocation = nullptr;
-        usize         size       = 0;
+        VkBuffer      handle      = nullptr;
+        VmaAllocation allocation  = nullptr;
+        usize         size        = 0;
+        u32           slice_count = 0;
+        u8*           mapped      = nullptr;  ///< Persistent mapping of the whole buffer memory.
     };
 
     struct DeviceBuffer {
@@ -130,10 +158,39 @@ namespace mina {
         usize         size       = 0;
     };
 
+    /// Sampled image holding the LCD frame presented to the screen.
+    struct LcdTexture {
+        VkImage       image      = nullptr;
+        VmaAllocation allocation = nullptr;
+        VkImageView   view       = nullptr;
+        VkSampler     sampler    = nullptr;
+    };
+
+    /// Offscreen color target where the frame is composed, and post-processed, at the native
+    /// resolution of the LCD before being scaled to the swap chain extent.
+    struct NativeTarget {
+        VkImage       image      = nullptr;
+        VmaAllocation allocation = nullptr;
+        VkImageView   view       = nullptr;
+        VkSampler     sampler    = nullptr;
+        VkFramebuffer frame_buf  = nullptr;
+    };
+
+    [[maybe_unused]] constexpr VkFormat   LCD_TEXTURE_FORMAT   = VK_FORMAT_R8G8B8A8_UNORM;
+    [[maybe_unused]] constexpr VkFormat   NATIVE_TARGET_FORMAT = VK_FORMAT_R8G8B8A8_UNORM;
+    [[maybe_unused]] constexpr VkExtent2D NATIVE_EXTENT{.width = LCD_WIDTH, .height = LCD_HEIGHT};
+
     // TODO: this should be POD, remove the methods and write get_host_buffer(), etc.
     struct BufferManager {
         HostBuffer   host   = {};
         DeviceBuffer device = {};
+        LcdTexture   lcd    = {};
+        NativeTarget native = {};
+
+        /// Whether the staging ring lives in memory that is both host visible and device local
+        /// (UMA or resizable BAR). The shaders then read each slice in place and no transfer is
+        /// recorded.
+        bool zero_copy = false;
 
         Buffer host_buffer() const noexcept {
             return Buffer{
@@ -153,39 +210,22 @@ namespace mina {
             };
         }
 
-        Buffer vertex_staging_buffer() const noexcept {
+        /// Slice of the staging ring owned by the given frame in flight.
+        Buffer staging_slice(u32 frame_index) const noexcept {
             return Buffer{
                 .handle     = host.handle,
                 .allocation = host.allocation,
-                .offset     = VERTEX_STAGING_BUFFER_OFFSET,
-                .size       = VERTEX_STAGING_BUFFER_SIZE,
-            };
-        }
-
-        Buffer uniform_staging_buffer() const noexcept {
-            return Buffer{
-                .handle     = host.handle,
-                .allocation = host.allocation,
-                .offset     = UNIFORM_STAGING_BUFFER_OFFSET,
-                .size       = UNIFORM_STAGING_BUFFER_SIZE,
-            };
-        }
-
-        Buffer vertex_buffer() const noexcept {
-            return Buffer{
-                .handle     = device.handle,
-                .allocation = device.allocation,
-                .offset     = VERTEX_BUFFER_OFFSET,
-                .size       = VERTEX_BUFFER_SIZE,
+                .offset     = frame_index * STAGING_SLICE_SIZE,
+                .size       = STAGING_SLICE_SIZE,
             };
         }
 
-        Buffer uniform_buffer() const noexcept {
+        Buffer tile_data_buffer() const noexcept {
             return Buffer{
                 .handle     = device.handle,
                 .allocation = device.allocation,
-                .offset     = UNIFORM_BUFFER_OFFSET,
-                .size       = UNIFORM_BUFFER_SIZE,
+                .offset     = TILE_DATA_BUFFER_OFFSET,
+                .size       = TILE_DATA_BUFFER_SIZE,
             };
         }
     };
@@ -195,56 +235,108 @@ namespace mina {
     // -----------------------------------------------------------------------------
 
     struct FrameResources {
+        u32             frame_index;
         VkCommandBuffer transfer_cmd;
-        VkCommandBuffer graphics_cmd;
         VkFence         frame_in_flight_fence;
-        VkFence         transfer_ended_fence;
+        VkSemaphore     transfer_ended_semaphore;
         VkSemaphore     image_available_semaphore;
         VkSemaphore     render_pass_ended_semaphore;
-        VkImage         image     = nullptr;
-        VkFramebuffer   frame_buf = nullptr;
+        VkSemaphore     graphics_ended_semaphore = nullptr;
+        VkSemaphore     previous_graphics_ended  = nullptr;
+        u32             image_index = 0;
+        VkImage         image       = nullptr;
+        VkImageView     image_view  = nullptr;
+        VkFramebuffer   frame_buf   = nullptr;  ///< Null with dynamic rendering.
     };
 
+    /// Single color attachment pass. Without a handle, the pass is drawn with dynamic rendering
+    /// and has no frame buffers.
     struct RenderPass {
-        VkRenderPass handle = nullptr;
+        VkRenderPass handle       = nullptr;
+        VkFormat     color_format = VK_FORMAT_UNDEFINED;
     };
 
-    struct FrameCommands {
-        psh::Array<VkCommandBuffer> cmd = {};
+    /// Entry points of dynamic rendering, either core since Vulkan 1.3 or provided by
+    /// `VK_KHR_dynamic_rendering`. When disabled, render pass and frame buffer objects are used.
+    struct DynamicRendering {
+        bool                    enabled = false;
+        PFN_vkCmdBeginRendering begin   = nullptr;
+        PFN_vkCmdEndRendering   end     = nullptr;
     };
 
-    struct CommandManager {
-        VkCommandPool pool     = nullptr;
-        FrameCommands graphics = {};
-        FrameCommands transfer = {};
+    struct FrameCommands {
+        psh::Array<VkCommandBuffer> cmd = {};
     };
 
     struct DescriptorSetManager {
         VkDescriptorSetLayout layout;
+        VkDescriptorSetLayout tile_data_layout;
         VkDescriptorPool      pool;
-        VkDescriptorSet       uniform_buf_descriptor_set;
+        VkDescriptorSet       lcd_texture_descriptor_set;
+        VkDescriptorSet       native_descriptor_set;
+        VkDescriptorSet       tile_data_descriptor_set;
+
+        /// Storage buffer sets reading the LCD frame and the tile data in place from the slice of
+        /// each frame in flight. Only allocated when the staging ring is zero-copy.
+        psh::Array<VkDescriptorSet> lcd_frame_descriptor_sets       = {};
+        psh::Array<VkDescriptorSet> tile_data_frame_descriptor_sets = {};
     };
 
     struct RenderDataInfo {
-        usize size;
-        usize offset;
-        u32   vertex_count;
-        u32   instance_count;
-        u32   first_vertex_index   = 0;
-        u32   first_instance_index = 0;
+        u32 vertex_count;
+        u32 instance_count;
+        u32 first_vertex_index   = 0;
+        u32 first_instance_index = 0;
     };
 
     struct GraphicsCmdInfo {
+        // Composition of the frame at the native resolution of the LCD.
+        VkPipeline       native_pipeline;
+        VkPipelineLayout native_pipeline_layout;
+        RenderPass       native_render_pass;
+        VkFramebuffer    native_frame_buf;
+        VkImage          native_image;
+        VkImageView      native_view;
+        VkDescriptorSet  native_descriptor_set;
+
+        // Scaling of the composed frame to the swap chain image.
         VkPipeline       pipeline;
         VkPipelineLayout pipeline_layout;
         VkImage          image;
+        VkImageView      image_view;
         RenderPass       render_pass;
         VkFramebuffer    frame_buf;
         VkExtent2D       surface_extent;
-        VkBuffer         vertex_buf;
-        u32              vertex_buf_binding;
-        VkDescriptorSet  uniform_buf_descriptor_set;
-        u32              uniform_buf_offset;
+        VkDescriptorSet  descriptor_set;
+
+        // Resources written by the transfer queue family, acquired before they are sampled.
+        VkImage  lcd_image;
+        bool     lcd_valid;
+        VkBuffer tile_data_buf;
+        usize    tile_data_size;
+    };
+
+    /// Graphics commands of a pair of frame in flight and swap chain image. They are recorded once
+    /// and resubmitted for as long as the information they were recorded with stays the same.
+    struct RecordedGraphicsCmd {
+        VkCommandBuffer cmd         = nullptr;
+        GraphicsCmdInfo info        = {};
+        RenderDataInfo  data_info   = {};
+        bool            is_recorded = false;
+    };
+
+    struct CommandManager {
+        VkCommandPool                   pool                 = nullptr;
+        VkCommandPool                   transfer_pool        = nullptr;
+        psh::Array<RecordedGraphicsCmd> graphics             = {};  ///< Frame-major, then image.
+        u32                             graphics_image_count = 0;
+        FrameCommands                   transfer             = {};
+    };
+
+    /// Pipeline cache persisted to disk between launches, one file per device and driver.
+    struct PipelineCache {
+        VkPipelineCache handle      = nullptr;
+        usize           loaded_size = 0;  ///< Size of the data seeded from disk, if any.
     };
 
     struct Pipeline {
@@ -254,7 +346,20 @@ namespace mina {
     };
 
     struct PipelineManager {
+        /// Scaling of the native target to the swap chain image.
         Pipeline graphics{};
+
+        /// Composition of the uploaded LCD texture into the native target, where post-processing
+        /// is applied at the resolution of the LCD.
+        Pipeline compose{};
+
+        /// Fullscreen pipeline composing the LCD from the raw video memory into the native
+        /// target. Shares the render pass of the `compose` pipeline.
+        Pipeline tile_renderer{};
+
+        /// Replacement of `compose` reading the LCD frame in place from the zero-copy staging
+        /// ring. Shares the render pass of the `compose` pipeline.
+        Pipeline lcd_buffer{};
     };
 
     struct SwapChainInfo {
@@ -277,6 +382,41 @@ namespace mina {
         .layerCount     = 1,
     };
 
+    /// Latency policy of the presentation engine, ordered from the smoothest to the lowest
+    /// latency output.
+    enum struct PresentPolicy {
+        /// Wait for the vertical blank, queueing every presented frame (vsync).
+        FIFO,
+        /// Wait for the vertical blank, replacing the queued frame by the newest one.
+        MAILBOX,
+        /// Present right away, at the cost of tearing.
+        IMMEDIATE,
+    };
+
+    struct PresentConfig {
+        PresentPolicy policy = PresentPolicy::FIFO;
+
+        /// Number of frames the CPU may record ahead of the GPU. A single frame in flight gives
+        /// the lowest latency, zero lets the swap chain decide based on its image count.
+        u32 frames_in_flight = 0;
+    };
+
+    /// Swap chain replaced by a recreation, whose resources are kept alive until the frames in
+    /// flight that still use its images retire.
+    struct RetiredSwapChain {
+        VkSwapchainKHR            handle         = nullptr;
+        psh::Array<VkImageView>   image_views    = {};
+        psh::Array<VkFramebuffer> frame_bufs     = {};
+        u32                       pending_frames = 0;  ///< Bit mask of the frames in flight.
+    };
+
+    /// Maximum number of swap chains waiting for their frames in flight to retire.
+    constexpr u32 MAX_RETIRED_SWAP_CHAINS = 4;
+
+    /// Upper bound of the frames in flight, keeping them within the bit masks of the retired swap
+    /// chains. More frames would only add latency.
+    constexpr u32 MAX_FRAMES_IN_FLIGHT = 8;
+
     struct SwapChain {
         VkSwapchainKHR            handle               = nullptr;
         psh::Array<VkImage>       images               = {};
@@ -284,29 +424,49 @@ namespace mina {
         psh::Array<VkFramebuffer> frame_bufs           = {};
         VkExtent2D                extent               = {};
         VkSurfaceFormatKHR        surface_format       = {};
+        PresentConfig             present_config       = {};
+        VkPresentModeKHR          present_mode         = VK_PRESENT_MODE_FIFO_KHR;
         u32                       max_frames_in_flight = 0;
         u32                       current_image_index  = 0;
         u32                       current_frame        = 0;
+
+        /// Retired swap chains, followed by the spare image view and frame buffer arrays that
+        /// the next retirements swap with the ones of the current swap chain.
+        psh::Buffer<RetiredSwapChain, MAX_RETIRED_SWAP_CHAINS> retired       = {};
+        u32                                                    retired_count = 0;
     };
 
     struct QueueFamilies {
         VkQueue graphics_queue = nullptr;
         VkQueue present_queue  = nullptr;
+        VkQueue transfer_queue = nullptr;
         u32     graphics_queue_index;
         u32     present_queue_index;
+        u32     transfer_queue_index;  ///< Same as the graphics family if there's no dedicated one.
 
+        /// Indices of the graphics and presentation queue families.
         inline psh::FatPtr<u32 const> indices() const {
             return psh::FatPtr{&this->graphics_queue_index, 2};
         }
 
         inline psh::DynArray<u32> unique_indices(psh::Arena* arena) const {
-            psh::DynArray<u32> uidx{arena, 2};
+            psh::DynArray<u32> uidx{arena, 3};
             uidx.push(graphics_queue_index);
             if (psh_unlikely(present_queue_index != graphics_queue_index)) {
                 uidx.push(present_queue_index);
             }
+            if (transfer_queue_index != graphics_queue_index &&
+                transfer_queue_index != present_queue_index) {
+                uidx.push(transfer_queue_index);
+            }
             return uidx;
         }
+
+        /// Whether uploads run on a transfer-only queue family, requiring ownership transfers of
+        /// the resources shared with the graphics queue.
+        inline bool has_dedicated_transfer() const {
+            return transfer_queue_index != graphics_queue_index;
+        }
     };
 
     enum AttribFormat {
@@ -52,7 +52,8 @@
 #    define mina_vk_assert_msg(res, msg) (void)(res)
 #endif
 
-#define MINA_CLEAR_COLOR 1.0f, 0.0f, 1.0f, 1.0f
+/// Color of the borders left around the integer scaled LCD.
+#define MINA_CLEAR_COLOR 0.0f, 0.0f, 0.0f, 1.0f
 
 namespace mina {
     bool has_validation_layers(
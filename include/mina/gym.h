@@ -0,0 +1,112 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Gym-style C interface over the emulation core, for training harnesses that drive
+///              many emulator instances from another language.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+///
+/// Observations are never copied out of an instance: the frame and memory views returned by the
+/// interface point straight into the instance, stay valid until it is destroyed, and their
+/// contents are updated in place by each call to `mina_gym_step` or `mina_gym_reset`.
+///
+/// The header only depends on the C standard library so that it can be consumed by C and by
+/// foreign function interfaces.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#    if defined(MINA_GYM_BUILD)
+#        define MINA_GYM_API __declspec(dllexport)
+#    else
+#        define MINA_GYM_API __declspec(dllimport)
+#    endif
+#else
+#    define MINA_GYM_API __attribute__((visibility("default")))
+#endif
+
+#if defined(__cplusplus)
+extern "C" {
+#endif
+
+/// Opaque emulator instance.
+typedef struct MinaGym MinaGym;
+
+/// Buttons of an action, any combination of them may be pressed at once.
+enum {
+    MINA_GYM_BUTTON_A      = 1 << 0,
+    MINA_GYM_BUTTON_B      = 1 << 1,
+    MINA_GYM_BUTTON_SELECT = 1 << 2,
+    MINA_GYM_BUTTON_START  = 1 << 3,
+    MINA_GYM_BUTTON_RIGHT  = 1 << 4,
+    MINA_GYM_BUTTON_LEFT   = 1 << 5,
+    MINA_GYM_BUTTON_UP     = 1 << 6,
+    MINA_GYM_BUTTON_DOWN   = 1 << 7,
+};
+
+typedef struct MinaGymConfig {
+    uint32_t frame_skip;   ///< Frames run by a step not asking for a frame count, at least 1.
+    uint8_t  pool_frames;  ///< Observe the darker of each pixel of the last two frames of a step.
+    uint8_t  downsample;   ///< Observe frames downsampled to half of the LCD resolution.
+} MinaGymConfig;
+
+/// View of the observed frame, one byte of gray intensity per pixel (`0xFF` being white).
+typedef struct MinaGymFrame {
+    uint8_t const* pixels;
+    uint32_t       width;
+    uint32_t       height;
+} MinaGymFrame;
+
+/// View of the work RAM (0xC000 to 0xDFFF) and high RAM (0xFF80 to 0xFFFE) of an instance.
+typedef struct MinaGymRam {
+    uint8_t* wram;
+    size_t   wram_size;
+    uint8_t* hram;
+    size_t   hram_size;
+} MinaGymRam;
+
+/// Load a ROM and create an instance running it, reset with a seed of zero.
+///
+/// A null configuration uses a frame skip of 1 with neither pooling nor downsampling. Returns
+/// null if the ROM couldn't be loaded.
+MINA_GYM_API MinaGym* mina_gym_create(char const* rom_path, MinaGymConfig const* config);
+
+/// Destroy an instance. The ROM is only released with the last instance sharing it.
+MINA_GYM_API void mina_gym_destroy(MinaGym* gym);
+
+/// Restart the ROM from the state left by the boot ROM. A non-zero seed fills the work RAM with
+/// pseudo-random contents, a seed of zero keeps it cleared.
+MINA_GYM_API void mina_gym_reset(MinaGym* gym, uint64_t seed);
+
+/// Hold the buttons of the action for the given amount of frames, zero using the configured
+/// frame skip. Returns the total amount of frames run by the instance since its last reset.
+MINA_GYM_API uint64_t mina_gym_step(MinaGym* gym, uint8_t action, uint32_t frame_count);
+
+MINA_GYM_API MinaGymFrame mina_gym_get_framebuffer(MinaGym const* gym);
+
+MINA_GYM_API MinaGymRam mina_gym_get_ram(MinaGym* gym);
+
+/// Create a new instance with the exact state of another one, sharing its ROM. The clone and the
+/// original evolve independently from then on.
+MINA_GYM_API MinaGym* mina_gym_clone_state(MinaGym const* gym);
+
+#if defined(__cplusplus)
+}
+#endif
@@ -0,0 +1,34 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Fast non-cryptographic hashing of memory regions.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <psh/types.h>
+
+namespace mina {
+    /// Compute a 64-bit hash of a memory region.
+    ///
+    /// The algorithm is the xxHash64 hash: the input is consumed in stripes of 32 bytes, each
+    /// stripe being split into four independent 64-bit lanes, which allows the CPU to process the
+    /// lanes in parallel. This is meant for change detection (frames, states, ROMs), never for
+    /// anything security related.
+    u64 hash_memory(u8 const* buf, usize size, u64 seed = 0) noexcept;
+}  // namespace mina
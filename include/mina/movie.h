@@ -0,0 +1,129 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Input movies, logs of the buttons held in each frame of a run, replayed
+///              deterministically from the state they were recorded from.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/core.h>
+#include <mina/savestate.h>
+#include <psh/memory_manager.h>
+#include <psh/string.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Identifies a file as a movie, reads as "MNMV" in memory.
+    constexpr u32 MOVIE_MAGIC = 0x564D4E4D;
+
+    /// Version of the movie file layout, bumped by any change to it or to `SaveState`.
+    constexpr u32 MOVIE_VERSION = 2;
+
+    struct MovieHeader {
+        u32 magic              = MOVIE_MAGIC;
+        u32 version            = MOVIE_VERSION;
+        u64 cart_hash          = 0;  ///< Hash of the cartridge contents the movie was recorded on.
+        u64 frame_count        = 0;  ///< Frames whose buttons were logged.
+        u32 keyframe_interval  = 0;
+        u32 keyframe_count     = 0;  ///< Keyframes recorded after the initial state.
+        u64 keyframe_data_size = 0;  ///< Bytes taken by the encoded keyframes.
+    };
+
+    struct MovieConfig {
+        u64   max_frames           = 216000;  ///< An hour of frames.
+        u32   keyframe_interval    = 600;     ///< Ten seconds of frames.
+        usize keyframe_buffer_size = psh_mebibytes(8);
+    };
+
+    /// Movie of a run of a core, starting from the state of the core when the recording started.
+    ///
+    /// The buttons held in each frame are logged as a single byte with a bit per button. Every
+    /// `keyframe_interval` frames, the state of the core is recorded as a keyframe, encoded as its
+    /// XOR delta against the initial state. Seeking to any frame thus costs the decoding of a
+    /// single keyframe and the emulation of less than `keyframe_interval` frames, however long
+    /// the movie is.
+    ///
+    /// A movie file is the header followed by the initial state, the logged buttons, the end
+    /// offset of each keyframe and the encoded keyframes. Files are only portable between
+    /// little-endian hosts.
+    struct Movie {
+        MovieHeader header               = {};
+        u64         max_frames           = 0;
+        u32         max_keyframes        = 0;
+        usize       keyframe_buffer_size = 0;
+        SaveState*  initial              = nullptr;  ///< Reference of every keyframe.
+        SaveState*  scratch              = nullptr;
+        u8*         buttons              = nullptr;  ///< Buttons held in each frame.
+        u64*        keyframe_ends        = nullptr;  ///< End of each keyframe in their data.
+        u8*         keyframe_data        = nullptr;
+    };
+
+    enum struct MovieStatus {
+        OK,
+        FULL,             ///< No room for recording another frame.
+        END_OF_MOVIE,     ///< The frame is past the last frame of the movie.
+        OUT_OF_SYNC,      ///< The core isn't at the frame of the movie being recorded.
+        OUT_OF_MEMORY,    ///< Not enough memory for the contents of the movie file.
+        FAILED_TO_OPEN,   ///< The movie file couldn't be opened or read.
+        FAILED_TO_WRITE,  ///< The movie file couldn't be completely written.
+        INVALID_SIZE,     ///< The file is smaller than its contents or they are inconsistent.
+        INVALID_MAGIC,    ///< The file isn't a movie.
+        INVALID_VERSION,  ///< The file was recorded with another layout version.
+        WRONG_CARTRIDGE,  ///< The movie was recorded on another cartridge.
+        CORRUPT,          ///< A state of the movie doesn't decode to a state of its run.
+    };
+
+    /// Allocate a movie starting from the current state of the core.
+    void init_movie(
+        Movie&             movie,
+        psh::Arena*        arena,
+        Core const&        core,
+        MovieConfig const& config) noexcept;
+
+    /// Frame of the movie the core is at, that is, the amount of frames the core ran since the
+    /// initial state of the movie.
+    u64 movie_frame(Movie const& movie, Core const& core) noexcept;
+
+    /// Run the next frame of the core with the buttons it holds, logging them to the movie. The
+    /// core has to be at the end of the movie.
+    MovieStatus record_movie_frame(Movie& movie, Core& core) noexcept;
+
+    /// Run the frame of the core with the buttons logged for it.
+    MovieStatus play_movie_frame(Movie const& movie, Core& core) noexcept;
+
+    /// Bring the core to the given frame of the movie, from the closest keyframe before it. The
+    /// core is left untouched if the keyframe is corrupt.
+    MovieStatus seek_movie(Movie& movie, Core& core, u64 frame) noexcept;
+
+    /// Drop every frame of the movie from the given one on, so that the recording can resume
+    /// from it.
+    void truncate_movie(Movie& movie, u64 frame) noexcept;
+
+    MovieStatus write_movie_file(Movie const& movie, psh::StringView path) noexcept;
+
+    /// Read a movie file, allocating the movie with room for at least the given configuration,
+    /// so that the recording can go on after it. The initial state and every keyframe are
+    /// checked as `load_state` would, so that seeking a loaded movie never fails.
+    MovieStatus load_movie_file(
+        Movie&             movie,
+        psh::Arena*        arena,
+        psh::StringView    path,
+        MovieConfig const& config) noexcept;
+}  // namespace mina
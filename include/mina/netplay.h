@@ -0,0 +1,225 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Two-player netplay, with each peer running the cores of both players in lockstep
+///              and rolling back whenever the prediction of the remote buttons was wrong.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/cartridge.h>
+#include <mina/core.h>
+#include <mina/savestate.h>
+#include <psh/memory_manager.h>
+#include <psh/types.h>
+
+namespace mina {
+    constexpr u32 NETPLAY_PLAYER_COUNT = 2;
+
+    /// Upper bounds of the frames a peer may run ahead of the buttons it received, and of the
+    /// frames by which the local buttons are delayed.
+    constexpr u32 NETPLAY_MAX_ROLLBACK    = 15;
+    constexpr u32 NETPLAY_MAX_INPUT_DELAY = 8;
+
+    /// Frames of buttons kept by a session, enough for every frame that may still be rolled
+    /// back, delayed or unacknowledged.
+    constexpr u32 NETPLAY_INPUT_RING_SIZE = 128;
+
+    /// Upper bound on the amount of frames of buttons carried by a packet.
+    constexpr u32 NETPLAY_MAX_PACKET_INPUTS = 64;
+
+    /// Upper bound on the size of a packet sent through a transport.
+    constexpr usize NETPLAY_MAX_PACKET_SIZE = 24 + NETPLAY_MAX_PACKET_INPUTS;
+
+    /// Unreliable and unordered delivery of packets between two peers. Packets may be lost,
+    /// duplicated or reordered, the session only relies on their contents being intact.
+    struct NetplayTransport {
+        void* user = nullptr;
+
+        /// Send a packet, returning false if it couldn't be sent.
+        bool (*send)(void* user, u8 const* packet, usize size) noexcept = nullptr;
+
+        /// Receive a single pending packet into the buffer, returning its size or zero if there
+        /// was none.
+        usize (*receive)(void* user, u8* buffer, usize capacity) noexcept = nullptr;
+    };
+
+    struct NetplayConfig {
+        u32 local_player = 0;  ///< Player whose buttons are given to the local session.
+        u32 input_delay  = 2;  ///< Frames between sampling the local buttons and running them.
+        u32 max_rollback = 8;  ///< Frames that may be run ahead of the remote buttons.
+    };
+
+    struct NetplayStats {
+        u64 rollback_count       = 0;
+        u64 resimulated_frames   = 0;    ///< Frames of both cores run again by rollbacks.
+        f64 rollback_seconds     = 0.0;  ///< Time spent restoring and re-running frames.
+        f64 max_rollback_seconds = 0.0;  ///< Slowest single rollback.
+        u64 stall_count          = 0;    ///< Host frames without any progress.
+        u64 packets_sent         = 0;
+        u64 packets_received     = 0;
+        u64 packets_rejected     = 0;    ///< Malformed packets, or from another cartridge.
+    };
+
+    /// Netplay session of a peer.
+    ///
+    /// Each peer runs a core per player, all of them from the same cartridge and initial state.
+    /// Every frame, the buttons of each player drive the core of that player. The local buttons
+    /// are known right away, while the remote ones are predicted to be the same as the last ones
+    /// received. Each frame's state is saved before it runs, and once the remote buttons of a
+    /// frame arrive and differ from the prediction, both cores are restored to that frame and
+    /// every frame since then is run again. A peer stalls rather than run more than
+    /// `max_rollback` frames ahead of the remote buttons.
+    ///
+    /// Every frame, the local buttons not yet acknowledged by the remote peer are sent again, so
+    /// that lost packets only delay them.
+    ///
+    /// NOTE(luiz): the serial port isn't emulated yet, so the two cores don't exchange any data
+    ///             through the link cable. Once it is, both cores should be stepped together
+    ///             within each frame, and the session itself won't need to change.
+    struct NetplaySession {
+        Core             cores[NETPLAY_PLAYER_COUNT] = {};
+        NetplayTransport transport                   = {};
+        u32              local_player                = 0;
+        u32              input_delay                 = 0;
+        u32              max_rollback                = 0;
+
+        u64 frame              = 0;  ///< Next frame to run.
+        u64 local_input_count  = 0;  ///< Local buttons known for every frame before this one.
+        u64 remote_input_count = 0;  ///< Remote buttons received for every frame before this one.
+        u64 remote_ack         = 0;  ///< Local buttons received by the remote peer.
+
+        /// Buttons of each player for each frame, where the remote ones from `remote_input_count`
+        /// on are the predictions used to run the frame.
+        u8 buttons[NETPLAY_PLAYER_COUNT][NETPLAY_INPUT_RING_SIZE] = {};
+
+        /// State of the cores at the start of each of the latest frames.
+        SaveState* states = nullptr;
+
+        NetplayStats stats = {};
+    };
+
+    enum struct NetplayStatus {
+        OK,
+        STALLED,          ///< Too far ahead of the remote peer, the frame wasn't run.
+        WRONG_CARTRIDGE,  ///< The remote peer runs another cartridge.
+    };
+
+    /// Start a session of the cartridge over the given transport, with every core right after
+    /// the boot ROM.
+    void init_netplay(
+        NetplaySession&         session,
+        psh::Arena*             arena,
+        Cartridge const&        cart,
+        NetplayTransport const& transport,
+        NetplayConfig const&    config) noexcept;
+
+    /// Run a host frame of the session with the local buttons just sampled: receive the pending
+    /// packets, roll back if any prediction was wrong, run the next frame and send the local
+    /// buttons.
+    NetplayStatus advance_netplay(NetplaySession& session, u8 local_buttons) noexcept;
+
+    /// Receive the pending packets, roll back if any prediction was wrong and send the local
+    /// buttons again, without running any frame. Keeps the session alive while the host is paused.
+    NetplayStatus poll_netplay(NetplaySession& session) noexcept;
+
+    /// Whether every frame run so far had the buttons of both players confirmed.
+    bool netplay_confirmed(NetplaySession const& session) noexcept;
+
+    //--------------------------------------------------------------------------------------------
+    // In-process loopback transport.
+    //--------------------------------------------------------------------------------------------
+
+    /// Conditions of a loopback channel, with the times in calls to `tick_loopback`.
+    struct LoopbackConfig {
+        u32 delay        = 0;  ///< Delay of every packet.
+        u32 jitter       = 0;  ///< Upper bound of a random delay added to each packet.
+        u32 loss_percent = 0;  ///< Chance of a packet being lost.
+        u64 seed         = 1;
+    };
+
+    struct LoopbackPacket {
+        u64   deliver_at                    = 0;
+        usize size                          = 0;
+        u8    data[NETPLAY_MAX_PACKET_SIZE] = {};
+    };
+
+    /// Packets in flight towards one of the endpoints of a loopback channel.
+    struct LoopbackQueue {
+        LoopbackPacket* packets  = nullptr;
+        u32             count    = 0;
+        u32             capacity = 0;
+    };
+
+    struct LoopbackChannel;
+
+    /// Endpoint of a loopback channel, given as the user data of its transport.
+    struct LoopbackEndpoint {
+        LoopbackChannel* channel = nullptr;
+        u32              index   = 0;
+    };
+
+    /// In-process channel between two endpoints, delivering packets with artificial delay,
+    /// jitter and loss. Jitter may deliver packets out of order, as a network would.
+    struct LoopbackChannel {
+        LoopbackConfig   config       = {};
+        u64              now          = 0;
+        u64              rng          = 0;
+        LoopbackQueue    queues[2]    = {};  ///< Packets in flight towards each endpoint.
+        LoopbackEndpoint endpoints[2] = {};
+        u64              lost_count   = 0;
+    };
+
+    /// Allocate a channel with room for `capacity` packets in flight towards each endpoint,
+    /// packets sent beyond that are lost.
+    void init_loopback(
+        LoopbackChannel&      channel,
+        psh::Arena*           arena,
+        LoopbackConfig const& config,
+        u32                   capacity) noexcept;
+
+    /// Transport of one of the two endpoints of the channel.
+    NetplayTransport loopback_transport(LoopbackChannel& channel, u32 endpoint) noexcept;
+
+    /// Advance the time of the channel, usually once per host frame.
+    void tick_loopback(LoopbackChannel& channel) noexcept;
+
+    //--------------------------------------------------------------------------------------------
+    // UDP transport.
+    //--------------------------------------------------------------------------------------------
+
+    /// Non-blocking UDP socket exchanging packets with a single remote address.
+    struct UdpTransport {
+        i32 socket      = -1;
+        u32 remote_ip   = 0;  ///< IPv4 address, in network byte order.
+        u16 remote_port = 0;  ///< In network byte order.
+    };
+
+    /// Bind a socket to the local port, sending to the given IPv4 address and port. Returns false
+    /// if the socket couldn't be created or bound, or on platforms without POSIX sockets.
+    bool open_udp_transport(
+        UdpTransport& udp,
+        u16           local_port,
+        strptr        remote_ip,
+        u16           remote_port) noexcept;
+
+    void close_udp_transport(UdpTransport& udp) noexcept;
+
+    NetplayTransport udp_transport(UdpTransport& udp) noexcept;
+}  // namespace mina
@@ -0,0 +1,60 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Software rendering of the LCD into 8-bit grayscale frames, meant for consumers
+///              that read the frames on the CPU, such as agents trained on the emulator output.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/memory_map.h>
+#include <mina/ppu/lcd.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Each pixel of a gray frame is a single byte, with the intensity of its DMG shade: `0xFF` for
+    /// white down to `0x00` for black (see `DMG_SHADES`).
+    constexpr u32 GRAY_FRAME_SIZE = LCD_PIXEL_COUNT;
+
+    /// Gray frames downsampled by averaging blocks of 2x2 pixels.
+    constexpr u32 GRAY_HALF_WIDTH      = LCD_WIDTH / 2;
+    constexpr u32 GRAY_HALF_HEIGHT     = LCD_HEIGHT / 2;
+    constexpr u32 GRAY_HALF_FRAME_SIZE = GRAY_HALF_WIDTH * GRAY_HALF_HEIGHT;
+
+    /// Compose the frame currently held by the video memory, following the same rules as the GPU
+    /// tile renderer (`src/shaders/lcd_tiles.frag`).
+    ///
+    /// NOTE(luiz): the PPU isn't timed yet, so the registers in effect at the time of the call
+    ///             are used for every line and raster effects are lost.
+    void render_gray_frame(MemoryMap const& mmap, u8* dst) noexcept;
+
+    /// Pixel-wise minimum of two gray frames of `GRAY_FRAME_SIZE` bytes, that is, the darker of
+    /// each pair of pixels, black being 0x00.
+    ///
+    /// Games often flicker objects on alternate frames, pooling the last two frames keeps them
+    /// visible, as long as they are darker than what lies behind them, which is the common case
+    /// on the light backgrounds of the DMG.
+    void min_pool_gray_frames(u8 const* frame_a, u8 const* frame_b, u8* dst) noexcept;
+
+    /// Downsample a gray frame to `GRAY_HALF_WIDTH` by `GRAY_HALF_HEIGHT` pixels.
+    ///
+    /// Each destination pixel is the rounded average of the vertical pairs of its 2x2 block,
+    /// followed by the rounded average of the resulting horizontal pair. This is the rounding
+    /// natively done by the byte averaging SIMD instructions.
+    void downsample_gray_frame(u8 const* src, u8* dst) noexcept;
+}  // namespace mina
@@ -0,0 +1,35 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Game Boy LCD screen properties.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <psh/types.h>
+
+namespace mina {
+    constexpr u32 LCD_WIDTH       = 160;  ///< Number of pixels in each line of the screen.
+    constexpr u32 LCD_HEIGHT      = 144;  ///< Number of lines of the screen.
+    constexpr u32 LCD_PIXEL_COUNT = LCD_WIDTH * LCD_HEIGHT;
+
+    /// Host pixels are stored as 8-bit RGBA, in this exact memory order.
+    constexpr u32 LCD_BYTES_PER_PIXEL = 4;
+    constexpr u32 LCD_ROW_SIZE        = LCD_WIDTH * LCD_BYTES_PER_PIXEL;
+    constexpr u32 LCD_FRAME_SIZE      = LCD_PIXEL_COUNT * LCD_BYTES_PER_PIXEL;
+}  // namespace mina
@@ -0,0 +1,98 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Conversion of the PPU pixel output to host RGBA colors.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/memory_map.h>
+#include <mina/ppu/lcd.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Pixel IDs.
+    ///
+    /// The PPU outputs, for each pixel, a 6-bit ID composed of the palette slot that should be used
+    /// in the upper 4 bits and the 2-bit color ID of the pixel in the lowest 2 bits:
+    ///
+    ///                         +---+---+---+---+---+---+---+---+
+    ///                         | 0 | 0 |    slot       | color |
+    ///                         +---+---+---+---+---+---+---+---+
+    ///
+    /// In DMG mode only the first three slots are used, whereas CGB mode uses the first 8 slots
+    /// for the background palettes and the remaining 8 for the object palettes.
+    constexpr u8 PALETTE_SLOT_COUNT        = 16;
+    constexpr u8 DMG_BG_PALETTE_SLOT       = 0;  ///< Background and window (BGP).
+    constexpr u8 DMG_OBJ0_PALETTE_SLOT     = 1;  ///< Objects using OBP0.
+    constexpr u8 DMG_OBJ1_PALETTE_SLOT     = 2;  ///< Objects using OBP1.
+    constexpr u8 CGB_BG_PALETTE_SLOT_BASE  = 0;
+    constexpr u8 CGB_OBJ_PALETTE_SLOT_BASE = 8;
+
+    constexpr u8 make_pixel_id(u8 slot, VideoRAM::ColorID color) noexcept {
+        return static_cast<u8>(((slot & 0x0F) << 2) | (static_cast<u8>(color) & 0b11));
+    }
+
+    /// Host colors of the four DMG shades of gray, in RGBA memory order.
+    struct DMGShade {
+        u8 red;
+        u8 green;
+        u8 blue;
+    };
+    constexpr DMGShade DMG_SHADES[4] = {
+        {0xFF, 0xFF, 0xFF},  // White.
+        {0xAA, 0xAA, 0xAA},  // Light gray.
+        {0x55, 0x55, 0x55},  // Dark gray.
+        {0x00, 0x00, 0x00},  // Black.
+    };
+
+    /// Lookup table mapping pixel IDs to host RGBA colors.
+    ///
+    /// The table is stored in planar form (one 64 byte plane per color channel) so that each
+    /// plane can be looked up with byte shuffles, 16 pixels at a time.
+    struct PaletteTable {
+        static constexpr usize ENTRY_COUNT = PALETTE_SLOT_COUNT * 4;
+
+        alignas(16) u8 red[ENTRY_COUNT]{};
+        alignas(16) u8 green[ENTRY_COUNT]{};
+        alignas(16) u8 blue[ENTRY_COUNT]{};
+        alignas(16) u8 alpha[ENTRY_COUNT]{};
+
+        // Snapshot of the DMG palette registers used to build the current table.
+        u8   bgp       = 0x00;
+        u8   obp0      = 0x00;
+        u8   obp1      = 0x00;
+        bool dmg_valid = false;
+    };
+
+    /// Rebuild the DMG entries of the table from the BGP, OBP0 and OBP1 registers.
+    ///
+    /// The table is only rebuilt if any of the palette registers changed since the last call,
+    /// returns whether the table was rebuilt.
+    bool update_dmg_palette_table(PaletteTable& table, HwRegisterBank const& reg) noexcept;
+
+    /// Set the entries of a CGB palette slot from its 8 bytes of palette RAM data (four
+    /// little-endian RGB555 colors).
+    void set_cgb_palette(PaletteTable& table, u8 slot, u8 const* palette_data) noexcept;
+
+    /// Convert a whole scanline of `LCD_WIDTH` pixel IDs to host RGBA colors.
+    ///
+    /// The destination is meant to be the scanline memory of a mapped staging buffer, so that no
+    /// intermediate copy of the frame is needed.
+    void convert_scanline(PaletteTable const& table, u8 const* pixel_ids, u8* dst) noexcept;
+}  // namespace mina
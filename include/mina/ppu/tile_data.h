@@ -0,0 +1,62 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Raw video memory snapshots consumed by the GPU tile renderer.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/memory_map.h>
+#include <mina/ppu/lcd.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Snapshot of the PPU registers in effect while a given line was being drawn.
+    ///
+    /// Games often change these registers mid-frame (raster effects), so the renderer needs one
+    /// copy of them per line.
+    struct LineRegisters {
+        u8 lcdc = 0x00;
+        u8 scy  = 0x00;
+        u8 scx  = 0x00;
+        u8 wy   = 0x00;
+        u8 wx   = 0x00;
+        u8 bgp  = 0x00;
+        u8 obp0 = 0x00;
+        u8 obp1 = 0x00;
+    };
+
+    /// Everything the GPU tile renderer needs in order to compose a frame.
+    ///
+    /// The layout of this structure is mirrored by the `std430` storage buffer declared in the
+    /// shader `src/shaders/lcd_tiles.frag` and is uploaded without any conversion.
+    struct TileRendererInput {
+        VideoRAM      vram{};
+        SpriteOAM     oam{};
+        LineRegisters lines[LCD_HEIGHT]{};
+    };
+
+    /// Copy the video RAM and the sprite attribute table.
+    void snapshot_video_memory(TileRendererInput& input, MemoryMap const& mmap) noexcept;
+
+    /// Copy the PPU registers that are in effect for the given line.
+    void snapshot_line_registers(
+        TileRendererInput&    input,
+        HwRegisterBank const& reg,
+        u32                   line) noexcept;
+}  // namespace mina
@@ -0,0 +1,114 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Rewind buffer, recording the state of a core every frame as compressed deltas.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/core.h>
+#include <mina/savestate.h>
+#include <psh/memory_manager.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Upper bound on the size of the XOR delta encoding of `size` bytes.
+    constexpr usize max_xor_delta_size(usize size) noexcept {
+        return size + 2 * ((size / 8) + 1) * 5;
+    }
+
+    /// Encode the XOR difference between `size` bytes of `src` and of a reference into `dst`,
+    /// which should have room for `max_xor_delta_size(size)` bytes.
+    ///
+    /// The encoding is a sequence of pairs of runs, each pair being the LEB128 length of a run of
+    /// bytes equal to the reference, the LEB128 length of the following run of distinct bytes and
+    /// then the XOR of the distinct bytes with the reference. Distinct runs are only broken by
+    /// runs of at least 8 equal bytes. The runs of equal bytes are scanned 16 bytes at a time.
+    ///
+    /// Returns the size of the encoded delta.
+    usize encode_xor_delta(u8 const* src, u8 const* reference, usize size, u8* dst) noexcept;
+
+    /// Rebuild `size` bytes from their encoded XOR delta against the reference.
+    ///
+    /// The delta may come from an untrusted source: returns false if it is malformed or doesn't
+    /// fit within `size` bytes, in which case the contents of `dst` are unspecified.
+    [[nodiscard]] bool decode_xor_delta(
+        u8 const* delta,
+        usize     delta_size,
+        u8 const* reference,
+        usize     size,
+        u8*       dst) noexcept;
+
+    struct RewindConfig {
+        usize buffer_size       = psh_mebibytes(4);  ///< Memory for the encoded states.
+        u32   max_entries       = 8192;              ///< Maximum amount of recorded states.
+        u32   keyframe_interval = 60;                ///< Frames between consecutive keyframes.
+    };
+
+    struct RewindEntry {
+        usize offset   = 0;  ///< Position of the encoded state in the buffer data.
+        u32   size     = 0;
+        bool  keyframe = false;
+    };
+
+    /// Ring of the states of a core, recorded once per frame.
+    ///
+    /// Every `keyframe_interval` frames a keyframe is recorded as the delta of the state against
+    /// the base state, taken when the buffer is initialized. Every other state is recorded as its
+    /// delta against the latest keyframe. Restoring any state thus decodes at most two deltas.
+    ///
+    /// When the buffer is full, the oldest keyframe and every delta depending on it are dropped.
+    struct RewindBuffer {
+        u8*          data              = nullptr;  ///< Ring of encoded states.
+        usize        data_size         = 0;
+        usize        data_head         = 0;        ///< Where the next encoded state goes.
+        RewindEntry* entries           = nullptr;  ///< Ring of recorded states, oldest first.
+        u32          max_entries       = 0;
+        u32          first_entry       = 0;
+        u32          entry_count       = 0;
+        u32          keyframe_interval = 0;
+        u32          since_keyframe    = 0;        ///< States recorded since the latest keyframe.
+        SaveState*   base              = nullptr;  ///< Reference of the keyframes.
+        SaveState*   keyframe          = nullptr;  ///< Latest keyframe, reference of the deltas.
+        SaveState*   scratch           = nullptr;
+        u8*          encoded           = nullptr;  ///< Scratch space for encoding a state.
+        u64          encoded_bytes     = 0;        ///< Size of every state recorded so far.
+        u64          recorded_count    = 0;        ///< Amount of states recorded so far.
+    };
+
+    /// Allocate a rewind buffer for the given core, using its current state as the base state.
+    void init_rewind(
+        RewindBuffer&       rewind,
+        psh::Arena*         arena,
+        Core const&         core,
+        RewindConfig const& config) noexcept;
+
+    /// Record the current state of the core.
+    void record_rewind_state(RewindBuffer& rewind, Core const& core) noexcept;
+
+    /// Restore the core to the state recorded `steps` states before the latest one, dropping
+    /// every state recorded after it. A step count of zero restores the latest state.
+    ///
+    /// Returns false and leaves the core untouched if not that many states were recorded, or if
+    /// the core runs another cartridge. Should a recorded state fail to decode, every state is
+    /// dropped and false is returned as well.
+    bool rewind_core(RewindBuffer& rewind, Core& core, u32 steps) noexcept;
+
+    /// Drop every recorded state, keeping the base state.
+    void clear_rewind(RewindBuffer& rewind) noexcept;
+}  // namespace mina
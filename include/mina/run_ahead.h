@@ -0,0 +1,72 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Run-ahead, hiding the input lag of a game by presenting frames emulated ahead of
+///              the host with the current input.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/core.h>
+#include <mina/savestate.h>
+#include <psh/memory_manager.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Upper bound on the amount of frames emulated ahead of the host.
+    constexpr u32 MAX_RUN_AHEAD_FRAMES = 8;
+
+    /// Time spent in each phase of the host frames run so far, in seconds.
+    struct RunAheadStats {
+        u64 host_frame_count = 0;
+        f64 frame_seconds    = 0.0;  ///< Emulation of the frames that are kept.
+        f64 save_seconds     = 0.0;
+        f64 restore_seconds  = 0.0;
+        f64 ahead_seconds    = 0.0;  ///< Emulation of the frames that are thrown away.
+        f64 max_host_seconds = 0.0;  ///< Slowest host frame, all phases included.
+    };
+
+    /// Every host frame, the core emulates its next frame and saves its state. The state is then
+    /// restored into a shadow core, which emulates the following `frames` frames with the same
+    /// buttons held. The last of them is the one presented, while the core itself carries on
+    /// from its own state in the next host frame.
+    ///
+    /// Restoring into a shadow core rather than into the core itself means that the core never
+    /// has to be rolled back, and that the presented frame stays readable until the next host
+    /// frame, at the same cost of a save and a restore per host frame.
+    struct RunAhead {
+        u32        frames = 0;  ///< Frames emulated ahead of the host, zero disables run-ahead.
+        SaveState* state  = nullptr;
+        Core*      shadow = nullptr;
+
+        RunAheadStats stats = {};
+    };
+
+    /// Allocate the state of the run-ahead from the arena, the amount of frames is clamped to
+    /// `MAX_RUN_AHEAD_FRAMES`.
+    void init_run_ahead(RunAhead& run_ahead, psh::Arena* arena, u32 frames) noexcept;
+
+    /// Emulate a host frame of the core with the buttons it currently holds.
+    ///
+    /// Returns the core to be presented: the shadow core when running ahead, the core otherwise.
+    Core const& run_ahead_frame(RunAhead& run_ahead, Core& core) noexcept;
+
+    /// Average time spent per host frame in each phase of the run-ahead, in seconds.
+    RunAheadStats mean_run_ahead_stats(RunAheadStats const& stats) noexcept;
+}  // namespace mina
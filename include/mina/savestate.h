@@ -0,0 +1,102 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Savestates of the emulation core, stored as a single fixed-layout binary blob.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#pragma once
+
+#include <mina/core.h>
+#include <mina/cpu/dmg.h>
+#include <mina/memory_map.h>
+#include <psh/fat_ptr.h>
+#include <psh/memory_manager.h>
+#include <psh/string.h>
+#include <psh/types.h>
+
+namespace mina {
+    /// Identifies a blob as a savestate, reads as "MNSS" in memory.
+    constexpr u32 SAVESTATE_MAGIC = 0x53534E4D;
+
+    /// Version of the layout of `SaveState`, bumped by any change to it. States of other versions
+    /// are rejected.
+    constexpr u32 SAVESTATE_VERSION = 2;
+
+    struct SaveStateHeader {
+        u32 magic     = SAVESTATE_MAGIC;
+        u32 version   = SAVESTATE_VERSION;
+        u32 size      = 0;  ///< Size of the whole blob, header included.
+        u32 reserved_ = 0;
+        u64 cart_hash = 0;  ///< Hash of the cartridge contents the state was saved from.
+    };
+
+    /// Snapshot of everything that evolves while a core runs.
+    ///
+    /// A savestate blob is exactly the memory of this structure, so a blob can be saved with a
+    /// single write and loaded (or mapped from a file) with a bounds check and a copy of each
+    /// section. Blobs are only portable between little-endian hosts.
+    ///
+    /// NOTE(luiz): the core has no mapper, PPU, APU or timer of its own yet, the whole of their
+    ///             state lives in their I/O registers, which are part of the memory image. The
+    ///             ROM banks are part of it too, since without a mapper the writes to them
+    ///             land on the banks themselves.
+    struct alignas(64) SaveState {
+        SaveStateHeader header{};
+
+        RegisterFile regfile     = {};
+        u16          bus_addr    = 0x0000;
+        u16          clock       = 0x0000;
+        u8           buttons     = 0;  ///< Buttons held by the player when the state was saved.
+        u64          cycle_count = 0;
+        u64          frame_count = 0;
+
+        /// Image of the whole `MemoryMap`, from 0x0000 to 0xFFFF.
+        alignas(64) u8 memory[sizeof(MemoryMap)]{};
+    };
+
+    enum struct SaveStateStatus {
+        OK,
+        FAILED_TO_OPEN,   ///< The savestate file couldn't be opened or read.
+        FAILED_TO_WRITE,  ///< The savestate file couldn't be completely written.
+        INVALID_SIZE,     ///< The blob is smaller than its header or than the size it declares.
+        INVALID_MAGIC,    ///< The blob isn't a savestate.
+        INVALID_VERSION,  ///< The blob was saved with another layout version.
+        WRONG_CARTRIDGE,  ///< The blob was saved from the run of another cartridge.
+        OUT_OF_MEMORY,    ///< The arena couldn't hold the state read from the file.
+    };
+
+    /// Check that a blob is a savestate of the current layout, saved from the run of the cartridge
+    /// with the given hash. Done by `load_state` before touching the core.
+    SaveStateStatus validate_state(psh::FatPtr<u8 const> blob, u64 cart_hash) noexcept;
+
+    /// Capture the current state of the core.
+    void save_state(Core const& core, SaveState& state) noexcept;
+
+    /// Restore the core from a savestate blob, which must come from a core running the same
+    /// cartridge. The core is left untouched if the blob is rejected.
+    SaveStateStatus load_state(Core& core, psh::FatPtr<u8 const> blob) noexcept;
+
+    SaveStateStatus load_state(Core& core, SaveState const& state) noexcept;
+
+    SaveStateStatus write_state_file(SaveState const& state, psh::StringView path) noexcept;
+
+    /// Restore the core from a savestate file, which is mapped into memory rather than read
+    /// wherever the platform allows it. Otherwise, the file is read into scratch memory of the
+    /// arena, which is released before returning.
+    SaveStateStatus load_state_file(Core& core, psh::Arena* arena, psh::StringView path) noexcept;
+}  // namespace mina
@@ -159,13 +159,14 @@ namespace mina {
     };
 
     /// Configuration used to construct a window.
+    ///
+    /// The presentation timing is decided by the swap chain, see `PresentConfig`.
     struct WindowConfig {
-        void*            user_pointer  = nullptr;
-        psh::Option<i32> x             = {};
-        psh::Option<i32> y             = {};
-        psh::Option<i32> width         = {};
-        psh::Option<i32> height        = {};
-        i32              swap_interval = 1;
+        void*            user_pointer = nullptr;
+        psh::Option<i32> x            = {};
+        psh::Option<i32> y            = {};
+        psh::Option<i32> width        = {};
+        psh::Option<i32> height       = {};
     };
 
     using WindowHandle = GLFWwindow;
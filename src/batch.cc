@@ -0,0 +1,270 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the batch runner.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/batch.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <thread>
+
+#if defined(__linux__)
+#    include <pthread.h>
+#    include <sched.h>
+#elif defined(_WIN32)
+#    define WIN32_LEAN_AND_MEAN
+#    include <windows.h>
+#endif
+
+namespace mina {
+    namespace {
+        /// Hardware threads the workers are pinned to, in the order they are handed out.
+        struct WorkerPlacement {
+            u32 hw_threads[MAX_BATCH_WORKERS] = {};
+            u32 count                         = 0;  ///< Zero leaves the scheduling to the OS.
+        };
+
+#if defined(__linux__)
+        /// Read a sysfs list of CPUs, such as `0-3,8,10-11`, into a set.
+        bool read_cpu_list(char const* path, cpu_set_t& set) noexcept {
+            CPU_ZERO(&set);
+            FILE* file = std::fopen(path, "r");
+            if (file == nullptr) {
+                return false;
+            }
+
+            unsigned first;
+            while (std::fscanf(file, "%u", &first) == 1) {
+                unsigned last = first;
+                int      sep  = std::fgetc(file);
+                if ((sep == '-') && (std::fscanf(file, "%u", &last) == 1)) {
+                    sep = std::fgetc(file);
+                }
+                for (unsigned cpu = first; (cpu <= last) && (cpu < CPU_SETSIZE); ++cpu) {
+                    CPU_SET(cpu, &set);
+                }
+                if (sep != ',') {
+                    break;
+                }
+            }
+            std::fclose(file);
+            return true;
+        }
+
+        /// Pick the hardware threads of the affinity mask of the process, handing out a thread of
+        /// each NUMA node in turn, and within a node the first thread of every physical core
+        /// before any of their SMT siblings.
+        void place_workers(WorkerPlacement& placement) noexcept {
+            placement.count = 0;
+
+            cpu_set_t allowed;
+            if (sched_getaffinity(0, sizeof(cpu_set_t), &allowed) != 0) {
+                return;
+            }
+
+            constexpr u32 MAX_NODES = 64;
+            u8            node_of[CPU_SETSIZE]  = {};
+            u8            smt_rank[CPU_SETSIZE] = {};
+            u32           node_count            = 1;
+
+            // Machines without NUMA have no node directory, every CPU is then on node 0.
+            char path[128];
+            for (u32 node = 0; node < MAX_NODES; ++node) {
+                cpu_set_t node_cpus;
+                std::snprintf(path, sizeof(path), "/sys/devices/system/node/node%u/cpulist", node);
+                if (!read_cpu_list(path, node_cpus)) {
+                    continue;
+                }
+                node_count = psh_max(node_count, node + 1);
+                for (u32 cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                    if (CPU_ISSET(cpu, &node_cpus)) {
+                        node_of[cpu] = static_cast<u8>(node);
+                    }
+                }
+            }
+
+            // The rank of a thread among the allowed SMT siblings of its core.
+            u8 max_rank = 0;
+            for (u32 cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (!CPU_ISSET(cpu, &allowed)) {
+                    continue;
+                }
+                cpu_set_t siblings;
+                std::snprintf(
+                    path,
+                    sizeof(path),
+                    "/sys/devices/system/cpu/cpu%u/topology/thread_siblings_list",
+                    cpu);
+                if (read_cpu_list(path, siblings)) {
+                    u32 rank = 0;
+                    for (u32 sibling = 0; sibling < cpu; ++sibling) {
+                        rank += (CPU_ISSET(sibling, &siblings) && CPU_ISSET(sibling, &allowed))
+                                    ? 1u
+                                    : 0u;
+                    }
+                    smt_rank[cpu] = static_cast<u8>(psh_min(rank, 255u));
+                }
+                max_rank = psh_max(max_rank, smt_rank[cpu]);
+            }
+
+            // Round-robin over the nodes, taking the next thread of each by rank and then by id.
+            u32 next_cpu[MAX_NODES]  = {};
+            u32 next_rank[MAX_NODES] = {};
+            for (bool progress = true; progress && (placement.count < MAX_BATCH_WORKERS);) {
+                progress = false;
+                for (u32 node = 0; (node < node_count) && (placement.count < MAX_BATCH_WORKERS);
+                     ++node) {
+                    for (; next_rank[node] <= max_rank; ++next_rank[node], next_cpu[node] = 0) {
+                        u32& cpu = next_cpu[node];
+                        while ((cpu < CPU_SETSIZE)
+                               && (!CPU_ISSET(cpu, &allowed) || (node_of[cpu] != node)
+                                   || (smt_rank[cpu] != next_rank[node]))) {
+                            ++cpu;
+                        }
+                        if (cpu < CPU_SETSIZE) {
+                            placement.hw_threads[placement.count++] = cpu++;
+                            progress                                = true;
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+#elif defined(_WIN32)
+        /// Pick the hardware threads of the affinity mask of the process, in order.
+        void place_workers(WorkerPlacement& placement) noexcept {
+            placement.count = 0;
+
+            DWORD_PTR process_mask;
+            DWORD_PTR system_mask;
+            if (GetProcessAffinityMask(GetCurrentProcess(), &process_mask, &system_mask) == 0) {
+                return;
+            }
+            for (u32 hw_thread = 0; hw_thread < 8 * sizeof(DWORD_PTR); ++hw_thread) {
+                if ((process_mask & (DWORD_PTR{1} << hw_thread)) != 0) {
+                    placement.hw_threads[placement.count++] = hw_thread;
+                }
+            }
+        }
+#else
+        void place_workers(WorkerPlacement& placement) noexcept {
+            placement.count = 0;
+        }
+#endif
+
+        /// Pin the calling thread to a single hardware thread. Platforms without affinity
+        /// control leave the scheduling to the OS.
+        void pin_current_thread(u32 hw_thread) noexcept {
+#if defined(__linux__)
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(hw_thread, &set);
+            if (pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &set) != 0) {
+                psh_warning_fmt("Unable to pin the worker to the hardware thread %u.", hw_thread);
+            }
+#elif defined(_WIN32)
+            SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR{1} << hw_thread);
+#else
+            psh_discard(hw_thread);
+#endif
+        }
+
+        void run_instance(BatchInstance& instance, BatchConfig const& config) noexcept {
+            instance.core = instance.arena.zero_alloc<Core>(1);
+            psh_assert_msg(instance.core != nullptr, "Instance arena too small for its core");
+
+            init_core(*instance.core, *instance.cart);
+            if (instance.seed != 0) {
+                scramble_work_ram(*instance.core, instance.seed);
+            }
+
+            auto const start = std::chrono::steady_clock::now();
+            if (config.cycle_count != 0) {
+                run_core_cycles(*instance.core, config.cycle_count);
+            } else {
+                for (u64 idx = 0; idx < config.frame_count; ++idx) {
+                    run_core_frame(*instance.core);
+                }
+            }
+            auto const end = std::chrono::steady_clock::now();
+
+            instance.seconds = std::chrono::duration<f64>(end - start).count();
+        }
+
+        void run_worker(
+            psh::FatPtr<BatchInstance> instances,
+            BatchConfig const&         config,
+            u32                        worker,
+            u32                        worker_count,
+            WorkerPlacement const&     placement) noexcept {
+            if (placement.count != 0) {
+                pin_current_thread(placement.hw_threads[worker % placement.count]);
+            }
+
+            for (usize idx = worker; idx < instances.size; idx += worker_count) {
+                instances.buf[idx].worker = worker;
+                run_instance(instances.buf[idx], config);
+            }
+        }
+
+        u32 hardware_thread_count() noexcept {
+            return psh_max(std::thread::hardware_concurrency(), 1u);
+        }
+    }  // namespace
+
+    u32 batch_worker_count(BatchConfig const& config, usize instance_count) noexcept {
+        u32 count = (config.worker_count != 0) ? config.worker_count : hardware_thread_count();
+        count     = psh_min(count, MAX_BATCH_WORKERS);
+        count     = static_cast<u32>(psh_min(static_cast<usize>(count), instance_count));
+        return psh_max(count, 1u);
+    }
+
+    f64 run_batch(psh::FatPtr<BatchInstance> instances, BatchConfig const& config) noexcept {
+        u32 const worker_count = batch_worker_count(config, instances.size);
+
+        WorkerPlacement placement;
+        place_workers(placement);
+
+        auto const start = std::chrono::steady_clock::now();
+        {
+            std::thread workers[MAX_BATCH_WORKERS];
+            for (u32 worker = 0; worker < worker_count; ++worker) {
+                workers[worker] = std::thread{
+                    run_worker,
+                    instances,
+                    std::cref(config),
+                    worker,
+                    worker_count,
+                    std::cref(placement),
+                };
+            }
+            for (u32 worker = 0; worker < worker_count; ++worker) {
+                workers[worker].join();
+            }
+        }
+        auto const end = std::chrono::steady_clock::now();
+
+        return std::chrono::duration<f64>(end - start).count();
+    }
+}  // namespace mina
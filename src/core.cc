@@ -0,0 +1,112 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the emulation core.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/core.h>
+
+#include <mina/hash.h>
+#include <mina/memory_map.h>
+#include <psh/assert.h>
+#include <cstring>
+#include <memory>
+
+namespace mina {
+    void init_core(Core& core, Cartridge const& cart) noexcept {
+        core.cart      = &cart;
+        core.cart_hash = hash_memory(
+            reinterpret_cast<u8 const*>(cart.content.data.buf),
+            cart.content.data.size);
+        reset_core(core);
+    }
+
+    void reset_core(Core& core) noexcept {
+        psh_assert_msg(core.cart != nullptr, "The core has no cartridge to reset to");
+
+        // The memory map has read-only regions, so the CPU is constructed anew instead of assigned.
+        // The whole of it is rewritten outside of the bus, so every page is dirty.
+        std::construct_at(&core.cpu);
+        core.cpu.dirty_pages = ~u64{0};
+        core.cycle_count     = 0;
+        core.frame_count     = 0;
+
+        // Register values after the DMG boot ROM hands control to the cartridge.
+        core.cpu.regfile = RegisterFile{
+            .f     = 0xB0,
+            .a     = 0x01,
+            .c     = 0x13,
+            .b     = 0x00,
+            .e     = 0xD8,
+            .d     = 0x00,
+            .l     = 0x4D,
+            .h     = 0x01,
+            .sp_lo = 0xFE,
+            .sp_hi = 0xFF,
+            .pc    = 0x0100,
+        };
+
+        transfer_fixed_rom_bank(*core.cart, core.cpu.mmap);
+        // TODO(luiz): transfer the remaining memory regions.
+
+        set_cpu_buttons(core.cpu, core.buttons);
+    }
+
+    void scramble_work_ram(Core& core, u64 seed) noexcept {
+        // SplitMix64 generator, enough to decorrelate the contents of neighbouring seeds.
+        u64  state = seed;
+        auto next  = [&state]() -> u64 {
+            state += 0x9E3779B97F4A7C15;
+            u64 z = state;
+            z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z     = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            return z ^ (z >> 31);
+        };
+
+        u8* const   wram      = reinterpret_cast<u8*>(&core.cpu.mmap.fx_wram);
+        usize const wram_size = sizeof(FxWorkRAM) + sizeof(SwWorkRAM);
+        for (usize offset = 0; offset < wram_size; offset += sizeof(u64)) {
+            u64 const value = next();
+            std::memcpy(wram + offset, &value, sizeof(u64));
+        }
+        core.cpu.dirty_pages = ~u64{0};
+    }
+
+    void sync_core_buttons(Core& core) noexcept {
+        if (core.cpu.buttons != core.buttons) {
+            set_cpu_buttons(core.cpu, core.buttons);
+        }
+    }
+
+    void run_core_cycles(Core& core, u64 cycle_count) noexcept {
+        sync_core_buttons(core);
+        for (u64 idx = 0; idx < cycle_count; ++idx) {
+            run_cpu_cycle(core.cpu);
+        }
+
+        u64 const previous_cycles = core.cycle_count;
+        core.cycle_count += cycle_count;
+        core.frame_count += (core.cycle_count / MACHINE_CYCLES_PER_FRAME)
+                            - (previous_cycles / MACHINE_CYCLES_PER_FRAME);
+    }
+
+    void run_core_frame(Core& core) noexcept {
+        u64 const frame_end = (core.frame_count + 1) * MACHINE_CYCLES_PER_FRAME;
+        run_core_cycles(core, frame_end - core.cycle_count);
+    }
+}  // namespace mina
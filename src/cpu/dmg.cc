@@ -25,6 +25,7 @@
 #include <psh/assert.h>
 #include <psh/bit.h>
 #include <psh/intrinsics.h>
+#include <cstring>
 
 // TODO(luiz): implement cycle timing correctness.
 
@@ -85,17 +86,55 @@ namespace mina {
 
 #define cpu_memory(cpu) reinterpret_cast<u8*>(&cpu.mmap)
 
-#define mmap_write_byte(cpu, dst_addr, val_u8)                                      \
-    do {                                                                            \
-        *(cpu_memory(cpu) + static_cast<uptr>(dst_addr)) = static_cast<u8>(val_u8); \
+#define mark_page_dirty(cpu, addr_u16) \
+    (cpu.dirty_pages |= u64{1} << (static_cast<u16>(addr_u16) >> MEMORY_PAGE_SHIFT))
+
+        /// Address of the joypad register, whose input lines follow the half of the buttons
+        /// selected by the last write to it.
+        constexpr u16 P1_ADDR = 0xFF00;
+
+        // Joypad lines selecting which half of the buttons is read through the low nibble of P1.
+        constexpr u8 P1_SELECT_DPAD    = 1 << 4;
+        constexpr u8 P1_SELECT_BUTTONS = 1 << 5;
+
+        void refresh_joypad(CPU& cpu) noexcept {
+            u8 p1;
+            std::memcpy(&p1, &cpu.mmap.reg.p1, sizeof(u8));
+
+            u8 pressed = 0;
+            if ((p1 & P1_SELECT_DPAD) == 0) {
+                pressed |= static_cast<u8>(cpu.buttons >> 4);
+            }
+            if ((p1 & P1_SELECT_BUTTONS) == 0) {
+                pressed |= static_cast<u8>(cpu.buttons & 0x0F);
+            }
+
+            u8 const select = p1 & (P1_SELECT_DPAD | P1_SELECT_BUTTONS);
+            p1              = static_cast<u8>(0xC0 | select | (~pressed & 0x0F));
+            std::memcpy(&cpu.mmap.reg.p1, &p1, sizeof(u8));
+        }
+
+#define mmap_write_byte(cpu, dst_addr, val_u8)                    \
+    do {                                                          \
+        u16 addr__                  = static_cast<u16>(dst_addr); \
+        *(cpu_memory(cpu) + addr__) = static_cast<u8>(val_u8);    \
+        mark_page_dirty(cpu, addr__);                             \
+        if (addr__ == P1_ADDR) {                                  \
+            refresh_joypad(cpu);                                  \
+        }                                                         \
     } while (0)
 
-#define mmap_write_word(cpu, dst_addr, val_u16)              \
-    do {                                                     \
-        u16 addr__                      = (dst_addr);        \
-        u16 val__                       = (val_u16);         \
-        *(cpu_memory(cpu) + addr__)     = psh_u16_lo(val__); \
-        *(cpu_memory(cpu) + addr__ + 1) = psh_u16_hi(val__); \
+#define mmap_write_word(cpu, dst_addr, val_u16)               \
+    do {                                                      \
+        u16 addr__                      = (dst_addr);         \
+        u16 val__                       = (val_u16);          \
+        *(cpu_memory(cpu) + addr__)     = psh_u16_lo(val__);  \
+        *(cpu_memory(cpu) + addr__ + 1) = psh_u16_hi(val__);  \
+        mark_page_dirty(cpu, addr__);                         \
+        mark_page_dirty(cpu, addr__ + 1);                     \
+        if ((addr__ == P1_ADDR) || (addr__ == P1_ADDR - 1)) { \
+            refresh_joypad(cpu);                              \
+        }                                                     \
     } while (0)
 
         u8 bus_read_byte(CPU& cpu, u16 addr) noexcept {
@@ -162,6 +201,10 @@ namespace mina {
                 u8* memory       = cpu_memory(cpu);
                 u16 addr         = read_reg16(cpu, Reg16::HL);
                 *(memory + addr) = val;
+                mark_page_dirty(cpu, addr);
+                if (addr == P1_ADDR) {
+                    refresh_joypad(cpu);
+                }
             } else if (reg == Reg8::A) {
                 cpu.regfile.a = val;
             } else {
@@ -1158,4 +1201,10 @@ namespace mina {
         u8 data = bus_read_pc(cpu);
         dexec(cpu, data);
     }
+
+    void set_cpu_buttons(CPU& cpu, u8 buttons) noexcept {
+        cpu.buttons = buttons;
+        refresh_joypad(cpu);
+        mark_page_dirty(cpu, P1_ADDR);
+    }
 }  // namespace mina
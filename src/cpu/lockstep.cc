@@ -0,0 +1,612 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Lockstep execution of many instances of the same cartridge.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/cpu/lockstep.h>
+
+#include <psh/assert.h>
+#include <psh/bit.h>
+#include <psh/intrinsics.h>
+#include <cstring>
+
+// NOTE(luiz): The handlers of this file mirror, expression by expression, the ones of `dexec` in
+//             `cpu/dmg.cc`, so that a lane evolves exactly as the same core would under
+//             `run_cpu_cycle`. Any change of behaviour in there has to be reflected in here.
+
+namespace mina {
+    namespace {
+        /// Register file flag bits, as in `dmg.cc`.
+        constexpr u8 FLAG_C = 0x04;
+        constexpr u8 FLAG_H = 0x05;
+        constexpr u8 FLAG_N = 0x06;
+        constexpr u8 FLAG_Z = 0x07;
+
+        /// Offsets of the flags and accumulator registers in the register file.
+        constexpr u8 REG_F = 0x00;
+        constexpr u8 REG_A = 0x01;
+
+        /// The 8-bit register operand encoding of the opcodes that refers to the byte at `[HL]`.
+        constexpr u8 OPERAND_HL_PTR = 0x06;
+
+        /// Cartridge ROM region of the memory map, the code shared by every lane.
+        constexpr u32 ROM_END  = SwROMBank::RANGE.end;
+        constexpr u32 ROM_SIZE = ROM_END + 1;
+
+        bool in_rom(u32 addr) noexcept {
+            return (addr & 0xFFFF) <= ROM_END;
+        }
+
+        /// Offset in the register file of the 8-bit register operand of an opcode, which can't be
+        /// `[HL]`. As in `dmg.cc`, every register other than the accumulator is resolved by its
+        /// operand index.
+        constexpr u8 reg8_offset(u8 operand) noexcept {
+            return (operand == 0x07) ? REG_A : operand;
+        }
+
+        /// Lanes of a group, either every lane of the group or a list of them.
+        struct AllLanes {
+            u32 count;
+
+            constexpr u32 operator[](u32 idx) const noexcept {
+                return idx;
+            }
+        };
+        struct LaneList {
+            u32 const* buf;
+            u32        count;
+
+            u32 operator[](u32 idx) const noexcept {
+                return buf[idx];
+            }
+        };
+
+        template <typename Lanes, typename Fn>
+        void for_each_lane(Lanes lanes, Fn fn) noexcept {
+            for (u32 idx = 0; idx < lanes.count; ++idx) {
+                fn(lanes[idx]);
+            }
+        }
+
+        u8 const* lane_memory(LockstepGroup const& group, u32 lane) noexcept {
+            return reinterpret_cast<u8 const*>(&group.lanes[lane].cpu.mmap);
+        }
+
+        /// Amount of bytes read by the lockstep handler of an opcode, or zero if the opcode can
+        /// only be run by `run_cpu_cycle`.
+        u8 lockstep_code_size(u8 opcode) noexcept {
+            u8 const y = psh_bits_at(opcode, 3, 3);
+            u8 const z = psh_bits_at(opcode, 0, 3);
+
+            u8 size = 0;
+            if (opcode == 0x00) {
+                size = 1;  // NOP
+            } else if (opcode < 0x40) {
+                switch (z) {
+                    case 0x00: size = (opcode == 0x18 || y >= 4) ? 2 : 0; break;  // JR
+                    case 0x01: size = ((y & 1) == 0) ? 3 : 0; break;              // LD R16, U16
+                    case 0x03: size = 1; break;                                   // INC/DEC R16
+                    case 0x04:
+                    case 0x05: size = (y != OPERAND_HL_PTR) ? 1 : 0; break;  // INC/DEC R8
+                    case 0x06: size = (y != OPERAND_HL_PTR) ? 2 : 0; break;  // LD R8, U8
+                    default:   break;
+                }
+            } else if (opcode < 0xC0) {
+                // LD R8, R8 and the arithmetic-logic operations on the accumulator.
+                bool const reads_hl  = (z == OPERAND_HL_PTR);
+                bool const writes_hl = (opcode < 0x80) && (y == OPERAND_HL_PTR);
+                size                 = (reads_hl || writes_hl) ? 0 : 1;
+            } else if (z == 0x06) {
+                size = 2;  // Arithmetic-logic operations with an immediate.
+            } else if (opcode == 0xC3 || (z == 0x02 && y < 4)) {
+                size = 3;  // JP U16 and JP CC U16.
+            }
+            return size;
+        }
+
+        /// Whether running an instruction through `run_cpu_cycle` may write to the ROM of the lane.
+        /// Every memory write of `dexec` has to be accounted for in here.
+        bool may_write_rom(LockstepGroup const& group, u32 lane, u8 const* code) noexcept {
+            auto reg16 = [&](u8 offset) {
+                return psh_u16_from_bytes(group.regs[offset + 1][lane], group.regs[offset][lane]);
+            };
+            u16 const hl    = reg16(0x06);
+            u16 const imm16 = psh_u16_from_bytes(code[2], code[1]);
+            u8 const  op    = code[0];
+
+            if (0x70 <= op && op <= 0x77) {
+                return in_rom(hl);  // LD [HL], R8
+            }
+
+            bool res = false;
+            switch (op) {
+                case 0x02: res = in_rom(reg16(0x02)); break;  // LD [BC], A
+                case 0x12: res = in_rom(reg16(0x04)); break;  // LD [DE], A
+                case 0x22:                                     // LDI [HL], A
+                case 0x32:                                     // LDD [HL], A
+                case 0x34:                                     // INC [HL]
+                case 0x35:                                     // DEC [HL]
+                case 0x36: res = in_rom(hl); break;            // LD [HL], U8
+                case 0x08: res = in_rom(imm16) || in_rom(imm16 + 1u); break;  // LD [U16], SP
+                case 0xEA: res = in_rom(imm16); break;                         // LD [U16], A
+                case 0xCB: {
+                    // Prefixed operations acting on [HL].
+                    res = (psh_bits_at(code[1], 0, 3) == OPERAND_HL_PTR) && in_rom(hl);
+                    break;
+                }
+                default: break;
+            }
+            return res;
+        }
+
+        bool condition_holds(u8 flags, u8 cc) noexcept {
+            bool res;
+            switch (cc) {
+                case 0x00: res = (psh_bit_at(flags, FLAG_Z) == 0); break;
+                case 0x01: res = (psh_bit_at(flags, FLAG_Z) != 0); break;
+                case 0x02: res = (psh_bit_at(flags, FLAG_C) == 0); break;
+                default:   res = (psh_bit_at(flags, FLAG_C) != 0); break;
+            }
+            return res;
+        }
+
+        /// Run the arithmetic-logic operation `y` of the accumulator with a value.
+        template <typename Lanes, typename ValueFn>
+        void alu_accumulator(LockstepGroup& group, Lanes lanes, u8 y, ValueFn value) noexcept {
+            u8* const f = group.regs[REG_F];
+            u8* const a = group.regs[REG_A];
+
+            switch (y) {
+                case 0x00: {  // ADD
+                    for_each_lane(lanes, [&](u32 l) {
+                        u8  val = value(l);
+                        u8  acc = a[l];
+                        u16 res = static_cast<u16>(acc + val);
+                        a[l]    = static_cast<u8>(res);
+
+                        f[l] = 0x00;
+                        psh_bit_set_or_clear_if(f[l], FLAG_C, res > 0x00FF);
+                        psh_bit_set_or_clear_if(
+                            f[l],
+                            FLAG_H,
+                            (psh_u8_lo(acc) + psh_u8_lo(val)) > 0x0F);
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, res == 0);
+                    });
+                    break;
+                }
+                case 0x01: {  // ADC
+                    for_each_lane(lanes, [&](u32 l) {
+                        u8  val   = value(l);
+                        u8  acc   = a[l];
+                        u8  carry = psh_bit_at(f[l], FLAG_C);
+                        u16 res   = static_cast<u16>(acc + val + carry);
+                        a[l]      = static_cast<u8>(res);
+
+                        f[l] = 0x00;
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, res == 0);
+                        psh_bit_set_or_clear_if(
+                            f[l],
+                            FLAG_H,
+                            (psh_u8_lo(acc) + psh_u8_lo(val) + carry) > 0x0F);
+                        psh_bit_set_or_clear_if(f[l], FLAG_C, res > 0x00FF);
+                    });
+                    break;
+                }
+                case 0x02: {  // SUB
+                    for_each_lane(lanes, [&](u32 l) {
+                        u8 val = value(l);
+                        u8 acc = a[l];
+                        a[l]   = static_cast<u8>(a[l] - val);
+
+                        psh_bit_set(f[l], FLAG_N);
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, a[l] == 0);
+                        psh_bit_set_or_clear_if(f[l], FLAG_H, psh_u8_lo(val) > psh_u8_lo(acc));
+                        psh_bit_set_or_clear_if(f[l], FLAG_C, val > acc);
+                    });
+                    break;
+                }
+                case 0x03: {  // SBC
+                    for_each_lane(lanes, [&](u32 l) {
+                        u8 val   = value(l);
+                        u8 acc   = a[l];
+                        u8 carry = psh_bit_at(f[l], FLAG_C);
+                        a[l]     = static_cast<u8>(a[l] - (val - carry));
+
+                        psh_bit_set(f[l], FLAG_N);
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, a[l] == 0);
+                        psh_bit_set_or_clear_if(
+                            f[l],
+                            FLAG_H,
+                            psh_u8_lo(val) + carry > psh_u8_lo(acc));
+                        psh_bit_set_or_clear_if(f[l], FLAG_C, val + carry > acc);
+                    });
+                    break;
+                }
+                case 0x04: {  // AND
+                    for_each_lane(lanes, [&](u32 l) {
+                        a[l] &= value(l);
+
+                        f[l] = 0x00;
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, a[l] == 0);
+                        psh_bit_set(f[l], FLAG_H);
+                    });
+                    break;
+                }
+                case 0x05: {  // XOR
+                    for_each_lane(lanes, [&](u32 l) {
+                        a[l] ^= value(l);
+
+                        f[l] = 0x00;
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, a[l] == 0);
+                    });
+                    break;
+                }
+                case 0x06: {  // OR
+                    for_each_lane(lanes, [&](u32 l) {
+                        a[l] |= value(l);
+
+                        f[l] = 0x00;
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, a[l] == 0);
+                    });
+                    break;
+                }
+                default: {  // CP
+                    for_each_lane(lanes, [&](u32 l) {
+                        u8 val = value(l);
+
+                        psh_bit_set(f[l], FLAG_N);
+                        psh_bit_set_or_clear_if(f[l], FLAG_Z, a[l] == val);
+                        psh_bit_set_or_clear_if(f[l], FLAG_C, val > a[l]);
+                        psh_bit_set_or_clear_if(f[l], FLAG_H, psh_u8_lo(val) > psh_u8_lo(a[l]));
+                    });
+                    break;
+                }
+            }
+        }
+
+        /// Run, over every lane of a group, the instruction at `pc` whose bytes are `code`.
+        template <typename Lanes>
+        void exec_group(LockstepGroup& group, Lanes lanes, u16 pc, u8 const* code) noexcept {
+            u8 const opcode = code[0];
+            u8 const y      = psh_bits_at(opcode, 3, 3);
+            u8 const p      = psh_bits_at(y, 1, 2);
+            u8 const z      = psh_bits_at(opcode, 0, 3);
+
+            u16* const lane_pc  = group.pc;
+            u16* const lane_bus = group.bus_addr;
+            u8* const  f        = group.regs[REG_F];
+
+            // Every instruction starts by fetching its opcode, immediates move both further.
+            auto fetch = [&](u16 size) {
+                u16 const next_pc  = static_cast<u16>(pc + size);
+                u16 const bus_addr = (size == 1) ? pc : next_pc;
+                for_each_lane(lanes, [&](u32 l) {
+                    lane_pc[l]  = next_pc;
+                    lane_bus[l] = bus_addr;
+                });
+            };
+
+            if (opcode == 0x00) {
+                fetch(1);
+            } else if (opcode < 0x40) {
+                switch (z) {
+                    case 0x00: {
+                        // JR I8 and JR CC I8, which read a 16-bit immediate as in `dmg.cc`.
+                        i8 const  rel_addr = static_cast<i8>(code[1]);
+                        u16 const taken_pc = static_cast<u16>(static_cast<u16>(pc + 3) + rel_addr);
+                        if (opcode == 0x18) {
+                            fetch(3);
+                            for_each_lane(lanes, [&](u32 l) { lane_pc[l] = taken_pc; });
+                        } else {
+                            u8 const cc = static_cast<u8>(y - 4);
+                            for_each_lane(lanes, [&](u32 l) {
+                                bool const taken = condition_holds(f[l], cc);
+                                lane_pc[l]       = taken ? taken_pc : static_cast<u16>(pc + 1);
+                                lane_bus[l]      = taken ? static_cast<u16>(pc + 3) : pc;
+                            });
+                        }
+                        break;
+                    }
+                    case 0x01: {  // LD R16, U16
+                        fetch(3);
+                        u8* const lo = group.regs[p];
+                        u8* const hi = group.regs[p + 1];
+                        for_each_lane(lanes, [&](u32 l) {
+                            lo[l] = code[1];
+                            hi[l] = code[2];
+                        });
+                        break;
+                    }
+                    case 0x03: {  // INC R16 and DEC R16
+                        fetch(1);
+                        u8* const lo  = group.regs[p];
+                        u8* const hi  = group.regs[p + 1];
+                        u16 const inc = ((y & 1) == 0) ? 1 : 0xFFFF;
+                        for_each_lane(lanes, [&](u32 l) {
+                            u16 const prev_val = psh_u16_from_bytes(hi[l], lo[l]);
+                            u16 const val      = static_cast<u16>(prev_val + inc);
+                            lo[l]              = psh_u16_lo(val);
+                            hi[l]              = psh_u16_hi(val);
+                        });
+                        break;
+                    }
+                    case 0x04: {  // INC R8
+                        fetch(1);
+                        u8* const reg = group.regs[reg8_offset(y)];
+                        for_each_lane(lanes, [&](u32 l) {
+                            u8 prev_val = reg[l];
+                            reg[l]      = static_cast<u8>(prev_val + 1);
+
+                            psh_bit_clear(f[l], FLAG_N);
+                            psh_bit_set_or_clear_if(f[l], FLAG_Z, prev_val + 1 == 0);
+                            psh_bit_set_or_clear_if(f[l], FLAG_H, psh_u8_lo(prev_val) + 1 > 0x0F);
+                        });
+                        break;
+                    }
+                    case 0x05: {  // DEC R8
+                        fetch(1);
+                        u8* const reg = group.regs[reg8_offset(y)];
+                        for_each_lane(lanes, [&](u32 l) {
+                            u8 prev_val = reg[l];
+                            reg[l]      = static_cast<u8>(prev_val - 1);
+
+                            psh_bit_set(f[l], FLAG_N);
+                            psh_bit_set_or_clear_if(f[l], FLAG_Z, prev_val - 1 == 0);
+                            psh_bit_set_or_clear_if(f[l], FLAG_H, psh_u8_lo(prev_val) - 1 > 0x0F);
+                        });
+                        break;
+                    }
+                    default: {  // LD R8, U8
+                        fetch(2);
+                        u8* const reg = group.regs[reg8_offset(y)];
+                        for_each_lane(lanes, [&](u32 l) { reg[l] = code[1]; });
+                        break;
+                    }
+                }
+            } else if (opcode < 0x80) {  // LD R8, R8
+                fetch(1);
+                u8* const       dst = group.regs[reg8_offset(y)];
+                u8 const* const src = group.regs[reg8_offset(z)];
+                for_each_lane(lanes, [&](u32 l) { dst[l] = src[l]; });
+            } else if (opcode < 0xC0) {
+                fetch(1);
+                u8 const* const src = group.regs[reg8_offset(z)];
+                alu_accumulator(group, lanes, y, [src](u32 l) { return src[l]; });
+            } else if (z == 0x06) {
+                fetch(2);
+                u8 const val = code[1];
+                alu_accumulator(group, lanes, y, [val](u32) { return val; });
+            } else {
+                u16 const target = psh_u16_from_bytes(code[2], code[1]);
+                if (opcode == 0xC3) {  // JP U16
+                    fetch(3);
+                    for_each_lane(lanes, [&](u32 l) { lane_pc[l] = target; });
+                } else {  // JP CC U16
+                    for_each_lane(lanes, [&](u32 l) {
+                        bool const taken = condition_holds(f[l], y);
+                        lane_pc[l]       = taken ? target : static_cast<u16>(pc + 1);
+                        lane_bus[l]      = taken ? static_cast<u16>(pc + 3) : pc;
+                    });
+                }
+            }
+        }
+
+        void load_lane(LockstepGroup& group, u32 lane) noexcept {
+            CPU const& cpu     = group.lanes[lane].cpu;
+            u8 const*  regfile = reinterpret_cast<u8 const*>(&cpu.regfile);
+            for (usize idx = 0; idx < LOCKSTEP_REG8_COUNT; ++idx) {
+                group.regs[idx][lane] = regfile[idx];
+            }
+            group.pc[lane]       = cpu.regfile.pc;
+            group.bus_addr[lane] = cpu.bus_addr;
+        }
+
+        void store_lane(LockstepGroup& group, u32 lane) noexcept {
+            CPU& cpu     = group.lanes[lane].cpu;
+            u8*  regfile = reinterpret_cast<u8*>(&cpu.regfile);
+            for (usize idx = 0; idx < LOCKSTEP_REG8_COUNT; ++idx) {
+                regfile[idx] = group.regs[idx][lane];
+            }
+            cpu.regfile.pc = group.pc[lane];
+            cpu.bus_addr   = group.bus_addr[lane];
+        }
+
+        void run_scalar_lane(LockstepGroup& group, u32 lane) noexcept {
+            if (!group.rom_diverged[lane]) {
+                u8 const* const memory  = lane_memory(group, lane);
+                u16 const       pc      = group.pc[lane];
+                u8 const        code[3] = {
+                    memory[pc],
+                    memory[static_cast<u16>(pc + 1)],
+                    memory[static_cast<u16>(pc + 2)],
+                };
+                if (may_write_rom(group, lane, code)) {
+                    group.rom_diverged[lane] = true;
+                    ++group.rom_diverged_count;
+                }
+            }
+
+            store_lane(group, lane);
+            run_cpu_cycle(group.lanes[lane].cpu);
+            load_lane(group, lane);
+            ++group.scalar_lane_steps;
+        }
+    }  // namespace
+
+    void init_lockstep(
+        LockstepGroup&   group,
+        psh::Arena*      arena,
+        Cartridge const& cart,
+        u32              lane_count) noexcept {
+        psh_assert_msg(lane_count != 0, "A lockstep group needs at least one lane");
+
+        group               = {};
+        group.lane_count    = lane_count;
+        group.lanes         = arena->zero_alloc<Core>(lane_count);
+        group.pc            = arena->zero_alloc<u16>(lane_count);
+        group.bus_addr      = arena->zero_alloc<u16>(lane_count);
+        group.rom_diverged  = arena->zero_alloc<bool>(lane_count);
+        group.rom_reference = arena->zero_alloc<u8>(ROM_SIZE);
+        group.group_lanes   = arena->zero_alloc<u32>(lane_count);
+        group.pending_lanes = arena->zero_alloc<u32>(lane_count);
+        for (usize idx = 0; idx < LOCKSTEP_REG8_COUNT; ++idx) {
+            group.regs[idx] = arena->zero_alloc<u8>(lane_count);
+        }
+        psh_assert_msg(group.regs[LOCKSTEP_REG8_COUNT - 1] != nullptr, "Lockstep arena too small");
+
+        for (u32 lane = 0; lane < lane_count; ++lane) {
+            init_core(group.lanes[lane], cart);
+        }
+        std::memcpy(group.rom_reference, lane_memory(group, 0), ROM_SIZE);
+
+        load_lockstep_lanes(group);
+    }
+
+    void load_lockstep_lanes(LockstepGroup& group) noexcept {
+        group.rom_diverged_count = 0;
+        for (u32 lane = 0; lane < group.lane_count; ++lane) {
+            // As in `run_core_cycles`, each lane sees the buttons held by its core.
+            sync_core_buttons(group.lanes[lane]);
+            load_lane(group, lane);
+
+            bool const diverged =
+                (std::memcmp(lane_memory(group, lane), group.rom_reference, ROM_SIZE) != 0);
+            group.rom_diverged[lane] = diverged;
+            group.rom_diverged_count += diverged ? 1 : 0;
+        }
+    }
+
+    void store_lockstep_lanes(LockstepGroup& group) noexcept {
+        for (u32 lane = 0; lane < group.lane_count; ++lane) {
+            store_lane(group, lane);
+            group.lanes[lane].cycle_count = group.cycle_count;
+            group.lanes[lane].frame_count = group.frame_count;
+        }
+    }
+
+    void run_lockstep_cycle(LockstepGroup& group) noexcept {
+        u32 const lane_count = group.lane_count;
+
+        // Fast path, every lane runs the same code in lockstep.
+        if (group.rom_diverged_count == 0) {
+            u16 const pc   = group.pc[0];
+            bool      same = true;
+            for (u32 lane = 1; lane < lane_count; ++lane) {
+                same &= (group.pc[lane] == pc);
+            }
+
+            u8 const* const memory  = lane_memory(group, 0);
+            u8 const        code[3] = {
+                memory[pc],
+                memory[static_cast<u16>(pc + 1)],
+                memory[static_cast<u16>(pc + 2)],
+            };
+            u8 const code_size = lockstep_code_size(code[0]);
+            if (same && (code_size != 0) && (pc + code_size - 1u <= ROM_END)) {
+                exec_group(group, AllLanes{lane_count}, pc, code);
+                group.vector_lane_steps += lane_count;
+                return;
+            }
+        }
+
+        u32* const pending       = group.pending_lanes;
+        u32        pending_count = lane_count;
+        for (u32 lane = 0; lane < pending_count; ++lane) {
+            pending[lane] = lane;
+        }
+
+        u32 group_count = 0;
+        while (pending_count != 0) {
+            u32 const       leader  = pending[0];
+            u16 const       pc      = group.pc[leader];
+            u8 const* const memory  = lane_memory(group, leader);
+            u8 const        code[3] = {
+                memory[pc],
+                memory[static_cast<u16>(pc + 1)],
+                memory[static_cast<u16>(pc + 2)],
+            };
+            u8 const code_size = lockstep_code_size(code[0]);
+
+            // Opcodes without a lockstep handler run one lane at a time, the same goes for lanes
+            // too divergent to be worth grouping.
+            if (code_size == 0) {
+                run_scalar_lane(group, leader);
+                pending[0] = pending[--pending_count];
+                continue;
+            }
+            if (group_count == MAX_LOCKSTEP_GROUPS) {
+                for (u32 idx = 0; idx < pending_count; ++idx) {
+                    run_scalar_lane(group, pending[idx]);
+                }
+                break;
+            }
+            ++group_count;
+
+            // Code in the RAM, or in a ROM that was written to, has to be compared byte by byte.
+            bool const code_in_rom = (pc + code_size - 1u <= ROM_END);
+            bool const leader_rom  = code_in_rom && !group.rom_diverged[leader];
+
+            // Split the pending lanes between the ones that run the same instruction as the
+            // leader and the ones left for later, keeping their order.
+            u32 member_count = 0;
+            u32 left_count   = 0;
+            for (u32 idx = 0; idx < pending_count; ++idx) {
+                u32 const lane = pending[idx];
+
+                bool same = (group.pc[lane] == pc);
+                if (same && !(leader_rom && !group.rom_diverged[lane])) {
+                    u8 const* const bytes = lane_memory(group, lane);
+                    for (u8 byte = 0; same && (byte < code_size); ++byte) {
+                        same = (bytes[static_cast<u16>(pc + byte)] == code[byte]);
+                    }
+                }
+
+                if (same) {
+                    group.group_lanes[member_count++] = lane;
+                } else {
+                    pending[left_count++] = lane;
+                }
+            }
+            pending_count = left_count;
+
+            if (member_count == lane_count) {
+                exec_group(group, AllLanes{member_count}, pc, code);
+            } else {
+                exec_group(group, LaneList{group.group_lanes, member_count}, pc, code);
+            }
+            group.vector_lane_steps += member_count;
+        }
+    }
+
+    void run_lockstep_cycles(LockstepGroup& group, u64 cycle_count) noexcept {
+        for (u64 idx = 0; idx < cycle_count; ++idx) {
+            run_lockstep_cycle(group);
+        }
+
+        u64 const previous_cycles = group.cycle_count;
+        group.cycle_count += cycle_count;
+        group.frame_count += (group.cycle_count / MACHINE_CYCLES_PER_FRAME)
+                             - (previous_cycles / MACHINE_CYCLES_PER_FRAME);
+    }
+
+    void run_lockstep_frame(LockstepGroup& group) noexcept {
+        u64 const frame_end = (group.frame_count + 1) * MACHINE_CYCLES_PER_FRAME;
+        run_lockstep_cycles(group, frame_end - group.cycle_count);
+    }
+}  // namespace mina
@@ -0,0 +1,138 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Implementation of the copy-on-write branching of the state of a core.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/fork.h>
+
+#include <psh/assert.h>
+#include <bit>
+#include <cstring>
+
+namespace mina {
+    namespace {
+        u8* core_memory(Core& core) noexcept {
+            return reinterpret_cast<u8*>(&core.cpu.mmap);
+        }
+
+        /// Pages that may differ between the core and the given state, which has to be either the
+        /// state the core was last synchronized with or one of its ancestors. Pages not owned by
+        /// any state in between are shared with the given one.
+        u64 pages_to_sync(Core const& core, ForkedState const& state) noexcept {
+            u64                pages  = core.cpu.dirty_pages;
+            ForkedState const* synced = core.synced_state;
+            for (; (synced != nullptr) && (synced != &state); synced = synced->parent) {
+                pages |= synced->owned_pages;
+            }
+            psh_assert_msg(synced == &state, "The core isn't synchronized with the state");
+            return pages;
+        }
+
+        /// Allocate a state holding the registers of the core, with room for the given pages.
+        ForkedState* make_state(psh::Arena* arena, Core const& core, u64 owned_pages) noexcept {
+            usize const  owned_count = static_cast<usize>(std::popcount(owned_pages));
+            ForkedState* state       = arena->zero_alloc<ForkedState>(1);
+            u8*          page_data   = arena->zero_alloc<u8>(owned_count * MEMORY_PAGE_SIZE);
+            if ((state == nullptr) || (page_data == nullptr)) {
+                return nullptr;
+            }
+
+            CPU const& cpu     = core.cpu;
+            state->cart_hash   = core.cart_hash;
+            state->regfile     = cpu.regfile;
+            state->bus_addr    = cpu.bus_addr;
+            state->clock       = cpu.clock;
+            state->buttons     = core.buttons;
+            state->cycle_count = core.cycle_count;
+            state->frame_count = core.frame_count;
+            state->owned_pages = owned_pages;
+
+            u8 const* memory = reinterpret_cast<u8 const*>(&cpu.mmap);
+            for (u64 pages = owned_pages; pages != 0; pages &= pages - 1) {
+                usize const page = static_cast<usize>(std::countr_zero(pages));
+                std::memcpy(page_data, memory + page * MEMORY_PAGE_SIZE, MEMORY_PAGE_SIZE);
+                state->pages[page] = page_data;
+                page_data += MEMORY_PAGE_SIZE;
+            }
+            return state;
+        }
+
+        void restore_pages(Core& core, ForkedState const& state, u64 pages) noexcept {
+            psh_assert_msg(core.cart_hash == state.cart_hash, "State of another cartridge");
+
+            u8* memory = core_memory(core);
+            for (; pages != 0; pages &= pages - 1) {
+                usize const page = static_cast<usize>(std::countr_zero(pages));
+                std::memcpy(memory + page * MEMORY_PAGE_SIZE, state.pages[page], MEMORY_PAGE_SIZE);
+            }
+
+            CPU& cpu          = core.cpu;
+            cpu.regfile       = state.regfile;
+            cpu.bus_addr      = state.bus_addr;
+            cpu.clock         = state.clock;
+            cpu.dirty_pages   = 0;
+            core.buttons      = state.buttons;
+            core.cycle_count  = state.cycle_count;
+            core.frame_count  = state.frame_count;
+            core.synced_state = &state;
+            set_cpu_buttons(cpu, core.buttons);
+        }
+    }  // namespace
+
+    ForkedState* capture_root_state(psh::Arena* arena, Core& core) noexcept {
+        ForkedState* state = make_state(arena, core, ~u64{0});
+        if (state != nullptr) {
+            core.cpu.dirty_pages = 0;
+            core.synced_state    = state;
+        }
+        return state;
+    }
+
+    ForkedState* fork_state(psh::Arena* arena, ForkedState const& parent, Core& core) noexcept {
+        psh_assert_msg(core.cart_hash == parent.cart_hash, "State of another cartridge");
+
+        u64 const    owned_pages = pages_to_sync(core, parent);
+        ForkedState* state       = make_state(arena, core, owned_pages);
+        if (state == nullptr) {
+            return nullptr;
+        }
+
+        state->parent = &parent;
+        for (u64 pages = ~owned_pages; pages != 0; pages &= pages - 1) {
+            usize const page   = static_cast<usize>(std::countr_zero(pages));
+            state->pages[page] = parent.pages[page];
+        }
+        core.cpu.dirty_pages = 0;
+        core.synced_state    = state;
+        return state;
+    }
+
+    void restore_forked_state(Core& core, ForkedState const& state) noexcept {
+        restore_pages(core, state, ~u64{0});
+    }
+
+    void revert_forked_state(Core& core, ForkedState const& state) noexcept {
+        restore_pages(core, state, pages_to_sync(core, state));
+    }
+
+    usize forked_state_owned_size(ForkedState const& state) noexcept {
+        return static_cast<usize>(std::popcount(state.owned_pages)) * MEMORY_PAGE_SIZE;
+    }
+}  // namespace mina
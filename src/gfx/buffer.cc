@@ -20,40 +20,83 @@
 /// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
 
 #include <mina/gfx/buffer.h>
+#include <mina/gfx/data.h>
 
 #include <mina/gfx/utils.h>
 #include <vulkan/vulkan_core.h>
 #include <cstring>
 
 namespace mina {
-    void
-    create_buffers(VmaAllocator alloc, BufferManager& buffers, QueueFamilies& queues) noexcept {
-        // Host local (CPU) staging buffer.
+    void create_buffers(
+        VmaAllocator   alloc,
+        BufferManager& buffers,
+        QueueFamilies& queues,
+        u32            max_frames_in_flight) noexcept {
+        // Host local (CPU) staging ring, with one slice for each frame in flight.
         {
-            buffers.host.size = HOST_BUFFER_SIZE;
+            buffers.host.slice_count = max_frames_in_flight;
+            buffers.host.size        = max_frames_in_flight * STAGING_SLICE_SIZE;
 
             VkBufferCreateInfo host_buf_info{
                 .sType                 = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                 .pNext                 = nullptr,
                 .size                  = buffers.host.size,
-                .usage                 = VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                // The storage usage allows the shaders to read the slices in place when the ring is
+                // zero-copy.
+                .usage                 = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                                         VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                 .sharingMode           = VK_SHARING_MODE_EXCLUSIVE,
                 .queueFamilyIndexCount = 1,
                 .pQueueFamilyIndices   = &queues.graphics_queue_index,
             };
-            VmaAllocationCreateInfo host_alloc_info{
+
+            VmaAllocationInfo host_alloc_result;
+
+            // On UMA systems and GPUs exposing resizable BAR, some memory type is both host visible
+            // and device local. Writing the frame straight into it makes the transfer to the device
+            // buffer and the LCD texture unnecessary.
+            VmaAllocationCreateInfo zero_copy_alloc_info{
                 .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
                          VMA_ALLOCATION_CREATE_MAPPED_BIT,
-                .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                .usage         = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+                .requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT |
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
             };
+            u32 zero_copy_mem_type;
+            if (vmaFindMemoryTypeIndexForBufferInfo(
+                    alloc,
+                    &host_buf_info,
+                    &zero_copy_alloc_info,
+                    &zero_copy_mem_type) == VK_SUCCESS) {
+                // The device local heap visible to the host may be small, fall back to the staged
+                // path if it can't hold the ring.
+                buffers.zero_copy = (vmaCreateBuffer(
+                                         alloc,
+                                         &host_buf_info,
+                                         &zero_copy_alloc_info,
+                                         &buffers.host.handle,
+                                         &buffers.host.allocation,
+                                         &host_alloc_result) == VK_SUCCESS);
+            }
 
-            mina_vk_assert(vmaCreateBuffer(
-                alloc,
-                &host_buf_info,
-                &host_alloc_info,
-                &buffers.host.handle,
-                &buffers.host.allocation,
-                nullptr));
+            if (!buffers.zero_copy) {
+                VmaAllocationCreateInfo host_alloc_info{
+                    .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
+                             VMA_ALLOCATION_CREATE_MAPPED_BIT,
+                    .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST,
+                };
+                mina_vk_assert(vmaCreateBuffer(
+                    alloc,
+                    &host_buf_info,
+                    &host_alloc_info,
+                    &buffers.host.handle,
+                    &buffers.host.allocation,
+                    &host_alloc_result));
+            }
+
+            // The staging memory stays mapped for the whole lifetime of the buffer, so that
+            // producers (such as the palette conversion) can write directly into it.
+            buffers.host.mapped = reinterpret_cast<u8*>(host_alloc_result.pMappedData);
         }
 
         // Device local buffer (GPU).
@@ -64,13 +107,10 @@ namespace mina {
                 .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
                 .pNext = nullptr,
                 .size  = buffers.device.size,
-                .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT |
-                         VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
                 .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
             };
             VmaAllocationCreateInfo device_alloc_info{
-                .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT |
-                         VMA_ALLOCATION_CREATE_MAPPED_BIT,
                 .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
             };
 
@@ -89,30 +129,189 @@ namespace mina {
         vmaDestroyBuffer(alloc, bufs.device.handle, bufs.device.allocation);
     }
 
+    void create_lcd_texture(VkDevice dev, VmaAllocator alloc, LcdTexture& lcd) noexcept {
+        // Device local image with the exact resolution of the LCD.
+        {
+            VkImageCreateInfo image_info{
+                .sType     = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format    = LCD_TEXTURE_FORMAT,
+                .extent{
+                    .width  = LCD_WIDTH,
+                    .height = LCD_HEIGHT,
+                    .depth  = 1,
+                },
+                .mipLevels     = 1,
+                .arrayLayers   = 1,
+                .samples       = VK_SAMPLE_COUNT_1_BIT,
+                .tiling        = VK_IMAGE_TILING_OPTIMAL,
+                .usage         = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+            VmaAllocationCreateInfo image_alloc_info{
+                .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+            };
+
+            mina_vk_assert(vmaCreateImage(
+                alloc,
+                &image_info,
+                &image_alloc_info,
+                &lcd.image,
+                &lcd.allocation,
+                nullptr));
+        }
+
+        // Image view.
+        {
+            VkImageViewCreateInfo view_info{
+                .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .image            = lcd.image,
+                .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+                .format           = LCD_TEXTURE_FORMAT,
+                .components       = IMAGE_COMPONENT_MAPPING,
+                .subresourceRange = IMAGE_SUBRESOURCE_RANGE,
+            };
+            mina_vk_assert(vkCreateImageView(dev, &view_info, nullptr, &lcd.view));
+        }
+
+        // Nearest filtering preserves the pixel art with the integer scaling of the viewport.
+        {
+            VkSamplerCreateInfo sampler_info{
+                .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                .magFilter               = VK_FILTER_NEAREST,
+                .minFilter               = VK_FILTER_NEAREST,
+                .mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                .addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .anisotropyEnable        = VK_FALSE,
+                .compareEnable           = VK_FALSE,
+                .minLod                  = 0.0f,
+                .maxLod                  = 0.0f,
+                .unnormalizedCoordinates = VK_FALSE,
+            };
+            mina_vk_assert(vkCreateSampler(dev, &sampler_info, nullptr, &lcd.sampler));
+        }
+    }
+
+    void destroy_lcd_texture(VkDevice dev, VmaAllocator alloc, LcdTexture& lcd) noexcept {
+        vkDestroySampler(dev, lcd.sampler, nullptr);
+        vkDestroyImageView(dev, lcd.view, nullptr);
+        vmaDestroyImage(alloc, lcd.image, lcd.allocation);
+    }
+
+    void create_native_target(VkDevice dev, VmaAllocator alloc, NativeTarget& target) noexcept {
+        // Color attachment of the native composition pass, sampled by the scaling pass.
+        {
+            VkImageCreateInfo image_info{
+                .sType     = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+                .imageType = VK_IMAGE_TYPE_2D,
+                .format    = NATIVE_TARGET_FORMAT,
+                .extent{
+                    .width  = NATIVE_EXTENT.width,
+                    .height = NATIVE_EXTENT.height,
+                    .depth  = 1,
+                },
+                .mipLevels     = 1,
+                .arrayLayers   = 1,
+                .samples       = VK_SAMPLE_COUNT_1_BIT,
+                .tiling        = VK_IMAGE_TILING_OPTIMAL,
+                .usage         = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                .sharingMode   = VK_SHARING_MODE_EXCLUSIVE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            };
+            VmaAllocationCreateInfo image_alloc_info{
+                .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE,
+            };
+
+            mina_vk_assert(vmaCreateImage(
+                alloc,
+                &image_info,
+                &image_alloc_info,
+                &target.image,
+                &target.allocation,
+                nullptr));
+        }
+
+        // Image view.
+        {
+            VkImageViewCreateInfo view_info{
+                .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+                .image            = target.image,
+                .viewType         = VK_IMAGE_VIEW_TYPE_2D,
+                .format           = NATIVE_TARGET_FORMAT,
+                .components       = IMAGE_COMPONENT_MAPPING,
+                .subresourceRange = IMAGE_SUBRESOURCE_RANGE,
+            };
+            mina_vk_assert(vkCreateImageView(dev, &view_info, nullptr, &target.view));
+        }
+
+        // The scaling is always by an integer factor, nearest filtering is exact.
+        {
+            VkSamplerCreateInfo sampler_info{
+                .sType                   = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+                .magFilter               = VK_FILTER_NEAREST,
+                .minFilter               = VK_FILTER_NEAREST,
+                .mipmapMode              = VK_SAMPLER_MIPMAP_MODE_NEAREST,
+                .addressModeU            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .addressModeV            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .addressModeW            = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE,
+                .anisotropyEnable        = VK_FALSE,
+                .compareEnable           = VK_FALSE,
+                .minLod                  = 0.0f,
+                .maxLod                  = 0.0f,
+                .unnormalizedCoordinates = VK_FALSE,
+            };
+            mina_vk_assert(vkCreateSampler(dev, &sampler_info, nullptr, &target.sampler));
+        }
+    }
+
+    void create_native_frame_buffer(
+        VkDevice          dev,
+        NativeTarget&     target,
+        RenderPass const& native_pass) noexcept {
+        VkFramebufferCreateInfo frame_buf_info{
+            .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
+            .renderPass      = native_pass.handle,
+            .attachmentCount = 1,
+            .pAttachments    = &target.view,
+            .width           = NATIVE_EXTENT.width,
+            .height          = NATIVE_EXTENT.height,
+            .layers          = 1,
+        };
+        mina_vk_assert(vkCreateFramebuffer(dev, &frame_buf_info, nullptr, &target.frame_buf));
+    }
+
+    void destroy_native_target(VkDevice dev, VmaAllocator alloc, NativeTarget& target) noexcept {
+        vkDestroyFramebuffer(dev, target.frame_buf, nullptr);
+        vkDestroySampler(dev, target.sampler, nullptr);
+        vkDestroyImageView(dev, target.view, nullptr);
+        vmaDestroyImage(alloc, target.image, target.allocation);
+    }
+
     void stage_host_data(
         VmaAllocator       alloc,
-        Buffer const&      staging_buf,
+        HostBuffer const&  staging_buf,
         StagingInfo const& info) noexcept {
-        void* staging_memory_ptr;
-        mina_vk_assert(vmaMapMemory(alloc, staging_buf.allocation, &staging_memory_ptr));
-        {
-            u8 const* vbo_src = info.src_ptr + info.vertex_buf_src_offset;
-            u8 const* ubo_src = info.src_ptr + info.uniform_buf_src_offset;
-            u8* vbo_dst = reinterpret_cast<u8*>(staging_memory_ptr) + info.vertex_buf_dst_offset;
-            u8* ubo_dst = reinterpret_cast<u8*>(staging_memory_ptr) + info.uniform_buf_dst_offset;
-
-            // Check if the data to be staged is packed.
-            bool host_data_is_packed   = (vbo_src + info.vertex_buf_size == ubo_src);
-            // Check if the staging buffer will receive the host data in a packed manner.
-            bool staging_dst_is_packed = (vbo_dst + info.vertex_buf_size == ubo_dst);
-
-            if (host_data_is_packed && staging_dst_is_packed) {
-                std::memcpy(vbo_dst, vbo_src, info.vertex_buf_size + info.uniform_buf_size);
-            } else {
-                std::memcpy(vbo_dst, vbo_src, info.vertex_buf_size);
-                std::memcpy(ubo_dst, ubo_src, info.uniform_buf_size);
-            }
+        u8* slice = staging_buf.mapped + info.dst_slice_offset;
+
+        // Only the lines that changed are converted into the slice and later transferred.
+        convert_staged_lcd_rows(info, slice + STAGING_LCD_FRAME_OFFSET);
+
+        // Raw video memory snapshot used by the GPU tile renderer.
+        if (info.tile_data_size != 0) {
+            std::memcpy(
+                slice + STAGING_TILE_DATA_OFFSET,
+                info.src_ptr + info.tile_data_src_offset,
+                info.tile_data_size);
         }
-        vmaUnmapMemory(alloc, staging_buf.allocation);
+
+        // No-op for host coherent memory, which is what we get on most platforms.
+        mina_vk_assert(vmaFlushAllocation(
+            alloc,
+            staging_buf.allocation,
+            info.dst_slice_offset,
+            STAGING_SLICE_SIZE));
     }
 }  // namespace mina
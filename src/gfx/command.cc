@@ -22,6 +22,10 @@
 #include <mina/gfx/command.h>
 
 #include <mina/gfx/utils.h>
+#include <psh/assert.h>
+#include <psh/buffer.h>
+#include <psh/intrinsics.h>
+#include <psh/math.h>
 
 namespace mina {
     // -----------------------------------------------------------------------------
@@ -33,26 +37,39 @@ namespace mina {
         CommandManager&      commander,
         QueueFamilies const& queues,
         psh::Arena*          persistent_arena,
-        u32                  max_frames_in_flight) noexcept {
+        u32                  max_frames_in_flight,
+        u32                  image_count) noexcept {
         // Create command buffer pools.
         {
-            VkCommandPoolCreateInfo cmd_pool_info{
+            // Graphics command buffers are long-lived: recorded once and resubmitted every time
+            // their frame in flight renders to their swap chain image.
+            VkCommandPoolCreateInfo gfx_pool_info{
+                .sType            = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+                .flags            = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+                .queueFamilyIndex = queues.graphics_queue_index,
+            };
+            mina_vk_assert(vkCreateCommandPool(dev, &gfx_pool_info, nullptr, &commander.pool));
+
+            // Transfer command buffers will be short-lived - only submitted once and then
+            // re-recorded. They are submitted to the transfer queue, which may belong to a
+            // different family.
+            VkCommandPoolCreateInfo transf_pool_info{
                 .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
-                // Command buffers will be short-lived - only submitted once and then re-recorded.
                 .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT |
                          VK_COMMAND_POOL_CREATE_TRANSIENT_BIT,
-                .queueFamilyIndex = queues.graphics_queue_index,
+                .queueFamilyIndex = queues.transfer_queue_index,
             };
-
-            mina_vk_assert(vkCreateCommandPool(dev, &cmd_pool_info, nullptr, &commander.pool));
+            mina_vk_assert(
+                vkCreateCommandPool(dev, &transf_pool_info, nullptr, &commander.transfer_pool));
         }
 
         // Create command buffers.
         {
-            // The number of graphics and transfer buffers should match the number of frames in
-            // flight.
+            // There's a transfer buffer for each frame in flight, and a graphics buffer for each
+            // pair of frame in flight and swap chain image.
             commander.transfer.cmd.init(persistent_arena, max_frames_in_flight);
-            commander.graphics.cmd.init(persistent_arena, max_frames_in_flight);
+            commander.graphics.init(persistent_arena, max_frames_in_flight * image_count);
+            commander.graphics_image_count = image_count;
 
             VkCommandBufferAllocateInfo cmd_buf_alloc_info{
                 .sType              = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -61,9 +78,12 @@ namespace mina {
                 .commandBufferCount = 1,
             };
 
-            for (VkCommandBuffer& gfx_cmd : commander.graphics.cmd) {
-                mina_vk_assert(vkAllocateCommandBuffers(dev, &cmd_buf_alloc_info, &gfx_cmd));
+            for (RecordedGraphicsCmd& gfx_cmd : commander.graphics) {
+                mina_vk_assert(vkAllocateCommandBuffers(dev, &cmd_buf_alloc_info, &gfx_cmd.cmd));
+                gfx_cmd.is_recorded = false;
             }
+
+            cmd_buf_alloc_info.commandPool = commander.transfer_pool;
             for (VkCommandBuffer& transf_cmd : commander.transfer.cmd) {
                 mina_vk_assert(vkAllocateCommandBuffers(dev, &cmd_buf_alloc_info, &transf_cmd));
             }
@@ -72,28 +92,146 @@ namespace mina {
 
     void destroy_command_buffers(VkDevice dev, CommandManager& cmds) noexcept {
         vkDestroyCommandPool(dev, cmds.pool, nullptr);
+        vkDestroyCommandPool(dev, cmds.transfer_pool, nullptr);
     }
 
     // -----------------------------------------------------------------------------
     // - Implementation of the data transfer routines -
     // -----------------------------------------------------------------------------
 
-    // NOTE: assumes that VBO-UBO are tightly packed
-    TransferInfo transfer_whole_info(
-        VkBuffer src,
-        VkBuffer dst,
-        usize    vertex_buf_size,
-        usize    uniform_buf_size) noexcept {
+    TransferInfo transfer_info(
+        BufferManager const& buffers,
+        QueueFamilies const& queues,
+        StagingInfo const&   staging_info) noexcept {
         return TransferInfo{
-            .src_buf_handle   = src,
-            .dst_buf_handle   = dst,
-            .src_buf_offset   = 0,
-            .dst_buf_offset   = 0,
-            .vertex_buf_size  = vertex_buf_size,
-            .uniform_buf_size = uniform_buf_size,
+            .src_buf_handle       = buffers.host.handle,
+            .dst_buf_handle       = buffers.device.handle,
+            .lcd_image            = buffers.lcd.image,
+            .src_slice_offset     = staging_info.dst_slice_offset,
+            .lcd_ranges           = staging_info.lcd_ranges,
+            .lcd_range_count      = staging_info.lcd_range_count,
+            .lcd_discard          = staging_info.lcd_discard,
+            .tile_data_size       = staging_info.tile_data_size,
+            .transfer_queue_index = queues.transfer_queue_index,
+            .graphics_queue_index = queues.graphics_queue_index,
         };
     }
 
+    namespace {
+        /// Barrier moving the LCD texture between queue families. Both halves keep the image in the
+        /// shader read-only layout, so that the release and acquire always match regardless of
+        /// whether the frame uploaded any rows.
+        VkImageMemoryBarrier lcd_ownership_barrier(
+            VkImage       lcd_image,
+            u32           src_family,
+            u32           dst_family,
+            VkAccessFlags src_access,
+            VkAccessFlags dst_access) noexcept {
+            return VkImageMemoryBarrier{
+                .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask       = src_access,
+                .dstAccessMask       = dst_access,
+                .oldLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .srcQueueFamilyIndex = src_family,
+                .dstQueueFamilyIndex = dst_family,
+                .image               = lcd_image,
+                .subresourceRange    = IMAGE_SUBRESOURCE_RANGE,
+            };
+        }
+
+        /// Barrier transitioning the layout of a color image within its queue family.
+        VkImageMemoryBarrier layout_barrier(
+            VkImage       image,
+            VkImageLayout old_layout,
+            VkImageLayout new_layout,
+            VkAccessFlags src_access,
+            VkAccessFlags dst_access) noexcept {
+            return VkImageMemoryBarrier{
+                .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask       = src_access,
+                .dstAccessMask       = dst_access,
+                .oldLayout           = old_layout,
+                .newLayout           = new_layout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image               = image,
+                .subresourceRange    = IMAGE_SUBRESOURCE_RANGE,
+            };
+        }
+
+        /// Begin rendering to a single color attachment, either through its render pass object or
+        /// dynamically. The layout transitions done by the render pass have to be recorded around
+        /// the dynamic pass by the caller.
+        void begin_color_pass(
+            VkCommandBuffer         cmd,
+            DynamicRendering const& rendering,
+            RenderPass              render_pass,
+            VkFramebuffer           frame_buf,
+            VkImageView             view,
+            VkExtent2D              extent,
+            VkClearValue const*     clear) noexcept {
+            VkRect2D const area{.offset = {0, 0}, .extent = extent};
+
+            if (!rendering.enabled) {
+                VkRenderPassBeginInfo begin_info{
+                    .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
+                    .renderPass      = render_pass.handle,
+                    .framebuffer     = frame_buf,
+                    .renderArea      = area,
+                    .clearValueCount = (clear != nullptr) ? 1u : 0u,
+                    .pClearValues    = clear,
+                };
+                vkCmdBeginRenderPass(cmd, &begin_info, VK_SUBPASS_CONTENTS_INLINE);
+                return;
+            }
+
+            VkRenderingAttachmentInfo color_attachment{
+                .sType       = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+                .imageView   = view,
+                .imageLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                .loadOp = (clear != nullptr) ? VK_ATTACHMENT_LOAD_OP_CLEAR
+                                             : VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+            };
+            if (clear != nullptr) {
+                color_attachment.clearValue = *clear;
+            }
+            VkRenderingInfo rendering_info{
+                .sType                = VK_STRUCTURE_TYPE_RENDERING_INFO,
+                .renderArea           = area,
+                .layerCount           = 1,
+                .colorAttachmentCount = 1,
+                .pColorAttachments    = &color_attachment,
+            };
+            rendering.begin(cmd, &rendering_info);
+        }
+
+        void end_color_pass(VkCommandBuffer cmd, DynamicRendering const& rendering) noexcept {
+            if (rendering.enabled) {
+                rendering.end(cmd);
+            } else {
+                vkCmdEndRenderPass(cmd);
+            }
+        }
+
+        void record_image_barrier(
+            VkCommandBuffer             cmd,
+            VkPipelineStageFlags        src_stage,
+            VkPipelineStageFlags        dst_stage,
+            VkImageMemoryBarrier const& barrier) noexcept {
+            vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+        }
+
+        void record_buffer_barrier(
+            VkCommandBuffer              cmd,
+            VkPipelineStageFlags         src_stage,
+            VkPipelineStageFlags         dst_stage,
+            VkBufferMemoryBarrier const& barrier) noexcept {
+            vkCmdPipelineBarrier(cmd, src_stage, dst_stage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+        }
+    }  // namespace
+
     void record_transfer_commands(VkCommandBuffer transfer_cmd, TransferInfo const& info) noexcept {
         mina_vk_assert(vkResetCommandBuffer(transfer_cmd, 0));
 
@@ -102,101 +240,230 @@ namespace mina {
             .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,  // Submitted once per frame.
         };
 
+        // With a dedicated transfer queue, the previous frame is ordered before the copies by a
+        // semaphore waited at the transfer stage, and the resources are handed to the graphics
+        // queue by release barriers. Otherwise everything runs on the graphics queue and the
+        // barriers synchronize directly with the fragment shaders.
+        bool const dedicated = (info.transfer_queue_index != info.graphics_queue_index);
+        VkPipelineStageFlags const shader_stage =
+            dedicated ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+        bool const lcd_owned_by_graphics = dedicated && !info.lcd_discard;
+
         mina_vk_assert(vkBeginCommandBuffer(transfer_cmd, &BEGIN_INFO));
-        {
-            VkBufferCopy buf_copy_info{
-                .srcOffset = info.src_buf_offset,
-                .dstOffset = info.dst_buf_offset,
-                .size      = info.vertex_buf_size + info.uniform_buf_size,
+
+        // Once the texture holds valid contents, it travels back and forth between the queue
+        // families every frame, even when no line is copied, so that each release on one queue
+        // is paired with an acquire on the other.
+        if (lcd_owned_by_graphics) {
+            record_image_barrier(
+                transfer_cmd,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                lcd_ownership_barrier(
+                    info.lcd_image,
+                    info.graphics_queue_index,
+                    info.transfer_queue_index,
+                    0,
+                    VK_ACCESS_TRANSFER_WRITE_BIT));
+        }
+
+        if (info.lcd_range_count != 0) {
+            // Lines that aren't uploaded keep the contents of the previous frame, so the image is
+            // only discarded when it has no valid contents. The barrier still has to wait for any
+            // previous frame that is sampling the image.
+            VkImageMemoryBarrier to_transfer_dst{
+                .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask       = 0,
+                .dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+                .oldLayout           = info.lcd_discard ? VK_IMAGE_LAYOUT_UNDEFINED
+                                                        : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                .newLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image               = info.lcd_image,
+                .subresourceRange    = IMAGE_SUBRESOURCE_RANGE,
             };
-            vkCmdCopyBuffer(
+            record_image_barrier(
+                transfer_cmd,
+                shader_stage,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                to_transfer_dst);
+
+            // One copy region for each range of dirty lines.
+            psh::Buffer<VkBufferImageCopy, LCD_MAX_ROW_RANGES> lcd_copy_regions;
+            for (u32 idx = 0; idx < info.lcd_range_count; ++idx) {
+                LcdRowRange const& range = info.lcd_ranges[idx];
+
+                lcd_copy_regions[idx] = VkBufferImageCopy{
+                    .bufferOffset = info.src_slice_offset + STAGING_LCD_FRAME_OFFSET +
+                                    range.first_line * LCD_ROW_SIZE,
+                    .bufferRowLength   = 0,  // Tightly packed.
+                    .bufferImageHeight = 0,
+                    .imageSubresource{
+                        .aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT,
+                        .mipLevel       = 0,
+                        .baseArrayLayer = 0,
+                        .layerCount     = 1,
+                    },
+                    .imageOffset = {0, static_cast<i32>(range.first_line), 0},
+                    .imageExtent = {LCD_WIDTH, range.line_count, 1},
+                };
+            }
+            vkCmdCopyBufferToImage(
                 transfer_cmd,
                 info.src_buf_handle,
-                info.dst_buf_handle,
-                1,
-                &buf_copy_info);
-
-            usize vertex_buf_dst_offset  = info.dst_buf_offset;
-            usize uniform_buf_dst_offset = info.dst_buf_offset + info.vertex_buf_size;
-
-            // Prepare the uniform buffer memory for the vertex shader stage.
-            VkBufferMemoryBarrier transfer_uniform_buf_barrier{
-                .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                info.lcd_image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                info.lcd_range_count,
+                lcd_copy_regions.buf);
+
+            // Prepare the image to be sampled by the presentation fragment shader.
+            VkImageMemoryBarrier to_shader_read{
+                .sType               = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
                 .srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .dstAccessMask       = VK_ACCESS_UNIFORM_READ_BIT,
+                .dstAccessMask       = dedicated ? VK_ACCESS_TRANSFER_WRITE_BIT
+                                                 : VK_ACCESS_SHADER_READ_BIT,
+                .oldLayout           = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                .newLayout           = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
                 .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
                 .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .buffer              = info.dst_buf_handle,
-                .offset              = uniform_buf_dst_offset,
-                .size                = info.uniform_buf_size,
+                .image               = info.lcd_image,
+                .subresourceRange    = IMAGE_SUBRESOURCE_RANGE,
             };
-            vkCmdPipelineBarrier(
+            record_image_barrier(
                 transfer_cmd,
                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
-                0,
-                0,
-                nullptr,
+                shader_stage,
+                to_shader_read);
+        }
+
+        // Hand the texture over to the graphics queue family.
+        if (lcd_owned_by_graphics || (dedicated && info.lcd_range_count != 0)) {
+            record_image_barrier(
+                transfer_cmd,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                lcd_ownership_barrier(
+                    info.lcd_image,
+                    info.transfer_queue_index,
+                    info.graphics_queue_index,
+                    VK_ACCESS_TRANSFER_WRITE_BIT,
+                    0));
+        }
+
+        // Raw video memory read by the fragment shader of the GPU tile renderer.
+        if (info.tile_data_size != 0) {
+            // The whole range is overwritten, so the previous frame only has to be done reading it.
+            // Its contents are discarded, which is why no ownership is acquired for the copy.
+            if (!dedicated) {
+                VkBufferMemoryBarrier tile_data_war_barrier{
+                    .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .srcAccessMask       = 0,
+                    .dstAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
+                    .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                    .buffer              = info.dst_buf_handle,
+                    .offset              = TILE_DATA_BUFFER_OFFSET,
+                    .size                = info.tile_data_size,
+                };
+                record_buffer_barrier(
+                    transfer_cmd,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    tile_data_war_barrier);
+            }
+
+            VkBufferCopy tile_data_copy_info{
+                .srcOffset = info.src_slice_offset + STAGING_TILE_DATA_OFFSET,
+                .dstOffset = TILE_DATA_BUFFER_OFFSET,
+                .size      = info.tile_data_size,
+            };
+            vkCmdCopyBuffer(
+                transfer_cmd,
+                info.src_buf_handle,
+                info.dst_buf_handle,
                 1,
-                &transfer_uniform_buf_barrier,
-                0,
-                nullptr);
+                &tile_data_copy_info);
 
-            // Prepare the vertex buffer memory to be read by the vertex shader.
-            VkBufferMemoryBarrier transfer_vertex_buf_barrier{
+            VkBufferMemoryBarrier transfer_tile_data_barrier{
                 .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
                 .srcAccessMask       = VK_ACCESS_TRANSFER_WRITE_BIT,
-                .dstAccessMask       = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT,
-                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstAccessMask       = dedicated ? 0 : VK_ACCESS_SHADER_READ_BIT,
+                .srcQueueFamilyIndex = dedicated ? info.transfer_queue_index
+                                                 : VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = dedicated ? info.graphics_queue_index
+                                                 : VK_QUEUE_FAMILY_IGNORED,
                 .buffer              = info.dst_buf_handle,
-                .offset              = vertex_buf_dst_offset,
-                .size                = info.vertex_buf_size,
+                .offset              = TILE_DATA_BUFFER_OFFSET,
+                .size                = info.tile_data_size,
             };
-            vkCmdPipelineBarrier(
+            record_buffer_barrier(
                 transfer_cmd,
                 VK_PIPELINE_STAGE_TRANSFER_BIT,
-                VK_PIPELINE_STAGE_VERTEX_INPUT_BIT,
-                0,
-                0,
-                nullptr,
-                1,
-                &transfer_vertex_buf_barrier,
-                0,
-                nullptr);
+                dedicated ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT
+                          : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                transfer_tile_data_barrier);
         }
         mina_vk_assert(vkEndCommandBuffer(transfer_cmd));
     }
 
     void submit_transfer_commands(
-        VkQueue         graphics_queue,
+        VkQueue         transfer_queue,
         VkCommandBuffer transfer_cmd,
-        VkFence         transfer_fence) noexcept {
+        VkSemaphore     previous_graphics_ended,
+        VkSemaphore     transfer_ended) noexcept {
+        // The copies overwrite resources that the previous frame may still be sampling.
+        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
         VkSubmitInfo submit_info{
             .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-            .waitSemaphoreCount   = 0,
+            .waitSemaphoreCount   = (previous_graphics_ended != nullptr) ? 1u : 0u,
+            .pWaitSemaphores      = &previous_graphics_ended,
+            .pWaitDstStageMask    = &wait_stage,
             .commandBufferCount   = 1,
             .pCommandBuffers      = &transfer_cmd,
-            .signalSemaphoreCount = 0,
+            .signalSemaphoreCount = 1,
+            .pSignalSemaphores    = &transfer_ended,
         };
-        mina_vk_assert(vkQueueSubmit(graphics_queue, 1, &submit_info, transfer_fence));
-    }
-
-    void wait_transfer_completion(VkDevice dev, VkFence transfer_fence) noexcept {
-        constexpr u64 DATA_TRANSFER_TIMEOUT = UINT64_MAX;
-        mina_vk_assert(vkWaitForFences(dev, 1, &transfer_fence, true, DATA_TRANSFER_TIMEOUT));
-        mina_vk_assert(vkResetFences(dev, 1, &transfer_fence));
+        mina_vk_assert(vkQueueSubmit(transfer_queue, 1, &submit_info, VK_NULL_HANDLE));
     }
 
     // -----------------------------------------------------------------------------
     // - Implementation of the graphics drawing routines -
     // -----------------------------------------------------------------------------
 
+    VkViewport integer_scaled_viewport(VkExtent2D surface_extent) noexcept {
+        u32 scale = psh_min(surface_extent.width / LCD_WIDTH, surface_extent.height / LCD_HEIGHT);
+
+        // Windows smaller than the LCD get a downscaled image instead of nothing at all.
+        if (psh_unlikely(scale == 0)) {
+            return VkViewport{
+                .x        = 0.0f,
+                .y        = 0.0f,
+                .width    = static_cast<f32>(surface_extent.width),
+                .height   = static_cast<f32>(surface_extent.height),
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f,
+            };
+        }
+
+        u32 width  = scale * LCD_WIDTH;
+        u32 height = scale * LCD_HEIGHT;
+        return VkViewport{
+            .x        = static_cast<f32>((surface_extent.width - width) / 2),
+            .y        = static_cast<f32>((surface_extent.height - height) / 2),
+            .width    = static_cast<f32>(width),
+            .height   = static_cast<f32>(height),
+            .minDepth = 0.0f,
+            .maxDepth = 1.0f,
+        };
+    }
+
     void record_graphics_commands(
-        VkCommandBuffer        graphics_cmd,
-        QueueFamilies const&   queues,
-        GraphicsCmdInfo const& info,
-        RenderDataInfo const&  data_info) noexcept {
+        VkCommandBuffer         graphics_cmd,
+        QueueFamilies const&    queues,
+        DynamicRendering const& rendering,
+        GraphicsCmdInfo const&  info,
+        RenderDataInfo const&   data_info) noexcept {
         mina_vk_assert(vkResetCommandBuffer(graphics_cmd, 0));
 
         constexpr VkCommandBufferBeginInfo BEGIN_INFO{
@@ -204,6 +471,131 @@ namespace mina {
         };
         mina_vk_assert(vkBeginCommandBuffer(graphics_cmd, &BEGIN_INFO));
         {
+            // Acquire the resources released by the dedicated transfer queue. The semaphore of the
+            // transfer is waited at the fragment shader stage, which is where they're consumed.
+            bool const dedicated_transfer = queues.has_dedicated_transfer();
+            if (dedicated_transfer && info.lcd_valid) {
+                record_image_barrier(
+                    graphics_cmd,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    lcd_ownership_barrier(
+                        info.lcd_image,
+                        queues.transfer_queue_index,
+                        queues.graphics_queue_index,
+                        0,
+                        VK_ACCESS_SHADER_READ_BIT));
+            }
+            if (dedicated_transfer && info.tile_data_size != 0) {
+                VkBufferMemoryBarrier acquire_tile_data{
+                    .sType               = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER,
+                    .srcAccessMask       = 0,
+                    .dstAccessMask       = VK_ACCESS_SHADER_READ_BIT,
+                    .srcQueueFamilyIndex = queues.transfer_queue_index,
+                    .dstQueueFamilyIndex = queues.graphics_queue_index,
+                    .buffer              = info.tile_data_buf,
+                    .offset              = TILE_DATA_BUFFER_OFFSET,
+                    .size                = info.tile_data_size,
+                };
+                record_buffer_barrier(
+                    graphics_cmd,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    acquire_tile_data);
+            }
+
+            // Compose the frame at the native resolution of the LCD. Every pixel is overwritten, so
+            // the previous contents are discarded once the last frame is done sampling them.
+            if (rendering.enabled) {
+                record_image_barrier(
+                    graphics_cmd,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    layout_barrier(
+                        info.native_image,
+                        VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        0,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT));
+            }
+            begin_color_pass(
+                graphics_cmd,
+                rendering,
+                info.native_render_pass,
+                info.native_frame_buf,
+                info.native_view,
+                NATIVE_EXTENT,
+                nullptr);
+            {
+                vkCmdBindPipeline(
+                    graphics_cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    info.native_pipeline);
+
+                VkViewport native_viewport{
+                    .x        = 0.0f,
+                    .y        = 0.0f,
+                    .width    = static_cast<f32>(NATIVE_EXTENT.width),
+                    .height   = static_cast<f32>(NATIVE_EXTENT.height),
+                    .minDepth = 0.0f,
+                    .maxDepth = 1.0f,
+                };
+                vkCmdSetViewport(graphics_cmd, 0, 1, &native_viewport);
+
+                VkRect2D native_scissors{
+                    .offset = {0, 0},
+                    .extent = NATIVE_EXTENT,
+                };
+                vkCmdSetScissor(graphics_cmd, 0, 1, &native_scissors);
+
+                vkCmdBindDescriptorSets(
+                    graphics_cmd,
+                    VK_PIPELINE_BIND_POINT_GRAPHICS,
+                    info.native_pipeline_layout,
+                    0,
+                    1,
+                    &info.native_descriptor_set,
+                    0,
+                    nullptr);
+
+                vkCmdDraw(
+                    graphics_cmd,
+                    data_info.vertex_count,
+                    data_info.instance_count,
+                    data_info.first_vertex_index,
+                    data_info.first_instance_index);
+            }
+            end_color_pass(graphics_cmd, rendering);
+
+            // Make the composed frame visible to the scaling pass.
+            if (rendering.enabled) {
+                record_image_barrier(
+                    graphics_cmd,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    layout_barrier(
+                        info.native_image,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        VK_ACCESS_SHADER_READ_BIT));
+            }
+
+            // Give the texture back to the transfer queue, which copies the next dirty lines into
+            // it. The tile data is overwritten as a whole, so it is never released back.
+            if (dedicated_transfer && info.lcd_valid) {
+                record_image_barrier(
+                    graphics_cmd,
+                    VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    lcd_ownership_barrier(
+                        info.lcd_image,
+                        queues.graphics_queue_index,
+                        queues.transfer_queue_index,
+                        0,
+                        0));
+            }
+
             bool const sharing_mode_is_exclusive =
                 (queues.present_queue_index != queues.graphics_queue_index);
 
@@ -231,33 +623,36 @@ namespace mina {
                     &image_from_present_to_graphics_queue);
             }
 
-            constexpr VkClearValue clear_color{.color = {.float32{MINA_CLEAR_COLOR}}};
-            VkRenderPassBeginInfo  render_pass_begin_info{
-                 .sType       = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO,
-                 .renderPass  = info.render_pass.handle,
-                 .framebuffer = info.frame_buf,
-                 .renderArea{
-                     .offset = {0, 0},
-                     .extent = info.surface_extent,
-                },
-                 .clearValueCount = 1,
-                 .pClearValues    = &clear_color,
-            };
+            // The image is only written once the acquire semaphore, waited at the color attachment
+            // output stage, is signaled.
+            if (rendering.enabled) {
+                record_image_barrier(
+                    graphics_cmd,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    layout_barrier(
+                        info.image,
+                        VK_IMAGE_LAYOUT_UNDEFINED,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        0,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT));
+            }
 
-            vkCmdBeginRenderPass(graphics_cmd, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+            constexpr VkClearValue clear_color{.color = {.float32{MINA_CLEAR_COLOR}}};
+            begin_color_pass(
+                graphics_cmd,
+                rendering,
+                info.render_pass,
+                info.frame_buf,
+                info.image_view,
+                info.surface_extent,
+                &clear_color);
             {
                 vkCmdBindPipeline(graphics_cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, info.pipeline);
 
                 // Set the dynamic states.
                 {
-                    VkViewport dyn_viewport{
-                        .x        = 0.0f,
-                        .y        = 0.0f,
-                        .width    = static_cast<f32>(info.surface_extent.width),
-                        .height   = static_cast<f32>(info.surface_extent.height),
-                        .minDepth = 0.0f,
-                        .maxDepth = 1.0f,
-                    };
+                    VkViewport dyn_viewport = integer_scaled_viewport(info.surface_extent);
                     vkCmdSetViewport(graphics_cmd, 0, 1, &dyn_viewport);
 
                     VkRect2D dyn_scissors{
@@ -273,15 +668,9 @@ namespace mina {
                     info.pipeline_layout,
                     0,
                     1,
-                    &info.uniform_buf_descriptor_set,
+                    &info.descriptor_set,
                     0,
                     nullptr);
-                vkCmdBindVertexBuffers(
-                    graphics_cmd,
-                    info.vertex_buf_binding,
-                    1,
-                    &info.vertex_buf,
-                    &data_info.offset);
 
                 vkCmdDraw(
                     graphics_cmd,
@@ -290,7 +679,20 @@ namespace mina {
                     data_info.first_vertex_index,
                     data_info.first_instance_index);
             }
-            vkCmdEndRenderPass(graphics_cmd);
+            end_color_pass(graphics_cmd, rendering);
+
+            if (rendering.enabled) {
+                record_image_barrier(
+                    graphics_cmd,
+                    VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                    layout_barrier(
+                        info.image,
+                        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
+                        VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
+                        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                        0));
+            }
 
             if (sharing_mode_is_exclusive) {
                 VkImageMemoryBarrier image_from_graphics_to_present_queue{
@@ -321,22 +723,93 @@ namespace mina {
             "Failed to record commands to the buffer");
     }
 
+    namespace {
+        bool same_graphics_cmd_info(GraphicsCmdInfo const& a, GraphicsCmdInfo const& b) noexcept {
+            return (a.native_pipeline == b.native_pipeline) &&
+                   (a.native_pipeline_layout == b.native_pipeline_layout) &&
+                   (a.native_render_pass.handle == b.native_render_pass.handle) &&
+                   (a.native_frame_buf == b.native_frame_buf) &&
+                   (a.native_image == b.native_image) && (a.native_view == b.native_view) &&
+                   (a.native_descriptor_set == b.native_descriptor_set) &&
+                   (a.pipeline == b.pipeline) && (a.pipeline_layout == b.pipeline_layout) &&
+                   (a.image == b.image) && (a.image_view == b.image_view) &&
+                   (a.render_pass.handle == b.render_pass.handle) &&
+                   (a.frame_buf == b.frame_buf) &&
+                   (a.surface_extent.width == b.surface_extent.width) &&
+                   (a.surface_extent.height == b.surface_extent.height) &&
+                   (a.descriptor_set == b.descriptor_set) && (a.lcd_image == b.lcd_image) &&
+                   (a.lcd_valid == b.lcd_valid) && (a.tile_data_buf == b.tile_data_buf) &&
+                   (a.tile_data_size == b.tile_data_size);
+        }
+
+        bool same_render_data_info(RenderDataInfo const& a, RenderDataInfo const& b) noexcept {
+            return (a.vertex_count == b.vertex_count) && (a.instance_count == b.instance_count) &&
+                   (a.first_vertex_index == b.first_vertex_index) &&
+                   (a.first_instance_index == b.first_instance_index);
+        }
+    }  // namespace
+
+    VkCommandBuffer graphics_commands(
+        CommandManager&         cmds,
+        QueueFamilies const&    queues,
+        DynamicRendering const& rendering,
+        u32                     frame_index,
+        u32                     image_index,
+        GraphicsCmdInfo const&  info,
+        RenderDataInfo const&   data_info) noexcept {
+        psh_assert_msg(
+            image_index < cmds.graphics_image_count,
+            "Swap chain image without a graphics command buffer");
+
+        u32                  cmd_index = frame_index * cmds.graphics_image_count + image_index;
+        RecordedGraphicsCmd& recorded  = cmds.graphics[cmd_index];
+
+        // The frame in flight was already waited on, so the buffer isn't pending execution and
+        // can be re-recorded if anything changed.
+        if (psh_unlikely(
+                !recorded.is_recorded || !same_graphics_cmd_info(recorded.info, info) ||
+                !same_render_data_info(recorded.data_info, data_info))) {
+            record_graphics_commands(recorded.cmd, queues, rendering, info, data_info);
+            recorded.info        = info;
+            recorded.data_info   = data_info;
+            recorded.is_recorded = true;
+        }
+
+        return recorded.cmd;
+    }
+
+    void invalidate_graphics_commands(CommandManager& cmds) noexcept {
+        for (RecordedGraphicsCmd& recorded : cmds.graphics) {
+            recorded.is_recorded = false;
+        }
+    }
+
     void submit_graphics_commands(
         VkQueue         graphics_queue,
         VkCommandBuffer graphics_cmd,
         VkSemaphore     image_available,
+        VkSemaphore     transfer_ended,
         VkSemaphore     finished_render_pass,
+        VkSemaphore     graphics_ended,
         VkFence         frame_in_flight) noexcept {
-        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-        VkSubmitInfo         submit_info{
-                    .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-                    .waitSemaphoreCount   = 1,
-                    .pWaitSemaphores      = &image_available,
-                    .pWaitDstStageMask    = &wait_stage,
-                    .commandBufferCount   = 1,
-                    .pCommandBuffers      = &graphics_cmd,
-                    .signalSemaphoreCount = 1,
-                    .pSignalSemaphores    = &finished_render_pass,
+        // The staged LCD rows and tile data are only read by the fragment shaders, so the vertex
+        // work of the frame can overlap the tail of the transfer. Without a transfer (zero-copy
+        // staging ring), only the swap chain image is waited on.
+        VkSemaphore          wait_semas[2]  = {image_available, transfer_ended};
+        VkPipelineStageFlags wait_stages[2] = {
+            VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+            VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        };
+        VkSemaphore  signal_semas[2] = {finished_render_pass, graphics_ended};
+        VkSubmitInfo submit_info{
+            .sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+            .waitSemaphoreCount   = (transfer_ended != nullptr) ? 2u : 1u,
+            .pWaitSemaphores      = wait_semas,
+            .pWaitDstStageMask    = wait_stages,
+            .commandBufferCount   = 1,
+            .pCommandBuffers      = &graphics_cmd,
+            .signalSemaphoreCount = (graphics_ended != nullptr) ? 2u : 1u,
+            .pSignalSemaphores    = signal_semas,
         };
 
         mina_vk_assert_msg(
@@ -48,9 +48,13 @@ namespace mina {
         //
         // These indices may coincide, so in order to get them without repetition you'll need to
         // call `QueueFamilies::unique_indices`.
+        //
+        // The transfer family is optional: it's only set for a transfer-only family (no graphics
+        // or compute support), which usually maps to a DMA engine of the device.
         struct QueueFamiliesQuery {
             psh::Option<u32> graphics_idx = {};
             psh::Option<u32> present_idx  = {};
+            psh::Option<u32> transfer_idx = {};
 
             void
             query(psh::ScratchArena&& sarena, VkPhysicalDevice pdev, VkSurfaceKHR surf) noexcept {
@@ -60,20 +64,33 @@ namespace mina {
                 psh::Array<VkQueueFamilyProperties> fam_props{sarena.arena, fam_count};
                 vkGetPhysicalDeviceQueueFamilyProperties(pdev, &fam_count, fam_props.buf);
 
+                graphics_idx = {};
+                present_idx  = {};
+                transfer_idx = {};
+
                 for (u32 i = 0; i < fam_props.size; ++i) {
-                    if ((fam_props[i].queueFlags & VK_QUEUE_GRAPHICS_BIT) != 0) {
+                    VkQueueFlags flags = fam_props[i].queueFlags;
+
+                    if (!graphics_idx.has_val && ((flags & VK_QUEUE_GRAPHICS_BIT) != 0)) {
                         graphics_idx = i;
                     }
 
                     u32 present_support;
                     mina_vk_assert(
                         vkGetPhysicalDeviceSurfaceSupportKHR(pdev, i, surf, &present_support));
-                    if (present_support == VK_TRUE) {
+                    if (!present_idx.has_val && (present_support == VK_TRUE)) {
                         present_idx = i;
                     }
 
-                    if (this->has_all()) {
-                        break;
+                    // The LCD rows are copied at arbitrary line offsets, which requires a unit
+                    // image transfer granularity.
+                    VkExtent3D gran = fam_props[i].minImageTransferGranularity;
+                    bool unit_gran  = (gran.width == 1) && (gran.height == 1) && (gran.depth == 1);
+                    bool only_transfer = ((flags & VK_QUEUE_TRANSFER_BIT) != 0) &&
+                                         ((flags & VK_QUEUE_GRAPHICS_BIT) == 0) &&
+                                         ((flags & VK_QUEUE_COMPUTE_BIT) == 0);
+                    if (!transfer_idx.has_val && only_transfer && unit_gran) {
+                        transfer_idx = i;
                     }
                 }
             }
@@ -151,6 +168,8 @@ namespace mina {
                 ctx.pdev                        = pdev;
                 ctx.queues.graphics_queue_index = qfq.graphics_idx.val;
                 ctx.queues.present_queue_index  = qfq.present_idx.val;
+                ctx.queues.transfer_queue_index =
+                    qfq.transfer_idx.has_val ? qfq.transfer_idx.val : qfq.graphics_idx.val;
 
                 found = true;
                 break;
@@ -159,16 +178,44 @@ namespace mina {
             return found;
         }
 
+        /// Whether the device supports dynamic rendering, either in core, when the device supports
+        /// Vulkan 1.3, or through `VK_KHR_dynamic_rendering`, whose dependencies are in core since
+        /// Vulkan 1.2.
+        bool query_dynamic_rendering(
+            psh::ScratchArena&& sarena,
+            VkPhysicalDevice    pdev,
+            bool&               is_core) noexcept {
+            VkPhysicalDeviceProperties props;
+            vkGetPhysicalDeviceProperties(pdev, &props);
+            is_core = (props.apiVersion >= VK_API_VERSION_1_3);
+
+            if (!is_core) {
+                constexpr psh::Buffer<strptr, 1> dyn_ext{VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME};
+                bool const has_ext =
+                    physical_device_has_extensions(sarena.decouple(), pdev, const_fat_ptr(dyn_ext));
+                if ((props.apiVersion < VK_API_VERSION_1_2) || !has_ext) {
+                    return false;
+                }
+            }
+
+            VkPhysicalDeviceDynamicRenderingFeatures dyn_feats{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+            };
+            VkPhysicalDeviceFeatures2 feats{
+                .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+                .pNext = &dyn_feats,
+            };
+            vkGetPhysicalDeviceFeatures2(pdev, &feats);
+            return (dyn_feats.dynamicRendering == VK_TRUE);
+        }
+
         VkDevice create_logical_device(
             VkPhysicalDevice          pdev,
             QueueFamilies&            queues,
             psh::ScratchArena&&       sarena,
-            psh::FatPtr<strptr const> exts) {
-            psh::DynArray<u32> uidx{sarena.arena, 2};
-            uidx.push(queues.graphics_queue_index);
-            if (psh_unlikely(queues.present_queue_index != queues.graphics_queue_index)) {
-                uidx.push(queues.present_queue_index);
-            }
+            psh::FatPtr<strptr const> exts,
+            void const*               features) {
+            psh::DynArray<u32> uidx = queues.unique_indices(sarena.arena);
 
             psh::Array<f32> priorities{sarena.arena, uidx.size};
             psh::fill(psh::fat_ptr(priorities), 1.0f);
@@ -187,6 +234,7 @@ namespace mina {
             VkDevice           dev;
             VkDeviceCreateInfo dev_info{
                 .sType                   = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+                .pNext                   = features,
                 .queueCreateInfoCount    = static_cast<u32>(dev_queue_info.size),
                 .pQueueCreateInfos       = dev_queue_info.buf,
                 .enabledExtensionCount   = static_cast<u32>(exts.size),
@@ -203,10 +251,11 @@ namespace mina {
     // -----------------------------------------------------------------------------
 
     void init_graphics_system(
-        GraphicsContext& ctx,
-        WindowHandle*    win_handle,
-        psh::Arena*      persistent_arena,
-        psh::Arena*      work_arena) noexcept {
+        GraphicsContext&     ctx,
+        WindowHandle*        win_handle,
+        psh::Arena*          persistent_arena,
+        psh::Arena*          work_arena,
+        PresentConfig const& present_config) noexcept {
         psh_assert_msg(
             persistent_arena != nullptr,
             "Persistent arena required for the graphics context");
@@ -291,6 +340,7 @@ namespace mina {
         psh::ScratchArena sarena   = ctx.work_arena->make_scratch();
 
         // Select the physical device having the requested extensions, and get its swap chain info.
+        bool dyn_rendering_is_core = false;
         {
             constexpr psh::Buffer<strptr, 2> pdev_ext{"VK_KHR_swapchain", "VK_EXT_memory_budget"};
 
@@ -298,16 +348,58 @@ namespace mina {
                 select_physical_dev(ctx, sarena.arena, const_fat_ptr(pdev_ext), swc_info),
                 "Failed to find an adequate physical device for the Vulkan graphics context.");
 
+            // Dynamic rendering is optional, the render pass objects are used without it.
+            ctx.rendering.enabled = query_dynamic_rendering(
+                sarena.arena->make_scratch(),
+                ctx.pdev,
+                dyn_rendering_is_core);
+
+            psh::Buffer<strptr, 3> dev_ext{
+                pdev_ext[0],
+                pdev_ext[1],
+                VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
+            };
+            usize const dev_ext_count =
+                (ctx.rendering.enabled && !dyn_rendering_is_core) ? 3 : 2;
+
+            VkPhysicalDeviceDynamicRenderingFeatures dyn_feats{
+                .sType            = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES,
+                .dynamicRendering = VK_TRUE,
+            };
+
             ctx.dev = create_logical_device(
                 ctx.pdev,
                 ctx.queues,
                 sarena.decouple(),
-                const_fat_ptr(pdev_ext));
+                psh::FatPtr<strptr const>{dev_ext.buf, dev_ext_count},
+                ctx.rendering.enabled ? &dyn_feats : nullptr);
         }
 
+        // Load the dynamic rendering entry points, under their extension names if not in core.
+        if (ctx.rendering.enabled) {
+            strptr begin_name = dyn_rendering_is_core ? "vkCmdBeginRendering"
+                                                      : "vkCmdBeginRenderingKHR";
+            strptr end_name = dyn_rendering_is_core ? "vkCmdEndRendering" : "vkCmdEndRenderingKHR";
+            ctx.rendering.begin =
+                reinterpret_cast<PFN_vkCmdBeginRendering>(vkGetDeviceProcAddr(ctx.dev, begin_name));
+            ctx.rendering.end =
+                reinterpret_cast<PFN_vkCmdEndRendering>(vkGetDeviceProcAddr(ctx.dev, end_name));
+            ctx.rendering.enabled =
+                (ctx.rendering.begin != nullptr) && (ctx.rendering.end != nullptr);
+        }
+        psh_debug_fmt(
+            "Rendering with %s.",
+            ctx.rendering.enabled ? "dynamic rendering" : "render pass objects");
+
         // Setup queues.
         vkGetDeviceQueue(ctx.dev, ctx.queues.graphics_queue_index, 0, &ctx.queues.graphics_queue);
         vkGetDeviceQueue(ctx.dev, ctx.queues.present_queue_index, 0, &ctx.queues.present_queue);
+        vkGetDeviceQueue(ctx.dev, ctx.queues.transfer_queue_index, 0, &ctx.queues.transfer_queue);
+        if (ctx.queues.has_dedicated_transfer()) {
+            psh_debug_fmt(
+                "Uploads run on the dedicated transfer queue family %u.",
+                ctx.queues.transfer_queue_index);
+        }
 
         // Create the allocator for the graphics context.
         {
@@ -330,36 +422,81 @@ namespace mina {
             vmaCreateAllocator(&alloc_info, &ctx.alloc);
         }
 
+        ctx.swap_chain.present_config = present_config;
         create_swap_chain(ctx.dev, ctx.surf, ctx.swap_chain, ctx.queues, win_handle, swc_info);
 
         create_image_views(ctx.dev, ctx.swap_chain, ctx.persistent_arena);
 
-        // Create vertex and uniform buffers.
-        create_buffers(ctx.alloc, ctx.buffers, ctx.queues);
+        // Create the staging ring, the tile renderer data buffer and the LCD texture.
+        create_buffers(ctx.alloc, ctx.buffers, ctx.queues, ctx.swap_chain.max_frames_in_flight);
+        create_lcd_texture(ctx.dev, ctx.alloc, ctx.buffers.lcd);
+        create_native_target(ctx.dev, ctx.alloc, ctx.buffers.native);
 
-        // Create the descriptor set for the uniform buffer.
-        create_descriptor_sets(ctx.dev, ctx.descriptor_sets, ctx.buffers.uniform_buffer());
+        // Create the descriptor sets for the sampled images and the tile renderer data.
+        create_descriptor_sets(ctx.dev, ctx.persistent_arena, ctx.descriptor_sets, ctx.buffers);
+        if (ctx.buffers.zero_copy) {
+            psh_debug("The staging ring is zero-copy, frame data is read in place by the shaders.");
+        }
+
+        // Pipelines found in the on-disk cache of the device skip shader compilation.
+        create_pipeline_cache(ctx.dev, ctx.pdev, ctx.work_arena, ctx.pipeline_cache);
 
         create_graphics_pipeline_context(
             ctx.dev,
-            ctx.persistent_arena,
+            ctx.pipeline_cache.handle,
             ctx.pipelines.graphics,
             ctx.descriptor_sets,
             ctx.swap_chain.surface_format.format,
-            ctx.swap_chain.extent);
+            ctx.rendering.enabled);
 
-        create_frame_buffers(
+        create_native_pipeline_context(
             ctx.dev,
-            ctx.swap_chain,
-            ctx.persistent_arena,
-            ctx.pipelines.graphics.render_pass);
+            ctx.pipeline_cache.handle,
+            ctx.pipelines.compose,
+            ctx.descriptor_sets,
+            ctx.rendering.enabled);
+
+        create_tile_renderer_pipeline(
+            ctx.dev,
+            ctx.pipeline_cache.handle,
+            ctx.pipelines.tile_renderer,
+            ctx.pipelines.compose.render_pass,
+            ctx.descriptor_sets);
+
+        if (ctx.buffers.zero_copy) {
+            create_lcd_buffer_pipeline(
+                ctx.dev,
+                ctx.pipeline_cache.handle,
+                ctx.pipelines.lcd_buffer,
+                ctx.pipelines.compose.render_pass,
+                ctx.descriptor_sets);
+        }
+
+        // Every pipeline exists by now. Saving right away keeps the cache useful for the next
+        // launches even if this one doesn't shut down cleanly.
+        save_pipeline_cache(ctx.dev, ctx.pdev, ctx.work_arena, ctx.pipeline_cache);
+
+        // Dynamic rendering draws directly to the image views, without frame buffers.
+        if (!ctx.rendering.enabled) {
+            create_native_frame_buffer(
+                ctx.dev,
+                ctx.buffers.native,
+                ctx.pipelines.compose.render_pass);
+
+            create_frame_buffers(
+                ctx.dev,
+                ctx.swap_chain,
+                ctx.persistent_arena,
+                ctx.pipelines.graphics.render_pass);
+        }
 
         create_command_buffers(
             ctx.dev,
             ctx.commands,
             ctx.queues,
             ctx.persistent_arena,
-            ctx.swap_chain.max_frames_in_flight);
+            ctx.swap_chain.max_frames_in_flight,
+            static_cast<u32>(ctx.swap_chain.images.size));
 
         create_synchronizers(
             ctx.dev,
@@ -374,9 +511,15 @@ namespace mina {
 
         destroy_command_buffers(ctx.dev, ctx.commands);
         destroy_descriptor_sets(ctx.dev, ctx.descriptor_sets);
+        destroy_native_pipeline(ctx.dev, ctx.pipelines.lcd_buffer);
+        destroy_native_pipeline(ctx.dev, ctx.pipelines.tile_renderer);
+        destroy_graphics_pipeline_context(ctx.dev, ctx.pipelines.compose);
         destroy_graphics_pipeline_context(ctx.dev, ctx.pipelines.graphics);
+        destroy_pipeline_cache(ctx.dev, ctx.pdev, ctx.work_arena, ctx.pipeline_cache);
         destroy_swap_chain(ctx.dev, ctx.swap_chain);
 
+        destroy_native_target(ctx.dev, ctx.alloc, ctx.buffers.native);
+        destroy_lcd_texture(ctx.dev, ctx.alloc, ctx.buffers.lcd);
         destroy_buffers(ctx.alloc, ctx.buffers);
         vmaDestroyAllocator(ctx.alloc);
 
@@ -393,35 +536,75 @@ namespace mina {
     void recreate_swap_chain_context(GraphicsContext& ctx, Window& win) noexcept {
         wait_if_minimized(win);
 
-        // Complete all operations before proceeding
-        vkDeviceWaitIdle(ctx.dev);
+        SwapChain&                 swc    = ctx.swap_chain;
+        psh::Array<VkFence> const& fences = ctx.sync.frame_in_flight.frame_fence;
 
-        // Recreate the swap chain itself.
+        // Frames in flight that are still rendering may be using the images of the swap chain.
+        u32 pending_frames = 0;
+        for (u32 idx = 0; idx < fences.size; ++idx) {
+            if (vkGetFenceStatus(ctx.dev, fences[idx]) == VK_NOT_READY) {
+                pending_frames |= (1u << idx);
+            }
+        }
+
+        // Only wait when too many recreations happened within the frames in flight, and only on
+        // the frames using the retired images rather than on the whole device.
+        if (swc.retired_count == MAX_RETIRED_SWAP_CHAINS) {
+            u32 retired_frames = 0;
+            for (u32 idx = 0; idx < swc.retired_count; ++idx) {
+                retired_frames |= swc.retired[idx].pending_frames;
+            }
+            for (u32 idx = 0; idx < fences.size; ++idx) {
+                if ((retired_frames & (1u << idx)) != 0) {
+                    mina_vk_assert(vkWaitForFences(ctx.dev, 1, &fences[idx], VK_TRUE, UINT64_MAX));
+                }
+            }
+            release_retired_swap_chains(ctx.dev, swc, ~0u);
+            pending_frames = 0;
+        }
+
+        // Recreate the swap chain itself. The retired resources are released as their frames
+        // in flight retire.
         {
-            destroy_swap_chain(ctx.dev, ctx.swap_chain);
+            retire_swap_chain(swc, pending_frames);
 
             psh::ScratchArena sarena = ctx.work_arena->make_scratch();
             SwapChainInfo     swc_info;
             query_swap_chain_info(ctx.pdev, ctx.surf, sarena.arena, swc_info);
 
-            create_swap_chain(ctx.dev, ctx.surf, ctx.swap_chain, ctx.queues, win.handle, swc_info);
+            create_swap_chain(ctx.dev, ctx.surf, swc, ctx.queues, win.handle, swc_info);
+
+            // Nothing used the old images, they can go right away.
+            if (pending_frames == 0) {
+                release_retired_swap_chains(ctx.dev, swc, 0);
+            }
         }
 
         // Recreate the swap chain's associated context objects.
-        recreate_image_views(ctx.dev, ctx.swap_chain);
-        recreate_frame_buffers(ctx.dev, ctx.swap_chain, ctx.pipelines.graphics.render_pass);
+        recreate_image_views(ctx.dev, swc);
+        if (!ctx.rendering.enabled) {
+            recreate_frame_buffers(ctx.dev, swc, ctx.pipelines.graphics.render_pass);
+        }
+
+        // The recorded graphics commands reference the retired images and frame buffers.
+        invalidate_graphics_commands(ctx.commands);
     }
 
     FrameResources current_frame_resources(GraphicsContext const& ctx) noexcept {
         u32 current_frame = ctx.swap_chain.current_frame;
         return FrameResources{
+            .frame_index               = current_frame,
             .transfer_cmd              = ctx.commands.transfer.cmd[current_frame],
-            .graphics_cmd              = ctx.commands.graphics.cmd[current_frame],
             .frame_in_flight_fence     = ctx.sync.frame_in_flight.frame_fence[current_frame],
-            .transfer_ended_fence      = ctx.sync.finished_transfer.frame_fence[current_frame],
+            .transfer_ended_semaphore  = ctx.sync.finished_transfer.frame_semaphore[current_frame],
             .image_available_semaphore = ctx.sync.image_available.frame_semaphore[current_frame],
             .render_pass_ended_semaphore =
                 ctx.sync.finished_render_pass.frame_semaphore[current_frame],
+            .graphics_ended_semaphore =
+                (ctx.queues.has_dedicated_transfer() && !ctx.buffers.zero_copy)
+                    ? ctx.sync.finished_graphics.frame_semaphore[current_frame]
+                    : nullptr,
+            .previous_graphics_ended = ctx.sync.pending_graphics_ended,
         };
     }
 }  // namespace mina
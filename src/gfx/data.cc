@@ -21,65 +21,128 @@
 
 #include <mina/gfx/data.h>
 
-#include <psh/vec.h>
+#include <mina/hash.h>
+#include <psh/assert.h>
+#include <cstring>
 
 namespace mina {
-    VertexData vertex_data(FrameMemory const& frame_memory) noexcept {
-        return VertexData{
-            psh::FatPtr<Vertex>{
-                reinterpret_cast<Vertex*>(frame_memory.vertex_buf),
-                VERTEX_BUF_SIZE / sizeof(Vertex)},
-        };
+    static_assert(
+        sizeof(TileRendererInput) == TILE_DATA_BUFFER_SIZE,
+        "The tile data buffer must hold exactly the tile renderer input");
+
+    namespace {
+        /// The palette, the LCD pixels and the tile renderer input are allocated back to back, in
+        /// that order, so that the hash of a frame covers all of them at once.
+        constexpr usize FRAME_MEMORY_SIZE =
+            sizeof(PaletteTable) + LCD_PIXEL_COUNT + TILE_DATA_BUFFER_SIZE;
+        static_assert(sizeof(PaletteTable) % alignof(PaletteTable) == 0);
+
+        bool lcd_row_is_dirty(FrameMemory const& frame_memory, u32 line) noexcept {
+            return ((frame_memory.lcd_dirty_rows[line / 64] >> (line % 64)) & 1) != 0;
+        }
+    }  // namespace
+
+    FrameMemory create_frame_memory(psh::MemoryManager& memory_manager) noexcept {
+        FrameMemory frame_memory;
+        frame_memory.arena = memory_manager.make_arena(FRAME_MEMORY_SIZE).demand();
+
+        frame_memory.palette    = frame_memory.arena.zero_alloc<PaletteTable>(1);
+        frame_memory.lcd_pixels = frame_memory.arena.zero_alloc<u8>(LCD_PIXEL_COUNT);
+        frame_memory.tile_input = reinterpret_cast<TileRendererInput*>(
+            frame_memory.arena.zero_alloc<u8>(TILE_DATA_BUFFER_SIZE));
+
+        // Start with a blank (white) screen, as the Game Boy does when the LCD is turned off: every
+        // pixel has the background color 0, which the cleared palette registers map to white.
+        psh_discard(update_dmg_palette_table(*frame_memory.palette, HwRegisterBank{}));
+        mark_lcd_rows_dirty(frame_memory, 0, LCD_HEIGHT);
+
+        return frame_memory;
     }
 
-    Vertex* vertex_buffer_ptr(FrameMemory const& frame_memory) noexcept {
-        return reinterpret_cast<Vertex*>(frame_memory.vertex_buf);
+    void write_lcd_row(FrameMemory& frame_memory, u32 line, u8 const* pixel_ids) noexcept {
+        psh_assert_msg(line < LCD_HEIGHT, "Line out of the LCD bounds");
+
+        u8* row = frame_memory.lcd_pixels + line * LCD_WIDTH;
+        if (std::memcmp(row, pixel_ids, LCD_WIDTH) != 0) {
+            std::memcpy(row, pixel_ids, LCD_WIDTH);
+            mark_lcd_rows_dirty(frame_memory, line, 1);
+        }
     }
 
-    FrameMemory create_frame_memory(psh::MemoryManager& memory_manager, f32 aspect) noexcept {
-        FrameMemory frame_memory;
-        frame_memory.arena = memory_manager.make_arena(VERTEX_BUF_SIZE + UNIFORM_BUF_SIZE).demand();
-
-        frame_memory.vertex_buf = frame_memory.arena.zero_alloc<u8>(VERTEX_BUF_SIZE);
-
-        // Initialize the state of the vertices.
-        {
-            frame_memory.vertex_count = 3;
-            Vertex* vertex_buf        = vertex_buffer_ptr(frame_memory);
-
-            // Counter-clockwise face.
-            vertex_buf[0].position = psh::Vec3{0.0f, -0.5f, 0.0f};
-            vertex_buf[0].color    = psh::Vec3{1.0f, 0.0f, 0.0f};
-            vertex_buf[1].position = psh::Vec3{0.5f, 0.5f, 0.0f};
-            vertex_buf[1].color    = psh::Vec3{0.0f, 1.0f, 0.0f};
-            vertex_buf[2].position = psh::Vec3{-0.5f, 0.5f, 0.0f};
-            vertex_buf[2].color    = psh::Vec3{0.0f, 0.0f, 1.0f};
+    void update_lcd_palette(FrameMemory& frame_memory, HwRegisterBank const& reg) noexcept {
+        if (update_dmg_palette_table(*frame_memory.palette, reg)) {
+            mark_lcd_rows_dirty(frame_memory, 0, LCD_HEIGHT);
         }
+    }
 
-        return frame_memory;
+    void collect_dirty_lcd_rows(FrameMemory& frame_memory) noexcept {
+        if (!frame_memory.lcd_texture_valid) {
+            mark_lcd_rows_dirty(frame_memory, 0, LCD_HEIGHT);
+        }
+
+        u32 range_count = 0;
+        u32 line        = 0;
+        while (line < LCD_HEIGHT) {
+            if (!lcd_row_is_dirty(frame_memory, line)) {
+                ++line;
+                continue;
+            }
+
+            u32 first_line = line;
+            while (line < LCD_HEIGHT && lcd_row_is_dirty(frame_memory, line)) {
+                ++line;
+            }
+            frame_memory.lcd_ranges[range_count++] = LcdRowRange{
+                .first_line = first_line,
+                .line_count = line - first_line,
+            };
+        }
+
+        frame_memory.lcd_range_count = range_count;
+        for (u64& word : frame_memory.lcd_dirty_rows) {
+            word = 0;
+        }
     }
 
-    StagingInfo memory_staging_info(FrameMemory const& frame_memory) noexcept {
+    u64 frame_memory_hash(FrameMemory const& frame_memory) noexcept {
+        return hash_memory(frame_memory.arena.buf, FRAME_MEMORY_SIZE);
+    }
+
+    StagingInfo memory_staging_info(FrameMemory const& frame_memory, u32 frame_index) noexcept {
+        u8 const* tile_data_src = reinterpret_cast<u8 const*>(frame_memory.tile_input);
+        bool      tiles         = frame_memory.uses_tile_renderer;
+
         return StagingInfo{
-            .src_ptr                = frame_memory.arena.buf,
-            .vertex_buf_size        = VERTEX_BUF_SIZE,
-            .vertex_buf_src_offset  = 0,
-            .vertex_buf_dst_offset  = 0,
-            // NOTE(luiz): currently there is no uniform buffer.
-            .uniform_buf_size       = 0,
-            .uniform_buf_src_offset = 0,
-            .uniform_buf_dst_offset = 0,
+            .src_ptr              = frame_memory.arena.buf,
+            .dst_slice_offset     = frame_index * STAGING_SLICE_SIZE,
+            .lcd_pixels           = frame_memory.lcd_pixels,
+            .palette              = frame_memory.palette,
+            .lcd_ranges           = frame_memory.lcd_ranges,
+            .lcd_range_count      = tiles ? 0 : frame_memory.lcd_range_count,
+            .lcd_discard          = !frame_memory.lcd_texture_valid,
+            .tile_data_size       = tiles ? TILE_DATA_BUFFER_SIZE : 0,
+            .tile_data_src_offset = static_cast<usize>(tile_data_src - frame_memory.arena.buf),
         };
     }
 
-    RenderDataInfo render_data_info(FrameMemory const& frame_memory) noexcept {
+    void convert_staged_lcd_rows(StagingInfo const& info, u8* lcd_frame) noexcept {
+        for (u32 idx = 0; idx < info.lcd_range_count; ++idx) {
+            LcdRowRange const& range = info.lcd_ranges[idx];
+            for (u32 line = range.first_line; line < range.first_line + range.line_count; ++line) {
+                convert_scanline(
+                    *info.palette,
+                    info.lcd_pixels + line * LCD_WIDTH,
+                    lcd_frame + line * LCD_ROW_SIZE);
+            }
+        }
+    }
+
+    RenderDataInfo render_data_info([[maybe_unused]] FrameMemory const& frame_memory) noexcept {
+        // Both the LCD presentation and the tile renderer draw a single triangle covering the
+        // whole viewport, generated by the vertex shader.
         return RenderDataInfo{
-            .size                 = VERTEX_BUF_SIZE,
-            .offset               = 0,
-            .vertex_count         = frame_memory.vertex_count,
-            .instance_count       = 1,
-            .first_vertex_index   = 0,
-            .first_instance_index = 0,
+            .vertex_count   = 3,
+            .instance_count = 1,
         };
     }
 }  // namespace mina
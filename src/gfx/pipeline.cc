@@ -21,13 +21,14 @@
 
 #include <mina/gfx/pipeline.h>
 
-#include <mina/gfx/data.h>
 #include <mina/gfx/utils.h>
 #include <psh/buffer.h>
 #include <psh/defer.h>
 #include <psh/streams.h>
 #include <psh/log.h>
 #include <psh/string.h>
+#include <cstdio>
+#include <cstring>
 
 namespace mina {
     // -----------------------------------------------------------------------------
@@ -35,22 +36,200 @@ namespace mina {
     // -----------------------------------------------------------------------------
 
     namespace {
-        VkShaderModule make_shader_module(
-            VkDevice               dev,
-            psh::StringView const& shader_src) noexcept {
+        // SPIR-V words generated by glslc from the sources in `src/shaders`.
+        constexpr u32 FULLSCREEN_VERT_SPV[] = {
+#include "fullscreen.vert.spv.inc"
+        };
+        constexpr u32 LCD_FRAG_SPV[] = {
+#include "lcd.frag.spv.inc"
+        };
+        constexpr u32 LCD_BUFFER_FRAG_SPV[] = {
+#include "lcd_buffer.frag.spv.inc"
+        };
+        constexpr u32 LCD_TILES_FRAG_SPV[] = {
+#include "lcd_tiles.frag.spv.inc"
+        };
+        constexpr u32 SCALE_FRAG_SPV[] = {
+#include "scale.frag.spv.inc"
+        };
+
+        struct ShaderCode {
+            u32 const* words;
+            usize      size;  ///< Size in bytes.
+        };
+
+        template <usize N>
+        constexpr ShaderCode spirv(u32 const (&words)[N]) noexcept {
+            return ShaderCode{.words = words, .size = N * sizeof(u32)};
+        }
+
+        constexpr ShaderCode shader_code(ShaderCatalog s) noexcept {
+            ShaderCode code;
+            switch (s) {
+                case ShaderCatalog::FULLSCREEN_VERTEX:   code = spirv(FULLSCREEN_VERT_SPV); break;
+                case ShaderCatalog::LCD_FRAGMENT:        code = spirv(LCD_FRAG_SPV); break;
+                case ShaderCatalog::LCD_BUFFER_FRAGMENT: code = spirv(LCD_BUFFER_FRAG_SPV); break;
+                case ShaderCatalog::LCD_TILES_FRAGMENT:  code = spirv(LCD_TILES_FRAG_SPV); break;
+                case ShaderCatalog::SCALE_FRAGMENT:      code = spirv(SCALE_FRAG_SPV); break;
+                default:                                 psh_unreachable();
+            }
+            return code;
+        }
+
+        /// Create the module of a shader embedded in the binary.
+        VkShaderModule make_shader_module(VkDevice dev, ShaderCatalog shader) noexcept {
+            ShaderCode code = shader_code(shader);
+
             VkShaderModuleCreateInfo sm_info{
                 .sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-                .codeSize = shader_src.data.size,
-                .pCode    = reinterpret_cast<u32 const*>(shader_src.data.buf),
+                .codeSize = code.size,
+                .pCode    = code.words,
             };
 
             VkShaderModule sm;
             if (vkCreateShaderModule(dev, &sm_info, nullptr, &sm) != VK_SUCCESS) {
                 sm = nullptr;
-                psh_error_fmt("Couldn't make shader module for shader:\n%s", shader_src.data.buf);
+                psh_error_fmt(
+                    "Couldn't make shader module for shader %d.",
+                    static_cast<i32>(shader));
             }
             return sm;
         }
+
+        /// Create a pipeline drawing a single triangle covering the whole viewport. The vertices
+        /// are generated by the vertex shader, so the pipeline has no vertex input.
+        void create_fullscreen_pipeline(
+            VkDevice              dev,
+            VkPipelineCache       cache,
+            Pipeline&             pip,
+            RenderPass            render_pass,
+            VkDescriptorSetLayout set_layout,
+            ShaderCatalog         vert_shader,
+            ShaderCatalog         frag_shader) noexcept {
+            psh::Buffer<VkShaderModule, 2> shaders{
+                make_shader_module(dev, vert_shader),
+                make_shader_module(dev, frag_shader),
+            };
+
+            psh::Buffer<VkPipelineShaderStageCreateInfo, 2> pipe_shader_stages_info{
+                VkPipelineShaderStageCreateInfo{
+                    .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage  = VK_SHADER_STAGE_VERTEX_BIT,
+                    .module = shaders[0],
+                    .pName  = "main",
+                },
+                VkPipelineShaderStageCreateInfo{
+                    .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+                    .stage  = VK_SHADER_STAGE_FRAGMENT_BIT,
+                    .module = shaders[1],
+                    .pName  = "main",
+                },
+            };
+
+            VkPipelineLayoutCreateInfo pipe_layout_info{
+                .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+                .setLayoutCount         = 1,
+                .pSetLayouts            = &set_layout,
+                .pushConstantRangeCount = 0,
+            };
+            mina_vk_assert(
+                vkCreatePipelineLayout(dev, &pipe_layout_info, nullptr, &pip.pipeline_layout));
+
+            constexpr VkPipelineVertexInputStateCreateInfo PIPE_VERT_STAGE_INFO{
+                .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
+                .vertexBindingDescriptionCount   = 0,
+                .vertexAttributeDescriptionCount = 0,
+            };
+            constexpr VkPipelineInputAssemblyStateCreateInfo PIPE_INPUT_ASSEMBLY_INFO{
+                .sType    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
+                .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
+                .primitiveRestartEnable = VK_FALSE,
+            };
+
+            // Both the viewport and scissors are dynamic states.
+            constexpr VkPipelineViewportStateCreateInfo PIPE_VIEWPORT_INFO{
+                .sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
+                .viewportCount = 1,
+                .scissorCount  = 1,
+            };
+            constexpr VkPipelineRasterizationStateCreateInfo PIPE_RASTERIZATION_INFO{
+                .sType            = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
+                .depthClampEnable = VK_FALSE,
+                .rasterizerDiscardEnable = VK_FALSE,
+                .polygonMode             = VK_POLYGON_MODE_FILL,
+                .cullMode                = VK_CULL_MODE_NONE,
+                .frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE,
+                .depthBiasEnable         = VK_FALSE,
+                .lineWidth               = 1.0f,
+            };
+            constexpr VkPipelineMultisampleStateCreateInfo PIPE_SAMPLING_INFO{
+                .sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
+                .rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT,
+                .sampleShadingEnable   = VK_FALSE,
+                .minSampleShading      = 1.0f,
+                .alphaToCoverageEnable = VK_FALSE,
+                .alphaToOneEnable      = VK_FALSE,
+            };
+
+            // The LCD is opaque, no blending is needed.
+            constexpr VkPipelineColorBlendAttachmentState PIPE_BLEND_ATTACHMENT{
+                .blendEnable    = VK_FALSE,
+                .colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                  VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
+            };
+            VkPipelineColorBlendStateCreateInfo pipe_color_blending{
+                .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
+                .logicOpEnable   = VK_FALSE,
+                .attachmentCount = 1,
+                .pAttachments    = &PIPE_BLEND_ATTACHMENT,
+            };
+
+            constexpr psh::Buffer<VkDynamicState, 2> PIPE_DYNAMICALLY_SET_STATES{
+                VK_DYNAMIC_STATE_SCISSOR,
+                VK_DYNAMIC_STATE_VIEWPORT,
+            };
+            VkPipelineDynamicStateCreateInfo pipe_dynamic_states_info{
+                .sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
+                .dynamicStateCount = PIPE_DYNAMICALLY_SET_STATES.size(),
+                .pDynamicStates    = PIPE_DYNAMICALLY_SET_STATES.buf,
+            };
+
+            VkGraphicsPipelineCreateInfo pipe_info{
+                .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
+                .stageCount          = pipe_shader_stages_info.size(),
+                .pStages             = pipe_shader_stages_info.buf,
+                .pVertexInputState   = &PIPE_VERT_STAGE_INFO,
+                .pInputAssemblyState = &PIPE_INPUT_ASSEMBLY_INFO,
+                .pTessellationState  = nullptr,
+                .pViewportState      = &PIPE_VIEWPORT_INFO,
+                .pRasterizationState = &PIPE_RASTERIZATION_INFO,
+                .pMultisampleState   = &PIPE_SAMPLING_INFO,
+                .pDepthStencilState  = nullptr,
+                .pColorBlendState    = &pipe_color_blending,
+                .pDynamicState       = &pipe_dynamic_states_info,
+                .layout              = pip.pipeline_layout,
+                .renderPass          = render_pass.handle,
+                .subpass             = 0,
+            };
+
+            // Without a render pass object, the attachment is described to the pipeline instead.
+            VkPipelineRenderingCreateInfo rendering_info{
+                .sType                   = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO,
+                .colorAttachmentCount    = 1,
+                .pColorAttachmentFormats = &render_pass.color_format,
+            };
+            if (render_pass.handle == nullptr) {
+                pipe_info.pNext = &rendering_info;
+            }
+            mina_vk_assert(
+                vkCreateGraphicsPipelines(dev, cache, 1, &pipe_info, nullptr, &pip.handle));
+
+            pip.render_pass = render_pass;
+
+            for (VkShaderModule shader : shaders) {
+                vkDestroyShaderModule(dev, shader, nullptr);
+            }
+        }
     }  // namespace
 
     // -----------------------------------------------------------------------------
@@ -59,40 +238,71 @@ namespace mina {
 
     void create_descriptor_sets(
         VkDevice              dev,
+        psh::Arena*           persistent_arena,
         DescriptorSetManager& descriptor_sets,
-        Buffer const&         uniform_buf) noexcept {
-        // Create the descriptor set layout.
+        BufferManager const&  buffers) noexcept {
+        LcdTexture const&   lcd_texture   = buffers.lcd;
+        NativeTarget const& native_target = buffers.native;
+        Buffer              tile_data_buf = buffers.tile_data_buffer();
+
+        // Sets reading the LCD frame and the tile data of each slice of a zero-copy staging ring.
+        u32 frame_set_count = buffers.zero_copy ? 2 * buffers.host.slice_count : 0;
+
+        // Create the descriptor set layouts.
         {
-            constexpr VkDescriptorSetLayoutBinding UBO_LAYOUT_BINDING{
+            constexpr VkDescriptorSetLayoutBinding LCD_TEXTURE_LAYOUT_BINDING{
                 .binding         = 0,
-                .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
                 .descriptorCount = 1,
-                .stageFlags      = VK_SHADER_STAGE_VERTEX_BIT,
+                .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT,
             };
             VkDescriptorSetLayoutCreateInfo descriptor_set_layout_info{
                 .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
                 .bindingCount = 1,
-                .pBindings    = &UBO_LAYOUT_BINDING,
+                .pBindings    = &LCD_TEXTURE_LAYOUT_BINDING,
             };
             mina_vk_assert(vkCreateDescriptorSetLayout(
                 dev,
                 &descriptor_set_layout_info,
                 nullptr,
                 &descriptor_sets.layout));
+
+            constexpr VkDescriptorSetLayoutBinding TILE_DATA_LAYOUT_BINDING{
+                .binding         = 0,
+                .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                .descriptorCount = 1,
+                .stageFlags      = VK_SHADER_STAGE_FRAGMENT_BIT,
+            };
+            VkDescriptorSetLayoutCreateInfo tile_data_layout_info{
+                .sType        = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+                .bindingCount = 1,
+                .pBindings    = &TILE_DATA_LAYOUT_BINDING,
+            };
+            mina_vk_assert(vkCreateDescriptorSetLayout(
+                dev,
+                &tile_data_layout_info,
+                nullptr,
+                &descriptor_sets.tile_data_layout));
         }
 
         // Create the descriptor set pool.
         {
-            VkDescriptorPoolSize pool_size{
-                .type            = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .descriptorCount = 1,
+            psh::Buffer<VkDescriptorPoolSize, 2> pool_sizes{
+                VkDescriptorPoolSize{
+                    .type            = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .descriptorCount = 2,
+                },
+                VkDescriptorPoolSize{
+                    .type            = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .descriptorCount = 1 + frame_set_count,
+                },
             };
             VkDescriptorPoolCreateInfo pool_info{
                 .sType         = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
                 .flags         = 0,
-                .maxSets       = 1,
-                .poolSizeCount = 1,
-                .pPoolSizes    = &pool_size,
+                .maxSets       = 3 + frame_set_count,
+                .poolSizeCount = pool_sizes.size(),
+                .pPoolSizes    = pool_sizes.buf,
             };
 
             mina_vk_assert(vkCreateDescriptorPool(dev, &pool_info, nullptr, &descriptor_sets.pool));
@@ -100,58 +310,303 @@ namespace mina {
 
         // Allocate the descriptor sets.
         {
+            psh::Buffer<VkDescriptorSetLayout, 3> layouts{
+                descriptor_sets.layout,
+                descriptor_sets.layout,
+                descriptor_sets.tile_data_layout,
+            };
+            psh::Buffer<VkDescriptorSet, 3> sets;
+
             VkDescriptorSetAllocateInfo descriptor_set_alloc_info{
                 .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
                 .descriptorPool     = descriptor_sets.pool,
-                .descriptorSetCount = 1,
-                .pSetLayouts        = &descriptor_sets.layout,
+                .descriptorSetCount = layouts.size(),
+                .pSetLayouts        = layouts.buf,
             };
-            mina_vk_assert(vkAllocateDescriptorSets(
-                dev,
-                &descriptor_set_alloc_info,
-                &descriptor_sets.uniform_buf_descriptor_set));
+            mina_vk_assert(vkAllocateDescriptorSets(dev, &descriptor_set_alloc_info, sets.buf));
+
+            descriptor_sets.lcd_texture_descriptor_set = sets[0];
+            descriptor_sets.native_descriptor_set      = sets[1];
+            descriptor_sets.tile_data_descriptor_set   = sets[2];
         }
 
-        // Write the content of the descriptor set.
+        // Write the content of the descriptor sets.
         {
-            VkDescriptorBufferInfo ubo_info{
-                .buffer = uniform_buf.handle,
-                .offset = uniform_buf.offset,
-                .range  = uniform_buf.size,
+            // The texture is always sampled after being uploaded by the transfer commands.
+            VkDescriptorImageInfo lcd_texture_info{
+                .sampler     = lcd_texture.sampler,
+                .imageView   = lcd_texture.view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            };
+            // Left in this layout by the native render pass.
+            VkDescriptorImageInfo native_target_info{
+                .sampler     = native_target.sampler,
+                .imageView   = native_target.view,
+                .imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+            };
+            VkDescriptorBufferInfo tile_data_info{
+                .buffer = tile_data_buf.handle,
+                .offset = tile_data_buf.offset,
+                .range  = tile_data_buf.size,
             };
 
-            VkWriteDescriptorSet ubo_descriptor_write{
-                .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
-                .dstSet          = descriptor_sets.uniform_buf_descriptor_set,
-                .dstBinding      = 0,
-                .dstArrayElement = 0,
-                .descriptorCount = 1,
-                .descriptorType  = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER,
-                .pBufferInfo     = &ubo_info,
+            psh::Buffer<VkWriteDescriptorSet, 3> descriptor_writes{
+                VkWriteDescriptorSet{
+                    .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet          = descriptor_sets.lcd_texture_descriptor_set,
+                    .dstBinding      = 0,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo      = &lcd_texture_info,
+                },
+                VkWriteDescriptorSet{
+                    .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet          = descriptor_sets.native_descriptor_set,
+                    .dstBinding      = 0,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType  = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                    .pImageInfo      = &native_target_info,
+                },
+                VkWriteDescriptorSet{
+                    .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                    .dstSet          = descriptor_sets.tile_data_descriptor_set,
+                    .dstBinding      = 0,
+                    .dstArrayElement = 0,
+                    .descriptorCount = 1,
+                    .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                    .pBufferInfo     = &tile_data_info,
+                },
+            };
+
+            vkUpdateDescriptorSets(
+                dev,
+                descriptor_writes.size(),
+                descriptor_writes.buf,
+                0,
+                nullptr);
+        }
+
+        // Allocate and write the sets reading the zero-copy staging ring in place. Both use the
+        // single storage buffer layout of the tile renderer.
+        if (buffers.zero_copy) {
+            u32 slice_count = buffers.host.slice_count;
+            descriptor_sets.lcd_frame_descriptor_sets.init(persistent_arena, slice_count);
+            descriptor_sets.tile_data_frame_descriptor_sets.init(persistent_arena, slice_count);
+
+            VkDescriptorSetAllocateInfo frame_set_alloc_info{
+                .sType              = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+                .descriptorPool     = descriptor_sets.pool,
+                .descriptorSetCount = 1,
+                .pSetLayouts        = &descriptor_sets.tile_data_layout,
             };
 
-            vkUpdateDescriptorSets(dev, 1, &ubo_descriptor_write, 0, nullptr);
+            for (u32 frame = 0; frame < slice_count; ++frame) {
+                VkDescriptorSet& lcd_set  = descriptor_sets.lcd_frame_descriptor_sets[frame];
+                VkDescriptorSet& tile_set = descriptor_sets.tile_data_frame_descriptor_sets[frame];
+                mina_vk_assert(vkAllocateDescriptorSets(dev, &frame_set_alloc_info, &lcd_set));
+                mina_vk_assert(vkAllocateDescriptorSets(dev, &frame_set_alloc_info, &tile_set));
+
+                Buffer                 slice = buffers.staging_slice(frame);
+                VkDescriptorBufferInfo lcd_frame_info{
+                    .buffer = slice.handle,
+                    .offset = slice.offset + STAGING_LCD_FRAME_OFFSET,
+                    .range  = LCD_FRAME_SIZE,
+                };
+                VkDescriptorBufferInfo slice_tile_data_info{
+                    .buffer = slice.handle,
+                    .offset = slice.offset + STAGING_TILE_DATA_OFFSET,
+                    .range  = TILE_DATA_BUFFER_SIZE,
+                };
+
+                psh::Buffer<VkWriteDescriptorSet, 2> frame_writes{
+                    VkWriteDescriptorSet{
+                        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet          = lcd_set,
+                        .dstBinding      = 0,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .pBufferInfo     = &lcd_frame_info,
+                    },
+                    VkWriteDescriptorSet{
+                        .sType           = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+                        .dstSet          = tile_set,
+                        .dstBinding      = 0,
+                        .dstArrayElement = 0,
+                        .descriptorCount = 1,
+                        .descriptorType  = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                        .pBufferInfo     = &slice_tile_data_info,
+                    },
+                };
+                vkUpdateDescriptorSets(dev, frame_writes.size(), frame_writes.buf, 0, nullptr);
+            }
         }
     }
 
     void destroy_descriptor_sets(VkDevice dev, DescriptorSetManager& descriptor_sets) noexcept {
         vkDestroyDescriptorSetLayout(dev, descriptor_sets.layout, nullptr);
+        vkDestroyDescriptorSetLayout(dev, descriptor_sets.tile_data_layout, nullptr);
         vkDestroyDescriptorPool(dev, descriptor_sets.pool, nullptr);
     }
 
+    // -----------------------------------------------------------------------------
+    // - Implementation of the pipeline cache -
+    // -----------------------------------------------------------------------------
+
+    namespace {
+        constexpr usize PIPELINE_CACHE_PATH_MAX_SIZE = 64;
+
+        void pipeline_cache_path(
+            psh::Buffer<char, PIPELINE_CACHE_PATH_MAX_SIZE>& path,
+            VkPhysicalDeviceProperties const&                props) noexcept {
+            std::snprintf(
+                path.buf,
+                path.size(),
+                PIPELINE_CACHE_PATH_FMT,
+                props.vendorID,
+                props.deviceID);
+        }
+
+        /// Drivers are supposed to reject foreign cache data, but some of them crash instead, so
+        /// the header is checked against the device before handing the data to the driver.
+        bool pipeline_cache_matches_device(
+            u8 const*                         data,
+            usize                             size,
+            VkPhysicalDeviceProperties const& props) noexcept {
+            VkPipelineCacheHeaderVersionOne header;
+            if (size < sizeof(header)) {
+                return false;
+            }
+            std::memcpy(&header, data, sizeof(header));
+
+            return (header.headerSize >= sizeof(header)) && (header.headerSize <= size) &&
+                   (header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE) &&
+                   (header.vendorID == props.vendorID) && (header.deviceID == props.deviceID) &&
+                   (std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) ==
+                    0);
+        }
+
+        /// Write to a temporary file first, so that concurrent launches never read a partially
+        /// written cache.
+        bool write_pipeline_cache_file(strptr path, u8 const* data, usize size) noexcept {
+            psh::Buffer<char, PIPELINE_CACHE_PATH_MAX_SIZE + 4> tmp_path;
+            std::snprintf(tmp_path.buf, tmp_path.size(), "%s.tmp", path);
+
+            std::FILE* file = std::fopen(tmp_path.buf, "wb");
+            if (file == nullptr) {
+                psh_warning_fmt("Unable to write the pipeline cache to '%s'.", tmp_path.buf);
+                return false;
+            }
+            bool written = (std::fwrite(data, 1, size, file) == size);
+            written      = (std::fclose(file) == 0) && written;
+
+            if (written && (std::rename(tmp_path.buf, path) != 0)) {
+                // Renaming over an existing file fails on some platforms.
+                std::remove(path);
+                written = (std::rename(tmp_path.buf, path) == 0);
+            }
+            if (!written) {
+                psh_warning_fmt("Unable to write the pipeline cache to '%s'.", path);
+                std::remove(tmp_path.buf);
+            }
+            return written;
+        }
+    }  // namespace
+
+    void create_pipeline_cache(
+        VkDevice         dev,
+        VkPhysicalDevice pdev,
+        psh::Arena*      work_arena,
+        PipelineCache&   cache) noexcept {
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(pdev, &props);
+
+        psh::Buffer<char, PIPELINE_CACHE_PATH_MAX_SIZE> path;
+        pipeline_cache_path(path, props);
+
+        psh::ScratchArena   sarena = work_arena->make_scratch();
+        psh::FileReadResult res =
+            psh::read_file(sarena.arena, path.buf, psh::ReadFileFlag::READ_BIN);
+
+        u8 const* initial_data = nullptr;
+        usize     initial_size = 0;
+        if (res.status == psh::FileStatus::OK) {
+            u8 const* data = reinterpret_cast<u8 const*>(res.content.data.buf);
+            usize     size = res.content.data.size;
+            if (pipeline_cache_matches_device(data, size, props)) {
+                initial_data = data;
+                initial_size = size;
+            } else {
+                psh_warning_fmt(
+                    "Ignoring the pipeline cache '%s', written by another device or driver.",
+                    path.buf);
+            }
+        }
+
+        VkPipelineCacheCreateInfo cache_info{
+            .sType           = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO,
+            .initialDataSize = initial_size,
+            .pInitialData    = initial_data,
+        };
+        mina_vk_assert(vkCreatePipelineCache(dev, &cache_info, nullptr, &cache.handle));
+        cache.loaded_size = initial_size;
+    }
+
+    void save_pipeline_cache(
+        VkDevice         dev,
+        VkPhysicalDevice pdev,
+        psh::Arena*      work_arena,
+        PipelineCache&   cache) noexcept {
+        usize size = 0;
+        mina_vk_assert(vkGetPipelineCacheData(dev, cache.handle, &size, nullptr));
+
+        // Caches only grow, so an unchanged size means that every pipeline came from the file.
+        if (size == cache.loaded_size) {
+            return;
+        }
+
+        psh::ScratchArena sarena = work_arena->make_scratch();
+        u8*               data   = sarena.arena->zero_alloc<u8>(size);
+        mina_vk_assert(vkGetPipelineCacheData(dev, cache.handle, &size, data));
+
+        VkPhysicalDeviceProperties props;
+        vkGetPhysicalDeviceProperties(pdev, &props);
+
+        psh::Buffer<char, PIPELINE_CACHE_PATH_MAX_SIZE> path;
+        pipeline_cache_path(path, props);
+        if (write_pipeline_cache_file(path.buf, data, size)) {
+            cache.loaded_size = size;
+        }
+    }
+
+    void destroy_pipeline_cache(
+        VkDevice         dev,
+        VkPhysicalDevice pdev,
+        psh::Arena*      work_arena,
+        PipelineCache&   cache) noexcept {
+        save_pipeline_cache(dev, pdev, work_arena, cache);
+        vkDestroyPipelineCache(dev, cache.handle, nullptr);
+        cache = {};
+    }
+
     // -----------------------------------------------------------------------------
     // - Implementation of the graphics pipeline lifetime management -
     // -----------------------------------------------------------------------------
 
     void create_graphics_pipeline_context(
         VkDevice              dev,
-        psh::Arena*           persistent_arena,
+        VkPipelineCache       cache,
         Pipeline&             graphics_pip,
         DescriptorSetManager& descriptor_sets,
         VkFormat              surf_fmt,
-        VkExtent2D            surf_ext) noexcept {
-        // Graphics render pass creation.
-        {
+        bool                  dynamic_rendering) noexcept {
+        graphics_pip.render_pass.color_format = surf_fmt;
+
+        // Graphics render pass creation, replaced by layout transitions recorded around the pass
+        // when rendering dynamically.
+        if (!dynamic_rendering) {
             VkAttachmentDescription color_attachment{
                 .format        = surf_fmt,
                 .samples       = VK_SAMPLE_COUNT_1_BIT,
@@ -211,173 +666,94 @@ namespace mina {
                 &graphics_pip.render_pass.handle));
         }
 
-        // Pipeline setup.
-        {
-            psh::ScratchArena sarena = persistent_arena->make_scratch();
-
-            psh::FileReadResult vert = psh::read_file(
-                sarena.arena,
-                shader_path(ShaderCatalog::TRIANGLE_VERTEX),
-                psh::ReadFileFlag::READ_BIN);
-            psh_assert_msg(vert.status == psh::FileStatus::OK, "Failed to read vertex shader file");
-
-            psh::FileReadResult frag = psh::read_file(
-                sarena.arena,
-                shader_path(ShaderCatalog::TRIANGLE_FRAGMENT),
-                psh::ReadFileFlag::READ_BIN);
-            psh_assert_msg(
-                frag.status == psh::FileStatus::OK,
-                "Failed to read fragment shader file");
-
-            // Shader modules.
-            psh::Buffer<VkShaderModule, 2> shaders{
-                make_shader_module(dev, vert.content.view()),
-                make_shader_module(dev, frag.content.view()),
-            };
-
-            // Stage information.
-            psh::Buffer<VkPipelineShaderStageCreateInfo, 2> pipe_shader_stages_info{
-                VkPipelineShaderStageCreateInfo{
-                    .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                    .stage  = VK_SHADER_STAGE_VERTEX_BIT,
-                    .module = shaders[0],
-                    .pName  = "main",
-                },
-                VkPipelineShaderStageCreateInfo{
-                    .sType  = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-                    .stage  = VK_SHADER_STAGE_FRAGMENT_BIT,
-                    .module = shaders[1],
-                    .pName  = "main",
-                },
-            };
-
-            // Pipeline layout for the constants accessed by the shader stages.
-            VkPipelineLayoutCreateInfo pipe_layout_info{
-                .sType                  = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
-                // TODO: remove hard coded descriptor set layout setup.
-                .setLayoutCount         = 1,
-                .pSetLayouts            = &descriptor_sets.layout,
-                .pushConstantRangeCount = 0,
-            };
-            mina_vk_assert(vkCreatePipelineLayout(
-                dev,
-                &pipe_layout_info,
-                nullptr,
-                &graphics_pip.pipeline_layout));
-
-            VkPipelineVertexInputStateCreateInfo pipe_vert_stage_info{
-                .sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
-                .vertexBindingDescriptionCount   = 1,
-                .pVertexBindingDescriptions      = &VERTEX_BINDING_DESCRIPTION,
-                .vertexAttributeDescriptionCount = VERTEX_ATTRIBUTE_DESCRIPTION.size(),
-                .pVertexAttributeDescriptions    = VERTEX_ATTRIBUTE_DESCRIPTION.buf,
-            };
+        // Scaling of the native target to the swap chain image.
+        create_fullscreen_pipeline(
+            dev,
+            cache,
+            graphics_pip,
+            graphics_pip.render_pass,
+            descriptor_sets.layout,
+            ShaderCatalog::FULLSCREEN_VERTEX,
+            ShaderCatalog::SCALE_FRAGMENT);
+    }
 
-            constexpr VkPipelineInputAssemblyStateCreateInfo PIPE_INPUT_ASSEMBLY_INFO{
-                .sType    = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO,
-                .topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
-                .primitiveRestartEnable = VK_FALSE,  // NOTE: this disables index buffers
-            };
+    void create_native_pipeline_context(
+        VkDevice              dev,
+        VkPipelineCache       cache,
+        Pipeline&             compose_pip,
+        DescriptorSetManager& descriptor_sets,
+        bool                  dynamic_rendering) noexcept {
+        compose_pip.render_pass.color_format = NATIVE_TARGET_FORMAT;
 
-            VkViewport pipe_viewport{
-                .x        = 0.0f,
-                .y        = 0.0f,
-                .width    = static_cast<f32>(surf_ext.width),
-                .height   = static_cast<f32>(surf_ext.height),
-                .minDepth = 0.0f,
-                .maxDepth = 1.0f,
+        // Native render pass creation, replaced by layout transitions recorded around the pass
+        // when rendering dynamically.
+        if (!dynamic_rendering) {
+            VkAttachmentDescription color_attachment{
+                .format        = NATIVE_TARGET_FORMAT,
+                .samples       = VK_SAMPLE_COUNT_1_BIT,
+                // Every pixel is overwritten by the fullscreen triangle.
+                .loadOp        = VK_ATTACHMENT_LOAD_OP_DONT_CARE,
+                .storeOp       = VK_ATTACHMENT_STORE_OP_STORE,
+                .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                // Ready to be sampled by the scaling pass.
+                .finalLayout   = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             };
-            VkRect2D pipe_scissors{
-                .offset = {.x = 0, .y = 0},
-                .extent = surf_ext,
+            VkAttachmentReference color_attachment_reference{
+                .attachment = 0,
+                .layout     = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
             };
-            VkPipelineViewportStateCreateInfo pipe_viewport_info{
-                .sType         = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO,
-                .viewportCount = 1,
-                .pViewports    = &pipe_viewport,
-                .scissorCount  = 1,
-                .pScissors     = &pipe_scissors,
+            VkSubpassDescription subpass_description{
+                .pipelineBindPoint    = VK_PIPELINE_BIND_POINT_GRAPHICS,
+                .colorAttachmentCount = 1,
+                .pColorAttachments    = &color_attachment_reference,
             };
 
-            constexpr VkPipelineRasterizationStateCreateInfo PIPE_RASTERIZATION_INFO{
-                .sType            = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO,
-                .depthClampEnable = VK_FALSE,
-                .rasterizerDiscardEnable = VK_FALSE,
-                .polygonMode             = VK_POLYGON_MODE_FILL,
-                .cullMode                = VK_CULL_MODE_NONE,
-                .frontFace               = VK_FRONT_FACE_COUNTER_CLOCKWISE,
-                .depthBiasEnable         = VK_FALSE,
-                .lineWidth               = 1.0f,
-            };
-            constexpr VkPipelineMultisampleStateCreateInfo PIPE_SAMPLING_INFO{
-                .sType                 = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO,
-                .rasterizationSamples  = VK_SAMPLE_COUNT_1_BIT,
-                .sampleShadingEnable   = VK_FALSE,
-                .minSampleShading      = 1.0f,
-                .alphaToCoverageEnable = VK_FALSE,
-                .alphaToOneEnable      = VK_FALSE,
+            psh::Buffer<VkSubpassDependency, 2> subpass_dependencies{
+                // Wait for the scaling pass of the previous frame to stop sampling the target.
+                VkSubpassDependency{
+                    .srcSubpass    = VK_SUBPASS_EXTERNAL,
+                    .dstSubpass    = 0,
+                    .srcStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    .dstStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    .srcAccessMask = 0,
+                    .dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                },
+                // Make the composed frame visible to the scaling pass.
+                VkSubpassDependency{
+                    .srcSubpass    = 0,
+                    .dstSubpass    = VK_SUBPASS_EXTERNAL,
+                    .srcStageMask  = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    .dstStageMask  = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+                    .srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
+                    .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+                },
             };
 
-            // Alpha-blending setup.
-            constexpr VkPipelineColorBlendAttachmentState PIPE_BLEND_ATTACHMENT{
-                .blendEnable         = VK_TRUE,
-                .srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA,
-                .dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA,
-                .colorBlendOp        = VK_BLEND_OP_ADD,
-                .srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE,
-                .dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO,
-                .alphaBlendOp        = VK_BLEND_OP_ADD,
-                .colorWriteMask      = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
-                                  VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT,
-            };
-            VkPipelineColorBlendStateCreateInfo pipe_color_blending{
-                .sType           = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO,
-                .logicOpEnable   = VK_FALSE,
+            VkRenderPassCreateInfo render_pass_info{
+                .sType           = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO,
                 .attachmentCount = 1,
-                .pAttachments    = &PIPE_BLEND_ATTACHMENT,
-            };
-
-            constexpr psh::Buffer<VkDynamicState, 2> PIPE_DYNAMICALLY_SET_STATES{
-                VK_DYNAMIC_STATE_SCISSOR,
-                VK_DYNAMIC_STATE_VIEWPORT,
-            };
-            VkPipelineDynamicStateCreateInfo pipe_dynamic_states_info{
-                .sType             = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO,
-                .dynamicStateCount = PIPE_DYNAMICALLY_SET_STATES.size(),
-                .pDynamicStates    = PIPE_DYNAMICALLY_SET_STATES.buf,
-            };
-
-            // Create the graphics pipeline.
-            VkGraphicsPipelineCreateInfo pipe_info{
-                .sType               = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO,
-                .stageCount          = pipe_shader_stages_info.size(),
-                .pStages             = pipe_shader_stages_info.buf,
-                .pVertexInputState   = &pipe_vert_stage_info,
-                .pInputAssemblyState = &PIPE_INPUT_ASSEMBLY_INFO,
-                .pTessellationState  = nullptr,
-                .pViewportState      = &pipe_viewport_info,
-                .pRasterizationState = &PIPE_RASTERIZATION_INFO,
-                .pMultisampleState   = &PIPE_SAMPLING_INFO,
-                .pDepthStencilState  = nullptr,
-                .pColorBlendState    = &pipe_color_blending,
-                .pDynamicState       = &pipe_dynamic_states_info,
-                .layout              = graphics_pip.pipeline_layout,
-                .renderPass          = graphics_pip.render_pass.handle,
-                .subpass             = 0,
+                .pAttachments    = &color_attachment,
+                .subpassCount    = 1,
+                .pSubpasses      = &subpass_description,
+                .dependencyCount = subpass_dependencies.size(),
+                .pDependencies   = subpass_dependencies.buf,
             };
-            mina_vk_assert(vkCreateGraphicsPipelines(
+            mina_vk_assert(vkCreateRenderPass(
                 dev,
+                &render_pass_info,
                 nullptr,
-                1,
-                &pipe_info,
-                nullptr,
-                &graphics_pip.handle));
-
-            // Delete shaders.
-            for (VkShaderModule shader : shaders) {
-                vkDestroyShaderModule(dev, shader, nullptr);
-            }
+                &compose_pip.render_pass.handle));
         }
+
+        // Composition of the uploaded LCD texture.
+        create_fullscreen_pipeline(
+            dev,
+            cache,
+            compose_pip,
+            compose_pip.render_pass,
+            descriptor_sets.layout,
+            ShaderCatalog::FULLSCREEN_VERTEX,
+            ShaderCatalog::LCD_FRAGMENT);
     }
 
     void destroy_graphics_pipeline_context(VkDevice dev, Pipeline& graphics_pipe) noexcept {
@@ -385,4 +761,46 @@ namespace mina {
         vkDestroyRenderPass(dev, graphics_pipe.render_pass.handle, nullptr);
         vkDestroyPipeline(dev, graphics_pipe.handle, nullptr);
     }
+
+    // -----------------------------------------------------------------------------
+    // - Implementation of the GPU tile renderer pipeline -
+    // -----------------------------------------------------------------------------
+
+    void create_tile_renderer_pipeline(
+        VkDevice                    dev,
+        VkPipelineCache             cache,
+        Pipeline&                   tile_pip,
+        RenderPass                  render_pass,
+        DescriptorSetManager const& descriptor_sets) noexcept {
+        create_fullscreen_pipeline(
+            dev,
+            cache,
+            tile_pip,
+            render_pass,
+            descriptor_sets.tile_data_layout,
+            ShaderCatalog::FULLSCREEN_VERTEX,
+            ShaderCatalog::LCD_TILES_FRAGMENT);
+    }
+
+    void create_lcd_buffer_pipeline(
+        VkDevice                    dev,
+        VkPipelineCache             cache,
+        Pipeline&                   lcd_buf_pip,
+        RenderPass                  render_pass,
+        DescriptorSetManager const& descriptor_sets) noexcept {
+        create_fullscreen_pipeline(
+            dev,
+            cache,
+            lcd_buf_pip,
+            render_pass,
+            descriptor_sets.tile_data_layout,
+            ShaderCatalog::FULLSCREEN_VERTEX,
+            ShaderCatalog::LCD_BUFFER_FRAGMENT);
+    }
+
+    void destroy_native_pipeline(VkDevice dev, Pipeline& native_pip) noexcept {
+        // NOTE: the render pass is borrowed and destroyed by its owner.
+        vkDestroyPipelineLayout(dev, native_pip.pipeline_layout, nullptr);
+        vkDestroyPipeline(dev, native_pip.handle, nullptr);
+    }
 }  // namespace mina
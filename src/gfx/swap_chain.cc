@@ -24,16 +24,72 @@
 #include <mina/gfx/utils.h>
 #include <psh/buffer.h>
 #include <psh/intrinsics.h>
+#include <psh/log.h>
 #include <psh/mem_utils.h>
 #include <cstring>
+#include <utility>
 
 namespace mina {
+    namespace {
+        VkPresentModeKHR present_mode_of(PresentPolicy policy) noexcept {
+            VkPresentModeKHR mode;
+            switch (policy) {
+                case PresentPolicy::FIFO:      mode = VK_PRESENT_MODE_FIFO_KHR; break;
+                case PresentPolicy::MAILBOX:   mode = VK_PRESENT_MODE_MAILBOX_KHR; break;
+                case PresentPolicy::IMMEDIATE: mode = VK_PRESENT_MODE_IMMEDIATE_KHR; break;
+                default:                       psh_unreachable();
+            }
+            return mode;
+        }
+
+        bool has_present_mode(SwapChainInfo const& swc_info, VkPresentModeKHR mode) noexcept {
+            for (usize idx = 0; idx < swc_info.presentation_modes.size; ++idx) {
+                if (swc_info.presentation_modes[idx] == mode) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        /// Select the mode of the policy if available. Otherwise fall back to the next policy
+        /// with a higher latency, down to FIFO, whose support is required by the specification.
+        VkPresentModeKHR select_present_mode(
+            SwapChainInfo const& swc_info,
+            PresentPolicy        policy) noexcept {
+            i32 p = static_cast<i32>(policy);
+            for (; p > static_cast<i32>(PresentPolicy::FIFO); --p) {
+                VkPresentModeKHR mode = present_mode_of(static_cast<PresentPolicy>(p));
+                if (has_present_mode(swc_info, mode)) {
+                    return mode;
+                }
+            }
+            return VK_PRESENT_MODE_FIFO_KHR;
+        }
+
+        void destroy_retired_swap_chain(VkDevice dev, RetiredSwapChain& retired) noexcept {
+            for (usize idx = 0; idx < retired.image_views.size; ++idx) {
+                vkDestroyImageView(dev, retired.image_views[idx], nullptr);
+            }
+            for (usize idx = 0; idx < retired.frame_bufs.size; ++idx) {
+                vkDestroyFramebuffer(dev, retired.frame_bufs[idx], nullptr);
+            }
+            vkDestroySwapchainKHR(dev, retired.handle, nullptr);
+            retired.handle         = nullptr;
+            retired.pending_frames = 0;
+        }
+    }  // namespace
+
     // Does the same as `create_image_views` but without initializing the image and image view
-    // arrays, simply reusing and overriding their memory.
+    // arrays, simply reusing and overriding their memory. The per-image resources are sized at
+    // the first creation, so the recreated swap chain must have the same amount of images.
     void recreate_image_views(VkDevice dev, SwapChain& swc) noexcept {
-        u32 img_count = static_cast<u32>(swc.images.size);
+        u32 img_count;
+        vkGetSwapchainImagesKHR(dev, swc.handle, &img_count, nullptr);
+        psh_assert_msg(
+            img_count == swc.images.size,
+            "The recreated swap chain changed its amount of images");
 
-        vkGetSwapchainImagesKHR(dev, swc.handle, &img_count, swc.images.buf);
+        mina_vk_assert(vkGetSwapchainImagesKHR(dev, swc.handle, &img_count, swc.images.buf));
 
         VkImageViewCreateInfo img_info{
             .sType            = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
@@ -147,15 +203,48 @@ namespace mina {
                 swc_info.surface_capabilities.maxImageExtent.height);
         }
 
-        // Compute the number of images handled by the swap chain. Whenever the maximum image count
-        // is non-zero, there exists a limit to be accounted.
-        u32 img_count = (swc_info.surface_capabilities.maxImageCount == 0)
-                            ? (swc_info.surface_capabilities.minImageCount + 1)
-                            : psh_min(
-                                  swc_info.surface_capabilities.minImageCount + 1,
-                                  swc_info.surface_capabilities.maxImageCount);
+        swc.present_mode = select_present_mode(swc_info, swc.present_config.policy);
+        if (swc.present_mode != present_mode_of(swc.present_config.policy)) {
+            psh_warning_fmt(
+                "Requested present mode unavailable, falling back to mode %d.",
+                static_cast<i32>(swc.present_mode));
+        }
+
+        // Compute the number of images handled by the swap chain: one more than the frames in
+        // flight, so that an image is always free to be acquired, and at least three for
+        // mailbox to have an image to replace. Whenever the maximum image count is non-zero,
+        // there exists a limit to be accounted.
+        u32 const requested_frames =
+            psh_min(swc.present_config.frames_in_flight, MAX_FRAMES_IN_FLIGHT);
+        u32 img_count = psh_max(
+            swc_info.surface_capabilities.minImageCount + 1,
+            requested_frames + 1);
+        if (swc.present_mode == VK_PRESENT_MODE_MAILBOX_KHR) {
+            img_count = psh_max(img_count, 3u);
+        }
+        if (swc_info.surface_capabilities.maxImageCount != 0) {
+            img_count = psh_min(img_count, swc_info.surface_capabilities.maxImageCount);
+        }
 
-        swc.max_frames_in_flight = img_count - 1;
+        // The images, their views and frame buffers, and the graphics command buffers of each
+        // image are only allocated at the first creation, so recreations ask for the same amount.
+        if (!swc.images.is_empty()) {
+            img_count = static_cast<u32>(swc.images.size);
+            psh_assert_msg(
+                (img_count >= swc_info.surface_capabilities.minImageCount)
+                    && ((swc_info.surface_capabilities.maxImageCount == 0)
+                        || (img_count <= swc_info.surface_capabilities.maxImageCount)),
+                "The surface no longer supports the amount of images of the swap chain");
+        }
+
+        // The per-frame resources are sized by the number of frames in flight, so it is only
+        // decided at the first creation of the swap chain.
+        if (swc.max_frames_in_flight == 0) {
+            u32 const max_frames     = psh_clamp(img_count - 1, 1u, MAX_FRAMES_IN_FLIGHT);
+            swc.max_frames_in_flight = (requested_frames == 0)
+                                           ? max_frames
+                                           : psh_min(requested_frames, max_frames);
+        }
 
         VkSwapchainCreateInfoKHR create_info{
             .sType            = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
@@ -170,15 +259,13 @@ namespace mina {
             .preTransform     = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
             // No alpha-compose with other windows.
             .compositeAlpha   = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-            // NOTE: Although mailbox may be better for performance reasons, it may cause the screen
-            //       region that got reduced to be completely black, as if we just erased that part
-            //       from the frame buffer.
-            .presentMode      = VK_PRESENT_MODE_FIFO_KHR,
+            // NOTE: Mailbox may cause the screen region that got reduced to be completely black,
+            //       as if we just erased that part from the frame buffer.
+            .presentMode      = swc.present_mode,
             // Ignore the color of pixels outside the view.
             .clipped          = VK_TRUE,
-            // NOTE: We should start dealing with old swap chains as soon as we want
-            //       resizing windows.
-            .oldSwapchain     = nullptr,
+            // When recreating, the retired swap chain hands its resources over to the new one.
+            .oldSwapchain     = swc.handle,
         };
 
         // Resolve the sharing mode for the images.
@@ -196,7 +283,37 @@ namespace mina {
         mina_vk_assert(vkCreateSwapchainKHR(dev, &create_info, nullptr, &swc.handle));
     }
 
+    void retire_swap_chain(SwapChain& swc, u32 pending_frames) noexcept {
+        psh_assert_msg(
+            swc.retired_count < MAX_RETIRED_SWAP_CHAINS,
+            "No room left for retiring the swap chain");
+
+        RetiredSwapChain& retired = swc.retired[swc.retired_count++];
+        retired.handle            = swc.handle;
+        retired.pending_frames    = pending_frames;
+        std::swap(retired.image_views, swc.image_views);
+        std::swap(retired.frame_bufs, swc.frame_bufs);
+    }
+
+    void release_retired_swap_chains(VkDevice dev, SwapChain& swc, u32 retired_frames) noexcept {
+        for (u32 idx = 0; idx < swc.retired_count;) {
+            RetiredSwapChain& retired = swc.retired[idx];
+            retired.pending_frames &= ~retired_frames;
+            if (retired.pending_frames != 0) {
+                ++idx;
+                continue;
+            }
+
+            // Move the arrays of the released entry past the end, as spares for the next
+            // retirement.
+            destroy_retired_swap_chain(dev, retired);
+            std::swap(retired, swc.retired[--swc.retired_count]);
+        }
+    }
+
     void destroy_swap_chain(VkDevice dev, SwapChain& swc) noexcept {
+        release_retired_swap_chains(dev, swc, ~0u);
+
         usize img_count = swc.image_views.size;
         for (usize idx = 0; idx < img_count; ++idx) {
             vkDestroyImageView(dev, swc.image_views[idx], nullptr);
@@ -213,6 +330,9 @@ namespace mina {
 
         swc.images.init(persistent_arena, img_count);
         swc.image_views.init(persistent_arena, img_count);
+        for (RetiredSwapChain& retired : swc.retired) {
+            retired.image_views.init(persistent_arena, img_count);
+        }
 
         vkGetSwapchainImagesKHR(dev, swc.handle, &img_count, swc.images.buf);
 
@@ -237,6 +357,9 @@ namespace mina {
         RenderPass const& gfx_pass) noexcept {
         usize img_count = swc.image_views.size;
         swc.frame_bufs.init(persistent_arena, img_count);
+        for (RetiredSwapChain& retired : swc.retired) {
+            retired.frame_bufs.init(persistent_arena, img_count);
+        }
 
         VkFramebufferCreateInfo fb_info{
             .sType           = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO,
@@ -263,6 +386,11 @@ namespace mina {
             default:                   psh_unreachable();
         }
 
+        // The last frame rendered by this frame in flight retired, its images may be released.
+        if (swc.retired_count != 0) {
+            release_retired_swap_chains(dev, swc, 1u << swc.current_frame);
+        }
+
         constexpr u64 NEXT_IMAGE_TIMEOUT = UINT64_MAX;
         VkResult      img_res            = vkAcquireNextImageKHR(
             dev,
@@ -272,17 +400,23 @@ namespace mina {
             nullptr,
             &swc.current_image_index);
 
+        // A suboptimal image was still acquired and its semaphore will be signaled, so it is
+        // rendered and presented. The presentation then reports the swap chain as out of date.
         FrameStatus status = FrameStatus::OK;
         switch (img_res) {
-            case VK_SUCCESS: {
+            case VK_SUCCESS:               // Pass-through.
+            case VK_SUBOPTIMAL_KHR:        {
                 // Set the swap-chain related resources.
-                resources.image     = swc.images[swc.current_image_index];
-                resources.frame_buf = swc.frame_bufs[swc.current_image_index];
+                resources.image_index = swc.current_image_index;
+                resources.image       = swc.images[swc.current_image_index];
+                resources.image_view  = swc.image_views[swc.current_image_index];
+                resources.frame_buf   = swc.frame_bufs.is_empty()
+                                            ? nullptr
+                                            : swc.frame_bufs[swc.current_image_index];
 
                 mina_vk_assert(vkResetFences(dev, 1, &resources.frame_in_flight_fence));
                 break;
             }
-            case VK_SUBOPTIMAL_KHR:        // Pass-through.
             case VK_ERROR_OUT_OF_DATE_KHR: status = FrameStatus::SWAP_CHAIN_OUT_OF_DATE; break;
             case VK_TIMEOUT:               // Pass-through.
             case VK_NOT_READY:             status = FrameStatus::NOT_READY; break;
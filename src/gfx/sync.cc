@@ -34,9 +34,10 @@ namespace mina {
         {
             // The number of synchronizers should match the maximum number of frames in flight.
             sync.frame_in_flight.frame_fence.init(persistent_arena, max_frames_in_flight);
-            sync.finished_transfer.frame_fence.init(persistent_arena, max_frames_in_flight);
+            sync.finished_transfer.frame_semaphore.init(persistent_arena, max_frames_in_flight);
             sync.image_available.frame_semaphore.init(persistent_arena, max_frames_in_flight);
             sync.finished_render_pass.frame_semaphore.init(persistent_arena, max_frames_in_flight);
+            sync.finished_graphics.frame_semaphore.init(persistent_arena, max_frames_in_flight);
         }
 
         // Create the synchronization objects.
@@ -48,14 +49,13 @@ namespace mina {
                 //       isn't blocked by the call to `vkWaitForFences`.
                 .flags = VK_FENCE_CREATE_SIGNALED_BIT,
             };
-            VkFenceCreateInfo     transf_fence_info{VK_STRUCTURE_TYPE_FENCE_CREATE_INFO};
             VkSemaphoreCreateInfo semaphore_info{VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO};
 
             for (VkFence& fif_fence : sync.frame_in_flight.frame_fence) {
                 mina_vk_assert(vkCreateFence(dev, &fif_fence_info, nullptr, &fif_fence));
             }
-            for (VkFence& transf_fence : sync.finished_transfer.frame_fence) {
-                mina_vk_assert(vkCreateFence(dev, &transf_fence_info, nullptr, &transf_fence));
+            for (VkSemaphore& transf_sema : sync.finished_transfer.frame_semaphore) {
+                mina_vk_assert(vkCreateSemaphore(dev, &semaphore_info, nullptr, &transf_sema));
             }
             for (VkSemaphore& swc_sema : sync.image_available.frame_semaphore) {
                 mina_vk_assert(vkCreateSemaphore(dev, &semaphore_info, nullptr, &swc_sema));
@@ -63,6 +63,9 @@ namespace mina {
             for (VkSemaphore& render_pass_sema : sync.finished_render_pass.frame_semaphore) {
                 mina_vk_assert(vkCreateSemaphore(dev, &semaphore_info, nullptr, &render_pass_sema));
             }
+            for (VkSemaphore& gfx_sema : sync.finished_graphics.frame_semaphore) {
+                mina_vk_assert(vkCreateSemaphore(dev, &semaphore_info, nullptr, &gfx_sema));
+            }
         }
     }
 
@@ -70,8 +73,8 @@ namespace mina {
         for (VkFence fif_fence : sync.frame_in_flight.frame_fence) {
             vkDestroyFence(dev, fif_fence, nullptr);
         }
-        for (VkFence transf_fence : sync.finished_transfer.frame_fence) {
-            vkDestroyFence(dev, transf_fence, nullptr);
+        for (VkSemaphore transf_sema : sync.finished_transfer.frame_semaphore) {
+            vkDestroySemaphore(dev, transf_sema, nullptr);
         }
         for (VkSemaphore swc_sema : sync.image_available.frame_semaphore) {
             vkDestroySemaphore(dev, swc_sema, nullptr);
@@ -79,5 +82,9 @@ namespace mina {
         for (VkSemaphore render_pass_sema : sync.finished_render_pass.frame_semaphore) {
             vkDestroySemaphore(dev, render_pass_sema, nullptr);
         }
+        for (VkSemaphore gfx_sema : sync.finished_graphics.frame_semaphore) {
+            vkDestroySemaphore(dev, gfx_sema, nullptr);
+        }
+        sync.pending_graphics_ended = nullptr;
     }
 }  // namespace mina
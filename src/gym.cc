@@ -0,0 +1,191 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the gym-style C interface over the emulation core.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/gym.h>
+
+#include <mina/cartridge.h>
+#include <mina/core.h>
+#include <mina/cpu/dmg.h>
+#include <mina/ppu/gray_frame.h>
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+
+namespace mina {
+    namespace {
+        constexpr usize MAX_GYM_CART_MEMORY_SIZE = psh_mebibytes(8);
+
+        /// Slack for the bookkeeping of each arena made by the memory manager.
+        constexpr usize ARENA_OVERHEAD = psh_kibibytes(1);
+
+        static_assert(MINA_GYM_BUTTON_A == BUTTON_A && MINA_GYM_BUTTON_DOWN == BUTTON_DOWN);
+    }  // namespace
+
+    /// Cartridge shared by an instance and all of its clones.
+    struct GymCartridge {
+        psh::MemoryManager memory    = {};
+        Cartridge          cart      = {};
+        std::atomic<u32>   ref_count = 1;
+    };
+}  // namespace mina
+
+struct MinaGym {
+    mina::GymCartridge* shared_cart = nullptr;
+    mina::Core          core        = {};
+    MinaGymConfig       config      = {};
+    u32                 latest      = 0;  ///< Slot of `frames` holding the latest frame.
+
+    /// Last two rendered frames, the second slot is only used when pooling.
+    alignas(16) u8 frames[2][mina::GRAY_FRAME_SIZE]{};
+    alignas(16) u8 pooled[mina::GRAY_FRAME_SIZE]{};
+    alignas(16) u8 downsampled[mina::GRAY_HALF_FRAME_SIZE]{};
+};
+
+namespace mina {
+    namespace {
+        void render_gym_frame(MinaGym& gym) noexcept {
+            // Without pooling a single slot is used, so that the observed frame never moves.
+            if (gym.config.pool_frames != 0) {
+                gym.latest ^= 1;
+            }
+            render_gray_frame(gym.core.cpu.mmap, gym.frames[gym.latest]);
+        }
+
+        void update_observation(MinaGym& gym) noexcept {
+            u8 const* frame = gym.frames[gym.latest];
+            if (gym.config.pool_frames != 0) {
+                min_pool_gray_frames(gym.frames[0], gym.frames[1], gym.pooled);
+                frame = gym.pooled;
+            }
+            if (gym.config.downsample != 0) {
+                downsample_gray_frame(frame, gym.downsampled);
+            }
+        }
+
+        void release_cartridge(GymCartridge* shared_cart) noexcept {
+            if (shared_cart->ref_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                delete shared_cart;
+            }
+        }
+    }  // namespace
+}  // namespace mina
+
+using namespace mina;
+
+extern "C" {
+MinaGym* mina_gym_create(char const* rom_path, MinaGymConfig const* config) {
+    psh_assert_msg(rom_path != nullptr, "No ROM path given to the gym");
+
+    GymCartridge* shared_cart = new GymCartridge{};
+    shared_cart->memory.init(MAX_GYM_CART_MEMORY_SIZE + ARENA_OVERHEAD);
+    psh::Arena arena = shared_cart->memory.make_arena(MAX_GYM_CART_MEMORY_SIZE).demand();
+
+    psh::StringView const path{rom_path};
+    if (init_cartridge(shared_cart->cart, &arena, path) != psh::FileStatus::OK) {
+        psh_error_fmt("Unable to read cartridge data %s", rom_path);
+        delete shared_cart;
+        return nullptr;
+    }
+
+    MinaGym* gym     = new MinaGym{};
+    gym->shared_cart = shared_cart;
+    if (config != nullptr) {
+        gym->config = *config;
+    }
+    if (gym->config.frame_skip == 0) {
+        gym->config.frame_skip = 1;
+    }
+
+    init_core(gym->core, shared_cart->cart);
+    mina_gym_reset(gym, 0);
+    return gym;
+}
+
+void mina_gym_destroy(MinaGym* gym) {
+    if (gym == nullptr) {
+        return;
+    }
+    release_cartridge(gym->shared_cart);
+    delete gym;
+}
+
+void mina_gym_reset(MinaGym* gym, uint64_t seed) {
+    reset_core(gym->core);
+    if (seed != 0) {
+        scramble_work_ram(gym->core, seed);
+    }
+    gym->core.buttons = 0;
+
+    // Both slots hold the initial frame, so that pooling is well defined from the first step.
+    render_gym_frame(*gym);
+    std::memcpy(gym->frames[gym->latest ^ 1], gym->frames[gym->latest], GRAY_FRAME_SIZE);
+    update_observation(*gym);
+}
+
+uint64_t mina_gym_step(MinaGym* gym, uint8_t action, uint32_t frame_count) {
+    u32 const count = (frame_count != 0) ? frame_count : gym->config.frame_skip;
+    gym->core.buttons = action;
+
+    // Only the frames that are going to be observed are rendered.
+    u32 const observed_count = (gym->config.pool_frames != 0) ? 2 : 1;
+    for (u32 idx = 0; idx < count; ++idx) {
+        run_core_frame(gym->core);
+        if (idx + observed_count >= count) {
+            render_gym_frame(*gym);
+        }
+    }
+    update_observation(*gym);
+
+    return gym->core.frame_count;
+}
+
+MinaGymFrame mina_gym_get_framebuffer(MinaGym const* gym) {
+    if (gym->config.downsample != 0) {
+        return MinaGymFrame{gym->downsampled, GRAY_HALF_WIDTH, GRAY_HALF_HEIGHT};
+    }
+    if (gym->config.pool_frames != 0) {
+        return MinaGymFrame{gym->pooled, LCD_WIDTH, LCD_HEIGHT};
+    }
+    return MinaGymFrame{gym->frames[0], LCD_WIDTH, LCD_HEIGHT};
+}
+
+MinaGymRam mina_gym_get_ram(MinaGym* gym) {
+    static_assert(
+        offsetof(MemoryMap, sw_wram) == offsetof(MemoryMap, fx_wram) + sizeof(FxWorkRAM),
+        "Both work RAM banks should be adjacent in the memory map");
+
+    MemoryMap& mmap = gym->core.cpu.mmap;
+    return MinaGymRam{
+        mmap.fx_wram.buf,
+        sizeof(FxWorkRAM) + sizeof(SwWorkRAM),
+        mmap.hram.buf,
+        sizeof(HighRAM),
+    };
+}
+
+MinaGym* mina_gym_clone_state(MinaGym const* gym) {
+    gym->shared_cart->ref_count.fetch_add(1, std::memory_order_relaxed);
+    return new MinaGym{*gym};
+}
+}
@@ -0,0 +1,120 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the memory hashing utilities.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/hash.h>
+
+#include <cstring>
+
+namespace mina {
+    namespace {
+        constexpr u64 PRIME_1 = 0x9E3779B185EBCA87ull;
+        constexpr u64 PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr u64 PRIME_3 = 0x165667B19E3779F9ull;
+        constexpr u64 PRIME_4 = 0x85EBCA77C2B2AE63ull;
+        constexpr u64 PRIME_5 = 0x27D4EB2F165667C5ull;
+
+        constexpr u64 rotl64(u64 x, u32 r) noexcept {
+            return (x << r) | (x >> (64u - r));
+        }
+
+        inline u64 read_u64(u8 const* ptr) noexcept {
+            u64 val;
+            std::memcpy(&val, ptr, sizeof(u64));
+            return val;
+        }
+
+        inline u32 read_u32(u8 const* ptr) noexcept {
+            u32 val;
+            std::memcpy(&val, ptr, sizeof(u32));
+            return val;
+        }
+
+        constexpr u64 hash_round(u64 acc, u64 input) noexcept {
+            acc += input * PRIME_2;
+            acc = rotl64(acc, 31);
+            return acc * PRIME_1;
+        }
+
+        constexpr u64 hash_merge_round(u64 acc, u64 lane) noexcept {
+            acc ^= hash_round(0, lane);
+            return acc * PRIME_1 + PRIME_4;
+        }
+    }  // namespace
+
+    u64 hash_memory(u8 const* buf, usize size, u64 seed) noexcept {
+        // Only remaining lengths are compared, `buf` may be null when `size` is zero.
+        u8 const* ptr       = buf;
+        usize     remaining = size;
+
+        u64 h;
+        if (size >= 32) {
+            // Four independent accumulators, one for each 64-bit lane of a stripe.
+            u64 v1 = seed + PRIME_1 + PRIME_2;
+            u64 v2 = seed + PRIME_2;
+            u64 v3 = seed;
+            u64 v4 = seed - PRIME_1;
+
+            do {
+                v1 = hash_round(v1, read_u64(ptr));
+                v2 = hash_round(v2, read_u64(ptr + 8));
+                v3 = hash_round(v3, read_u64(ptr + 16));
+                v4 = hash_round(v4, read_u64(ptr + 24));
+                ptr += 32;
+                remaining -= 32;
+            } while (remaining >= 32);
+
+            h = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+            h = hash_merge_round(h, v1);
+            h = hash_merge_round(h, v2);
+            h = hash_merge_round(h, v3);
+            h = hash_merge_round(h, v4);
+        } else {
+            h = seed + PRIME_5;
+        }
+
+        h += static_cast<u64>(size);
+
+        // Consume the remaining tail of the input.
+        for (; remaining >= 8; ptr += 8, remaining -= 8) {
+            h ^= hash_round(0, read_u64(ptr));
+            h = rotl64(h, 27) * PRIME_1 + PRIME_4;
+        }
+        if (remaining >= 4) {
+            h ^= static_cast<u64>(read_u32(ptr)) * PRIME_1;
+            h = rotl64(h, 23) * PRIME_2 + PRIME_3;
+            ptr += 4;
+            remaining -= 4;
+        }
+        for (; remaining != 0; ++ptr, --remaining) {
+            h ^= static_cast<u64>(*ptr) * PRIME_5;
+            h = rotl64(h, 11) * PRIME_1;
+        }
+
+        // Final avalanche.
+        h ^= h >> 33;
+        h *= PRIME_2;
+        h ^= h >> 29;
+        h *= PRIME_3;
+        h ^= h >> 32;
+
+        return h;
+    }
+}  // namespace mina
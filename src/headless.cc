@@ -0,0 +1,647 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Headless runner of the emulation core, running batches of instances and reporting
+///              their emulation throughput.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#if defined(MINA_DEBUG)
+#    define PSH_DEBUG
+#endif
+
+#include <mina/batch.h>
+#include <mina/cartridge.h>
+#include <mina/core.h>
+#include <mina/cpu/lockstep.h>
+#include <mina/fork.h>
+#include <mina/movie.h>
+#include <mina/netplay.h>
+#include <mina/rewind.h>
+#include <mina/run_ahead.h>
+#include <mina/savestate.h>
+#include <psh/array.h>
+#include <psh/assert.h>
+#include <psh/memory_manager.h>
+#include <psh/string.h>
+#include <psh/types.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+using namespace mina;
+
+constexpr usize MAX_CART_MEMORY_SIZE = psh_mebibytes(8);
+
+/// Slack for the bookkeeping of each arena made by the memory manager.
+constexpr usize ARENA_OVERHEAD = psh_kibibytes(1);
+
+/// Options given through the command line.
+struct HeadlessOptions {
+    BatchConfig batch          = {};
+    u64         seed_count     = 1;  ///< Instances run for each ROM, each with its own seed.
+    u32         lockstep_lanes = 0;  ///< When non-zero, run the ROMs as lockstep groups instead.
+    u64         savestates     = 0;  ///< When non-zero, benchmark savestates instead.
+    u64         rewind_frames  = 0;  ///< When non-zero, benchmark the rewind buffer instead.
+    u32         run_ahead      = 0;  ///< When non-zero, benchmark run-ahead instead.
+    u64         forks          = 0;  ///< When non-zero, benchmark forked states instead.
+    u64         movie_frames   = 0;  ///< When non-zero, benchmark input movies instead.
+    u64         netplay_frames = 0;  ///< When non-zero, benchmark rollback netplay instead.
+    usize       rom_count      = 0;
+};
+
+/// Parse the command line. Every argument that isn't an option is the path of a ROM:
+///
+/// * `--frames <count>`: amount of LCD frames run by each instance.
+/// * `--cycles <count>`: amount of machine cycles run by each instance.
+/// * `--seeds <count>`: instances of each ROM, instance `k` having its work RAM seeded by `k`.
+/// * `--threads <count>`: amount of worker threads, one per hardware thread by default.
+/// * `--lockstep <count>`: run each ROM as a single lockstep group of the given amount of lanes.
+/// * `--savestates <count>`: measure the time taken by the given amount of saves and loads of the
+///   state of each ROM.
+/// * `--rewind <frames>`: run each ROM for the given amount of frames, recording every frame into
+///   a rewind buffer and measuring the time taken by each recording.
+/// * `--run-ahead <frames>`: run each ROM for `--frames` host frames, each of them running the
+///   given amount of frames ahead, and measure the time taken by each phase of a host frame.
+/// * `--forks <count>`: fork the given amount of states from a single state of each ROM, each one
+///   a frame ahead with its own buttons, measuring their cost in time and memory.
+/// * `--movie <frames>`: record a movie of the given amount of frames of each ROM, then measure
+///   the time taken by seeking through it and check that its playback is deterministic.
+/// * `--netplay <frames>`: run two netplay peers of each ROM for the given amount of frames over
+///   a loopback channel with delay, jitter and loss, measuring the time taken by rollbacks.
+HeadlessOptions parse_options(i32 argc, strptr argv[], psh::Array<strptr>& rom_paths) noexcept {
+    HeadlessOptions options;
+    for (i32 idx = 1; idx < argc; ++idx) {
+        strptr const arg     = argv[idx];
+        bool const   has_val = (idx + 1 < argc);
+
+        if (psh::str_equal(arg, "--frames") && has_val) {
+            options.batch.frame_count = std::strtoull(argv[++idx], nullptr, 10);
+        } else if (psh::str_equal(arg, "--cycles") && has_val) {
+            options.batch.cycle_count = std::strtoull(argv[++idx], nullptr, 10);
+        } else if (psh::str_equal(arg, "--seeds") && has_val) {
+            u64 const seed_count = std::strtoull(argv[++idx], nullptr, 10);
+            options.seed_count   = psh_max(seed_count, u64{1});
+        } else if (psh::str_equal(arg, "--threads") && has_val) {
+            options.batch.worker_count = static_cast<u32>(std::strtoul(argv[++idx], nullptr, 10));
+        } else if (psh::str_equal(arg, "--lockstep") && has_val) {
+            options.lockstep_lanes = static_cast<u32>(std::strtoul(argv[++idx], nullptr, 10));
+        } else if (psh::str_equal(arg, "--savestates") && has_val) {
+            options.savestates = std::strtoull(argv[++idx], nullptr, 10);
+        } else if (psh::str_equal(arg, "--rewind") && has_val) {
+            options.rewind_frames = std::strtoull(argv[++idx], nullptr, 10);
+        } else if (psh::str_equal(arg, "--run-ahead") && has_val) {
+            options.run_ahead = static_cast<u32>(std::strtoul(argv[++idx], nullptr, 10));
+        } else if (psh::str_equal(arg, "--forks") && has_val) {
+            options.forks = std::strtoull(argv[++idx], nullptr, 10);
+        } else if (psh::str_equal(arg, "--movie") && has_val) {
+            options.movie_frames = std::strtoull(argv[++idx], nullptr, 10);
+        } else if (psh::str_equal(arg, "--netplay") && has_val) {
+            options.netplay_frames = std::strtoull(argv[++idx], nullptr, 10);
+        } else if (arg[0] == '-') {
+            psh_warning_fmt("Ignoring unknown option '%s'.", arg);
+        } else {
+            rom_paths[options.rom_count++] = arg;
+        }
+    }
+    return options;
+}
+
+/// Memory owned by a benchmark of a single cartridge.
+struct BenchmarkMemory {
+    psh::MemoryManager manager;
+    psh::Arena         arena;
+};
+
+/// Reserve an arena of the given size for a benchmark.
+void init_benchmark_memory(BenchmarkMemory& memory, usize memory_size) noexcept {
+    memory.manager.init(memory_size + ARENA_OVERHEAD);
+    memory.arena = memory.manager.make_arena(memory_size).demand();
+}
+
+/// Reserve an arena for a benchmark with room for a core and `extra_size` bytes, and initialize
+/// the core with the cartridge.
+Core* init_benchmark_core(
+    BenchmarkMemory& memory,
+    Cartridge const& cart,
+    usize            extra_size) noexcept {
+    init_benchmark_memory(memory, sizeof(Core) + extra_size);
+    Core* core = memory.arena.zero_alloc<Core>(1);
+    init_core(*core, cart);
+    return core;
+}
+
+/// Run a lockstep group of instances of the cartridge on the calling thread.
+void run_lockstep_group(
+    Cartridge const&       cart,
+    strptr                 path,
+    HeadlessOptions const& options) noexcept {
+    u32 const   lane_count  = options.lockstep_lanes;
+    usize const memory_size = lane_count * (sizeof(Core) + psh_kibibytes(1)) + psh_kibibytes(64);
+
+    BenchmarkMemory memory;
+    init_benchmark_memory(memory, memory_size);
+
+    LockstepGroup group;
+    init_lockstep(group, &memory.arena, cart, lane_count);
+
+    auto const start = std::chrono::steady_clock::now();
+    if (options.batch.cycle_count != 0) {
+        run_lockstep_cycles(group, options.batch.cycle_count);
+    } else {
+        for (u64 idx = 0; idx < options.batch.frame_count; ++idx) {
+            run_lockstep_frame(group);
+        }
+    }
+    auto const end = std::chrono::steady_clock::now();
+
+    f64 const seconds      = std::chrono::duration<f64>(end - start).count();
+    f64 const frames       = static_cast<f64>(group.cycle_count) / MACHINE_CYCLES_PER_FRAME;
+    f64 const total_fps    = (seconds > 0.0) ? frames * lane_count / seconds : 0.0;
+    f64 const lane_steps   = static_cast<f64>(group.vector_lane_steps + group.scalar_lane_steps);
+    f64 const vector_steps = static_cast<f64>(group.vector_lane_steps);
+    f64 const vector_part  = (lane_steps > 0.0) ? vector_steps / lane_steps : 0.0;
+
+    std::printf(
+        "%s: %u lockstep lanes, %.1f frames in %.3f s, %.1f emulated fps (%.1f%% vectorized)\n",
+        path,
+        lane_count,
+        frames,
+        seconds,
+        total_fps,
+        100.0 * vector_part);
+}
+
+/// Measure the throughput of saving and loading the state of a core running the cartridge.
+void run_savestate_benchmark(
+    Cartridge const&       cart,
+    strptr                 path,
+    HeadlessOptions const& options) noexcept {
+    BenchmarkMemory memory;
+    usize const     state_size = sizeof(SaveState) + psh_kibibytes(1);
+    Core*           core       = init_benchmark_core(memory, cart, state_size);
+    SaveState*      state      = memory.arena.zero_alloc<SaveState>(1);
+    run_core_frame(*core);
+
+    u64 const  count      = options.savestates;
+    auto const save_start = std::chrono::steady_clock::now();
+    for (u64 idx = 0; idx < count; ++idx) {
+        save_state(*core, *state);
+    }
+    auto const load_start = std::chrono::steady_clock::now();
+    for (u64 idx = 0; idx < count; ++idx) {
+        SaveStateStatus const status = load_state(*core, *state);
+        psh_assert(status == SaveStateStatus::OK);
+    }
+    auto const end = std::chrono::steady_clock::now();
+
+    f64 const save_seconds = std::chrono::duration<f64>(load_start - save_start).count();
+    f64 const load_seconds = std::chrono::duration<f64>(end - load_start).count();
+    f64 const state_bytes  = static_cast<f64>(count * sizeof(SaveState));
+    f64 const gibibytes    = state_bytes / static_cast<f64>(psh_mebibytes(1024));
+    f64 const per_op       = 1e6 / static_cast<f64>(count);
+
+    std::printf(
+        "%s: %zu byte states, save %.2f us (%.1f GiB/s), load %.2f us (%.1f GiB/s)\n",
+        path,
+        sizeof(SaveState),
+        save_seconds * per_op,
+        (save_seconds > 0.0) ? gibibytes / save_seconds : 0.0,
+        load_seconds * per_op,
+        (load_seconds > 0.0) ? gibibytes / load_seconds : 0.0);
+}
+
+/// Measure the cost of recording every frame of a core running the cartridge into a rewind
+/// buffer of the default configuration.
+void run_rewind_benchmark(
+    Cartridge const&       cart,
+    strptr                 path,
+    HeadlessOptions const& options) noexcept {
+    RewindConfig const config{};
+    BenchmarkMemory    memory;
+    usize const        rewind_size = config.buffer_size + psh_mebibytes(1);
+    Core*              core        = init_benchmark_core(memory, cart, rewind_size);
+
+    RewindBuffer rewind;
+    init_rewind(rewind, &memory.arena, *core, config);
+
+    f64 record_seconds = 0.0;
+    f64 worst_seconds  = 0.0;
+    for (u64 frame = 0; frame < options.rewind_frames; ++frame) {
+        run_core_frame(*core);
+
+        auto const start = std::chrono::steady_clock::now();
+        record_rewind_state(rewind, *core);
+        auto const end = std::chrono::steady_clock::now();
+
+        f64 const seconds = std::chrono::duration<f64>(end - start).count();
+        record_seconds += seconds;
+        worst_seconds = (seconds > worst_seconds) ? seconds : worst_seconds;
+    }
+
+    f64 const frames      = static_cast<f64>(psh_max(rewind.recorded_count, u64{1}));
+    f64 const mean_bytes  = static_cast<f64>(rewind.encoded_bytes) / frames;
+    f64 const history     = static_cast<f64>(rewind.entry_count) / DMG_FRAME_RATE;
+    f64 const buffer_mibs = static_cast<f64>(config.buffer_size) / psh_mebibytes(1);
+
+    std::printf(
+        "%s: %.0f bytes per frame, record %.2f us (worst %.2f us), %.1f s of rewind in %.1f MiB\n",
+        path,
+        mean_bytes,
+        1e6 * record_seconds / frames,
+        1e6 * worst_seconds,
+        history,
+        buffer_mibs);
+}
+
+/// Measure the time taken by each phase of the host frames of a core running the cartridge
+/// ahead, and whether they fit in the frame time of the DMG.
+void run_run_ahead_benchmark(
+    Cartridge const&       cart,
+    strptr                 path,
+    HeadlessOptions const& options) noexcept {
+    BenchmarkMemory memory;
+    usize const     ahead_size = sizeof(Core) + sizeof(SaveState) + psh_kibibytes(1);
+    Core*           core       = init_benchmark_core(memory, cart, ahead_size);
+
+    RunAhead run_ahead;
+    init_run_ahead(run_ahead, &memory.arena, options.run_ahead);
+    for (u64 frame = 0; frame < options.batch.frame_count; ++frame) {
+        psh_discard(run_ahead_frame(run_ahead, *core));
+    }
+
+    RunAheadStats const mean = mean_run_ahead_stats(run_ahead.stats);
+    f64 const           host_seconds =
+        mean.frame_seconds + mean.save_seconds + mean.restore_seconds + mean.ahead_seconds;
+    f64 const host_fps = (host_seconds > 0.0) ? 1.0 / host_seconds : 0.0;
+
+    std::printf(
+        "%s: run-ahead of %u frames, host frame %.3f ms (frame %.3f, save %.3f, restore %.3f, "
+        "ahead %.3f, worst %.3f), %.1f host fps, %s %.2f fps\n",
+        path,
+        run_ahead.frames,
+        1e3 * host_seconds,
+        1e3 * mean.frame_seconds,
+        1e3 * mean.save_seconds,
+        1e3 * mean.restore_seconds,
+        1e3 * mean.ahead_seconds,
+        1e3 * mean.max_host_seconds,
+        host_fps,
+        (host_fps >= DMG_FRAME_RATE) ? "keeps up with" : "falls behind",
+        DMG_FRAME_RATE);
+}
+
+/// Measure the cost of exploring many continuations of a single state of a core running the
+/// cartridge, forking a state for each of them.
+void run_fork_benchmark(
+    Cartridge const&       cart,
+    strptr                 path,
+    HeadlessOptions const& options) noexcept {
+    u64 const   count      = options.forks;
+    usize const fork_bound = sizeof(ForkedState) + 4 * MEMORY_PAGE_SIZE + psh_kibibytes(1);
+
+    BenchmarkMemory memory;
+    usize const     fork_size = 2 * sizeof(MemoryMap) + count * fork_bound;
+    Core*           core      = init_benchmark_core(memory, cart, fork_size);
+    psh::Arena&     arena     = memory.arena;
+    run_core_frame(*core);
+    ForkedState const* root = capture_root_state(&arena, *core);
+    psh_assert_msg(root != nullptr, "Not enough memory for the root state");
+
+    f64   fork_seconds = 0.0;
+    f64   run_seconds  = 0.0;
+    usize owned_bytes  = 0;
+    u64   fork_count   = 0;
+    for (; fork_count < count; ++fork_count) {
+        auto const revert_start = std::chrono::steady_clock::now();
+        revert_forked_state(*core, *root);
+        auto const run_start = std::chrono::steady_clock::now();
+        core->buttons = static_cast<u8>(fork_count);
+        run_core_frame(*core);
+        auto const fork_start = std::chrono::steady_clock::now();
+        ForkedState const* state = fork_state(&arena, *root, *core);
+        auto const end = std::chrono::steady_clock::now();
+
+        if (state == nullptr) {
+            break;
+        }
+        owned_bytes += forked_state_owned_size(*state) + sizeof(ForkedState);
+        fork_seconds += std::chrono::duration<f64>(run_start - revert_start).count();
+        fork_seconds += std::chrono::duration<f64>(end - fork_start).count();
+        run_seconds += std::chrono::duration<f64>(fork_start - run_start).count();
+    }
+
+    f64 const forks      = static_cast<f64>(psh_max(fork_count, u64{1}));
+    f64 const mean_bytes = static_cast<f64>(owned_bytes) / forks;
+    std::printf(
+        "%s: %llu forks, %.0f bytes per fork (%.1f%% of a savestate), fork and revert %.2f us, "
+        "frame %.2f us\n",
+        path,
+        static_cast<unsigned long long>(fork_count),
+        mean_bytes,
+        100.0 * mean_bytes / static_cast<f64>(sizeof(SaveState)),
+        1e6 * fork_seconds / forks,
+        1e6 * run_seconds / forks);
+}
+
+/// Record a movie of a core running the cartridge with changing buttons, then measure the time
+/// taken by seeking through the whole movie and check that playing it back ends in the state in
+/// which the recording ended.
+void run_movie_benchmark(
+    Cartridge const&       cart,
+    strptr                 path,
+    HeadlessOptions const& options) noexcept {
+    constexpr u32 SEEK_COUNT = 64;
+
+    MovieConfig const config{.max_frames = options.movie_frames};
+    usize const       max_keyframes = options.movie_frames / config.keyframe_interval;
+    usize const       movie_size    = 4 * sizeof(SaveState) + options.movie_frames
+                               + max_keyframes * sizeof(u64) + config.keyframe_buffer_size
+                               + psh_kibibytes(1);
+
+    BenchmarkMemory memory;
+    Core*           core      = init_benchmark_core(memory, cart, movie_size);
+    SaveState*      end_state = memory.arena.zero_alloc<SaveState>(1);
+    SaveState*      replayed  = memory.arena.zero_alloc<SaveState>(1);
+
+    Movie movie;
+    init_movie(movie, &memory.arena, *core, config);
+
+    // Buttons change every few frames, as a player would press them.
+    auto const record_start = std::chrono::steady_clock::now();
+    for (u64 frame = 0; frame < options.movie_frames; ++frame) {
+        core->buttons = static_cast<u8>(((frame / 8) * 0x9E3779B97F4A7C15) >> 56);
+        if (record_movie_frame(movie, *core) != MovieStatus::OK) {
+            break;
+        }
+    }
+    auto const record_end = std::chrono::steady_clock::now();
+    save_state(*core, *end_state);
+
+    u64 const frame_count  = movie.header.frame_count;
+    f64       seek_seconds = 0.0;
+    f64       worst_seek   = 0.0;
+    for (u32 idx = 0; idx < SEEK_COUNT; ++idx) {
+        u64 const  frame = (frame_count * (SEEK_COUNT - 1 - idx)) / (SEEK_COUNT - 1);
+        auto const start = std::chrono::steady_clock::now();
+        psh_discard(seek_movie(movie, *core, frame));
+        auto const end = std::chrono::steady_clock::now();
+
+        f64 const seconds = std::chrono::duration<f64>(end - start).count();
+        seek_seconds += seconds;
+        worst_seek = psh_max(worst_seek, seconds);
+    }
+
+    psh_discard(seek_movie(movie, *core, 0));
+    while (play_movie_frame(movie, *core) == MovieStatus::OK) {
+    }
+    save_state(*core, *replayed);
+    bool const deterministic = (std::memcmp(end_state, replayed, sizeof(SaveState)) == 0);
+
+    f64 const record_seconds = std::chrono::duration<f64>(record_end - record_start).count();
+    f64 const movie_bytes    = static_cast<f64>(
+        sizeof(MovieHeader) + sizeof(SaveState) + frame_count
+        + movie.header.keyframe_count * sizeof(u64) + movie.header.keyframe_data_size);
+
+    std::printf(
+        "%s: %llu frame movie of %.1f KiB with %u keyframes, recorded at %.0f fps, seek %.2f ms "
+        "(worst %.2f ms), playback %s\n",
+        path,
+        static_cast<unsigned long long>(frame_count),
+        movie_bytes / 1024.0,
+        movie.header.keyframe_count,
+        (record_seconds > 0.0) ? static_cast<f64>(frame_count) / record_seconds : 0.0,
+        1e3 * seek_seconds / SEEK_COUNT,
+        1e3 * worst_seek,
+        deterministic ? "deterministic" : "DIVERGED");
+}
+
+/// Run two netplay peers of the cartridge over a loopback channel, with every button changing
+/// every few frames so that predictions often fail, then report the cost of the rollbacks and
+/// check that both peers agree on the final state.
+void run_netplay_benchmark(
+    Cartridge const&       cart,
+    strptr                 path,
+    HeadlessOptions const& options) noexcept {
+    constexpr u32            PACKET_CAPACITY = 1024;
+    constexpr LoopbackConfig CONDITIONS{.delay = 3, .jitter = 4, .loss_percent = 10, .seed = 1};
+    NetplayConfig const      config{};
+
+    // Each peer saves the states of both cores for every frame that may be rolled back.
+    usize const session_states = (config.max_rollback + 1) * NETPLAY_PLAYER_COUNT;
+    usize const memory_size    = NETPLAY_PLAYER_COUNT * sizeof(NetplaySession)
+                              + (NETPLAY_PLAYER_COUNT * session_states + 2) * sizeof(SaveState)
+                              + 2 * PACKET_CAPACITY * sizeof(LoopbackPacket) + psh_kibibytes(4);
+    BenchmarkMemory memory;
+    init_benchmark_memory(memory, memory_size);
+    psh::Arena& arena = memory.arena;
+
+    LoopbackChannel channel;
+    init_loopback(channel, &arena, CONDITIONS, PACKET_CAPACITY);
+
+    NetplaySession* peers = arena.zero_alloc<NetplaySession>(NETPLAY_PLAYER_COUNT);
+    for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+        NetplayConfig player_config = config;
+        player_config.local_player  = player;
+        init_netplay(
+            peers[player],
+            &arena,
+            cart,
+            loopback_transport(channel, player),
+            player_config);
+    }
+
+    // Each peer stops at the last frame and keeps polling until both have every button.
+    u64 const  frame_count = options.netplay_frames;
+    u64        host_frames = 0;
+    auto const start       = std::chrono::steady_clock::now();
+    for (bool done = false; !done; ++host_frames) {
+        done = true;
+        for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+            NetplaySession& peer = peers[player];
+            if (peer.frame == frame_count) {
+                psh_discard(poll_netplay(peer));
+                done = done && netplay_confirmed(peer);
+                continue;
+            }
+
+            done              = false;
+            u64 const sample  = (peer.local_input_count / (4 + player)) + 7 * player;
+            u8 const  buttons = static_cast<u8>((sample * 0x9E3779B97F4A7C15) >> 56);
+            psh_discard(advance_netplay(peer, buttons));
+        }
+        tick_loopback(channel);
+    }
+    auto const end     = std::chrono::steady_clock::now();
+    f64 const  seconds = std::chrono::duration<f64>(end - start).count();
+
+    SaveState* states = arena.zero_alloc<SaveState>(2);
+    bool       agree  = true;
+    for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+        save_state(peers[0].cores[player], states[0]);
+        save_state(peers[1].cores[player], states[1]);
+        agree = agree && (std::memcmp(&states[0], &states[1], sizeof(SaveState)) == 0);
+    }
+
+    NetplayStats const& stats       = peers[0].stats;
+    f64 const           rollbacks   = static_cast<f64>(psh_max(stats.rollback_count, u64{1}));
+    f64 const           resimulated = static_cast<f64>(stats.resimulated_frames);
+    std::printf(
+        "%s: %llu frames in %llu host frames (%.0f fps), %llu rollbacks of %.1f frames taking "
+        "%.3f ms (worst %.3f ms, %.1f frames per ms), %llu stalls, %llu packets lost, peers %s\n",
+        path,
+        static_cast<unsigned long long>(frame_count),
+        static_cast<unsigned long long>(host_frames),
+        (seconds > 0.0) ? static_cast<f64>(frame_count) / seconds : 0.0,
+        static_cast<unsigned long long>(stats.rollback_count),
+        resimulated / rollbacks,
+        1e3 * stats.rollback_seconds / rollbacks,
+        1e3 * stats.max_rollback_seconds,
+        resimulated / (1e3 * psh_max(stats.rollback_seconds, 1e-9)),
+        static_cast<unsigned long long>(stats.stall_count),
+        static_cast<unsigned long long>(channel.lost_count),
+        agree ? "agree" : "DIVERGED");
+}
+
+/// A benchmark run on each cartridge in place of the batch, when its option is given.
+struct HeadlessBenchmark {
+    bool (*selected)(HeadlessOptions const& options) noexcept;
+    void (*run)(Cartridge const& cart, strptr path, HeadlessOptions const& options) noexcept;
+};
+
+/// Benchmarks in order of precedence, only the first one selected is run.
+constexpr HeadlessBenchmark HEADLESS_BENCHMARKS[] = {
+    {
+        [](HeadlessOptions const& options) noexcept { return options.netplay_frames != 0; },
+        run_netplay_benchmark,
+    },
+    {
+        [](HeadlessOptions const& options) noexcept { return options.movie_frames != 0; },
+        run_movie_benchmark,
+    },
+    {
+        [](HeadlessOptions const& options) noexcept { return options.forks != 0; },
+        run_fork_benchmark,
+    },
+    {
+        [](HeadlessOptions const& options) noexcept { return options.run_ahead != 0; },
+        run_run_ahead_benchmark,
+    },
+    {
+        [](HeadlessOptions const& options) noexcept { return options.rewind_frames != 0; },
+        run_rewind_benchmark,
+    },
+    {
+        [](HeadlessOptions const& options) noexcept { return options.savestates != 0; },
+        run_savestate_benchmark,
+    },
+    {
+        [](HeadlessOptions const& options) noexcept { return options.lockstep_lanes != 0; },
+        run_lockstep_group,
+    },
+};
+
+int main(i32 argc, strptr argv[]) {
+    psh_assert_msg(argc > 1, "Please provide the path of at least one ROM file as a CLI argument");
+
+    usize const        arg_memory_size = static_cast<usize>(argc) * sizeof(strptr);
+    psh::MemoryManager arg_memory;
+    arg_memory.init(arg_memory_size + ARENA_OVERHEAD);
+    psh::Arena arg_arena = arg_memory.make_arena(arg_memory_size).demand();
+
+    psh::Array<strptr> rom_paths;
+    rom_paths.init(&arg_arena, static_cast<usize>(argc));
+    HeadlessOptions const options = parse_options(argc, argv, rom_paths);
+    psh_assert_msg(options.rom_count != 0, "No ROM file was given");
+
+    usize const instance_count = options.rom_count * options.seed_count;
+
+    // Every cartridge is read once, and its pages are shared by all of its instances.
+    psh::MemoryManager batch_memory;
+    batch_memory.init(
+        options.rom_count * (MAX_CART_MEMORY_SIZE + sizeof(Cartridge) + ARENA_OVERHEAD)
+        + instance_count * (BATCH_INSTANCE_MEMORY_SIZE + sizeof(BatchInstance) + ARENA_OVERHEAD)
+        + ARENA_OVERHEAD);
+    psh::Arena cart_arena =
+        batch_memory.make_arena(options.rom_count * (MAX_CART_MEMORY_SIZE + sizeof(Cartridge)))
+            .demand();
+    psh::Arena instance_list_arena =
+        batch_memory.make_arena(instance_count * sizeof(BatchInstance)).demand();
+
+    psh::Array<Cartridge> carts;
+    carts.init(&cart_arena, options.rom_count);
+    for (usize rom = 0; rom < options.rom_count; ++rom) {
+        psh::StringView const path{rom_paths[rom]};
+        if (init_cartridge(carts[rom], &cart_arena, path) != psh::FileStatus::OK) {
+            psh_error_fmt("Unable to read cartridge data %s", rom_paths[rom]);
+            return 1;
+        }
+    }
+
+    for (HeadlessBenchmark const& benchmark : HEADLESS_BENCHMARKS) {
+        if (benchmark.selected(options)) {
+            for (usize rom = 0; rom < options.rom_count; ++rom) {
+                benchmark.run(carts[rom], rom_paths[rom], options);
+            }
+            return 0;
+        }
+    }
+
+    psh::Array<BatchInstance> instances;
+    instances.init(&instance_list_arena, instance_count);
+    for (usize idx = 0; idx < instance_count; ++idx) {
+        BatchInstance& instance = instances[idx];
+        instance.arena = batch_memory.make_arena(BATCH_INSTANCE_MEMORY_SIZE).demand();
+        instance.cart  = &carts[idx / options.seed_count];
+        instance.seed  = idx % options.seed_count;
+    }
+
+    u32 const worker_count = batch_worker_count(options.batch, instance_count);
+    f64 const wall_seconds = run_batch({instances.buf, instances.size}, options.batch);
+
+    f64 total_frames = 0.0;
+    for (usize idx = 0; idx < instance_count; ++idx) {
+        BatchInstance const& instance = instances[idx];
+
+        f64 const frames = static_cast<f64>(instance.core->cycle_count) / MACHINE_CYCLES_PER_FRAME;
+        f64 const fps    = (instance.seconds > 0.0) ? frames / instance.seconds : 0.0;
+        total_frames += frames;
+
+        std::printf(
+            "[%zu] %s (seed %llu, worker %u): %.1f frames in %.3f s, %.1f emulated fps\n",
+            idx,
+            rom_paths[idx / options.seed_count],
+            static_cast<unsigned long long>(instance.seed),
+            instance.worker,
+            frames,
+            instance.seconds,
+            fps);
+    }
+
+    f64 const total_fps = (wall_seconds > 0.0) ? total_frames / wall_seconds : 0.0;
+    std::printf(
+        "%zu instances on %u workers: %.1f frames in %.3f s, %.1f emulated fps (%.1fx real time)\n",
+        instance_count,
+        worker_count,
+        total_frames,
+        wall_seconds,
+        total_fps,
+        total_fps / DMG_FRAME_RATE);
+    return 0;
+}
@@ -23,24 +23,46 @@
 #    define PSH_DEBUG
 #endif
 
-#include <mina/cartridge.h>
-#include <mina/cpu/dmg.h>
+#include <mina/core.h>
 #include <mina/gfx/buffer.h>
 #include <mina/gfx/command.h>
 #include <mina/gfx/context.h>
 #include <mina/gfx/data.h>
 #include <mina/gfx/swap_chain.h>
 #include <mina/meta/info.h>
+#include <mina/ppu/tile_data.h>
+#include <mina/run_ahead.h>
 #include <mina/window.h>
 #include <psh/assert.h>
 #include <psh/input.h>
 #include <psh/memory_manager.h>
+#include <psh/string.h>
 #include <psh/types.h>
 
+#include <chrono>
 #include <cstdio>
+#include <cstdlib>
+#include <thread>
 
 using namespace mina;
 
+/// Options given through the command line.
+struct EmuOptions {
+    PresentConfig present            = {};
+    bool          uses_tile_renderer = false;
+    u32           run_ahead_frames   = 0;
+};
+
+/// Latency from sampling the input of a frame until the GPU finished rendering it and handed it
+/// to the presentation engine. The scan-out of the display isn't accounted for.
+struct LatencyCounter {
+    /// Input sampling time of the frame pending on each frame in flight, negative if none.
+    psh::Array<f64> input_time   = {};
+    f64             total        = 0.0;
+    f64             max          = 0.0;
+    u64             sample_count = 0;
+};
+
 struct Emulator {
     psh::MemoryManager memory_manager;
     psh::Arena         cart_arena;
@@ -48,10 +70,15 @@ struct Emulator {
     psh::Arena         frame_arena;
     psh::Arena         work_arena;
     FrameMemory        frame_memory;
+    LatencyCounter     latency;
     GraphicsContext    gfx_context;
     Window             win;
-    CPU                cpu;
     Cartridge          cart;
+    Core               core;
+    RunAhead           run_ahead;
+
+    /// Time by which the next frame is due, pacing the frames that aren't presented.
+    f64 next_frame_time = 0.0;
 
     static constexpr usize MAX_MEMORY_SIZE       = psh_mebibytes(64);
     static constexpr usize MAX_CART_MEMORY_SIZE  = psh_mebibytes(8);
@@ -60,7 +87,7 @@ struct Emulator {
     static constexpr usize MAX_WORK_MEMORY_SIZE  = psh_mebibytes(17);
 };
 
-void init_emu(Emulator& emu) noexcept {
+void init_emu(Emulator& emu, EmuOptions const& options) noexcept {
     // Initialize the memory system.
     {
         emu.memory_manager.init(Emulator::MAX_MEMORY_SIZE);
@@ -75,19 +102,90 @@ void init_emu(Emulator& emu) noexcept {
     {
         init_window(emu.win, {.user_pointer = &emu});
 
-        init_graphics_system(emu.gfx_context, emu.win.handle, &emu.gfx_arena, &emu.work_arena);
+        init_graphics_system(
+            emu.gfx_context,
+            emu.win.handle,
+            &emu.gfx_arena,
+            &emu.work_arena,
+            options.present);
 
         display_window(emu.win);
     }
 
-    emu.frame_memory =
-        create_frame_memory(emu.memory_manager, aspect_ratio(emu.gfx_context.swap_chain));
+    init_run_ahead(emu.run_ahead, &emu.work_arena, options.run_ahead_frames);
+
+    emu.frame_memory                    = create_frame_memory(emu.memory_manager);
+    emu.frame_memory.uses_tile_renderer = options.uses_tile_renderer;
+
+    u32 const frames_in_flight = emu.gfx_context.swap_chain.max_frames_in_flight;
+    emu.latency.input_time.init(&emu.gfx_arena, frames_in_flight);
+    for (u32 idx = 0; idx < frames_in_flight; ++idx) {
+        emu.latency.input_time[idx] = -1.0;
+    }
+}
+
+/// Buttons of the joypad held through the keyboard: the arrows for the directional pad, Z for A,
+/// X for B, Enter for Start and Backspace for Select.
+u8 held_buttons(Window const& win) noexcept {
+    struct KeyBinding {
+        Key key;
+        u8  button;
+    };
+    constexpr KeyBinding BINDINGS[] = {
+        {Key::Z, BUTTON_A},
+        {Key::X, BUTTON_B},
+        {Key::BACKSPACE, BUTTON_SELECT},
+        {Key::ENTER, BUTTON_START},
+        {Key::RIGHT, BUTTON_RIGHT},
+        {Key::LEFT, BUTTON_LEFT},
+        {Key::UP, BUTTON_UP},
+        {Key::DOWN, BUTTON_DOWN},
+    };
+
+    u8 buttons = 0;
+    for (KeyBinding const& binding : BINDINGS) {
+        i32 const state = glfwGetKey(win.handle, static_cast<i32>(binding.key));
+        if (state == static_cast<i32>(KeyState::PRESSED)) {
+            buttons |= binding.button;
+        }
+    }
+    return buttons;
+}
+
+/// Wait for the time at which the next frame is due. Presented frames are paced by the
+/// presentation engine, while skipped ones would otherwise run the loop as fast as it can.
+void wait_next_frame(f64& next_frame_time) noexcept {
+    f64 const now = glfwGetTime();
+    if (next_frame_time > now) {
+        std::this_thread::sleep_for(std::chrono::duration<f64>(next_frame_time - now));
+    }
+    next_frame_time = psh_max(next_frame_time, now) + 1.0 / DMG_FRAME_RATE;
+}
+
+/// Account the latency of every frame whose rendering ended since the last call.
+void sample_frame_latency(LatencyCounter& latency, GraphicsContext const& ctx) noexcept {
+    f64 const now = glfwGetTime();
+    for (u32 idx = 0; idx < latency.input_time.size; ++idx) {
+        if (latency.input_time[idx] < 0.0) {
+            continue;
+        }
+        if (vkGetFenceStatus(ctx.dev, ctx.sync.frame_in_flight.frame_fence[idx]) != VK_SUCCESS) {
+            continue;
+        }
+
+        f64 const elapsed = now - latency.input_time[idx];
+        latency.total += elapsed;
+        latency.max = psh_max(latency.max, elapsed);
+        ++latency.sample_count;
+
+        latency.input_time[idx] = -1.0;
+    }
 }
 
 FrameStatus render_scene(
-    GraphicsContext&   ctx,
-    FrameMemory const& frame_memory,
-    FrameResources&    resources) noexcept {
+    GraphicsContext& ctx,
+    FrameMemory&     frame_memory,
+    FrameResources&  resources) noexcept {
     // Prepare the frame for the pipeline commands.
     {
         FrameStatus prep_st = prepare_frame_for_rendering(ctx.dev, ctx.swap_chain, resources);
@@ -98,55 +196,122 @@ FrameStatus render_scene(
         }
     }
 
+    // With a zero-copy staging ring, the shaders read the slice of the frame in place and there
+    // is nothing to transfer.
+    bool const zero_copy = ctx.buffers.zero_copy;
+
+    // Stage the data that changed. The frame in flight was already waited on, so its slice of
+    // the staging ring is no longer read by the GPU.
+    StagingInfo staging_info;
+    {
+        if (!frame_memory.uses_tile_renderer) {
+            // Zero-copy slices are read directly, so each one has to hold the whole frame.
+            if (zero_copy) {
+                mark_lcd_rows_dirty(frame_memory, 0, LCD_HEIGHT);
+            }
+            collect_dirty_lcd_rows(frame_memory);
+        }
+
+        staging_info = memory_staging_info(frame_memory, resources.frame_index);
+        stage_host_data(ctx.alloc, ctx.buffers.host, staging_info);
+    }
+
     // Record and submit all commands.
     {
-        // Transfer the whole staging buffer data to the device buffer.
-        record_transfer_commands(
-            resources.transfer_cmd,
-            transfer_whole_info(
-                ctx.buffers.host.handle,
-                ctx.buffers.device.handle,
-                VERTEX_BUF_SIZE,
-                UNIFORM_BUF_SIZE));
-
-        // Submit the transfer as soon as possible.
-        submit_transfer_commands(
-            ctx.queues.graphics_queue,
-            resources.transfer_cmd,
-            resources.transfer_ended_fence);
+        VkSemaphore transfer_ended = nullptr;
+        if (!zero_copy) {
+            // Transfer the dirty regions of the frame's staging slice to the GPU.
+            record_transfer_commands(
+                resources.transfer_cmd,
+                transfer_info(ctx.buffers, ctx.queues, staging_info));
+
+            // Submit the transfer as soon as possible.
+            submit_transfer_commands(
+                ctx.queues.transfer_queue,
+                resources.transfer_cmd,
+                resources.previous_graphics_ended,
+                resources.transfer_ended_semaphore);
+            transfer_ended = resources.transfer_ended_semaphore;
+
+            if (staging_info.lcd_range_count != 0) {
+                frame_memory.lcd_texture_valid = true;
+            }
+        }
+
+        GraphicsCmdInfo gfx_info{
+            .native_pipeline        = ctx.pipelines.compose.handle,
+            .native_pipeline_layout = ctx.pipelines.compose.pipeline_layout,
+            .native_render_pass     = ctx.pipelines.compose.render_pass,
+            .native_frame_buf       = ctx.buffers.native.frame_buf,
+            .native_image           = ctx.buffers.native.image,
+            .native_view            = ctx.buffers.native.view,
+            .native_descriptor_set  = ctx.descriptor_sets.lcd_texture_descriptor_set,
+            .pipeline               = ctx.pipelines.graphics.handle,
+            .pipeline_layout        = ctx.pipelines.graphics.pipeline_layout,
+            .image                  = resources.image,
+            .image_view             = resources.image_view,
+            .render_pass            = ctx.pipelines.graphics.render_pass,
+            .frame_buf              = resources.frame_buf,
+            .surface_extent         = ctx.swap_chain.extent,
+            .descriptor_set         = ctx.descriptor_sets.native_descriptor_set,
+            .lcd_image              = ctx.buffers.lcd.image,
+            .lcd_valid              = frame_memory.lcd_texture_valid,
+            .tile_data_buf          = ctx.buffers.device.handle,
+            .tile_data_size         = zero_copy ? 0 : staging_info.tile_data_size,
+        };
+        DescriptorSetManager const& sets  = ctx.descriptor_sets;
+        u32 const                   frame = resources.frame_index;
+        if (frame_memory.uses_tile_renderer) {
+            gfx_info.native_pipeline        = ctx.pipelines.tile_renderer.handle;
+            gfx_info.native_pipeline_layout = ctx.pipelines.tile_renderer.pipeline_layout;
+            gfx_info.native_descriptor_set  = sets.tile_data_descriptor_set;
+            if (zero_copy) {
+                gfx_info.native_descriptor_set = sets.tile_data_frame_descriptor_sets[frame];
+            }
+        } else if (zero_copy) {
+            gfx_info.native_pipeline        = ctx.pipelines.lcd_buffer.handle;
+            gfx_info.native_pipeline_layout = ctx.pipelines.lcd_buffer.pipeline_layout;
+            gfx_info.native_descriptor_set  = sets.lcd_frame_descriptor_sets[frame];
+        }
 
-        record_graphics_commands(
-            resources.graphics_cmd,
+        // Only re-recorded when the swap chain or the pipelines changed since the last time this
+        // frame in flight rendered to the image.
+        VkCommandBuffer graphics_cmd = graphics_commands(
+            ctx.commands,
             ctx.queues,
-            GraphicsCmdInfo{
-                .pipeline                   = ctx.pipelines.graphics.handle,
-                .pipeline_layout            = ctx.pipelines.graphics.pipeline_layout,
-                .image                      = resources.image,
-                .render_pass                = ctx.pipelines.graphics.render_pass,
-                .frame_buf                  = resources.frame_buf,
-                .surface_extent             = ctx.swap_chain.extent,
-                .vertex_buf                 = ctx.buffers.device.handle,
-                .vertex_buf_binding         = VERTEX_BINDING_DESCRIPTION.binding,
-                .uniform_buf_descriptor_set = ctx.descriptor_sets.uniform_buf_descriptor_set,
-                .uniform_buf_offset         = 0,
-            },
+            ctx.rendering,
+            resources.frame_index,
+            resources.image_index,
+            gfx_info,
             render_data_info(frame_memory));
 
-        // Wait for the data transfer to be completed before going to the graphics pipeline.
-        wait_transfer_completion(ctx.dev, resources.transfer_ended_fence);
-
-        // Pass the new data through the graphics pipeline.
+        // Pass the new data through the graphics pipeline, the GPU orders it after the transfer.
         submit_graphics_commands(
             ctx.queues.graphics_queue,
-            resources.graphics_cmd,
+            graphics_cmd,
             resources.image_available_semaphore,
+            transfer_ended,
             resources.render_pass_ended_semaphore,
+            resources.graphics_ended_semaphore,
             resources.frame_in_flight_fence);
+        ctx.sync.pending_graphics_ended = resources.graphics_ended_semaphore;
     }
 
     return FrameStatus::OK;
 }
 
+/// Snapshot the video memory for the GPU tile renderer.
+///
+/// NOTE(luiz): there is still no PPU timing, so every line gets the registers that are in effect
+///             at the end of the frame. Once the PPU is implemented, the line registers should be
+///             captured as each line is drawn.
+void snapshot_frame(TileRendererInput& tile_input, MemoryMap const& mmap) noexcept {
+    snapshot_video_memory(tile_input, mmap);
+    for (u32 line = 0; line < LCD_HEIGHT; ++line) {
+        snapshot_line_registers(tile_input, mmap.reg, line);
+    }
+}
+
 void run_emu(Emulator& emu, psh::StringView cart_path) noexcept {
     switch (init_cartridge(emu.cart, &emu.cart_arena, cart_path)) {
         case psh::FileStatus::OK: {
@@ -163,12 +328,11 @@ void run_emu(Emulator& emu, psh::StringView cart_path) noexcept {
         }
     }
 
-    transfer_fixed_rom_bank(emu.cart, emu.cpu.mmap);
-    // TODO(luiz): transfer the remaining memory regions.
+    init_core(emu.core, emu.cart);
 
     // Update the window title adding the game title.
     {
-        auto        cart_title = extract_cart_title(emu.cpu.mmap);
+        auto        cart_title = extract_cart_title(emu.core.cpu.mmap);
         psh::String win_title{&emu.work_arena, cart_title.size() + EMU_NAME.size()};
         psh::Status res = win_title.join(
             {
@@ -185,16 +349,32 @@ void run_emu(Emulator& emu, psh::StringView cart_path) noexcept {
     }
 
     while (psh_likely(!emu.win.should_close)) {
+        sample_frame_latency(emu.latency, emu.gfx_context);
+
         process_input_events(emu.win);
+        f64 const input_time = glfwGetTime();
+        emu.core.buttons     = held_buttons(emu.win);
 
-        run_cpu_cycle(emu.cpu);
+        // A whole frame is emulated per host frame. With run-ahead, the frame presented is the
+        // one emulated furthest ahead with the buttons just sampled, otherwise it is the core.
+        Core const* presented = &run_ahead_frame(emu.run_ahead, emu.core);
 
         // Graphics pipeline.
         {
-            stage_host_data(
-                emu.gfx_context.alloc,
-                emu.gfx_context.buffers.host_buffer(),
-                memory_staging_info(emu.frame_memory));
+            if (emu.frame_memory.uses_tile_renderer) {
+                snapshot_frame(*emu.frame_memory.tile_input, presented->cpu.mmap);
+            } else {
+                update_lcd_palette(emu.frame_memory, presented->cpu.mmap.reg);
+            }
+
+            // Frames that are pixel-identical to the last presented one (menus, paused screens,
+            // etc.) don't need to be uploaded nor presented again, but still take a frame.
+            u64 const frame_hash = frame_memory_hash(emu.frame_memory);
+            if (frame_is_identical(emu.frame_memory, frame_hash)) {
+                ++emu.frame_memory.skipped_frame_count;
+                wait_next_frame(emu.next_frame_time);
+                continue;
+            }
 
             FrameResources resources = current_frame_resources(emu.gfx_context);
 
@@ -203,10 +383,14 @@ void run_emu(Emulator& emu, psh::StringView cart_path) noexcept {
                 FrameStatus frame_st = render_scene(emu.gfx_context, emu.frame_memory, resources);
 
                 switch (frame_st) {
-                    case FrameStatus::OK:                     break;
+                    case FrameStatus::OK: {
+                        emu.latency.input_time[resources.frame_index] = input_time;
+                        break;
+                    }
                     case FrameStatus::NOT_READY:              continue;
                     case FrameStatus::SWAP_CHAIN_OUT_OF_DATE: {
                         recreate_swap_chain_context(emu.gfx_context, emu.win);
+                        invalidate_presented_frame(emu.frame_memory);
                         continue;
                     }
                     case FrameStatus::FATAL: psh_todo_msg("Handle frame preparation failure");
@@ -226,25 +410,98 @@ void run_emu(Emulator& emu, psh::StringView cart_path) noexcept {
                     case PresentStatus::NOT_READY:              continue;
                     case PresentStatus::SWAP_CHAIN_OUT_OF_DATE: {
                         recreate_swap_chain_context(emu.gfx_context, emu.win);
+                        invalidate_presented_frame(emu.frame_memory);
                         continue;
                     }
                     default: psh_todo_msg("Handle presentation failure");
                 }
             }
+
+            mark_frame_presented(emu.frame_memory, frame_hash);
+            emu.next_frame_time = glfwGetTime() + 1.0 / DMG_FRAME_RATE;
         }
     }
 }
 
 void terminate_emu(Emulator& emu) noexcept {
+    psh_info_fmt(
+        "Skipped the presentation of %llu identical frames.",
+        static_cast<unsigned long long>(emu.frame_memory.skipped_frame_count));
+
+    LatencyCounter const& latency = emu.latency;
+    if (latency.sample_count != 0) {
+        psh_info_fmt(
+            "Input-to-present latency with present mode %d and %u frames in flight: "
+            "average %.2f ms, max %.2f ms over %llu frames.",
+            static_cast<i32>(emu.gfx_context.swap_chain.present_mode),
+            emu.gfx_context.swap_chain.max_frames_in_flight,
+            1000.0 * latency.total / static_cast<f64>(latency.sample_count),
+            1000.0 * latency.max,
+            static_cast<unsigned long long>(latency.sample_count));
+    }
+
+    if (emu.run_ahead.frames != 0) {
+        RunAheadStats const mean = mean_run_ahead_stats(emu.run_ahead.stats);
+        psh_info_fmt(
+            "Run-ahead of %u frames per host frame: frame %.3f ms, save %.3f ms, restore %.3f ms, "
+            "ahead %.3f ms, worst host frame %.3f ms over %llu host frames.",
+            emu.run_ahead.frames,
+            1000.0 * mean.frame_seconds,
+            1000.0 * mean.save_seconds,
+            1000.0 * mean.restore_seconds,
+            1000.0 * mean.ahead_seconds,
+            1000.0 * mean.max_host_seconds,
+            static_cast<unsigned long long>(mean.host_frame_count));
+    }
+
     destroy_graphics_system(emu.gfx_context);
     destroy_window(emu.win);
 }
 
+/// Parse the options following the ROM path:
+///
+/// * `--gpu-tiles`: compose the LCD on the GPU from the raw video memory.
+/// * `--present-mode <fifo|mailbox|immediate>`: latency policy of the presentation.
+/// * `--frames-in-flight <count>`: frames the CPU may record ahead of the GPU.
+/// * `--run-ahead <frames>`: frames emulated ahead of each presented one, hiding the input lag of
+///   the game.
+EmuOptions parse_options(i32 argc, strptr argv[]) noexcept {
+    EmuOptions options;
+    for (i32 idx = 2; idx < argc; ++idx) {
+        strptr const arg     = argv[idx];
+        bool const   has_val = (idx + 1 < argc);
+
+        if (psh::str_equal(arg, "--gpu-tiles")) {
+            options.uses_tile_renderer = true;
+        } else if (psh::str_equal(arg, "--present-mode") && has_val) {
+            strptr const mode = argv[++idx];
+            if (psh::str_equal(mode, "fifo")) {
+                options.present.policy = PresentPolicy::FIFO;
+            } else if (psh::str_equal(mode, "mailbox")) {
+                options.present.policy = PresentPolicy::MAILBOX;
+            } else if (psh::str_equal(mode, "immediate")) {
+                options.present.policy = PresentPolicy::IMMEDIATE;
+            } else {
+                psh_warning_fmt("Unknown present mode '%s', using fifo.", mode);
+            }
+        } else if (psh::str_equal(arg, "--frames-in-flight") && has_val) {
+            options.present.frames_in_flight =
+                static_cast<u32>(std::strtoul(argv[++idx], nullptr, 10));
+        } else if (psh::str_equal(arg, "--run-ahead") && has_val) {
+            options.run_ahead_frames = static_cast<u32>(std::strtoul(argv[++idx], nullptr, 10));
+        } else {
+            psh_warning_fmt("Ignoring unknown option '%s'.", arg);
+        }
+    }
+    return options;
+}
+
 int main(i32 argc, strptr argv[]) {
+    psh_assert_msg(argc > 1, "Please provide the path of a ROM file as a CLI argument");
+
     Emulator emu;
-    init_emu(emu);
+    init_emu(emu, parse_options(argc, argv));
 
-    psh_assert_msg(argc > 1, "Please provide the path of a ROM file as a CLI argument");
     run_emu(emu, psh::StringView{argv[1]});
 
     terminate_emu(emu);
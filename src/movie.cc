@@ -0,0 +1,334 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Implementation of the input movies.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/movie.h>
+
+#include <mina/rewind.h>
+#include <psh/assert.h>
+#include <cstdio>
+#include <cstring>
+
+namespace mina {
+    static_assert(sizeof(MovieHeader) == 40);
+
+    namespace {
+        constexpr usize MAX_KEYFRAME_SIZE = max_xor_delta_size(sizeof(SaveState));
+
+        u8* state_bytes(SaveState* state) noexcept {
+            return reinterpret_cast<u8*>(state);
+        }
+
+        /// Status of a movie whose state was validated with the given status.
+        MovieStatus movie_state_status(SaveStateStatus status) noexcept {
+            switch (status) {
+                case SaveStateStatus::OK:              return MovieStatus::OK;
+                case SaveStateStatus::INVALID_MAGIC:   return MovieStatus::INVALID_MAGIC;
+                case SaveStateStatus::INVALID_VERSION: return MovieStatus::INVALID_VERSION;
+                case SaveStateStatus::WRONG_CARTRIDGE: return MovieStatus::WRONG_CARTRIDGE;
+                default:                               return MovieStatus::INVALID_SIZE;
+            }
+        }
+
+        bool allocate_movie(
+            Movie&             movie,
+            psh::Arena*        arena,
+            MovieConfig const& config) noexcept {
+            u32 const interval      = psh_max(config.keyframe_interval, 1u);
+            u64 const max_keyframes = config.max_frames / interval;
+
+            movie                          = {};
+            movie.header.keyframe_interval = interval;
+            movie.max_frames               = config.max_frames;
+            movie.max_keyframes            = static_cast<u32>(max_keyframes);
+            movie.keyframe_buffer_size     = config.keyframe_buffer_size;
+            movie.initial                  = arena->zero_alloc<SaveState>(1);
+            movie.scratch                  = arena->zero_alloc<SaveState>(1);
+            movie.buttons                  = arena->zero_alloc<u8>(config.max_frames);
+            movie.keyframe_ends            = arena->zero_alloc<u64>(max_keyframes);
+            movie.keyframe_data            = arena->zero_alloc<u8>(config.keyframe_buffer_size);
+            return (movie.initial != nullptr) && (movie.scratch != nullptr)
+                   && (movie.buttons != nullptr) && (movie.keyframe_ends != nullptr)
+                   && (movie.keyframe_data != nullptr);
+        }
+
+        /// Offset in the keyframe data of the keyframe at frame `keyframe * keyframe_interval`.
+        u64 keyframe_start(Movie const& movie, u32 keyframe) noexcept {
+            return (keyframe > 1) ? movie.keyframe_ends[keyframe - 2] : 0;
+        }
+
+        bool read_exactly(FILE* file, void* dst, usize size) noexcept {
+            return std::fread(dst, 1, size, file) == size;
+        }
+
+        bool write_exactly(FILE* file, void const* src, usize size) noexcept {
+            return std::fwrite(src, 1, size, file) == size;
+        }
+
+        /// Decode the keyframe at frame `keyframe * keyframe_interval` into the scratch state,
+        /// checking that it is the state of the movie at that frame.
+        bool decode_keyframe(Movie& movie, u32 keyframe) noexcept {
+            u64 const  start   = keyframe_start(movie, keyframe);
+            bool const decoded = decode_xor_delta(
+                movie.keyframe_data + start,
+                static_cast<usize>(movie.keyframe_ends[keyframe - 1] - start),
+                state_bytes(movie.initial),
+                sizeof(SaveState),
+                state_bytes(movie.scratch));
+            if (!decoded) {
+                return false;
+            }
+
+            SaveStateStatus const status = validate_state(
+                {state_bytes(movie.scratch), sizeof(SaveState)},
+                movie.header.cart_hash);
+            u64 const frame =
+                movie.initial->frame_count + u64{keyframe} * movie.header.keyframe_interval;
+            return (status == SaveStateStatus::OK) && (movie.scratch->frame_count == frame);
+        }
+
+        /// Check that the keyframe offsets read from a file are consistent with the header.
+        bool valid_keyframe_ends(Movie const& movie) noexcept {
+            MovieHeader const& header = movie.header;
+            if (header.keyframe_count != header.frame_count / header.keyframe_interval) {
+                return false;
+            }
+
+            u64 start = 0;
+            for (u32 idx = 0; idx < header.keyframe_count; ++idx) {
+                u64 const end = movie.keyframe_ends[idx];
+                if ((end < start) || (end - start > MAX_KEYFRAME_SIZE)) {
+                    return false;
+                }
+                start = end;
+            }
+            return start == header.keyframe_data_size;
+        }
+
+        /// Check that every keyframe read from a file decodes to a state of the movie.
+        bool valid_keyframes(Movie& movie) noexcept {
+            for (u32 keyframe = 1; keyframe <= movie.header.keyframe_count; ++keyframe) {
+                if (!decode_keyframe(movie, keyframe)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+    }  // namespace
+
+    void init_movie(
+        Movie&             movie,
+        psh::Arena*        arena,
+        Core const&        core,
+        MovieConfig const& config) noexcept {
+        bool const allocated = allocate_movie(movie, arena, config);
+        psh_assert_msg(allocated, "Movie arena too small");
+
+        movie.header.cart_hash = core.cart_hash;
+        save_state(core, *movie.initial);
+    }
+
+    u64 movie_frame(Movie const& movie, Core const& core) noexcept {
+        return core.frame_count - movie.initial->frame_count;
+    }
+
+    MovieStatus record_movie_frame(Movie& movie, Core& core) noexcept {
+        MovieHeader& header = movie.header;
+        if (core.cart_hash != header.cart_hash) {
+            return MovieStatus::WRONG_CARTRIDGE;
+        }
+
+        u64 const frame = header.frame_count;
+        if (movie_frame(movie, core) != frame) {
+            return MovieStatus::OUT_OF_SYNC;
+        }
+        if (frame >= movie.max_frames) {
+            return MovieStatus::FULL;
+        }
+
+        // Room for the keyframe is checked beforehand, so that a frame is either fully recorded
+        // or not run at all.
+        bool const keyframe = ((frame + 1) % header.keyframe_interval == 0);
+        if (keyframe) {
+            bool const has_entry = (header.keyframe_count < movie.max_keyframes);
+            bool const has_room =
+                (header.keyframe_data_size + MAX_KEYFRAME_SIZE <= movie.keyframe_buffer_size);
+            if (!has_entry || !has_room) {
+                return MovieStatus::FULL;
+            }
+        }
+
+        movie.buttons[frame] = core.buttons;
+        run_core_frame(core);
+        header.frame_count = frame + 1;
+
+        if (keyframe) {
+            save_state(core, *movie.scratch);
+            usize const size = encode_xor_delta(
+                state_bytes(movie.scratch),
+                state_bytes(movie.initial),
+                sizeof(SaveState),
+                movie.keyframe_data + header.keyframe_data_size);
+
+            header.keyframe_data_size += size;
+            movie.keyframe_ends[header.keyframe_count] = header.keyframe_data_size;
+            header.keyframe_count += 1;
+        }
+        return MovieStatus::OK;
+    }
+
+    MovieStatus play_movie_frame(Movie const& movie, Core& core) noexcept {
+        if (core.cart_hash != movie.header.cart_hash) {
+            return MovieStatus::WRONG_CARTRIDGE;
+        }
+
+        u64 const frame = movie_frame(movie, core);
+        if (frame >= movie.header.frame_count) {
+            return MovieStatus::END_OF_MOVIE;
+        }
+
+        core.buttons = movie.buttons[frame];
+        run_core_frame(core);
+        return MovieStatus::OK;
+    }
+
+    MovieStatus seek_movie(Movie& movie, Core& core, u64 frame) noexcept {
+        MovieHeader const& header = movie.header;
+        if (core.cart_hash != header.cart_hash) {
+            return MovieStatus::WRONG_CARTRIDGE;
+        }
+        if (frame > header.frame_count) {
+            return MovieStatus::END_OF_MOVIE;
+        }
+
+        u32 const        keyframe = static_cast<u32>(frame / header.keyframe_interval);
+        SaveState const* state    = movie.initial;
+        if (keyframe != 0) {
+            if (!decode_keyframe(movie, keyframe)) {
+                return MovieStatus::CORRUPT;
+            }
+            state = movie.scratch;
+        }
+        if (load_state(core, *state) != SaveStateStatus::OK) {
+            return MovieStatus::CORRUPT;
+        }
+
+        // Never more than `keyframe_interval - 1` frames away from the keyframe.
+        for (u64 idx = u64{keyframe} * header.keyframe_interval; idx < frame; ++idx) {
+            core.buttons = movie.buttons[idx];
+            run_core_frame(core);
+        }
+        return MovieStatus::OK;
+    }
+
+    void truncate_movie(Movie& movie, u64 frame) noexcept {
+        MovieHeader& header = movie.header;
+        if (frame >= header.frame_count) {
+            return;
+        }
+
+        header.frame_count        = frame;
+        header.keyframe_count     = static_cast<u32>(frame / header.keyframe_interval);
+        header.keyframe_data_size = keyframe_start(movie, header.keyframe_count + 1);
+    }
+
+    MovieStatus write_movie_file(Movie const& movie, psh::StringView path) noexcept {
+        FILE* file = std::fopen(path.data.buf, "wb");
+        if (file == nullptr) {
+            return MovieStatus::FAILED_TO_OPEN;
+        }
+
+        MovieHeader const& header    = movie.header;
+        usize const        ends_size = header.keyframe_count * sizeof(u64);
+        bool const         written =
+            write_exactly(file, &header, sizeof(MovieHeader))
+            && write_exactly(file, movie.initial, sizeof(SaveState))
+            && write_exactly(file, movie.buttons, header.frame_count)
+            && write_exactly(file, movie.keyframe_ends, ends_size)
+            && write_exactly(file, movie.keyframe_data, header.keyframe_data_size);
+
+        bool const closed = (std::fclose(file) == 0);
+        return (written && closed) ? MovieStatus::OK : MovieStatus::FAILED_TO_WRITE;
+    }
+
+    MovieStatus load_movie_file(
+        Movie&             movie,
+        psh::Arena*        arena,
+        psh::StringView    path,
+        MovieConfig const& config) noexcept {
+        FILE* file = std::fopen(path.data.buf, "rb");
+        if (file == nullptr) {
+            return MovieStatus::FAILED_TO_OPEN;
+        }
+
+        MovieHeader header;
+        MovieStatus status = MovieStatus::OK;
+        if (!read_exactly(file, &header, sizeof(MovieHeader))) {
+            status = MovieStatus::INVALID_SIZE;
+        } else if (header.magic != MOVIE_MAGIC) {
+            status = MovieStatus::INVALID_MAGIC;
+        } else if (header.version != MOVIE_VERSION) {
+            status = MovieStatus::INVALID_VERSION;
+        } else if (header.keyframe_interval == 0) {
+            status = MovieStatus::INVALID_SIZE;
+        }
+
+        // The movie has room for the configuration, and at least for the contents of the file.
+        if (status == MovieStatus::OK) {
+            MovieConfig const capacity{
+                .max_frames           = psh_max(config.max_frames, header.frame_count),
+                .keyframe_interval    = header.keyframe_interval,
+                .keyframe_buffer_size = psh_max(
+                    config.keyframe_buffer_size,
+                    static_cast<usize>(header.keyframe_data_size)),
+            };
+            if (!allocate_movie(movie, arena, capacity)) {
+                status = MovieStatus::OUT_OF_MEMORY;
+            } else if (header.keyframe_count > movie.max_keyframes) {
+                status = MovieStatus::INVALID_SIZE;
+            }
+        }
+
+        if (status == MovieStatus::OK) {
+            movie.header = header;
+
+            usize const ends_size = header.keyframe_count * sizeof(u64);
+            bool const  read      = read_exactly(file, movie.initial, sizeof(SaveState))
+                              && read_exactly(file, movie.buttons, header.frame_count)
+                              && read_exactly(file, movie.keyframe_ends, ends_size)
+                              && read_exactly(file, movie.keyframe_data, header.keyframe_data_size);
+
+            if (!read || !valid_keyframe_ends(movie)) {
+                status = MovieStatus::INVALID_SIZE;
+            } else {
+                status = movie_state_status(validate_state(
+                    {state_bytes(movie.initial), sizeof(SaveState)},
+                    header.cart_hash));
+            }
+            if ((status == MovieStatus::OK) && !valid_keyframes(movie)) {
+                status = MovieStatus::CORRUPT;
+            }
+        }
+
+        std::fclose(file);
+        return status;
+    }
+}  // namespace mina
@@ -0,0 +1,503 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Implementation of the rollback netplay sessions and of their transports.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/netplay.h>
+
+#include <psh/assert.h>
+#include <chrono>
+#include <cstring>
+#include <limits>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    define MINA_NETPLAY_SOCKETS
+#    include <arpa/inet.h>
+#    include <fcntl.h>
+#    include <netinet/in.h>
+#    include <sys/socket.h>
+#    include <unistd.h>
+#endif
+
+namespace mina {
+    namespace {
+        /// Identifies a packet as part of a netplay session, reads as "MNNP" in memory.
+        constexpr u32 NETPLAY_MAGIC = 0x504E4E4D;
+
+        /// Header of a packet, followed by the local buttons of `count` frames from `first_frame`
+        /// on. Packets are only exchanged between little-endian hosts.
+        struct PacketHeader {
+            u32 magic       = NETPLAY_MAGIC;
+            u32 first_frame = 0;
+            u32 ack         = 0;  ///< Frames of the buttons of the receiver known by the sender.
+            u8  count       = 0;
+            u8  reserved_[3]{};
+            u64 cart_hash   = 0;
+        };
+
+        static_assert(sizeof(PacketHeader) + NETPLAY_MAX_PACKET_INPUTS == NETPLAY_MAX_PACKET_SIZE);
+        static_assert(
+            NETPLAY_INPUT_RING_SIZE
+                >= 2 * (NETPLAY_MAX_ROLLBACK + NETPLAY_MAX_INPUT_DELAY) + NETPLAY_MAX_PACKET_INPUTS,
+            "The ring should hold every frame that may be rolled back, delayed or resent");
+
+        using Clock = std::chrono::steady_clock;
+
+        u32 remote_player(NetplaySession const& session) noexcept {
+            return 1 - session.local_player;
+        }
+
+        u8& buttons_at(NetplaySession& session, u32 player, u64 frame) noexcept {
+            return session.buttons[player][frame % NETPLAY_INPUT_RING_SIZE];
+        }
+
+        /// States of the cores saved at the start of a frame.
+        SaveState* frame_states(NetplaySession& session, u64 frame) noexcept {
+            u64 const slot = frame % (session.max_rollback + 1);
+            return session.states + slot * NETPLAY_PLAYER_COUNT;
+        }
+
+        /// Buttons of the remote player in a frame, predicted to be the last ones received when
+        /// they weren't received yet.
+        u8 remote_buttons(NetplaySession& session, u64 frame) noexcept {
+            u32 const remote = remote_player(session);
+            if (frame < session.remote_input_count) {
+                return buttons_at(session, remote, frame);
+            }
+            if (session.remote_input_count == 0) {
+                return 0;
+            }
+            return buttons_at(session, remote, session.remote_input_count - 1);
+        }
+
+        void run_session_frame(NetplaySession& session) noexcept {
+            u64 const  frame  = session.frame;
+            SaveState* states = frame_states(session, frame);
+            for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+                save_state(session.cores[player], states[player]);
+            }
+
+            buttons_at(session, remote_player(session), frame) = remote_buttons(session, frame);
+            for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+                Core& core   = session.cores[player];
+                core.buttons = buttons_at(session, player, frame);
+                run_core_frame(core);
+            }
+            session.frame = frame + 1;
+        }
+
+        /// Restore the cores to the start of a frame and run every frame since then again.
+        void roll_back(NetplaySession& session, u64 frame) noexcept {
+            auto const start = Clock::now();
+
+            u64 const  target = session.frame;
+            SaveState* states = frame_states(session, frame);
+            for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+                psh_discard(load_state(session.cores[player], states[player]));
+            }
+
+            session.frame = frame;
+            while (session.frame < target) {
+                run_session_frame(session);
+            }
+
+            f64 const     seconds = std::chrono::duration<f64>(Clock::now() - start).count();
+            NetplayStats& stats   = session.stats;
+            stats.rollback_count += 1;
+            stats.resimulated_frames += target - frame;
+            stats.rollback_seconds += seconds;
+            stats.max_rollback_seconds = psh_max(stats.max_rollback_seconds, seconds);
+        }
+
+        /// Receive every pending packet, returning the first frame already run whose remote
+        /// buttons were mispredicted, if any.
+        u64 receive_packets(NetplaySession& session, NetplayStatus& status) noexcept {
+            u32 const remote         = remote_player(session);
+            u64       first_mismatch = std::numeric_limits<u64>::max();
+
+            // Remote buttons beyond this frame would overwrite frames that may still be rolled
+            // back.
+            u64 const oldest_frame = (session.frame > session.max_rollback)
+                                         ? session.frame - session.max_rollback
+                                         : 0;
+            u64 const ring_end     = oldest_frame + NETPLAY_INPUT_RING_SIZE;
+
+            NetplayTransport const& transport = session.transport;
+            u8                      packet[NETPLAY_MAX_PACKET_SIZE];
+            for (;;) {
+                usize const size = transport.receive(transport.user, packet, sizeof(packet));
+                if (size == 0) {
+                    break;
+                }
+
+                PacketHeader header;
+                if (size >= sizeof(PacketHeader)) {
+                    std::memcpy(&header, packet, sizeof(PacketHeader));
+                }
+                bool const valid = (size >= sizeof(PacketHeader)) && (header.magic == NETPLAY_MAGIC)
+                                   && (header.count <= NETPLAY_MAX_PACKET_INPUTS)
+                                   && (size >= sizeof(PacketHeader) + header.count);
+                if (!valid) {
+                    session.stats.packets_rejected += 1;
+                    continue;
+                }
+                if (header.cart_hash != session.cores[0].cart_hash) {
+                    session.stats.packets_rejected += 1;
+                    status = NetplayStatus::WRONG_CARTRIDGE;
+                    continue;
+                }
+                session.stats.packets_received += 1;
+
+                u64 const ack      = psh_min(u64{header.ack}, session.local_input_count);
+                session.remote_ack = psh_max(session.remote_ack, ack);
+
+                // Only buttons following the ones already received are taken, the missing ones
+                // are sent again by the remote peer until they're acknowledged.
+                u8 const* inputs = packet + sizeof(PacketHeader);
+                for (u32 idx = 0; idx < header.count; ++idx) {
+                    u64 const frame = u64{header.first_frame} + idx;
+                    if (frame < session.remote_input_count) {
+                        continue;
+                    }
+                    if ((frame > session.remote_input_count) || (frame >= ring_end)) {
+                        break;
+                    }
+
+                    u8& buttons = buttons_at(session, remote, frame);
+                    if ((frame < session.frame) && (buttons != inputs[idx])) {
+                        first_mismatch = psh_min(first_mismatch, frame);
+                    }
+                    buttons = inputs[idx];
+                    session.remote_input_count += 1;
+                }
+            }
+            return first_mismatch;
+        }
+
+        /// Receive the pending packets and roll back to the first mispredicted frame, if any.
+        NetplayStatus synchronize(NetplaySession& session) noexcept {
+            NetplayStatus status         = NetplayStatus::OK;
+            u64 const     first_mismatch = receive_packets(session, status);
+            if (status != NetplayStatus::OK) {
+                return status;
+            }
+            if (first_mismatch < session.frame) {
+                roll_back(session, first_mismatch);
+            }
+            return NetplayStatus::OK;
+        }
+
+        /// Send every local button not yet acknowledged by the remote peer.
+        void send_inputs(NetplaySession& session) noexcept {
+            u64 const first = session.remote_ack;
+            u64 const count =
+                psh_min(session.local_input_count - first, u64{NETPLAY_MAX_PACKET_INPUTS});
+
+            PacketHeader const header{
+                .magic       = NETPLAY_MAGIC,
+                .first_frame = static_cast<u32>(first),
+                .ack         = static_cast<u32>(session.remote_input_count),
+                .count       = static_cast<u8>(count),
+                .reserved_   = {},
+                .cart_hash   = session.cores[0].cart_hash,
+            };
+
+            u8 packet[NETPLAY_MAX_PACKET_SIZE];
+            std::memcpy(packet, &header, sizeof(PacketHeader));
+            for (u64 idx = 0; idx < count; ++idx) {
+                packet[sizeof(PacketHeader) + idx] =
+                    buttons_at(session, session.local_player, first + idx);
+            }
+
+            NetplayTransport const& transport = session.transport;
+            if (transport.send(transport.user, packet, sizeof(PacketHeader) + count)) {
+                session.stats.packets_sent += 1;
+            }
+        }
+
+        /// SplitMix64 generator, for the conditions of the loopback channels.
+        u64 next_random(u64& state) noexcept {
+            state += 0x9E3779B97F4A7C15;
+            u64 z = state;
+            z     = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+            z     = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+            return z ^ (z >> 31);
+        }
+
+        bool loopback_send(void* user, u8 const* packet, usize size) noexcept {
+            LoopbackEndpoint const& endpoint = *static_cast<LoopbackEndpoint const*>(user);
+            LoopbackChannel&        channel  = *endpoint.channel;
+            LoopbackConfig const&   config   = channel.config;
+            LoopbackQueue&          queue    = channel.queues[1 - endpoint.index];
+
+            bool const lost = (next_random(channel.rng) % 100) < config.loss_percent;
+            if (lost || (queue.count == queue.capacity) || (size > NETPLAY_MAX_PACKET_SIZE)) {
+                channel.lost_count += 1;
+                return true;
+            }
+
+            u64 delay = config.delay;
+            if (config.jitter != 0) {
+                delay += next_random(channel.rng) % (config.jitter + 1);
+            }
+
+            LoopbackPacket& queued = queue.packets[queue.count++];
+            queued.deliver_at      = channel.now + delay;
+            queued.size            = size;
+            std::memcpy(queued.data, packet, size);
+            return true;
+        }
+
+        usize loopback_receive(void* user, u8* buffer, usize capacity) noexcept {
+            LoopbackEndpoint const& endpoint = *static_cast<LoopbackEndpoint const*>(user);
+            LoopbackChannel&        channel  = *endpoint.channel;
+            LoopbackQueue&          queue    = channel.queues[endpoint.index];
+
+            // The packets that are due are delivered in the order they were sent.
+            for (u32 idx = 0; idx < queue.count; ++idx) {
+                LoopbackPacket const& packet = queue.packets[idx];
+                if (packet.deliver_at > channel.now) {
+                    continue;
+                }
+
+                usize const size = psh_min(packet.size, capacity);
+                std::memcpy(buffer, packet.data, size);
+                std::memmove(
+                    queue.packets + idx,
+                    queue.packets + idx + 1,
+                    (queue.count - idx - 1) * sizeof(LoopbackPacket));
+                queue.count -= 1;
+                return size;
+            }
+            return 0;
+        }
+
+#if defined(MINA_NETPLAY_SOCKETS)
+        bool udp_send(void* user, u8 const* packet, usize size) noexcept {
+            UdpTransport const& udp = *static_cast<UdpTransport const*>(user);
+
+            sockaddr_in remote{};
+            remote.sin_family      = AF_INET;
+            remote.sin_port        = udp.remote_port;
+            remote.sin_addr.s_addr = udp.remote_ip;
+
+            ssize_t const sent = sendto(
+                udp.socket,
+                packet,
+                size,
+                0,
+                reinterpret_cast<sockaddr const*>(&remote),
+                sizeof(remote));
+            return sent == static_cast<ssize_t>(size);
+        }
+
+        usize udp_receive(void* user, u8* buffer, usize capacity) noexcept {
+            UdpTransport const& udp = *static_cast<UdpTransport const*>(user);
+
+            // Datagrams from anywhere else than the remote peer are dropped.
+            for (;;) {
+                sockaddr_in   sender{};
+                socklen_t     sender_size = sizeof(sender);
+                ssize_t const received    = recvfrom(
+                    udp.socket,
+                    buffer,
+                    capacity,
+                    0,
+                    reinterpret_cast<sockaddr*>(&sender),
+                    &sender_size);
+                if (received <= 0) {
+                    return 0;
+                }
+                bool const from_remote = (sender.sin_addr.s_addr == udp.remote_ip)
+                                         && (sender.sin_port == udp.remote_port);
+                if (from_remote) {
+                    return static_cast<usize>(received);
+                }
+            }
+        }
+#else
+        bool udp_send(void*, u8 const*, usize) noexcept {
+            return false;
+        }
+
+        usize udp_receive(void*, u8*, usize) noexcept {
+            return 0;
+        }
+#endif
+    }  // namespace
+
+    void init_netplay(
+        NetplaySession&         session,
+        psh::Arena*             arena,
+        Cartridge const&        cart,
+        NetplayTransport const& transport,
+        NetplayConfig const&    config) noexcept {
+        psh_assert_msg(config.local_player < NETPLAY_PLAYER_COUNT, "Netplay is for two players");
+        psh_assert_msg(config.input_delay <= NETPLAY_MAX_INPUT_DELAY, "Input delay too long");
+        psh_assert_msg(
+            (config.max_rollback != 0) && (config.max_rollback <= NETPLAY_MAX_ROLLBACK),
+            "Invalid rollback window");
+
+        for (Core& core : session.cores) {
+            init_core(core, cart);
+            core.buttons = 0;
+        }
+        session.transport    = transport;
+        session.local_player = config.local_player;
+        session.input_delay  = config.input_delay;
+        session.max_rollback = config.max_rollback;
+
+        // The local buttons of the first frames are those held before the session started.
+        session.frame              = 0;
+        session.local_input_count  = config.input_delay;
+        session.remote_input_count = 0;
+        session.remote_ack         = 0;
+        std::memset(session.buttons, 0, sizeof(session.buttons));
+
+        session.states =
+            arena->zero_alloc<SaveState>((config.max_rollback + 1) * NETPLAY_PLAYER_COUNT);
+        psh_assert_msg(session.states != nullptr, "Netplay arena too small");
+        session.stats = {};
+    }
+
+    NetplayStatus poll_netplay(NetplaySession& session) noexcept {
+        NetplayStatus const status = synchronize(session);
+        if (status == NetplayStatus::OK) {
+            send_inputs(session);
+        }
+        return status;
+    }
+
+    NetplayStatus advance_netplay(NetplaySession& session, u8 local_buttons) noexcept {
+        NetplayStatus const status = synchronize(session);
+        if (status != NetplayStatus::OK) {
+            return status;
+        }
+
+        if (session.frame >= session.remote_input_count + session.max_rollback) {
+            session.stats.stall_count += 1;
+            send_inputs(session);
+            return NetplayStatus::STALLED;
+        }
+
+        buttons_at(session, session.local_player, session.local_input_count) = local_buttons;
+        session.local_input_count += 1;
+
+        run_session_frame(session);
+        send_inputs(session);
+        return NetplayStatus::OK;
+    }
+
+    bool netplay_confirmed(NetplaySession const& session) noexcept {
+        return session.remote_input_count >= session.frame;
+    }
+
+    void init_loopback(
+        LoopbackChannel&      channel,
+        psh::Arena*           arena,
+        LoopbackConfig const& config,
+        u32                   capacity) noexcept {
+        channel.config     = config;
+        channel.now        = 0;
+        channel.rng        = config.seed;
+        channel.lost_count = 0;
+        for (u32 idx = 0; idx < 2; ++idx) {
+            channel.queues[idx] = LoopbackQueue{
+                .packets  = arena->zero_alloc<LoopbackPacket>(capacity),
+                .count    = 0,
+                .capacity = capacity,
+            };
+            channel.endpoints[idx] = LoopbackEndpoint{.channel = &channel, .index = idx};
+        }
+        psh_assert_msg(channel.queues[1].packets != nullptr, "Loopback arena too small");
+    }
+
+    NetplayTransport loopback_transport(LoopbackChannel& channel, u32 endpoint) noexcept {
+        return NetplayTransport{
+            .user    = &channel.endpoints[endpoint],
+            .send    = loopback_send,
+            .receive = loopback_receive,
+        };
+    }
+
+    void tick_loopback(LoopbackChannel& channel) noexcept {
+        channel.now += 1;
+    }
+
+    bool open_udp_transport(
+        UdpTransport& udp,
+        u16           local_port,
+        strptr        remote_ip,
+        u16           remote_port) noexcept {
+#if defined(MINA_NETPLAY_SOCKETS)
+        udp = {};
+
+        in_addr remote_addr{};
+        if (inet_pton(AF_INET, remote_ip, &remote_addr) != 1) {
+            return false;
+        }
+
+        i32 const fd = socket(AF_INET, SOCK_DGRAM, 0);
+        if (fd < 0) {
+            return false;
+        }
+
+        sockaddr_in local{};
+        local.sin_family      = AF_INET;
+        local.sin_port        = htons(local_port);
+        local.sin_addr.s_addr = htonl(INADDR_ANY);
+
+        bool const bound =
+            (bind(fd, reinterpret_cast<sockaddr const*>(&local), sizeof(local)) == 0);
+        if (!bound || (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) != 0)) {
+            close(fd);
+            return false;
+        }
+
+        udp.socket      = fd;
+        udp.remote_ip   = remote_addr.s_addr;
+        udp.remote_port = htons(remote_port);
+        return true;
+#else
+        psh_discard(udp);
+        psh_discard(local_port);
+        psh_discard(remote_ip);
+        psh_discard(remote_port);
+        return false;
+#endif
+    }
+
+    void close_udp_transport(UdpTransport& udp) noexcept {
+#if defined(MINA_NETPLAY_SOCKETS)
+        if (udp.socket >= 0) {
+            close(udp.socket);
+        }
+#endif
+        udp.socket = -1;
+    }
+
+    NetplayTransport udp_transport(UdpTransport& udp) noexcept {
+        return NetplayTransport{
+            .user    = &udp,
+            .send    = udp_send,
+            .receive = udp_receive,
+        };
+    }
+}  // namespace mina
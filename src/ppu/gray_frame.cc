@@ -0,0 +1,290 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the software grayscale LCD renderer.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/ppu/gray_frame.h>
+
+#include <mina/ppu/palette.h>
+#include <cstring>
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#    define MINA_GRAY_FRAME_NEON
+#    include <arm_neon.h>
+#elif defined(__SSE2__)
+#    define MINA_GRAY_FRAME_SSE2
+#    include <emmintrin.h>
+#endif
+
+namespace mina {
+    namespace {
+        // Bits of the LCDC register, read as a whole byte.
+        constexpr u8 LCDC_BG_EN    = 1 << 0;
+        constexpr u8 LCDC_OBJ_EN   = 1 << 1;
+        constexpr u8 LCDC_OBJ_SIZE = 1 << 2;
+        constexpr u8 LCDC_BG_MAP   = 1 << 3;
+        constexpr u8 LCDC_TILE_SEL = 1 << 4;
+        constexpr u8 LCDC_WIN_EN   = 1 << 5;
+        constexpr u8 LCDC_WIN_MAP  = 1 << 6;
+        constexpr u8 LCDC_LCD_EN   = 1 << 7;
+
+        // Bits of the attribute flags of an object.
+        constexpr u8 OAM_PRIORITY = 1 << 7;
+        constexpr u8 OAM_Y_FLIP   = 1 << 6;
+        constexpr u8 OAM_X_FLIP   = 1 << 5;
+        constexpr u8 OAM_PALETTE  = 1 << 4;
+
+        constexpr u32 MAX_OBJECTS_PER_LINE = 10;
+        constexpr u32 OAM_OBJECT_COUNT     = 40;
+
+        constexpr u8 gray_shade(u8 palette, u8 color_id) noexcept {
+            return DMG_SHADES[(palette >> (2 * color_id)) & 0b11].red;
+        }
+
+        // Color ID of the pixel (col, row) of the tile starting at the given VRAM offset.
+        u8 tile_color_id(u8 const* vram, u32 tile_addr, u32 row, u32 col) noexcept {
+            u8 const  lo  = vram[tile_addr + 2 * row];
+            u8 const  hi  = vram[tile_addr + 2 * row + 1];
+            u32 const bit = 7 - col;
+            return static_cast<u8>((((hi >> bit) & 1) << 1) | ((lo >> bit) & 1));
+        }
+
+        // VRAM offset of a background or window tile, taking the indexing mode into account.
+        u32 bg_tile_addr(u8 lcdc, u8 tile_idx) noexcept {
+            if ((lcdc & LCDC_TILE_SEL) != 0) {
+                return u32{tile_idx} * 16;
+            }
+            return static_cast<u32>(0x1000 + static_cast<i8>(tile_idx) * 16);
+        }
+
+        void render_line(
+            u8 const*             vram,
+            u8 const*             oam,
+            HwRegisterBank const& reg,
+            u8                    lcdc,
+            u32                   line,
+            u8*                   dst) noexcept {
+            // Background and window layers.
+            u8 bg_ids[LCD_WIDTH] = {};
+            if ((lcdc & LCDC_BG_EN) != 0) {
+                bool const window_line = ((lcdc & LCDC_WIN_EN) != 0) && (line >= reg.wy);
+                u32 const  bg_map      = ((lcdc & LCDC_BG_MAP) != 0) ? 0x1C00 : 0x1800;
+                u32 const  win_map     = ((lcdc & LCDC_WIN_MAP) != 0) ? 0x1C00 : 0x1800;
+
+                for (u32 x = 0; x < LCD_WIDTH; ++x) {
+                    u32 map_base;
+                    u32 px;
+                    u32 py;
+                    if (window_line && (x + 7 >= reg.wx)) {
+                        map_base = win_map;
+                        px       = x + 7 - reg.wx;
+                        py       = line - reg.wy;
+                    } else {
+                        map_base = bg_map;
+                        px       = (x + reg.scx) & 0xFF;
+                        py       = (line + reg.scy) & 0xFF;
+                    }
+
+                    u8 const tile_idx = vram[map_base + (py / 8) * 32 + (px / 8)];
+                    bg_ids[x] = tile_color_id(vram, bg_tile_addr(lcdc, tile_idx), py % 8, px % 8);
+                }
+
+                for (u32 x = 0; x < LCD_WIDTH; ++x) {
+                    dst[x] = gray_shade(reg.bgp, bg_ids[x]);
+                }
+            } else {
+                std::memset(dst, DMG_SHADES[0].red, LCD_WIDTH);
+            }
+
+            if ((lcdc & LCDC_OBJ_EN) == 0) {
+                return;
+            }
+
+            // Only the first 10 objects of each line are displayed.
+            i32 const obj_height = ((lcdc & LCDC_OBJ_SIZE) != 0) ? 16 : 8;
+            u8 const* objects[MAX_OBJECTS_PER_LINE];
+            u32       obj_count = 0;
+            i32 const y         = static_cast<i32>(line);
+            for (u32 idx = 0; idx < OAM_OBJECT_COUNT; ++idx) {
+                u8 const* obj   = oam + 4 * idx;
+                i32 const obj_y = i32{obj[0]} - 16;
+                if ((y >= obj_y) && (y < obj_y + obj_height)) {
+                    objects[obj_count++] = obj;
+                    if (obj_count == MAX_OBJECTS_PER_LINE) {
+                        break;
+                    }
+                }
+            }
+
+            // Among the overlapping objects, the one with the smallest x coordinate wins (DMG
+            // priority), ties being won by the first one in the OAM.
+            for (u32 x = 0; x < LCD_WIDTH; ++x) {
+                i32 best_x = 0xFFFF;
+                for (u32 idx = 0; idx < obj_count; ++idx) {
+                    u8 const* obj   = objects[idx];
+                    i32 const obj_y = i32{obj[0]} - 16;
+                    i32 const obj_x = i32{obj[1]} - 8;
+                    if ((static_cast<i32>(x) < obj_x) || (static_cast<i32>(x) >= obj_x + 8)
+                        || (obj_x + 8 >= best_x)) {
+                        continue;
+                    }
+
+                    u8 const flags    = obj[3];
+                    u8       tile_idx = obj[2];
+                    if (obj_height == 16) {
+                        tile_idx &= 0xFE;
+                    }
+
+                    u32 row = static_cast<u32>(y - obj_y);
+                    u32 col = static_cast<u32>(static_cast<i32>(x) - obj_x);
+                    if ((flags & OAM_Y_FLIP) != 0) {
+                        row = static_cast<u32>(obj_height) - 1 - row;
+                    }
+                    if ((flags & OAM_X_FLIP) != 0) {
+                        col = 7 - col;
+                    }
+
+                    u8 const color_id = tile_color_id(vram, u32{tile_idx} * 16, row, col);
+                    if (color_id == 0) {
+                        continue;  // Transparent.
+                    }
+
+                    // The winner hides any object it overlaps, even when the background hides it.
+                    best_x = obj_x + 8;
+                    if (((flags & OAM_PRIORITY) != 0) && (bg_ids[x] != 0)) {
+                        dst[x] = gray_shade(reg.bgp, bg_ids[x]);
+                        continue;  // Background colors 1-3 are drawn over the object.
+                    }
+
+                    u8 const obp = ((flags & OAM_PALETTE) != 0) ? reg.obp1 : reg.obp0;
+                    dst[x]       = gray_shade(obp, color_id);
+                }
+            }
+        }
+
+#if defined(MINA_GRAY_FRAME_NEON)
+        void min_pool_pixels(u8 const* frame_a, u8 const* frame_b, u8* dst, usize count) noexcept {
+            for (usize idx = 0; idx < count; idx += 16) {
+                vst1q_u8(dst + idx, vminq_u8(vld1q_u8(frame_a + idx), vld1q_u8(frame_b + idx)));
+            }
+        }
+
+        void downsample_rows(
+            u8 const* top,
+            u8 const* bottom,
+            u8*       dst,
+            usize     count) noexcept {
+            for (usize idx = 0; idx < count; idx += 16) {
+                // De-interleave the even and odd columns of 32 source pixels.
+                uint8x16x2_t const t     = vld2q_u8(top + 2 * idx);
+                uint8x16x2_t const b     = vld2q_u8(bottom + 2 * idx);
+                uint8x16_t const   left  = vrhaddq_u8(t.val[0], b.val[0]);
+                uint8x16_t const   right = vrhaddq_u8(t.val[1], b.val[1]);
+                vst1q_u8(dst + idx, vrhaddq_u8(left, right));
+            }
+        }
+#elif defined(MINA_GRAY_FRAME_SSE2)
+        void min_pool_pixels(u8 const* frame_a, u8 const* frame_b, u8* dst, usize count) noexcept {
+            for (usize idx = 0; idx < count; idx += 16) {
+                __m128i const a = _mm_loadu_si128(reinterpret_cast<__m128i const*>(frame_a + idx));
+                __m128i const b = _mm_loadu_si128(reinterpret_cast<__m128i const*>(frame_b + idx));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + idx), _mm_min_epu8(a, b));
+            }
+        }
+
+        // Average of the even and odd bytes of each 16-bit lane, widened to 16 bits.
+        inline __m128i average_pairs(__m128i v) noexcept {
+            __m128i const even = _mm_and_si128(v, _mm_set1_epi16(0x00FF));
+            __m128i const odd  = _mm_srli_epi16(v, 8);
+            return _mm_avg_epu16(even, odd);
+        }
+
+        void downsample_rows(
+            u8 const* top,
+            u8 const* bottom,
+            u8*       dst,
+            usize     count) noexcept {
+            for (usize idx = 0; idx < count; idx += 16) {
+                __m128i const* t = reinterpret_cast<__m128i const*>(top + 2 * idx);
+                __m128i const* b = reinterpret_cast<__m128i const*>(bottom + 2 * idx);
+
+                __m128i const lo  = _mm_avg_epu8(_mm_loadu_si128(t), _mm_loadu_si128(b));
+                __m128i const hi  = _mm_avg_epu8(_mm_loadu_si128(t + 1), _mm_loadu_si128(b + 1));
+                __m128i const res = _mm_packus_epi16(average_pairs(lo), average_pairs(hi));
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + idx), res);
+            }
+        }
+#else
+        void min_pool_pixels(u8 const* frame_a, u8 const* frame_b, u8* dst, usize count) noexcept {
+            for (usize idx = 0; idx < count; ++idx) {
+                dst[idx] = (frame_a[idx] < frame_b[idx]) ? frame_a[idx] : frame_b[idx];
+            }
+        }
+
+        constexpr u8 rounded_average(u8 a, u8 b) noexcept {
+            return static_cast<u8>((u32{a} + u32{b} + 1) >> 1);
+        }
+
+        // Downsample `count` destination pixels out of a pair of source rows.
+        void downsample_rows(
+            u8 const* top,
+            u8 const* bottom,
+            u8*       dst,
+            usize     count) noexcept {
+            for (usize idx = 0; idx < count; ++idx) {
+                u8 const left  = rounded_average(top[2 * idx], bottom[2 * idx]);
+                u8 const right = rounded_average(top[2 * idx + 1], bottom[2 * idx + 1]);
+                dst[idx]       = rounded_average(left, right);
+            }
+        }
+#endif
+
+        static_assert(GRAY_FRAME_SIZE % 16 == 0, "SIMD pooling assumes 16 pixel wide blocks");
+        static_assert(GRAY_HALF_WIDTH % 16 == 0, "SIMD downsampling assumes 16 pixel wide blocks");
+    }  // namespace
+
+    void render_gray_frame(MemoryMap const& mmap, u8* dst) noexcept {
+        HwRegisterBank const& reg = mmap.reg;
+
+        u8 lcdc;
+        std::memcpy(&lcdc, &reg.lcdc, sizeof(u8));
+        if ((lcdc & LCDC_LCD_EN) == 0) {
+            std::memset(dst, DMG_SHADES[0].red, GRAY_FRAME_SIZE);
+            return;
+        }
+
+        u8 const* vram = reinterpret_cast<u8 const*>(&mmap.vram);
+        u8 const* oam  = reinterpret_cast<u8 const*>(&mmap.sprite);
+        for (u32 line = 0; line < LCD_HEIGHT; ++line) {
+            render_line(vram, oam, reg, lcdc, line, dst + line * LCD_WIDTH);
+        }
+    }
+
+    void min_pool_gray_frames(u8 const* frame_a, u8 const* frame_b, u8* dst) noexcept {
+        min_pool_pixels(frame_a, frame_b, dst, GRAY_FRAME_SIZE);
+    }
+
+    void downsample_gray_frame(u8 const* src, u8* dst) noexcept {
+        for (u32 row = 0; row < GRAY_HALF_HEIGHT; ++row) {
+            u8 const* top = src + (2 * row) * LCD_WIDTH;
+            u8*       out = dst + row * GRAY_HALF_WIDTH;
+            downsample_rows(top, top + LCD_WIDTH, out, GRAY_HALF_WIDTH);
+        }
+    }
+}  // namespace mina
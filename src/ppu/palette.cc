@@ -0,0 +1,218 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the PPU pixel to host color conversion.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/ppu/palette.h>
+
+#include <psh/assert.h>
+#include <psh/intrinsics.h>
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#    define MINA_PALETTE_NEON
+#    include <arm_neon.h>
+#elif (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+// The SSSE3 path is compiled regardless of the target flags and selected at runtime.
+#    define MINA_PALETTE_SSSE3
+#    include <tmmintrin.h>
+#endif
+
+namespace mina {
+    namespace {
+        void set_dmg_palette(PaletteTable& table, u8 slot, u8 palette_reg) noexcept {
+            for (u8 color = 0; color < 4; ++color) {
+                u8 const shade_idx = static_cast<u8>((palette_reg >> (2 * color)) & 0b11);
+                u8 const entry     = static_cast<u8>((slot << 2) | color);
+
+                table.red[entry]   = DMG_SHADES[shade_idx].red;
+                table.green[entry] = DMG_SHADES[shade_idx].green;
+                table.blue[entry]  = DMG_SHADES[shade_idx].blue;
+                table.alpha[entry] = 0xFF;
+            }
+        }
+
+        void convert_pixels_scalar(
+            PaletteTable const& table,
+            u8 const*           pixel_ids,
+            u8*                 dst,
+            usize               count) noexcept {
+            for (usize idx = 0; idx < count; ++idx) {
+                u8 const entry = pixel_ids[idx] & (PaletteTable::ENTRY_COUNT - 1);
+
+                dst[4 * idx + 0] = table.red[entry];
+                dst[4 * idx + 1] = table.green[entry];
+                dst[4 * idx + 2] = table.blue[entry];
+                dst[4 * idx + 3] = table.alpha[entry];
+            }
+        }
+
+#if defined(MINA_PALETTE_NEON)
+        void convert_pixels_simd(
+            PaletteTable const& table,
+            u8 const*           pixel_ids,
+            u8*                 dst,
+            usize               count) noexcept {
+            uint8x16x4_t const red   = vld1q_u8_x4(table.red);
+            uint8x16x4_t const green = vld1q_u8_x4(table.green);
+            uint8x16x4_t const blue  = vld1q_u8_x4(table.blue);
+            uint8x16x4_t const alpha = vld1q_u8_x4(table.alpha);
+            uint8x16_t const   mask  = vdupq_n_u8(PaletteTable::ENTRY_COUNT - 1);
+
+            for (usize idx = 0; idx < count; idx += 16) {
+                uint8x16_t const ids = vandq_u8(vld1q_u8(pixel_ids + idx), mask);
+
+                // The 64 byte table lookup and the RGBA interleaving are both native in NEON.
+                uint8x16x4_t rgba;
+                rgba.val[0] = vqtbl4q_u8(red, ids);
+                rgba.val[1] = vqtbl4q_u8(green, ids);
+                rgba.val[2] = vqtbl4q_u8(blue, ids);
+                rgba.val[3] = vqtbl4q_u8(alpha, ids);
+                vst4q_u8(dst + 4 * idx, rgba);
+            }
+        }
+
+        bool has_simd_support() noexcept {
+            return true;
+        }
+#elif defined(MINA_PALETTE_SSSE3)
+        // Look up 16 entries of a 64 byte table plane, one 16 byte segment at a time.
+        __attribute__((target("ssse3"))) inline __m128i
+        lookup_plane(u8 const* plane, __m128i lo_nibbles, __m128i const segment_mask[4]) noexcept {
+            __m128i res = _mm_setzero_si128();
+            for (u32 seg = 0; seg < 4; ++seg) {
+                __m128i const seg_entries =
+                    _mm_load_si128(reinterpret_cast<__m128i const*>(plane + 16 * seg));
+                __m128i const looked_up = _mm_shuffle_epi8(seg_entries, lo_nibbles);
+                res = _mm_or_si128(res, _mm_and_si128(looked_up, segment_mask[seg]));
+            }
+            return res;
+        }
+
+        __attribute__((target("ssse3"))) void convert_pixels_simd(
+            PaletteTable const& table,
+            u8 const*           pixel_ids,
+            u8*                 dst,
+            usize               count) noexcept {
+            __m128i const nibble_mask = _mm_set1_epi8(0x0F);
+            __m128i const seg_bits    = _mm_set1_epi8(0x03);
+
+            for (usize idx = 0; idx < count; idx += 16) {
+                __m128i const ids =
+                    _mm_loadu_si128(reinterpret_cast<__m128i const*>(pixel_ids + idx));
+
+                // Split each ID into its table segment (upper bits) and the index within the
+                // segment (lower nibble).
+                __m128i const lo  = _mm_and_si128(ids, nibble_mask);
+                __m128i const seg = _mm_and_si128(_mm_srli_epi16(ids, 4), seg_bits);
+
+                __m128i const segment_mask[4] = {
+                    _mm_cmpeq_epi8(seg, _mm_set1_epi8(0)),
+                    _mm_cmpeq_epi8(seg, _mm_set1_epi8(1)),
+                    _mm_cmpeq_epi8(seg, _mm_set1_epi8(2)),
+                    _mm_cmpeq_epi8(seg, _mm_set1_epi8(3)),
+                };
+
+                __m128i const r = lookup_plane(table.red, lo, segment_mask);
+                __m128i const g = lookup_plane(table.green, lo, segment_mask);
+                __m128i const b = lookup_plane(table.blue, lo, segment_mask);
+                __m128i const a = lookup_plane(table.alpha, lo, segment_mask);
+
+                // Interleave the planes into RGBA pixels.
+                __m128i const rg_lo = _mm_unpacklo_epi8(r, g);
+                __m128i const rg_hi = _mm_unpackhi_epi8(r, g);
+                __m128i const ba_lo = _mm_unpacklo_epi8(b, a);
+                __m128i const ba_hi = _mm_unpackhi_epi8(b, a);
+
+                __m128i* out = reinterpret_cast<__m128i*>(dst + 4 * idx);
+                _mm_storeu_si128(out + 0, _mm_unpacklo_epi16(rg_lo, ba_lo));
+                _mm_storeu_si128(out + 1, _mm_unpackhi_epi16(rg_lo, ba_lo));
+                _mm_storeu_si128(out + 2, _mm_unpacklo_epi16(rg_hi, ba_hi));
+                _mm_storeu_si128(out + 3, _mm_unpackhi_epi16(rg_hi, ba_hi));
+            }
+        }
+
+        bool has_simd_support() noexcept {
+            static bool const supported = (__builtin_cpu_supports("ssse3") != 0);
+            return supported;
+        }
+#else
+        void convert_pixels_simd(
+            PaletteTable const& table,
+            u8 const*           pixel_ids,
+            u8*                 dst,
+            usize               count) noexcept {
+            convert_pixels_scalar(table, pixel_ids, dst, count);
+        }
+
+        bool has_simd_support() noexcept {
+            return false;
+        }
+#endif
+
+        static_assert(LCD_WIDTH % 16 == 0, "SIMD conversion assumes 16 pixel wide blocks");
+    }  // namespace
+
+    bool update_dmg_palette_table(PaletteTable& table, HwRegisterBank const& reg) noexcept {
+        bool const unchanged = table.dmg_valid && (table.bgp == reg.bgp) &&
+                               (table.obp0 == reg.obp0) && (table.obp1 == reg.obp1);
+        if (unchanged) {
+            return false;
+        }
+
+        set_dmg_palette(table, DMG_BG_PALETTE_SLOT, reg.bgp);
+        set_dmg_palette(table, DMG_OBJ0_PALETTE_SLOT, reg.obp0);
+        set_dmg_palette(table, DMG_OBJ1_PALETTE_SLOT, reg.obp1);
+
+        table.bgp       = reg.bgp;
+        table.obp0      = reg.obp0;
+        table.obp1      = reg.obp1;
+        table.dmg_valid = true;
+        return true;
+    }
+
+    void set_cgb_palette(PaletteTable& table, u8 slot, u8 const* palette_data) noexcept {
+        psh_assert_msg(slot < PALETTE_SLOT_COUNT, "Invalid palette slot");
+
+        for (u8 color = 0; color < 4; ++color) {
+            u16 const rgb555 = static_cast<u16>(
+                palette_data[2 * color] | (palette_data[2 * color + 1] << 8));
+            u8 const r5 = static_cast<u8>(rgb555 & 0x1F);
+            u8 const g5 = static_cast<u8>((rgb555 >> 5) & 0x1F);
+            u8 const b5 = static_cast<u8>((rgb555 >> 10) & 0x1F);
+
+            // Expand the 5-bit channels to 8 bits by replicating the upper bits.
+            u8 const entry     = static_cast<u8>((slot << 2) | color);
+            table.red[entry]   = static_cast<u8>((r5 << 3) | (r5 >> 2));
+            table.green[entry] = static_cast<u8>((g5 << 3) | (g5 >> 2));
+            table.blue[entry]  = static_cast<u8>((b5 << 3) | (b5 >> 2));
+            table.alpha[entry] = 0xFF;
+        }
+
+        // Any CGB write invalidates the DMG snapshot since they share the table entries.
+        table.dmg_valid = false;
+    }
+
+    void convert_scanline(PaletteTable const& table, u8 const* pixel_ids, u8* dst) noexcept {
+        if (psh_likely(has_simd_support())) {
+            convert_pixels_simd(table, pixel_ids, dst, LCD_WIDTH);
+        } else {
+            convert_pixels_scalar(table, pixel_ids, dst, LCD_WIDTH);
+        }
+    }
+}  // namespace mina
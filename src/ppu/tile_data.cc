@@ -0,0 +1,57 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the video memory snapshots for the GPU tile renderer.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/ppu/tile_data.h>
+
+#include <psh/assert.h>
+#include <cstddef>
+#include <cstring>
+
+namespace mina {
+    // The shader reads the buffer with the `std430` layout, make sure we match it exactly.
+    static_assert(offsetof(TileRendererInput, vram) == 0x0000);
+    static_assert(offsetof(TileRendererInput, oam) == 0x2000);
+    static_assert(offsetof(TileRendererInput, lines) == 0x20A0);
+    static_assert(sizeof(LineRegisters) == 8);
+    static_assert(sizeof(TileRendererInput) == 0x20A0 + LCD_HEIGHT * sizeof(LineRegisters));
+
+    void snapshot_video_memory(TileRendererInput& input, MemoryMap const& mmap) noexcept {
+        std::memcpy(&input.vram, &mmap.vram, sizeof(VideoRAM));
+        std::memcpy(&input.oam, &mmap.sprite, sizeof(SpriteOAM));
+    }
+
+    void snapshot_line_registers(
+        TileRendererInput&    input,
+        HwRegisterBank const& reg,
+        u32                   line) noexcept {
+        psh_assert_msg(line < LCD_HEIGHT, "Line out of the LCD bounds");
+
+        LineRegisters& regs = input.lines[line];
+        std::memcpy(&regs.lcdc, &reg.lcdc, sizeof(u8));
+        regs.scy  = reg.scy;
+        regs.scx  = reg.scx;
+        regs.wy   = reg.wy;
+        regs.wx   = reg.wx;
+        regs.bgp  = reg.bgp;
+        regs.obp0 = reg.obp0;
+        regs.obp1 = reg.obp1;
+    }
+}  // namespace mina
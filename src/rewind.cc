@@ -0,0 +1,375 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the rewind buffer and its delta codec.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/rewind.h>
+
+#include <psh/assert.h>
+#include <bit>
+#include <cstring>
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#    define MINA_REWIND_NEON
+#    include <arm_neon.h>
+#elif defined(__SSE2__)
+#    define MINA_REWIND_SSE2
+#    include <emmintrin.h>
+#endif
+
+namespace mina {
+    namespace {
+        /// Shortest run of equal bytes breaking a run of distinct bytes. Shorter runs cost less
+        /// as part of the distinct run than as a pair of run lengths.
+        constexpr usize MIN_EQUAL_RUN = 8;
+
+        /// Bit mask of the bytes of a 16 byte block that are equal in both buffers, the bit `n`
+        /// corresponding to the byte `n` (NEON uses 4 bits per byte).
+#if defined(MINA_REWIND_NEON)
+        constexpr u32 MASK_BITS_PER_BYTE = 4;
+
+        inline u64 equal_mask(u8 const* a, u8 const* b) noexcept {
+            uint8x16_t const eq     = vceqq_u8(vld1q_u8(a), vld1q_u8(b));
+            uint8x8_t const  narrow = vshrn_n_u16(vreinterpretq_u16_u8(eq), 4);
+            return vget_lane_u64(vreinterpret_u64_u8(narrow), 0);
+        }
+
+        constexpr u64 ALL_EQUAL_MASK = ~u64{0};
+#elif defined(MINA_REWIND_SSE2)
+        constexpr u32 MASK_BITS_PER_BYTE = 1;
+
+        inline u64 equal_mask(u8 const* a, u8 const* b) noexcept {
+            __m128i const va = _mm_loadu_si128(reinterpret_cast<__m128i const*>(a));
+            __m128i const vb = _mm_loadu_si128(reinterpret_cast<__m128i const*>(b));
+            return static_cast<u64>(_mm_movemask_epi8(_mm_cmpeq_epi8(va, vb)));
+        }
+
+        constexpr u64 ALL_EQUAL_MASK = 0xFFFF;
+#else
+        constexpr u32 MASK_BITS_PER_BYTE = 1;
+
+        inline u64 equal_mask(u8 const* a, u8 const* b) noexcept {
+            u64 mask = 0;
+            for (u32 idx = 0; idx < 16; ++idx) {
+                mask |= static_cast<u64>(a[idx] == b[idx]) << idx;
+            }
+            return mask;
+        }
+
+        constexpr u64 ALL_EQUAL_MASK = 0xFFFF;
+#endif
+
+        /// First position, starting at `pos`, where the buffers differ (`want_equal == false`) or
+        /// match (`want_equal == true`). Returns `size` if there's none.
+        usize find_first(
+            u8 const* a,
+            u8 const* b,
+            usize     pos,
+            usize     size,
+            bool      want_equal) noexcept {
+            for (; pos + 16 <= size; pos += 16) {
+                u64 const mask = want_equal ? equal_mask(a + pos, b + pos)
+                                            : (equal_mask(a + pos, b + pos) ^ ALL_EQUAL_MASK);
+                if (mask != 0) {
+                    return pos + static_cast<usize>(std::countr_zero(mask)) / MASK_BITS_PER_BYTE;
+                }
+            }
+            for (; pos < size; ++pos) {
+                if ((a[pos] == b[pos]) == want_equal) {
+                    return pos;
+                }
+            }
+            return size;
+        }
+
+        u8* write_leb128(u8* dst, usize value) noexcept {
+            do {
+                u8 const low = static_cast<u8>(value & 0x7F);
+                value >>= 7;
+                *dst++ = (value != 0) ? static_cast<u8>(low | 0x80) : low;
+            } while (value != 0);
+            return dst;
+        }
+
+        /// Read a value from the bytes before `end`, returning null if the value is truncated or
+        /// doesn't fit in a `usize`.
+        u8 const* read_leb128(u8 const* src, u8 const* end, usize& value) noexcept {
+            constexpr u32 VALUE_BITS = 8 * sizeof(usize);
+
+            value = 0;
+            for (u32 shift = 0; shift < VALUE_BITS; shift += 7) {
+                if (src == end) {
+                    return nullptr;
+                }
+
+                u8 const    byte = *src++;
+                usize const bits = byte & 0x7F;
+                if ((shift + 7 > VALUE_BITS) && ((bits >> (VALUE_BITS - shift)) != 0)) {
+                    return nullptr;
+                }
+
+                value |= bits << shift;
+                if ((byte & 0x80) == 0) {
+                    return src;
+                }
+            }
+            return nullptr;
+        }
+
+        RewindEntry& entry_at(RewindBuffer& rewind, u32 idx) noexcept {
+            return rewind.entries[(rewind.first_entry + idx) % rewind.max_entries];
+        }
+
+        void drop_first_entry(RewindBuffer& rewind) noexcept {
+            rewind.first_entry = (rewind.first_entry + 1) % rewind.max_entries;
+            rewind.entry_count -= 1;
+        }
+
+        /// Drop the oldest keyframe along with the deltas that depend on it.
+        void drop_oldest_keyframe(RewindBuffer& rewind) noexcept {
+            drop_first_entry(rewind);
+            while ((rewind.entry_count != 0) && !entry_at(rewind, 0).keyframe) {
+                drop_first_entry(rewind);
+            }
+        }
+
+        /// Find room for an encoded state of a given size, dropping the oldest states in the way.
+        /// Returns the offset of the room in the buffer data.
+        usize make_room(RewindBuffer& rewind, usize size) noexcept {
+            psh_assert_msg(size <= rewind.data_size, "Rewind buffer too small for a single state");
+
+            if (rewind.data_head + size > rewind.data_size) {
+                rewind.data_head = 0;
+            }
+            usize const start = rewind.data_head;
+            usize const end   = start + size;
+
+            if (rewind.entry_count == rewind.max_entries) {
+                drop_oldest_keyframe(rewind);
+            }
+            while (rewind.entry_count != 0) {
+                RewindEntry const& oldest = entry_at(rewind, 0);
+                if ((oldest.offset >= end) || (start >= oldest.offset + oldest.size)) {
+                    break;
+                }
+                drop_oldest_keyframe(rewind);
+            }
+            return start;
+        }
+
+        u8 const* state_bytes(SaveState const* state) noexcept {
+            return reinterpret_cast<u8 const*>(state);
+        }
+
+        bool decode_entry(
+            RewindBuffer const& rewind,
+            RewindEntry const&  entry,
+            SaveState const*    reference,
+            SaveState*          dst) noexcept {
+            return decode_xor_delta(
+                rewind.data + entry.offset,
+                entry.size,
+                state_bytes(reference),
+                sizeof(SaveState),
+                reinterpret_cast<u8*>(dst));
+        }
+    }  // namespace
+
+    usize encode_xor_delta(u8 const* src, u8 const* reference, usize size, u8* dst) noexcept {
+        u8* const start = dst;
+
+        usize pos = 0;
+        while (pos < size) {
+            usize const distinct_start = find_first(src, reference, pos, size, false);
+
+            // Extend the run of distinct bytes until a long enough run of equal bytes is found.
+            usize distinct_end = distinct_start;
+            while (distinct_end < size) {
+                usize const equal_start = find_first(src, reference, distinct_end, size, true);
+                usize const equal_end   = find_first(src, reference, equal_start, size, false);
+                distinct_end            = equal_start;
+                if ((equal_end - equal_start >= MIN_EQUAL_RUN) || (equal_end == size)) {
+                    break;
+                }
+                distinct_end = equal_end;
+            }
+
+            dst = write_leb128(dst, distinct_start - pos);
+            dst = write_leb128(dst, distinct_end - distinct_start);
+            for (usize idx = distinct_start; idx < distinct_end; ++idx) {
+                *dst++ = static_cast<u8>(src[idx] ^ reference[idx]);
+            }
+            pos = distinct_end;
+        }
+
+        return static_cast<usize>(dst - start);
+    }
+
+    bool decode_xor_delta(
+        u8 const* delta,
+        usize     delta_size,
+        u8 const* reference,
+        usize     size,
+        u8*       dst) noexcept {
+        if (dst != reference) {
+            std::memcpy(dst, reference, size);
+        }
+
+        u8 const* const end = delta + delta_size;
+        usize           pos = 0;
+        while (delta < end) {
+            usize equal_count;
+            usize distinct_count;
+            delta = read_leb128(delta, end, equal_count);
+            if (delta == nullptr) {
+                return false;
+            }
+            delta = read_leb128(delta, end, distinct_count);
+            if (delta == nullptr) {
+                return false;
+            }
+
+            // Runs may neither go past the end of the bytes nor past the end of the delta.
+            if ((equal_count > size - pos) || (distinct_count > size - pos - equal_count)
+                || (distinct_count > static_cast<usize>(end - delta))) {
+                return false;
+            }
+            pos += equal_count;
+
+            for (usize idx = 0; idx < distinct_count; ++idx) {
+                dst[pos + idx] ^= delta[idx];
+            }
+            delta += distinct_count;
+            pos += distinct_count;
+        }
+        return true;
+    }
+
+    void init_rewind(
+        RewindBuffer&       rewind,
+        psh::Arena*         arena,
+        Core const&         core,
+        RewindConfig const& config) noexcept {
+        psh_assert_msg(config.max_entries != 0, "A rewind buffer needs room for some states");
+
+        rewind                   = {};
+        rewind.data_size         = config.buffer_size;
+        rewind.data              = arena->zero_alloc<u8>(config.buffer_size);
+        rewind.max_entries       = config.max_entries;
+        rewind.entries           = arena->zero_alloc<RewindEntry>(config.max_entries);
+        rewind.keyframe_interval = (config.keyframe_interval != 0) ? config.keyframe_interval : 1;
+        rewind.base              = arena->zero_alloc<SaveState>(1);
+        rewind.keyframe          = arena->zero_alloc<SaveState>(1);
+        rewind.scratch           = arena->zero_alloc<SaveState>(1);
+        rewind.encoded           = arena->zero_alloc<u8>(max_xor_delta_size(sizeof(SaveState)));
+        psh_assert_msg(rewind.encoded != nullptr, "Rewind arena too small");
+
+        save_state(core, *rewind.base);
+    }
+
+    void record_rewind_state(RewindBuffer& rewind, Core const& core) noexcept {
+        save_state(core, *rewind.scratch);
+
+        bool keyframe =
+            (rewind.entry_count == 0) || (rewind.since_keyframe + 1 >= rewind.keyframe_interval);
+        usize size   = 0;
+        usize offset = 0;
+        for (;;) {
+            SaveState const* reference = keyframe ? rewind.base : rewind.keyframe;
+            size                       = encode_xor_delta(
+                state_bytes(rewind.scratch),
+                state_bytes(reference),
+                sizeof(SaveState),
+                rewind.encoded);
+            offset = make_room(rewind, size);
+
+            // Making room may have dropped the keyframe of the delta, which then has to be a
+            // keyframe itself.
+            if (keyframe || (rewind.entry_count != 0)) {
+                break;
+            }
+            keyframe = true;
+        }
+
+        std::memcpy(rewind.data + offset, rewind.encoded, size);
+        rewind.data_head = offset + size;
+
+        entry_at(rewind, rewind.entry_count) = RewindEntry{
+            .offset   = offset,
+            .size     = static_cast<u32>(size),
+            .keyframe = keyframe,
+        };
+        rewind.entry_count += 1;
+
+        if (keyframe) {
+            std::memcpy(rewind.keyframe, rewind.scratch, sizeof(SaveState));
+            rewind.since_keyframe = 0;
+        } else {
+            rewind.since_keyframe += 1;
+        }
+
+        rewind.encoded_bytes += size;
+        rewind.recorded_count += 1;
+    }
+
+    bool rewind_core(RewindBuffer& rewind, Core& core, u32 steps) noexcept {
+        if ((steps >= rewind.entry_count) || (rewind.base->header.cart_hash != core.cart_hash)) {
+            return false;
+        }
+
+        u32 const   target_idx = rewind.entry_count - 1 - steps;
+        RewindEntry target     = entry_at(rewind, target_idx);
+
+        u32 keyframe_idx = target_idx;
+        while (!entry_at(rewind, keyframe_idx).keyframe) {
+            psh_assert_msg(keyframe_idx != 0, "Rewind delta without a keyframe");
+            keyframe_idx -= 1;
+        }
+
+        // The latest keyframe gets overwritten, so a state that fails to decode leaves nothing
+        // that further states could be recorded against.
+        bool decoded =
+            decode_entry(rewind, entry_at(rewind, keyframe_idx), rewind.base, rewind.keyframe);
+        SaveState const* state = rewind.keyframe;
+        if (decoded && !target.keyframe) {
+            decoded = decode_entry(rewind, target, rewind.keyframe, rewind.scratch);
+            state   = rewind.scratch;
+        }
+        if (!decoded) {
+            clear_rewind(rewind);
+            return false;
+        }
+
+        // The states were saved by the buffer itself from a core of the same cartridge.
+        psh_discard(load_state(core, *state));
+
+        // Recording resumes right after the restored state.
+        rewind.entry_count    = target_idx + 1;
+        rewind.data_head      = target.offset + target.size;
+        rewind.since_keyframe = target_idx - keyframe_idx;
+        return true;
+    }
+
+    void clear_rewind(RewindBuffer& rewind) noexcept {
+        rewind.first_entry    = 0;
+        rewind.entry_count    = 0;
+        rewind.data_head      = 0;
+        rewind.since_keyframe = 0;
+    }
+}  // namespace mina
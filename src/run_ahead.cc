@@ -0,0 +1,109 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Implementation of the run-ahead of the emulation core.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/run_ahead.h>
+
+#include <psh/assert.h>
+#include <chrono>
+
+namespace mina {
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        f64 seconds_between(Clock::time_point start, Clock::time_point end) noexcept {
+            return std::chrono::duration<f64>(end - start).count();
+        }
+    }  // namespace
+
+    void init_run_ahead(RunAhead& run_ahead, psh::Arena* arena, u32 frames) noexcept {
+        run_ahead.frames = (frames < MAX_RUN_AHEAD_FRAMES) ? frames : MAX_RUN_AHEAD_FRAMES;
+        run_ahead.stats  = {};
+        if (run_ahead.frames == 0) {
+            return;
+        }
+
+        run_ahead.state  = arena->zero_alloc<SaveState>(1);
+        run_ahead.shadow = arena->zero_alloc<Core>(1);
+        psh_assert_msg(
+            (run_ahead.state != nullptr) && (run_ahead.shadow != nullptr),
+            "Not enough memory for the run-ahead state");
+    }
+
+    Core const& run_ahead_frame(RunAhead& run_ahead, Core& core) noexcept {
+        RunAheadStats& stats = run_ahead.stats;
+
+        auto const frame_start = Clock::now();
+        run_core_frame(core);
+        auto const frame_end = Clock::now();
+
+        stats.frame_seconds += seconds_between(frame_start, frame_end);
+        ++stats.host_frame_count;
+
+        if (run_ahead.frames == 0) {
+            f64 const host_seconds = seconds_between(frame_start, frame_end);
+            stats.max_host_seconds = psh_max(stats.max_host_seconds, host_seconds);
+            return core;
+        }
+
+        Core& shadow = *run_ahead.shadow;
+
+        save_state(core, *run_ahead.state);
+        auto const save_end = Clock::now();
+
+        // The shadow shares the cartridge of the core, so the state can't be rejected.
+        shadow.cart      = core.cart;
+        shadow.cart_hash = core.cart_hash;
+        shadow.buttons   = core.buttons;
+        psh_discard(load_state(shadow, *run_ahead.state));
+        auto const restore_end = Clock::now();
+
+        for (u32 idx = 0; idx < run_ahead.frames; ++idx) {
+            run_core_frame(shadow);
+        }
+        auto const ahead_end = Clock::now();
+
+        stats.save_seconds += seconds_between(frame_end, save_end);
+        stats.restore_seconds += seconds_between(save_end, restore_end);
+        stats.ahead_seconds += seconds_between(restore_end, ahead_end);
+        stats.max_host_seconds = psh_max(
+            stats.max_host_seconds,
+            seconds_between(frame_start, ahead_end));
+
+        return shadow;
+    }
+
+    RunAheadStats mean_run_ahead_stats(RunAheadStats const& stats) noexcept {
+        if (stats.host_frame_count == 0) {
+            return stats;
+        }
+
+        f64 const count = static_cast<f64>(stats.host_frame_count);
+        return RunAheadStats{
+            .host_frame_count = stats.host_frame_count,
+            .frame_seconds    = stats.frame_seconds / count,
+            .save_seconds     = stats.save_seconds / count,
+            .restore_seconds  = stats.restore_seconds / count,
+            .ahead_seconds    = stats.ahead_seconds / count,
+            .max_host_seconds = stats.max_host_seconds,
+        };
+    }
+}  // namespace mina
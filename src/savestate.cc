@@ -0,0 +1,173 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Implementation of the core savestates.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/savestate.h>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#if defined(__unix__) || defined(__APPLE__)
+#    define MINA_SAVESTATE_MMAP
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace mina {
+    static_assert(sizeof(SaveStateHeader) == 24);
+    static_assert(offsetof(SaveState, regfile) == 24);
+    static_assert(offsetof(SaveState, memory) % 64 == 0);
+    static_assert(sizeof(MemoryMap) == 0x10000, "The memory image should span the address space");
+
+    namespace {
+        // Copy a field of the blob, which may not be aligned, to its destination.
+#define copy_from_blob(dst, blob, field)         \
+    std::memcpy(                                 \
+        reinterpret_cast<u8*>(&(dst)),           \
+        (blob).buf + offsetof(SaveState, field), \
+        sizeof(SaveState::field))
+    }  // namespace
+
+    SaveStateStatus validate_state(psh::FatPtr<u8 const> blob, u64 cart_hash) noexcept {
+        if (blob.size < sizeof(SaveStateHeader)) {
+            return SaveStateStatus::INVALID_SIZE;
+        }
+
+        SaveStateHeader header;
+        std::memcpy(&header, blob.buf, sizeof(SaveStateHeader));
+        if (header.magic != SAVESTATE_MAGIC) {
+            return SaveStateStatus::INVALID_MAGIC;
+        }
+        if (header.version != SAVESTATE_VERSION) {
+            return SaveStateStatus::INVALID_VERSION;
+        }
+        if ((header.size != sizeof(SaveState)) || (blob.size < header.size)) {
+            return SaveStateStatus::INVALID_SIZE;
+        }
+        if (header.cart_hash != cart_hash) {
+            return SaveStateStatus::WRONG_CARTRIDGE;
+        }
+        return SaveStateStatus::OK;
+    }
+
+    void save_state(Core const& core, SaveState& state) noexcept {
+        state.header = SaveStateHeader{
+            .magic     = SAVESTATE_MAGIC,
+            .version   = SAVESTATE_VERSION,
+            .size      = sizeof(SaveState),
+            .reserved_ = 0,
+            .cart_hash = core.cart_hash,
+        };
+
+        state.regfile     = core.cpu.regfile;
+        state.bus_addr    = core.cpu.bus_addr;
+        state.clock       = core.cpu.clock;
+        state.buttons     = core.buttons;
+        state.cycle_count = core.cycle_count;
+        state.frame_count = core.frame_count;
+        std::memcpy(state.memory, &core.cpu.mmap, sizeof(MemoryMap));
+    }
+
+    SaveStateStatus load_state(Core& core, psh::FatPtr<u8 const> blob) noexcept {
+        SaveStateStatus const status = validate_state(blob, core.cart_hash);
+        if (status != SaveStateStatus::OK) {
+            return status;
+        }
+
+        copy_from_blob(core.cpu.regfile, blob, regfile);
+        copy_from_blob(core.cpu.bus_addr, blob, bus_addr);
+        copy_from_blob(core.cpu.clock, blob, clock);
+        copy_from_blob(core.buttons, blob, buttons);
+        copy_from_blob(core.cycle_count, blob, cycle_count);
+        copy_from_blob(core.frame_count, blob, frame_count);
+        copy_from_blob(core.cpu.mmap, blob, memory);
+        core.cpu.dirty_pages = ~u64{0};
+        set_cpu_buttons(core.cpu, core.buttons);
+        return SaveStateStatus::OK;
+    }
+
+    SaveStateStatus load_state(Core& core, SaveState const& state) noexcept {
+        return load_state(core, {reinterpret_cast<u8 const*>(&state), sizeof(SaveState)});
+    }
+
+    SaveStateStatus write_state_file(SaveState const& state, psh::StringView path) noexcept {
+        FILE* file = std::fopen(path.data.buf, "wb");
+        if (file == nullptr) {
+            return SaveStateStatus::FAILED_TO_OPEN;
+        }
+
+        usize const written = std::fwrite(&state, 1, sizeof(SaveState), file);
+        bool const  closed  = (std::fclose(file) == 0);
+        return ((written == sizeof(SaveState)) && closed) ? SaveStateStatus::OK
+                                                          : SaveStateStatus::FAILED_TO_WRITE;
+    }
+
+    SaveStateStatus load_state_file(Core& core, psh::Arena* arena, psh::StringView path) noexcept {
+#if defined(MINA_SAVESTATE_MMAP)
+        psh_discard(arena);
+
+        int const fd = open(path.data.buf, O_RDONLY);
+        if (fd < 0) {
+            return SaveStateStatus::FAILED_TO_OPEN;
+        }
+
+        struct stat file_info;
+        if (fstat(fd, &file_info) != 0) {
+            close(fd);
+            return SaveStateStatus::FAILED_TO_OPEN;
+        }
+        usize const size = static_cast<usize>(file_info.st_size);
+        if (size < sizeof(SaveStateHeader)) {
+            close(fd);
+            return SaveStateStatus::INVALID_SIZE;
+        }
+
+        // The mapping outlives the descriptor, and pages are only read in as they're copied.
+        void* const mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) {
+            return SaveStateStatus::FAILED_TO_OPEN;
+        }
+
+        SaveStateStatus const status = load_state(core, {static_cast<u8 const*>(mapping), size});
+        munmap(mapping, size);
+        return status;
+#else
+        FILE* file = std::fopen(path.data.buf, "rb");
+        if (file == nullptr) {
+            return SaveStateStatus::FAILED_TO_OPEN;
+        }
+
+        psh::ScratchArena sarena = arena->make_scratch();
+        SaveState* const  state  = sarena.arena->zero_alloc<SaveState>(1);
+        if (state == nullptr) {
+            std::fclose(file);
+            return SaveStateStatus::OUT_OF_MEMORY;
+        }
+
+        usize const read_size = std::fread(state, 1, sizeof(SaveState), file);
+        std::fclose(file);
+        return load_state(core, {reinterpret_cast<u8 const*>(state), read_size});
+#endif
+    }
+}  // namespace mina
@@ -0,0 +1,10 @@
+#version 460
+
+// Texture coordinates of the LCD, (0, 0) being the top-left corner of the screen.
+layout(location = 0) out vec2 lcd_uv;
+
+void main() {
+    // A single triangle covering the whole viewport, with vertices (-1, -1), (3, -1) and (-1, 3).
+    lcd_uv      = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+    gl_Position = vec4(lcd_uv * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,13 @@
+#version 460
+
+// Compose the uploaded LCD frame into the native target. Being drawn at the resolution of the
+// LCD, this is where any post-processing of the frame should take place.
+
+layout(set = 0, binding = 0) uniform sampler2D lcd;
+
+layout(location = 0) in vec2  lcd_uv;
+layout(location = 0) out vec4 res_col;
+
+void main() {
+    res_col = vec4(texture(lcd, lcd_uv).rgb, 1.0);
+}
@@ -0,0 +1,19 @@
+#version 460
+
+// Compose the LCD frame read in place from the staging ring, used when the ring lives in memory
+// that is both visible to the host and local to the device. The native target has the exact
+// resolution of the LCD, so each fragment reads a single pixel.
+
+const uint LCD_WIDTH = 160;
+
+layout(std430, set = 0, binding = 0) readonly buffer LcdFrame {
+    uint pixels[];  // Packed RGBA8, as written by the palette conversion.
+} lcd;
+
+layout(location = 0) in vec2  lcd_uv;
+layout(location = 0) out vec4 res_col;
+
+void main() {
+    uvec2 pos = uvec2(gl_FragCoord.xy);
+    res_col   = vec4(unpackUnorm4x8(lcd.pixels[pos.y * LCD_WIDTH + pos.x]).rgb, 1.0);
+}
@@ -0,0 +1,162 @@
+#version 460
+
+// Compose the Game Boy screen directly from the raw video memory.
+//
+// The storage buffer layout mirrors `mina::TileRendererInput`: the 8 KiB of VRAM, the 160 bytes
+// of OAM and one set of PPU registers per line. Bytes are packed 4 by 4 into each uint.
+
+const uint LCD_WIDTH  = 160;
+const uint LCD_HEIGHT = 144;
+
+const uint LCDC_BG_EN     = 1u << 0;
+const uint LCDC_OBJ_EN    = 1u << 1;
+const uint LCDC_OBJ_SIZE  = 1u << 2;
+const uint LCDC_BG_MAP    = 1u << 3;
+const uint LCDC_TILE_SEL  = 1u << 4;
+const uint LCDC_WIN_EN    = 1u << 5;
+const uint LCDC_WIN_MAP   = 1u << 6;
+const uint LCDC_LCD_EN    = 1u << 7;
+
+const uint OAM_PRIORITY = 1u << 7;
+const uint OAM_Y_FLIP   = 1u << 6;
+const uint OAM_X_FLIP   = 1u << 5;
+const uint OAM_PALETTE  = 1u << 4;
+
+layout(std430, set = 0, binding = 0) readonly buffer TileRendererInput {
+    uint  vram[2048];
+    uint  oam[40];
+    uvec2 lines[LCD_HEIGHT];
+} src;
+
+layout(location = 0) in vec2  lcd_uv;
+layout(location = 0) out vec4 res_col;
+
+uint vram_byte(uint addr) {
+    return (src.vram[addr >> 2] >> ((addr & 3u) * 8u)) & 0xFFu;
+}
+
+uint oam_byte(uint addr) {
+    return (src.oam[addr >> 2] >> ((addr & 3u) * 8u)) & 0xFFu;
+}
+
+// Register order: lcdc, scy, scx, wy, wx, bgp, obp0, obp1.
+uint line_reg(uint line, uint reg) {
+    uint word = (reg < 4u) ? src.lines[line].x : src.lines[line].y;
+    return (word >> ((reg & 3u) * 8u)) & 0xFFu;
+}
+
+// Color ID of the pixel (col, row) of the tile starting at the given VRAM offset.
+uint tile_color_id(uint tile_addr, uint row, uint col) {
+    uint lo  = vram_byte(tile_addr + 2u * row);
+    uint hi  = vram_byte(tile_addr + 2u * row + 1u);
+    uint bit = 7u - col;
+    return (((hi >> bit) & 1u) << 1) | ((lo >> bit) & 1u);
+}
+
+// VRAM offset of a background or window tile, taking the indexing mode into account.
+uint bg_tile_addr(uint lcdc, uint tile_idx) {
+    if ((lcdc & LCDC_TILE_SEL) != 0u) {
+        return tile_idx * 16u;
+    }
+    int signed_idx = int(tile_idx << 24) >> 24;
+    return uint(0x1000 + signed_idx * 16);
+}
+
+uint palette_shade(uint palette, uint color_id) {
+    return (palette >> (2u * color_id)) & 3u;
+}
+
+void main() {
+    uint x    = min(uint(lcd_uv.x * float(LCD_WIDTH)), LCD_WIDTH - 1u);
+    uint line = min(uint(lcd_uv.y * float(LCD_HEIGHT)), LCD_HEIGHT - 1u);
+
+    uint lcdc = line_reg(line, 0u);
+    uint scy  = line_reg(line, 1u);
+    uint scx  = line_reg(line, 2u);
+    uint wy   = line_reg(line, 3u);
+    uint wx   = line_reg(line, 4u);
+    uint bgp  = line_reg(line, 5u);
+
+    uint shade = 0u;
+    if ((lcdc & LCDC_LCD_EN) == 0u) {
+        res_col = vec4(1.0);
+        return;
+    }
+
+    // Background and window layers.
+    uint bg_color_id = 0u;
+    if ((lcdc & LCDC_BG_EN) != 0u) {
+        bool in_window = ((lcdc & LCDC_WIN_EN) != 0u) && (line >= wy) && (x + 7u >= wx);
+
+        uint map_base;
+        uint px;
+        uint py;
+        if (in_window) {
+            map_base = ((lcdc & LCDC_WIN_MAP) != 0u) ? 0x1C00u : 0x1800u;
+            px       = x + 7u - wx;
+            py       = line - wy;
+        } else {
+            map_base = ((lcdc & LCDC_BG_MAP) != 0u) ? 0x1C00u : 0x1800u;
+            px       = (x + scx) & 0xFFu;
+            py       = (line + scy) & 0xFFu;
+        }
+
+        uint tile_idx = vram_byte(map_base + (py / 8u) * 32u + (px / 8u));
+        bg_color_id   = tile_color_id(bg_tile_addr(lcdc, tile_idx), py % 8u, px % 8u);
+        shade         = palette_shade(bgp, bg_color_id);
+    }
+    uint bg_shade = shade;
+
+    // Object layer. Only the first 10 objects of each line are displayed, and among the
+    // overlapping ones the one with the smallest x coordinate wins (DMG priority).
+    if ((lcdc & LCDC_OBJ_EN) != 0u) {
+        uint obj_height = ((lcdc & LCDC_OBJ_SIZE) != 0u) ? 16u : 8u;
+        uint obj_count  = 0u;
+        uint best_x     = 0xFFFFu;
+
+        for (uint i = 0u; i < 40u && obj_count < 10u; ++i) {
+            int obj_y = int(oam_byte(4u * i)) - 16;
+            int obj_x = int(oam_byte(4u * i + 1u)) - 8;
+            if (int(line) < obj_y || int(line) >= obj_y + int(obj_height)) {
+                continue;
+            }
+            ++obj_count;
+
+            if (int(x) < obj_x || int(x) >= obj_x + 8 || uint(obj_x + 8) >= best_x) {
+                continue;
+            }
+
+            uint flags    = oam_byte(4u * i + 3u);
+            uint tile_idx = oam_byte(4u * i + 2u);
+            if (obj_height == 16u) {
+                tile_idx &= 0xFEu;
+            }
+
+            uint row = uint(int(line) - obj_y);
+            uint col = uint(int(x) - obj_x);
+            if ((flags & OAM_Y_FLIP) != 0u) {
+                row = obj_height - 1u - row;
+            }
+            if ((flags & OAM_X_FLIP) != 0u) {
+                col = 7u - col;
+            }
+
+            uint color_id = tile_color_id(tile_idx * 16u, row, col);
+            if (color_id == 0u) {
+                continue;  // Transparent.
+            }
+
+            // The winner hides any object it overlaps, even when the background hides it.
+            best_x = uint(obj_x + 8);
+            if ((flags & OAM_PRIORITY) != 0u && bg_color_id != 0u) {
+                shade = bg_shade;
+                continue;  // Background colors 1-3 are drawn over the object.
+            }
+
+            uint obp = ((flags & OAM_PALETTE) != 0u) ? line_reg(line, 7u) : line_reg(line, 6u);
+            shade    = palette_shade(obp, color_id);
+        }
+    }
+
+    res_col = vec4(vec3(1.0 - float(shade) / 3.0), 1.0);
+}
@@ -0,0 +1,13 @@
+#version 460
+
+// Scale the frame composed at the native resolution of the LCD to the swap chain image. The
+// viewport is an integer multiple of the LCD resolution, so nearest sampling is exact.
+
+layout(set = 0, binding = 0) uniform sampler2D native_frame;
+
+layout(location = 0) in vec2  lcd_uv;
+layout(location = 0) out vec4 res_col;
+
+void main() {
+    res_col = texture(native_frame, lcd_uv);
+}
@@ -1,20 +0,0 @@
-#version 460
-
-vec2 vtx_pos[3] = {
-    vec2( 0.0, -0.5),
-    vec2( 0.5,  0.5),
-    vec2(-0.5,  0.5),
-};
-
-vec3 colors[3] = {
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0),
-};
-
-layout(location = 0) out vec3 frag_col;
-
-void main() {
-    gl_Position = vec4(vtx_pos[gl_VertexIndex], 0.0, 1.0);
-    frag_col = colors[gl_VertexIndex];
-}
@@ -0,0 +1,85 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the batch runner.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/batch.h>
+
+#include <psh/array.h>
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+static TestPath rom_path;
+
+void instances_share_the_cartridge() {
+    constexpr usize INSTANCE_COUNT = 6;
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_mebibytes(1));
+    psh::Arena arena = memory_manager.make_arena(psh_kibibytes(16)).demand();
+
+    Cartridge cart;
+    psh_assert(
+        init_cartridge(cart, &arena, psh::StringView{rom_path.buf}) == psh::FileStatus::OK);
+
+    psh::Array<BatchInstance> instances;
+    instances.init(&arena, INSTANCE_COUNT);
+    for (usize idx = 0; idx < INSTANCE_COUNT; ++idx) {
+        instances[idx].arena = memory_manager.make_arena(BATCH_INSTANCE_MEMORY_SIZE).demand();
+        instances[idx].cart  = &cart;
+        instances[idx].seed  = idx % 3;
+    }
+
+    BatchConfig const config{.worker_count = 4, .frame_count = 2};
+    psh_assert(batch_worker_count(config, INSTANCE_COUNT) == 4);
+    psh_assert(batch_worker_count(config, 2) == 2);
+
+    run_batch({instances.buf, instances.size}, config);
+
+    for (usize idx = 0; idx < INSTANCE_COUNT; ++idx) {
+        BatchInstance const& instance = instances[idx];
+        psh_assert(instance.core != nullptr);
+        psh_assert(instance.core->cart == &cart);
+        psh_assert(instance.core->frame_count == 2);
+        psh_assert(instance.worker == idx % 4);
+    }
+
+    // Instances with the same seed have the same work RAM, distinct seeds don't.
+    MemoryMap const& seed_0       = instances[0].core->cpu.mmap;
+    MemoryMap const& seed_1       = instances[1].core->cpu.mmap;
+    MemoryMap const& seed_1_again = instances[4].core->cpu.mmap;
+    psh_assert(std::memcmp(&seed_1.fx_wram, &seed_1_again.fx_wram, sizeof(FxWorkRAM)) == 0);
+    psh_assert(std::memcmp(&seed_0.fx_wram, &seed_1.fx_wram, sizeof(FxWorkRAM)) != 0);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    rom_path = write_test_rom("test_batch.gb", LOOPING_PROGRAM);
+    instances_share_the_cartridge();
+    std::remove(rom_path.buf);
+    psh_info("Test passed.");
+}
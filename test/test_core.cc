@@ -0,0 +1,111 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the headless emulation core.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/core.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+void boot_state(Cartridge const& cart) {
+    Core core;
+    init_core(core, cart);
+    psh_assert(core.cpu.regfile.pc == 0x0100);
+    psh_assert(core.cpu.regfile.sp_hi == 0xFF);
+    psh_assert(core.cpu.regfile.sp_lo == 0xFE);
+    psh_assert(core.cpu.regfile.a == 0x01);
+    psh_assert(core.cpu.mmap.fx_rom.header.buf[0x01] == 0xC3);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void frame_accounting(Cartridge const& cart) {
+    Core core;
+    init_core(core, cart);
+
+    run_core_cycles(core, 3);
+    psh_assert(core.cycle_count == 3);
+    psh_assert(core.frame_count == 0);
+    psh_assert(core.cpu.regfile.pc == 0x0101);
+
+    // A frame ends at the frame boundary, not a whole frame after the current cycle.
+    run_core_frame(core);
+    psh_assert(core.cycle_count == MACHINE_CYCLES_PER_FRAME);
+    psh_assert(core.frame_count == 1);
+    psh_assert(core.cpu.regfile.pc == 0x0100);
+
+    run_core_cycles(core, 2 * MACHINE_CYCLES_PER_FRAME + 1);
+    psh_assert(core.frame_count == 3);
+
+    reset_core(core);
+    psh_assert(core.cycle_count == 0);
+    psh_assert(core.frame_count == 0);
+    psh_assert(core.cpu.regfile.pc == 0x0100);
+    psh_assert(core.cpu.mmap.fx_rom.header.buf[0x01] == 0xC3);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void seeded_work_ram(Cartridge const& cart) {
+    // Both cores read the same cartridge.
+    Core first;
+    Core second;
+    init_core(first, cart);
+    init_core(second, cart);
+    psh_assert(first.cart == second.cart);
+
+    MemoryMap const& first_mmap  = first.cpu.mmap;
+    MemoryMap const& second_mmap = second.cpu.mmap;
+
+    scramble_work_ram(first, 1);
+    scramble_work_ram(second, 1);
+    psh_assert(std::memcmp(&first_mmap.fx_wram, &second_mmap.fx_wram, sizeof(FxWorkRAM)) == 0);
+
+    scramble_work_ram(second, 2);
+    psh_assert(std::memcmp(&first_mmap.sw_wram, &second_mmap.sw_wram, sizeof(SwWorkRAM)) != 0);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    TestPath const rom_path = write_test_rom("test_core.gb", LOOPING_PROGRAM);
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_kibibytes(64));
+    psh::Arena arena = memory_manager.make_arena(psh_kibibytes(32)).demand();
+
+    Cartridge cart;
+    psh_assert(
+        init_cartridge(cart, &arena, psh::StringView{rom_path.buf}) == psh::FileStatus::OK);
+
+    boot_state(cart);
+    frame_accounting(cart);
+    seeded_work_ram(cart);
+
+    std::remove(rom_path.buf);
+    psh_info("Test passed.");
+}
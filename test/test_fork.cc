@@ -0,0 +1,212 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Tests for the copy-on-write branching of the state of a core.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/fork.h>
+
+#include <mina/savestate.h>
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+constexpr u32 WRAM_PAGE = 0xC000 >> MEMORY_PAGE_SHIFT;
+constexpr u32 IO_PAGE   = MEMORY_PAGE_COUNT - 1;
+
+static SaveState expected;
+static SaveState restored;
+
+bool same_state(Core const& lhs, Core const& rhs) {
+    save_state(lhs, expected);
+    save_state(rhs, restored);
+    return std::memcmp(&expected, &restored, sizeof(SaveState)) == 0;
+}
+
+/// Run a core from reset through a frame without buttons and then the given frames with buttons.
+void run_reference(Core& core, u8 buttons, u32 frame_count) {
+    reset_core(core);
+    core.buttons = 0;
+    run_core_frame(core);
+    core.buttons = buttons;
+    for (u32 frame = 0; frame < frame_count; ++frame) {
+        run_core_frame(core);
+    }
+}
+
+void forks_share_unchanged_pages(Cartridge const& cart, psh::Arena* arena) {
+    Core core;
+    init_core(core, cart);
+    run_core_frame(core);
+
+    ForkedState* root = capture_root_state(arena, core);
+    psh_assert(root != nullptr);
+    psh_assert(forked_state_owned_size(*root) == sizeof(MemoryMap));
+
+    core.buttons = BUTTON_START;
+    run_core_frame(core);
+    ForkedState* child = fork_state(arena, *root, core);
+    psh_assert(child != nullptr);
+    psh_assert(child->parent == root);
+
+    // Only the work RAM page and the I/O page were written.
+    psh_assert(child->owned_pages == ((u64{1} << WRAM_PAGE) | (u64{1} << IO_PAGE)));
+    psh_assert(forked_state_owned_size(*child) == 2 * MEMORY_PAGE_SIZE);
+    for (u32 page = 0; page < MEMORY_PAGE_COUNT; ++page) {
+        bool const owned = (page == WRAM_PAGE) || (page == IO_PAGE);
+        psh_assert((child->pages[page] == root->pages[page]) == !owned);
+    }
+
+    Core other;
+    init_core(other, cart);
+    restore_forked_state(other, *child);
+    psh_assert(same_state(other, core));
+    restore_forked_state(other, *root);
+    run_reference(core, 0, 0);
+    psh_assert(same_state(other, core));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void explores_branches(Cartridge const& cart, psh::Arena* arena) {
+    constexpr u32 BRANCH_COUNT = 8;
+    constexpr u32 DEPTH        = 3;
+
+    Core core;
+    init_core(core, cart);
+    run_core_frame(core);
+    ForkedState* root = capture_root_state(arena, core);
+    psh_assert(root != nullptr);
+
+    // Expand every button of the root, reverting to it between the branches.
+    ForkedState* children[BRANCH_COUNT] = {};
+    for (u32 branch = 0; branch < BRANCH_COUNT; ++branch) {
+        revert_forked_state(core, *root);
+        core.buttons = static_cast<u8>(1 << branch);
+        for (u32 frame = 0; frame < DEPTH; ++frame) {
+            run_core_frame(core);
+        }
+        children[branch] = fork_state(arena, *root, core);
+        psh_assert(children[branch] != nullptr);
+    }
+
+    // Each branch is the same as an independent run with its buttons held.
+    Core reference;
+    init_core(reference, cart);
+    for (u32 branch = 0; branch < BRANCH_COUNT; ++branch) {
+        restore_forked_state(core, *children[branch]);
+        run_reference(reference, static_cast<u8>(1 << branch), DEPTH);
+        psh_assert(same_state(core, reference));
+    }
+
+    // Grandchildren share the pages of their whole ancestry.
+    restore_forked_state(core, *children[0]);
+    core.buttons = BUTTON_A;
+    run_core_frame(core);
+    ForkedState const* grandchild = fork_state(arena, *children[0], core);
+    psh_assert(grandchild != nullptr);
+    psh_assert(grandchild->pages[0] == root->pages[0]);
+    psh_assert(grandchild->pages[WRAM_PAGE] != children[0]->pages[WRAM_PAGE]);
+
+    run_reference(reference, BUTTON_A, DEPTH + 1);
+    restore_forked_state(core, *grandchild);
+    psh_assert(same_state(core, reference));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void forks_after_loading_a_state(Cartridge const& cart, psh::Arena* arena) {
+    Core core;
+    init_core(core, cart);
+    run_core_frame(core);
+    ForkedState* root = capture_root_state(arena, core);
+    psh_assert(root != nullptr);
+
+    core.buttons = BUTTON_A;
+    run_core_frame(core);
+    run_core_frame(core);
+    SaveState* saved = arena->zero_alloc<SaveState>(1);
+    psh_assert(saved != nullptr);
+    save_state(core, *saved);
+
+    // Loading rewrites the memory map outside of the bus, so every page has to be forked.
+    revert_forked_state(core, *root);
+    core.buttons = BUTTON_B;
+    run_core_frame(core);
+    psh_assert(load_state(core, *saved) == SaveStateStatus::OK);
+    ForkedState* child = fork_state(arena, *root, core);
+    psh_assert(child != nullptr);
+    psh_assert(child->owned_pages == ~u64{0});
+
+    Core reference;
+    init_core(reference, cart);
+    run_reference(reference, BUTTON_A, 2);
+    Core other;
+    init_core(other, cart);
+    restore_forked_state(other, *child);
+    psh_assert(same_state(other, reference));
+
+    // Reverting after a reset or a load copies back every page as well.
+    reset_core(core);
+    revert_forked_state(core, *child);
+    psh_assert(same_state(core, reference));
+    psh_assert(load_state(core, *saved) == SaveStateStatus::OK);
+    revert_forked_state(core, *root);
+    run_reference(reference, 0, 0);
+    psh_assert(same_state(core, reference));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void full_arena_gives_no_state(Cartridge const& cart, psh::Arena* small_arena) {
+    Core core;
+    init_core(core, cart);
+    psh_assert(capture_root_state(small_arena, core) == nullptr);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    TestPath const rom_path = write_test_rom("test_fork.gb", JOYPAD_COPY_PROGRAM);
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_mebibytes(2));
+    psh::Arena cart_arena  = memory_manager.make_arena(psh_kibibytes(32)).demand();
+    psh::Arena arena       = memory_manager.make_arena(psh_mebibytes(1)).demand();
+    psh::Arena small_arena = memory_manager.make_arena(psh_kibibytes(4)).demand();
+
+    Cartridge cart;
+    psh_assert(
+        init_cartridge(cart, &cart_arena, psh::StringView{rom_path.buf})
+        == psh::FileStatus::OK);
+
+    forks_share_unchanged_pages(cart, &arena);
+    explores_branches(cart, &arena);
+    forks_after_loading_a_state(cart, &arena);
+    full_arena_gives_no_state(cart, &small_arena);
+
+    std::remove(rom_path.buf);
+    psh_info("Test passed.");
+}
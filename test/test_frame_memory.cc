@@ -0,0 +1,148 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the tracking of the LCD lines staged to the GPU.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/gfx/data.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstring>
+
+using namespace mina;
+
+void first_upload_covers_whole_screen() {
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_kibibytes(256));
+    FrameMemory frame_memory = create_frame_memory(memory_manager);
+
+    collect_dirty_lcd_rows(frame_memory);
+    psh_assert(frame_memory.lcd_range_count == 1);
+    psh_assert(frame_memory.lcd_ranges[0].first_line == 0);
+    psh_assert(frame_memory.lcd_ranges[0].line_count == LCD_HEIGHT);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void only_changed_rows_are_collected() {
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_kibibytes(256));
+    FrameMemory frame_memory       = create_frame_memory(memory_manager);
+    frame_memory.lcd_texture_valid = true;
+    collect_dirty_lcd_rows(frame_memory);
+
+    u8 row[LCD_WIDTH];
+    std::memset(row, make_pixel_id(DMG_BG_PALETTE_SLOT, VideoRAM::c3), LCD_WIDTH);
+    write_lcd_row(frame_memory, 3, row);
+    write_lcd_row(frame_memory, 4, row);
+    write_lcd_row(frame_memory, 63, row);
+    write_lcd_row(frame_memory, 64, row);
+    write_lcd_row(frame_memory, LCD_HEIGHT - 1, row);
+
+    // Writing the same contents again doesn't dirty the line.
+    std::memset(row, 0x00, LCD_WIDTH);
+    write_lcd_row(frame_memory, 100, row);
+
+    collect_dirty_lcd_rows(frame_memory);
+    psh_assert(frame_memory.lcd_range_count == 3);
+    psh_assert(frame_memory.lcd_ranges[0].first_line == 3);
+    psh_assert(frame_memory.lcd_ranges[0].line_count == 2);
+    psh_assert(frame_memory.lcd_ranges[1].first_line == 63);
+    psh_assert(frame_memory.lcd_ranges[1].line_count == 2);
+    psh_assert(frame_memory.lcd_ranges[2].first_line == LCD_HEIGHT - 1);
+    psh_assert(frame_memory.lcd_ranges[2].line_count == 1);
+
+    // Collecting clears the dirty state.
+    collect_dirty_lcd_rows(frame_memory);
+    psh_assert(frame_memory.lcd_range_count == 0);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void palette_change_dirties_whole_screen() {
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_kibibytes(256));
+    FrameMemory frame_memory       = create_frame_memory(memory_manager);
+    frame_memory.lcd_texture_valid = true;
+    collect_dirty_lcd_rows(frame_memory);
+
+    HwRegisterBank reg{};
+    update_lcd_palette(frame_memory, reg);
+    collect_dirty_lcd_rows(frame_memory);
+    psh_assert(frame_memory.lcd_range_count == 0);
+
+    reg.bgp = 0xE4;
+    update_lcd_palette(frame_memory, reg);
+    collect_dirty_lcd_rows(frame_memory);
+    psh_assert(frame_memory.lcd_range_count == 1);
+    psh_assert(frame_memory.lcd_ranges[0].line_count == LCD_HEIGHT);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void dirty_rows_are_converted_into_the_slice() {
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_kibibytes(256));
+    FrameMemory frame_memory       = create_frame_memory(memory_manager);
+    frame_memory.lcd_texture_valid = true;
+
+    HwRegisterBank reg{};
+    reg.bgp = 0xE4;  // Identity: color i uses shade i.
+    update_lcd_palette(frame_memory, reg);
+    collect_dirty_lcd_rows(frame_memory);
+
+    u8 row[LCD_WIDTH];
+    for (u32 idx = 0; idx < LCD_WIDTH; ++idx) {
+        row[idx] = make_pixel_id(DMG_BG_PALETTE_SLOT, static_cast<VideoRAM::ColorID>(idx % 4));
+    }
+    write_lcd_row(frame_memory, 10, row);
+    write_lcd_row(frame_memory, 11, row);
+    collect_dirty_lcd_rows(frame_memory);
+
+    // Lines that aren't staged are left untouched in the slice.
+    static u8 lcd_frame[LCD_FRAME_SIZE];
+    std::memset(lcd_frame, 0x7F, LCD_FRAME_SIZE);
+    convert_staged_lcd_rows(memory_staging_info(frame_memory, 0), lcd_frame);
+
+    for (u32 line = 0; line < LCD_HEIGHT; ++line) {
+        u8 const* rgba = lcd_frame + line * LCD_ROW_SIZE;
+        for (u32 idx = 0; idx < LCD_WIDTH; ++idx) {
+            if (line == 10 || line == 11) {
+                DMGShade const& shade = DMG_SHADES[idx % 4];
+                psh_assert(rgba[4 * idx + 0] == shade.red);
+                psh_assert(rgba[4 * idx + 1] == shade.green);
+                psh_assert(rgba[4 * idx + 2] == shade.blue);
+                psh_assert(rgba[4 * idx + 3] == 0xFF);
+            } else {
+                psh_assert(rgba[4 * idx] == 0x7F);
+            }
+        }
+    }
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    first_upload_covers_whole_screen();
+    only_changed_rows_are_collected();
+    palette_change_dirties_whole_screen();
+    dirty_rows_are_converted_into_the_slice();
+    psh_info("Test passed.");
+}
@@ -0,0 +1,121 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Tests for the rendering, pooling and downsampling of gray frames.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/ppu/gray_frame.h>
+
+#include <mina/memory_map.h>
+#include <mina/ppu/palette.h>
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <cstring>
+
+using namespace mina;
+
+static u8 frame_a[GRAY_FRAME_SIZE];
+static u8 frame_b[GRAY_FRAME_SIZE];
+static u8 pooled[GRAY_FRAME_SIZE];
+static u8 half[GRAY_HALF_FRAME_SIZE];
+
+void fill_frames() {
+    for (u32 idx = 0; idx < GRAY_FRAME_SIZE; ++idx) {
+        frame_a[idx] = static_cast<u8>(idx * 37 + (idx >> 5));
+        frame_b[idx] = static_cast<u8>(idx * 11 + 101);
+    }
+}
+
+/// Overlap two objects on a background of color 1, the one winning the DMG priority being hidden
+/// by the background. The other object must stay hidden under the winner rather than show through.
+void hidden_object_priority() {
+    static MemoryMap mmap;
+    static u8        frame[GRAY_FRAME_SIZE];
+
+    // Tiles are addressed from 0x8000: tile 0 is all color 1, tile 1 all color 3 and tile 2 all
+    // color 2. The background map is all zeros, thus of color 1.
+    u8* vram = reinterpret_cast<u8*>(&mmap.vram);
+    for (u32 row = 0; row < 8; ++row) {
+        vram[0 * 16 + 2 * row]     = 0xFF;
+        vram[1 * 16 + 2 * row]     = 0xFF;
+        vram[1 * 16 + 2 * row + 1] = 0xFF;
+        vram[2 * 16 + 2 * row + 1] = 0xFF;
+    }
+
+    // The first object in the OAM spans the pixels 4 to 11 of the first line, and the second one,
+    // winning over it for having a smaller x coordinate, spans the pixels 0 to 7 behind the
+    // background.
+    constexpr u8 OAM_PRIORITY = 1 << 7;
+    constexpr u8 objects[]    = {
+        16, 12, 1, 0x00,          // Y, X, tile, flags.
+        16, 8,  2, OAM_PRIORITY,  // Y, X, tile, flags.
+    };
+    std::memcpy(reinterpret_cast<u8*>(&mmap.sprite), objects, sizeof(objects));
+
+    u8 const lcdc = 0x93;  // LCD, tile data at 0x8000, objects and background enabled.
+    std::memcpy(&mmap.reg.lcdc, &lcdc, sizeof(u8));
+    mmap.reg.bgp  = 0xE4;  // Color `k` has shade `k`.
+    mmap.reg.obp0 = 0xE4;
+
+    render_gray_frame(mmap, frame);
+    for (u32 x = 0; x < 8; ++x) {
+        psh_assert(frame[x] == DMG_SHADES[1].red);
+    }
+    for (u32 x = 8; x < 12; ++x) {
+        psh_assert(frame[x] == DMG_SHADES[3].red);
+    }
+    psh_assert(frame[12] == DMG_SHADES[1].red);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+/// Check the vectorized pooling against the scalar rule, keeping the darker pixel.
+void min_pooling() {
+    min_pool_gray_frames(frame_a, frame_b, pooled);
+    for (u32 idx = 0; idx < GRAY_FRAME_SIZE; ++idx) {
+        psh_assert(pooled[idx] == ((frame_a[idx] < frame_b[idx]) ? frame_a[idx] : frame_b[idx]));
+    }
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+/// Check the rounding of the vectorized downsampling against the scalar rule.
+void downsampling() {
+    downsample_gray_frame(frame_a, half);
+    auto const average = [](u32 a, u32 b) -> u32 { return (a + b + 1) / 2; };
+    for (u32 row = 0; row < GRAY_HALF_HEIGHT; ++row) {
+        for (u32 col = 0; col < GRAY_HALF_WIDTH; ++col) {
+            u8 const* top    = frame_a + 2 * row * LCD_WIDTH + 2 * col;
+            u8 const* bottom = top + LCD_WIDTH;
+            u32 const left   = average(top[0], bottom[0]);
+            u32 const right  = average(top[1], bottom[1]);
+            psh_assert(half[row * GRAY_HALF_WIDTH + col] == average(left, right));
+        }
+    }
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    hidden_object_priority();
+    fill_frames();
+    min_pooling();
+    downsampling();
+    psh_info("Test passed.");
+}
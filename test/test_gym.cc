@@ -0,0 +1,181 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the gym-style C interface.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+///
+/// The test only links against the shared gym library, so it may only go through the C interface
+/// of `mina/gym.h`.
+
+#include <mina/gym.h>
+
+#include <mina/ppu/lcd.h>
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+static TestPath rom_path;
+
+/// Fills the screen with black and then keeps copying both halves of the joypad state to 0xC000
+/// (d-pad) and 0xC001 (buttons).
+constexpr u8 SCREEN_JOYPAD_PROGRAM[] = {
+    0x3E, 0xE4,              // LD A, 0xE4
+    0xEA, 0x47, 0xFF,        // LD (BGP), A
+    0x3E, 0xFF,              // LD A, 0xFF
+    // LD (0x8000 + n), A for n in [0, 16): tile 0 only uses color 3.
+    0xEA, 0x00, 0x80, 0xEA, 0x01, 0x80, 0xEA, 0x02, 0x80, 0xEA, 0x03, 0x80,
+    0xEA, 0x04, 0x80, 0xEA, 0x05, 0x80, 0xEA, 0x06, 0x80, 0xEA, 0x07, 0x80,
+    0xEA, 0x08, 0x80, 0xEA, 0x09, 0x80, 0xEA, 0x0A, 0x80, 0xEA, 0x0B, 0x80,
+    0xEA, 0x0C, 0x80, 0xEA, 0x0D, 0x80, 0xEA, 0x0E, 0x80, 0xEA, 0x0F, 0x80,
+    0x3E, 0x91,              // LD A, 0x91
+    0xEA, 0x40, 0xFF,        // LD (LCDC), A: LCD and background on, unsigned tile indexing.
+    0x3E, 0x20,              // 0x013C: LD A, 0x20
+    0xEA, 0x00, 0xFF,        // LD (P1), A: select the d-pad.
+    0xFA, 0x00, 0xFF,        // LD A, (P1)
+    0xEA, 0x00, 0xC0,        // LD (0xC000), A
+    0x3E, 0x10,              // LD A, 0x10
+    0xEA, 0x00, 0xFF,        // LD (P1), A: select the buttons.
+    0xFA, 0x00, 0xFF,        // LD A, (P1)
+    0xEA, 0x01, 0xC0,        // LD (0xC001), A
+    0xC3, 0x3C, 0x01,        // JP 0x013C
+};
+
+bool frame_is_filled(MinaGymFrame frame, u8 value) {
+    for (u32 idx = 0; idx < frame.width * frame.height; ++idx) {
+        if (frame.pixels[idx] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void observations_are_views() {
+    MinaGym* gym = mina_gym_create(rom_path.buf, nullptr);
+    psh_assert(gym != nullptr);
+
+    // The LCD is off until the ROM turns it on.
+    MinaGymFrame const frame = mina_gym_get_framebuffer(gym);
+    psh_assert(frame.width == LCD_WIDTH && frame.height == LCD_HEIGHT);
+    psh_assert(frame_is_filled(frame, 0xFF));
+
+    // The same view sees the contents of the following frames.
+    psh_assert(mina_gym_step(gym, 0, 0) == 1);
+    psh_assert(mina_gym_get_framebuffer(gym).pixels == frame.pixels);
+    psh_assert(frame_is_filled(frame, 0x00));
+
+    MinaGymRam const ram = mina_gym_get_ram(gym);
+    psh_assert(ram.wram_size == 0x2000 && ram.hram_size == 0x7F);
+    psh_assert(ram.wram[0] == 0xEF && ram.wram[1] == 0xDF);
+
+    mina_gym_destroy(gym);
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void joypad_action() {
+    MinaGym*         gym = mina_gym_create(rom_path.buf, nullptr);
+    MinaGymRam const ram = mina_gym_get_ram(gym);
+
+    mina_gym_step(gym, MINA_GYM_BUTTON_RIGHT | MINA_GYM_BUTTON_A, 1);
+    psh_assert((ram.wram[0] & 0x0F) == 0b1110);
+    psh_assert((ram.wram[1] & 0x0F) == 0b1110);
+
+    mina_gym_step(gym, MINA_GYM_BUTTON_DOWN | MINA_GYM_BUTTON_SELECT, 1);
+    psh_assert((ram.wram[0] & 0x0F) == 0b0111);
+    psh_assert((ram.wram[1] & 0x0F) == 0b1011);
+
+    mina_gym_step(gym, 0, 1);
+    psh_assert((ram.wram[0] & 0x0F) == 0b1111);
+    psh_assert((ram.wram[1] & 0x0F) == 0b1111);
+
+    mina_gym_destroy(gym);
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void frame_skip_and_pooling() {
+    MinaGymConfig const config{.frame_skip = 4, .pool_frames = 1, .downsample = 0};
+    MinaGym*            gym = mina_gym_create(rom_path.buf, &config);
+
+    // A single frame pools the white frame of the reset with the first black one, which is kept.
+    psh_assert(mina_gym_step(gym, 0, 1) == 1);
+    psh_assert(frame_is_filled(mina_gym_get_framebuffer(gym), 0x00));
+
+    psh_assert(mina_gym_step(gym, 0, 0) == 5);
+    psh_assert(frame_is_filled(mina_gym_get_framebuffer(gym), 0x00));
+
+    mina_gym_reset(gym, 0);
+    psh_assert(mina_gym_step(gym, 0, 0) == 4);
+    psh_assert(frame_is_filled(mina_gym_get_framebuffer(gym), 0x00));
+
+    mina_gym_destroy(gym);
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void downsampled_frames() {
+    MinaGymConfig const config{.frame_skip = 1, .pool_frames = 0, .downsample = 1};
+    MinaGym*            gym = mina_gym_create(rom_path.buf, &config);
+
+    MinaGymFrame const frame = mina_gym_get_framebuffer(gym);
+    psh_assert(frame.width == LCD_WIDTH / 2 && frame.height == LCD_HEIGHT / 2);
+    psh_assert(frame_is_filled(frame, 0xFF));
+    mina_gym_step(gym, 0, 0);
+    psh_assert(frame_is_filled(frame, 0x00));
+    mina_gym_destroy(gym);
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void clones_are_independent() {
+    MinaGym* gym = mina_gym_create(rom_path.buf, nullptr);
+    mina_gym_step(gym, MINA_GYM_BUTTON_UP, 3);
+
+    MinaGym* clone = mina_gym_clone_state(gym);
+    psh_assert(mina_gym_get_ram(clone).wram != mina_gym_get_ram(gym).wram);
+    psh_assert(mina_gym_get_framebuffer(clone).pixels != mina_gym_get_framebuffer(gym).pixels);
+
+    MinaGymRam const gym_ram   = mina_gym_get_ram(gym);
+    MinaGymRam const clone_ram = mina_gym_get_ram(clone);
+    psh_assert(std::memcmp(gym_ram.wram, clone_ram.wram, gym_ram.wram_size) == 0);
+
+    psh_assert(mina_gym_step(gym, MINA_GYM_BUTTON_B, 2) == 5);
+    psh_assert((gym_ram.wram[1] & 0x0F) == 0b1101);
+    psh_assert((clone_ram.wram[0] & 0x0F) == 0b1011);
+
+    // The cartridge outlives the instance that loaded it while clones still use it.
+    mina_gym_destroy(gym);
+    psh_assert(mina_gym_step(clone, MINA_GYM_BUTTON_B, 2) == 5);
+    psh_assert((clone_ram.wram[1] & 0x0F) == 0b1101);
+    psh_assert(frame_is_filled(mina_gym_get_framebuffer(clone), 0x00));
+
+    mina_gym_destroy(clone);
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    rom_path = write_test_rom("test_gym.gb", SCREEN_JOYPAD_PROGRAM);
+    observations_are_views();
+    joypad_action();
+    frame_skip_and_pooling();
+    downsampled_frames();
+    clones_are_independent();
+    std::remove(rom_path.buf);
+    psh_info("Test passed.");
+}
@@ -0,0 +1,56 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the memory hashing utilities.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/hash.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+
+using namespace mina;
+
+void reference_vectors() {
+    psh_assert(hash_memory(nullptr, 0) == 0xEF46DB3751D8E999ull);
+
+    constexpr char abc[] = "abc";
+    psh_assert(hash_memory(reinterpret_cast<u8 const*>(abc), 3) == 0x44BC2CF5AD770999ull);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void detects_single_byte_change() {
+    u8  buf[1024] = {};
+    u64 h0        = hash_memory(buf, sizeof(buf));
+
+    buf[517] = 0x01;
+    u64 h1   = hash_memory(buf, sizeof(buf));
+    psh_assert(h0 != h1);
+
+    buf[517] = 0x00;
+    psh_assert(hash_memory(buf, sizeof(buf)) == h0);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    reference_vectors();
+    detects_single_byte_change();
+    psh_info("Test passed.");
+}
@@ -0,0 +1,115 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the lockstep execution of many instances.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/cpu/lockstep.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+static TestPath rom_path;
+
+/// Loops over instructions with and without lockstep handlers, whose branches depend on the
+/// accumulator of each instance.
+constexpr u8 BRANCHING_PROGRAM[] = {
+    0x3C,              // 0x0100: INC A
+    0xC6, 0x07,        // 0x0101: ADD A, 0x07
+    0x77,              // 0x0103: LD [HL], A
+    0xE6, 0x1F,        // 0x0104: AND A, 0x1F
+    0x20, 0x00, 0x00,  // 0x0106: JR NZ, +0
+    0x47,              // 0x0109: LD B, A
+    0x0D,              // 0x010A: DEC C
+    0xCA, 0x0E, 0x01,  // 0x010B: JP Z, 0x010E
+    0x23,              // 0x010E: INC HL
+    0xC3, 0x00, 0x01,  // 0x010F: JP 0x0100
+};
+
+/// Make the lanes diverge both in their registers and in their code.
+void diverge_lane(Core& core, u32 lane) {
+    core.cpu.regfile.a = static_cast<u8>(lane * 37);
+    if (lane % 2 == 1) {
+        core.cpu.mmap.fx_rom.header.buf[0x02] = 0x09;  // ADD A, 0x09
+    }
+}
+
+void matches_scalar_execution() {
+    constexpr u32 LANE_COUNT  = 37;
+    constexpr u32 CYCLE_COUNT = 500;
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_mebibytes(8));
+    psh::Arena arena = memory_manager.make_arena(psh_mebibytes(6)).demand();
+
+    Cartridge cart;
+    psh_assert(
+        init_cartridge(cart, &arena, psh::StringView{rom_path.buf}) == psh::FileStatus::OK);
+
+    LockstepGroup group;
+    init_lockstep(group, &arena, cart, LANE_COUNT);
+    for (u32 lane = 0; lane < LANE_COUNT; ++lane) {
+        diverge_lane(group.lanes[lane], lane);
+    }
+    load_lockstep_lanes(group);
+
+    Core* const scalar = arena.zero_alloc<Core>(LANE_COUNT);
+    psh_assert(scalar != nullptr);
+    for (u32 lane = 0; lane < LANE_COUNT; ++lane) {
+        init_core(scalar[lane], cart);
+        diverge_lane(scalar[lane], lane);
+    }
+
+    run_lockstep_cycles(group, CYCLE_COUNT);
+    store_lockstep_lanes(group);
+    for (u32 lane = 0; lane < LANE_COUNT; ++lane) {
+        run_core_cycles(scalar[lane], CYCLE_COUNT);
+    }
+
+    for (u32 lane = 0; lane < LANE_COUNT; ++lane) {
+        CPU const& lockstep_cpu = group.lanes[lane].cpu;
+        CPU const& scalar_cpu   = scalar[lane].cpu;
+        RegisterFile const& lockstep_regfile = lockstep_cpu.regfile;
+        RegisterFile const& scalar_regfile   = scalar_cpu.regfile;
+        psh_assert(std::memcmp(&lockstep_regfile, &scalar_regfile, sizeof(RegisterFile)) == 0);
+        psh_assert(lockstep_cpu.bus_addr == scalar_cpu.bus_addr);
+        psh_assert(std::memcmp(&lockstep_cpu.mmap, &scalar_cpu.mmap, sizeof(MemoryMap)) == 0);
+        psh_assert(group.lanes[lane].cycle_count == scalar[lane].cycle_count);
+    }
+
+    // Both paths were taken.
+    psh_assert(group.vector_lane_steps != 0);
+    psh_assert(group.scalar_lane_steps != 0);
+    psh_assert(group.vector_lane_steps + group.scalar_lane_steps == LANE_COUNT * CYCLE_COUNT);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    rom_path = write_test_rom("test_lockstep.gb", BRANCHING_PROGRAM);
+    matches_scalar_execution();
+    std::remove(rom_path.buf);
+    psh_info("Test passed.");
+}
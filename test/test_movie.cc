@@ -0,0 +1,242 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Tests for the recording, playback and seeking of input movies.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/movie.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+static TestPath const movie_path = make_test_path("test_movie.mnmv");
+
+constexpr u32 FRAME_COUNT       = 250;
+constexpr u32 KEYFRAME_INTERVAL = 50;
+
+/// States of the core at the start of each frame of the movie, and at its end.
+static SaveState frame_states[FRAME_COUNT + 1];
+static SaveState restored;
+
+bool at_frame(Core const& core, u64 frame) {
+    save_state(core, restored);
+    return std::memcmp(&restored, &frame_states[frame], sizeof(SaveState)) == 0;
+}
+
+u8 buttons_of_frame(u32 frame) {
+    return static_cast<u8>((frame * 37) ^ (frame >> 3));
+}
+
+MovieConfig const config{
+    .max_frames           = 1000,
+    .keyframe_interval    = KEYFRAME_INTERVAL,
+    .keyframe_buffer_size = psh_kibibytes(512),
+};
+
+void record_and_seek(Cartridge const& cart, psh::Arena* arena, Movie& movie) {
+    Core core;
+    init_core(core, cart);
+    run_core_frame(core);
+
+    init_movie(movie, arena, core, config);
+    for (u32 frame = 0; frame < FRAME_COUNT; ++frame) {
+        save_state(core, frame_states[frame]);
+        core.buttons = buttons_of_frame(frame);
+        psh_assert(record_movie_frame(movie, core) == MovieStatus::OK);
+    }
+    save_state(core, frame_states[FRAME_COUNT]);
+
+    psh_assert(movie.header.frame_count == FRAME_COUNT);
+    psh_assert(movie.header.keyframe_count == FRAME_COUNT / KEYFRAME_INTERVAL);
+    psh_assert(movie.header.keyframe_data_size < FRAME_COUNT / KEYFRAME_INTERVAL * 64);
+
+    // Any frame, on either side of a keyframe, is reached in any order.
+    u64 const seeks[] = {249, 0, 50, 49, 51, 250, 1, 100, 199};
+    for (u64 const frame : seeks) {
+        psh_assert(seek_movie(movie, core, frame) == MovieStatus::OK);
+        psh_assert(movie_frame(movie, core) == frame);
+        psh_assert(at_frame(core, frame));
+    }
+    psh_assert(seek_movie(movie, core, FRAME_COUNT + 1) == MovieStatus::END_OF_MOVIE);
+
+    // Recording only resumes at the end of the movie.
+    psh_assert(seek_movie(movie, core, 10) == MovieStatus::OK);
+    psh_assert(record_movie_frame(movie, core) == MovieStatus::OUT_OF_SYNC);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void play_back(Cartridge const& cart, Movie const& movie) {
+    Core core;
+    init_core(core, cart);
+    psh_assert(load_state(core, *movie.initial) == SaveStateStatus::OK);
+
+    for (u32 frame = 0; frame < FRAME_COUNT; ++frame) {
+        psh_assert(at_frame(core, frame));
+        psh_assert(play_movie_frame(movie, core) == MovieStatus::OK);
+    }
+    psh_assert(at_frame(core, FRAME_COUNT));
+    psh_assert(play_movie_frame(movie, core) == MovieStatus::END_OF_MOVIE);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void truncate_and_rerecord(Cartridge const& cart, Movie& movie) {
+    Core core;
+    init_core(core, cart);
+
+    // Truncating at a keyframe keeps it, since it was reached through the same frames.
+    truncate_movie(movie, 150);
+    psh_assert(movie.header.frame_count == 150);
+    psh_assert(movie.header.keyframe_count == 3);
+    psh_assert(seek_movie(movie, core, 150) == MovieStatus::OK);
+    psh_assert(at_frame(core, 150));
+
+    for (u32 frame = 150; frame < FRAME_COUNT; ++frame) {
+        core.buttons = buttons_of_frame(frame);
+        psh_assert(record_movie_frame(movie, core) == MovieStatus::OK);
+    }
+    psh_assert(at_frame(core, FRAME_COUNT));
+    psh_assert(seek_movie(movie, core, 220) == MovieStatus::OK);
+    psh_assert(at_frame(core, 220));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void movie_file_round_trip(
+    Cartridge const& cart,
+    Cartridge const& other_cart,
+    psh::Arena*      arena,
+    Movie const&     movie) {
+    psh::StringView const path{movie_path.buf};
+    psh_assert(write_movie_file(movie, path) == MovieStatus::OK);
+
+    Movie loaded;
+    psh_assert(load_movie_file(loaded, arena, path, {}) == MovieStatus::OK);
+    psh_assert(loaded.header.frame_count == FRAME_COUNT);
+    psh_assert(loaded.max_frames >= MovieConfig{}.max_frames);
+
+    Core core;
+    init_core(core, cart);
+    psh_assert(seek_movie(loaded, core, 173) == MovieStatus::OK);
+    psh_assert(at_frame(core, 173));
+
+    // Movies only play on the cartridge they were recorded on.
+    Core other;
+    init_core(other, other_cart);
+    psh_assert(seek_movie(loaded, other, 0) == MovieStatus::WRONG_CARTRIDGE);
+    psh_assert(play_movie_frame(loaded, other) == MovieStatus::WRONG_CARTRIDGE);
+
+    // Corrupt files are rejected.
+    FILE* file = std::fopen(movie_path.buf, "r+b");
+    psh_assert(file != nullptr);
+    u32 const bad_magic = 0xDEADBEEF;
+    psh_assert(std::fwrite(&bad_magic, 1, sizeof(u32), file) == sizeof(u32));
+    std::fclose(file);
+    psh_assert(load_movie_file(loaded, arena, path, {}) == MovieStatus::INVALID_MAGIC);
+    psh_assert(load_movie_file(loaded, arena, psh::StringView{"missing.mnmv"}, {})
+               == MovieStatus::FAILED_TO_OPEN);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+/// Overwrite bytes of the movie file at the given offset.
+void patch_movie_file(usize offset, void const* bytes, usize size) {
+    FILE* file = std::fopen(movie_path.buf, "r+b");
+    psh_assert(file != nullptr);
+    psh_assert(std::fseek(file, static_cast<long>(offset), SEEK_SET) == 0);
+    psh_assert(std::fwrite(bytes, 1, size, file) == size);
+    std::fclose(file);
+}
+
+void corrupt_states_are_rejected(Cartridge const& cart, psh::Arena* arena, Movie const& movie) {
+    psh::StringView const path{movie_path.buf};
+    Movie                 loaded;
+
+    // The initial state is checked as `load_state` would.
+    psh_assert(write_movie_file(movie, path) == MovieStatus::OK);
+    u32 const   bad_version    = SAVESTATE_VERSION + 1;
+    usize const version_offset = sizeof(MovieHeader) + offsetof(SaveStateHeader, version);
+    patch_movie_file(version_offset, &bad_version, sizeof(u32));
+    psh_assert(load_movie_file(loaded, arena, path, config) == MovieStatus::INVALID_VERSION);
+
+    // So is every keyframe, which has to decode to the state of its frame. A run of LEB128
+    // continuation bytes overflows the counts of the first keyframe.
+    u8 garbage[16];
+    std::memset(garbage, 0xFF, sizeof(garbage));
+    MovieHeader const& header      = movie.header;
+    usize const        data_offset = sizeof(MovieHeader) + sizeof(SaveState) + header.frame_count
+                              + header.keyframe_count * sizeof(u64);
+    psh_assert(write_movie_file(movie, path) == MovieStatus::OK);
+    patch_movie_file(data_offset, garbage, sizeof(garbage));
+    psh_assert(load_movie_file(loaded, arena, path, config) == MovieStatus::CORRUPT);
+
+    // A keyframe corrupt in memory fails the seek, leaving the core untouched.
+    psh_assert(write_movie_file(movie, path) == MovieStatus::OK);
+    psh_assert(load_movie_file(loaded, arena, path, config) == MovieStatus::OK);
+    std::memcpy(loaded.keyframe_data, garbage, sizeof(garbage));
+
+    Core core;
+    init_core(core, cart);
+    psh_assert(seek_movie(loaded, core, 10) == MovieStatus::OK);
+    psh_assert(seek_movie(loaded, core, KEYFRAME_INTERVAL + 10) == MovieStatus::CORRUPT);
+    psh_assert(at_frame(core, 10));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    TestPath const rom_path = write_test_rom("test_movie.gb", joypad_sum_program(0x10));
+    TestPath const other_rom_path =
+        write_test_rom("test_movie_other.gb", joypad_sum_program(0x20));
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_mebibytes(16));
+    psh::Arena cart_arena = memory_manager.make_arena(psh_kibibytes(64)).demand();
+    psh::Arena arena      = memory_manager.make_arena(psh_mebibytes(15)).demand();
+
+    Cartridge cart;
+    Cartridge other_cart;
+    psh_assert(
+        init_cartridge(cart, &cart_arena, psh::StringView{rom_path.buf})
+        == psh::FileStatus::OK);
+    psh_assert(
+        init_cartridge(other_cart, &cart_arena, psh::StringView{other_rom_path.buf})
+        == psh::FileStatus::OK);
+
+    Movie movie;
+    record_and_seek(cart, &arena, movie);
+    play_back(cart, movie);
+    truncate_and_rerecord(cart, movie);
+    movie_file_round_trip(cart, other_cart, &arena, movie);
+    corrupt_states_are_rejected(cart, &arena, movie);
+
+    std::remove(rom_path.buf);
+    std::remove(other_rom_path.buf);
+    std::remove(movie_path.buf);
+    psh_info("Test passed.");
+}
@@ -0,0 +1,217 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Tests for rollback netplay sessions over lossy and reordering transports.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/netplay.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+constexpr u32 FRAME_COUNT = 120;
+
+/// Buttons sampled by a player on a host frame, changing often enough to make predictions fail.
+u8 sampled_buttons(u32 player, u64 frame) {
+    return static_cast<u8>(((frame / (3 + player)) * (29 + 6 * player)) ^ player);
+}
+
+static SaveState expected;
+static SaveState actual;
+
+bool same_state(Core const& lhs, Core const& rhs) {
+    save_state(lhs, expected);
+    save_state(rhs, actual);
+    return std::memcmp(&expected, &actual, sizeof(SaveState)) == 0;
+}
+
+/// Run both peers until each of them ran `FRAME_COUNT` frames with every button confirmed, and
+/// check that they agree with a run where the buttons were known right away.
+void run_peers(Cartridge const& cart, psh::Arena* arena, LoopbackConfig const& conditions) {
+    psh::ScratchArena sarena = arena->make_scratch();
+
+    LoopbackChannel channel;
+    init_loopback(channel, sarena.arena, conditions, 256);
+
+    static NetplaySession peers[NETPLAY_PLAYER_COUNT];
+    u64                   host_frames[NETPLAY_PLAYER_COUNT] = {};
+    for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+        NetplayConfig const config{.local_player = player, .input_delay = 2, .max_rollback = 8};
+        init_netplay(
+            peers[player],
+            sarena.arena,
+            cart,
+            loopback_transport(channel, player),
+            config);
+    }
+
+    // Each peer keeps sampling the buttons of the next frame it runs, so that the buttons of
+    // each frame don't depend on when a peer stalled.
+    bool done = false;
+    for (u32 tick = 0; !done; ++tick) {
+        psh_assert_msg(tick < 20 * FRAME_COUNT, "Netplay sessions made no progress");
+
+        done = true;
+        for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+            NetplaySession& peer = peers[player];
+            if (peer.frame == FRAME_COUNT) {
+                // Keep sending, the other peer may still be missing the last buttons.
+                psh_assert(poll_netplay(peer) == NetplayStatus::OK);
+                done = done && netplay_confirmed(peer);
+                continue;
+            }
+
+            done = false;
+            u8 const            buttons = sampled_buttons(player, host_frames[player]);
+            NetplayStatus const status  = advance_netplay(peer, buttons);
+            psh_assert(status != NetplayStatus::WRONG_CARTRIDGE);
+            if (status == NetplayStatus::OK) {
+                host_frames[player] += 1;
+            }
+        }
+        tick_loopback(channel);
+    }
+
+    // Reference run, where the local buttons of each frame reach both cores right away.
+    Core reference[NETPLAY_PLAYER_COUNT];
+    for (Core& core : reference) {
+        init_core(core, cart);
+    }
+    u32 const input_delay = 2;
+    for (u64 frame = 0; frame < FRAME_COUNT; ++frame) {
+        for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+            Core& core   = reference[player];
+            core.buttons = (frame < input_delay) ? 0 : sampled_buttons(player, frame - input_delay);
+            run_core_frame(core);
+        }
+    }
+
+    for (NetplaySession const& peer : peers) {
+        psh_assert(same_state(peer.cores[0], reference[0]));
+        psh_assert(same_state(peer.cores[1], reference[1]));
+    }
+
+    NetplayStats const& stats = peers[0].stats;
+    psh_info_fmt(
+        "delay %u, jitter %u, loss %u%%: %llu rollbacks, %llu frames run again, %llu stalls.",
+        conditions.delay,
+        conditions.jitter,
+        conditions.loss_percent,
+        static_cast<unsigned long long>(stats.rollback_count),
+        static_cast<unsigned long long>(stats.resimulated_frames),
+        static_cast<unsigned long long>(stats.stall_count));
+    if (conditions.delay != 0 || conditions.jitter != 0) {
+        psh_assert(stats.rollback_count != 0);
+    }
+}
+
+void loopback_sessions(Cartridge const& cart, psh::Arena* arena) {
+    run_peers(cart, arena, LoopbackConfig{.delay = 0, .jitter = 0, .loss_percent = 0, .seed = 1});
+    run_peers(cart, arena, LoopbackConfig{.delay = 3, .jitter = 0, .loss_percent = 0, .seed = 2});
+    run_peers(cart, arena, LoopbackConfig{.delay = 2, .jitter = 4, .loss_percent = 0, .seed = 3});
+    run_peers(cart, arena, LoopbackConfig{.delay = 1, .jitter = 3, .loss_percent = 20, .seed = 4});
+    run_peers(cart, arena, LoopbackConfig{.delay = 6, .jitter = 6, .loss_percent = 40, .seed = 5});
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void wrong_cartridge(Cartridge const& cart, Cartridge const& other_cart, psh::Arena* arena) {
+    LoopbackChannel channel;
+    init_loopback(channel, arena, {}, 16);
+
+    static NetplaySession peer;
+    static NetplaySession other;
+    init_netplay(peer, arena, cart, loopback_transport(channel, 0), {.local_player = 0});
+    init_netplay(other, arena, other_cart, loopback_transport(channel, 1), {.local_player = 1});
+
+    psh_assert(advance_netplay(peer, 0) == NetplayStatus::OK);
+    psh_assert(advance_netplay(other, 0) == NetplayStatus::WRONG_CARTRIDGE);
+    psh_assert(other.stats.packets_rejected == 1);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void udp_round_trip(Cartridge const& cart, psh::Arena* arena) {
+    constexpr u16 PORTS[NETPLAY_PLAYER_COUNT] = {47'311, 47'312};
+
+    UdpTransport udp[NETPLAY_PLAYER_COUNT];
+    bool const   opened = open_udp_transport(udp[0], PORTS[0], "127.0.0.1", PORTS[1])
+                        && open_udp_transport(udp[1], PORTS[1], "127.0.0.1", PORTS[0]);
+    if (!opened) {
+        close_udp_transport(udp[0]);
+        close_udp_transport(udp[1]);
+        psh_warning_fmt("%s: UDP sockets unavailable, skipping.", __func__);
+        return;
+    }
+
+    static NetplaySession peers[NETPLAY_PLAYER_COUNT];
+    for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+        NetplayConfig const config{.local_player = player};
+        init_netplay(peers[player], arena, cart, udp_transport(udp[player]), config);
+    }
+
+    // Datagrams over the loopback interface arrive right away, so the peers never stall for long.
+    for (u32 tick = 0; tick < 1000 && (peers[0].frame < 30 || peers[1].frame < 30); ++tick) {
+        for (u32 player = 0; player < NETPLAY_PLAYER_COUNT; ++player) {
+            u8 const buttons = sampled_buttons(player, peers[player].local_input_count);
+            psh_assert(advance_netplay(peers[player], buttons) != NetplayStatus::WRONG_CARTRIDGE);
+        }
+    }
+    psh_assert(peers[0].frame >= 30 && peers[1].frame >= 30);
+    psh_assert(peers[0].stats.packets_received != 0 && peers[1].stats.packets_received != 0);
+
+    close_udp_transport(udp[0]);
+    close_udp_transport(udp[1]);
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    TestPath const rom_path = write_test_rom("test_netplay.gb", joypad_sum_program(0x10));
+    TestPath const other_rom_path =
+        write_test_rom("test_netplay_other.gb", joypad_sum_program(0x20));
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_mebibytes(16));
+    psh::Arena cart_arena = memory_manager.make_arena(psh_kibibytes(64)).demand();
+    psh::Arena arena      = memory_manager.make_arena(psh_mebibytes(15)).demand();
+
+    Cartridge cart;
+    Cartridge other_cart;
+    psh_assert(
+        init_cartridge(cart, &cart_arena, psh::StringView{rom_path.buf})
+        == psh::FileStatus::OK);
+    psh_assert(
+        init_cartridge(other_cart, &cart_arena, psh::StringView{other_rom_path.buf})
+        == psh::FileStatus::OK);
+
+    loopback_sessions(cart, &arena);
+    wrong_cartridge(cart, other_cart, &arena);
+    udp_round_trip(cart, &arena);
+
+    std::remove(rom_path.buf);
+    std::remove(other_rom_path.buf);
+    psh_info("Test passed.");
+}
@@ -0,0 +1,86 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the conversion of PPU pixels to host colors.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/ppu/palette.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+
+using namespace mina;
+
+void dmg_palette_rebuild_only_on_change() {
+    PaletteTable   table{};
+    HwRegisterBank reg{};
+    reg.bgp  = 0xE4;
+    reg.obp0 = 0x1B;
+
+    psh_assert(update_dmg_palette_table(table, reg));
+    psh_assert(!update_dmg_palette_table(table, reg));
+
+    reg.obp1 = 0xFF;
+    psh_assert(update_dmg_palette_table(table, reg));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void scanline_matches_table() {
+    PaletteTable   table{};
+    HwRegisterBank reg{};
+    reg.bgp  = 0xE4;  // Identity: color i uses shade i.
+    reg.obp0 = 0x1B;  // Inverted.
+    reg.obp1 = 0xFF;  // All black.
+    psh_discard(update_dmg_palette_table(table, reg));
+
+    constexpr u8 cgb_palette[8] = {0xFF, 0x7F, 0x1F, 0x00, 0xE0, 0x03, 0x00, 0x7C};
+    set_cgb_palette(table, CGB_OBJ_PALETTE_SLOT_BASE + 1, cgb_palette);
+
+    u8 pixel_ids[LCD_WIDTH];
+    for (u32 idx = 0; idx < LCD_WIDTH; ++idx) {
+        pixel_ids[idx] = static_cast<u8>((idx * 7) % PaletteTable::ENTRY_COUNT);
+    }
+
+    u8 rgba[LCD_ROW_SIZE];
+    convert_scanline(table, pixel_ids, rgba);
+
+    for (u32 idx = 0; idx < LCD_WIDTH; ++idx) {
+        u8 entry = pixel_ids[idx];
+        psh_assert(rgba[4 * idx + 0] == table.red[entry]);
+        psh_assert(rgba[4 * idx + 1] == table.green[entry]);
+        psh_assert(rgba[4 * idx + 2] == table.blue[entry]);
+        psh_assert(rgba[4 * idx + 3] == table.alpha[entry]);
+    }
+
+    // Spot check the actual colors.
+    u8 const bg_black = make_pixel_id(DMG_BG_PALETTE_SLOT, VideoRAM::c3);
+    psh_assert(table.red[bg_black] == 0x00);
+    u8 const obj0_white = make_pixel_id(DMG_OBJ0_PALETTE_SLOT, VideoRAM::c3);
+    psh_assert(table.red[obj0_white] == 0xFF);
+    u8 const cgb_red = make_pixel_id(CGB_OBJ_PALETTE_SLOT_BASE + 1, VideoRAM::c1);
+    psh_assert(table.red[cgb_red] == 0xFF && table.green[cgb_red] == 0x00);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    dmg_palette_rebuild_only_on_change();
+    scanline_matches_table();
+    psh_info("Test passed.");
+}
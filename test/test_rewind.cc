@@ -0,0 +1,206 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the rewind buffer and its delta codec.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/rewind.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+#include <initializer_list>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+constexpr u32 FRAME_COUNT = 100;
+
+/// States of the core at the end of each frame.
+static SaveState frame_states[FRAME_COUNT];
+static SaveState restored;
+
+bool restores_frame(Core const& core, u32 frame) {
+    save_state(core, restored);
+    return std::memcmp(&restored, &frame_states[frame], sizeof(SaveState)) == 0;
+}
+
+void codec_round_trip() {
+    constexpr usize SIZE = 1000;  // Not a multiple of the SIMD block size.
+
+    static u8 reference[SIZE];
+    static u8 src[SIZE];
+    static u8 delta[max_xor_delta_size(SIZE)];
+    static u8 decoded[SIZE];
+    for (usize idx = 0; idx < SIZE; ++idx) {
+        reference[idx] = static_cast<u8>(idx * 13);
+    }
+
+    auto const check = [&]() {
+        usize const delta_size = encode_xor_delta(src, reference, SIZE, delta);
+        psh_assert(delta_size <= max_xor_delta_size(SIZE));
+        psh_assert(decode_xor_delta(delta, delta_size, reference, SIZE, decoded));
+        psh_assert(std::memcmp(decoded, src, SIZE) == 0);
+        return delta_size;
+    };
+
+    // Equal buffers encode to a single pair of runs.
+    std::memcpy(src, reference, SIZE);
+    psh_assert(check() <= 3);
+
+    // Sparse changes, at both edges, closer and further than the minimum equal run.
+    src[0]   ^= 0x01;
+    src[3]   ^= 0x80;
+    src[100] ^= 0xFF;
+    src[120] ^= 0x10;
+    src[998] ^= 0x42;
+    src[999] ^= 0x24;
+    psh_assert(check() < 32);
+
+    // Every other byte changed, the worst case of the encoding.
+    for (usize idx = 0; idx < SIZE; idx += 2) {
+        src[idx] = static_cast<u8>(~reference[idx]);
+    }
+    psh_assert(check() > SIZE / 2);
+
+    // Every byte changed.
+    for (usize idx = 0; idx < SIZE; ++idx) {
+        src[idx] = static_cast<u8>(~reference[idx]);
+    }
+    psh_assert(check() <= SIZE + 4);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void corrupt_deltas_are_rejected() {
+    constexpr usize SIZE = 64;
+
+    static u8 reference[SIZE];
+    static u8 decoded[SIZE];
+
+    auto const rejected = [&](std::initializer_list<u8> delta) {
+        return !decode_xor_delta(delta.begin(), delta.size(), reference, SIZE, decoded);
+    };
+
+    psh_assert(!rejected({60, 4, 1, 2, 3, 4}));
+    psh_assert(rejected({0x80}));                  // Truncated run length.
+    psh_assert(rejected({0, 5, 1, 2, 3}));         // Distinct run past the end of the delta.
+    psh_assert(rejected({65, 0}));                 // Equal run past the end of the bytes.
+    psh_assert(rejected({62, 3, 1, 2, 3}));        // Distinct run past the end of the bytes.
+    psh_assert(rejected({60, 4, 1, 2, 3, 4, 1}));  // Pair of runs past the end of the bytes.
+
+    // Run lengths overflowing a `usize`, or wrapping around the position.
+    psh_assert(rejected({0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F, 0}));
+    psh_assert(rejected({0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0}));
+    psh_assert(rejected({1, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x01, 0}));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void rewind_and_resume(Cartridge const& cart, psh::Arena* arena) {
+    Core core;
+    init_core(core, cart);
+
+    RewindBuffer rewind;
+    init_rewind(rewind, arena, core, {.buffer_size = psh_kibibytes(256), .keyframe_interval = 10});
+    for (u32 frame = 0; frame < FRAME_COUNT; ++frame) {
+        run_core_frame(core);
+        save_state(core, frame_states[frame]);
+        record_rewind_state(rewind, core);
+    }
+    psh_assert(rewind.entry_count == FRAME_COUNT);
+
+    // Neither a keyframe nor the state right after one.
+    psh_assert(rewind_core(rewind, core, 7));
+    psh_assert(restores_frame(core, FRAME_COUNT - 8));
+    psh_assert(rewind.entry_count == FRAME_COUNT - 7);
+
+    // Recording resumes after the restored state, and the run is identical.
+    for (u32 frame = FRAME_COUNT - 7; frame < FRAME_COUNT; ++frame) {
+        run_core_frame(core);
+        record_rewind_state(rewind, core);
+        psh_assert(restores_frame(core, frame));
+    }
+    psh_assert(rewind.entry_count == FRAME_COUNT);
+
+    psh_assert(rewind_core(rewind, core, 0));
+    psh_assert(restores_frame(core, FRAME_COUNT - 1));
+    psh_assert(rewind_core(rewind, core, FRAME_COUNT - 1));
+    psh_assert(restores_frame(core, 0));
+    psh_assert(!rewind_core(rewind, core, 1));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void oldest_states_are_dropped(Cartridge const& cart, psh::Arena* arena) {
+    Core core;
+    init_core(core, cart);
+
+    // Small enough for either limit to drop states.
+    RewindConfig const configs[2] = {
+        {.buffer_size = psh_kibibytes(64), .max_entries = 25, .keyframe_interval = 10},
+        {.buffer_size = 200, .max_entries = 1024, .keyframe_interval = 4},
+    };
+
+    for (RewindConfig const& config : configs) {
+        reset_core(core);
+
+        RewindBuffer rewind;
+        init_rewind(rewind, arena, core, config);
+        for (u32 frame = 0; frame < FRAME_COUNT; ++frame) {
+            run_core_frame(core);
+            record_rewind_state(rewind, core);
+        }
+        psh_assert(rewind.entry_count < FRAME_COUNT);
+        psh_assert(rewind.entry_count <= config.max_entries);
+        psh_assert(rewind.recorded_count == FRAME_COUNT);
+
+        // The oldest remaining state is still complete.
+        u32 const oldest = rewind.entry_count - 1;
+        psh_assert(!rewind_core(rewind, core, oldest + 1));
+        psh_assert(rewind_core(rewind, core, oldest));
+        psh_assert(restores_frame(core, FRAME_COUNT - 1 - oldest));
+    }
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    TestPath const rom_path = write_test_rom("test_rewind.gb", COUNTER_PROGRAM);
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_mebibytes(4));
+    psh::Arena cart_arena = memory_manager.make_arena(psh_kibibytes(32)).demand();
+    psh::Arena arena      = memory_manager.make_arena(psh_mebibytes(3)).demand();
+
+    Cartridge cart;
+    psh_assert(
+        init_cartridge(cart, &cart_arena, psh::StringView{rom_path.buf})
+        == psh::FileStatus::OK);
+
+    codec_round_trip();
+    corrupt_deltas_are_rejected();
+    rewind_and_resume(cart, &arena);
+    oldest_states_are_dropped(cart, &arena);
+
+    std::remove(rom_path.buf);
+    psh_info("Test passed.");
+}
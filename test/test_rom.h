@@ -0,0 +1,159 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Cartridges and files written by the tests, each at a path of its own in the
+///              temporary directory, so that tests running in parallel never share one.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+///
+/// Only depends on the presheaf library and the C library, so that tests restricted to the C
+/// interface of the emulator may use it as well.
+
+#pragma once
+
+#include <psh/assert.h>
+#include <psh/buffer.h>
+#include <psh/types.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(_WIN32)
+#    include <process.h>
+#else
+#    include <unistd.h>
+#endif
+
+namespace mina {
+    /// Loops forever over a `NOP; JP 0x0100` sequence.
+    constexpr u8 LOOPING_PROGRAM[] = {
+        0x00,              // 0x0100: NOP
+        0xC3, 0x00, 0x01,  // 0x0101: JP 0x0100
+    };
+
+    /// Keeps incrementing A and storing it to the work RAM and to the video RAM.
+    constexpr u8 COUNTER_PROGRAM[] = {
+        0x3C,              // 0x0100: INC A
+        0xEA, 0x00, 0xC0,  // 0x0101: LD (0xC000), A
+        0xEA, 0x00, 0x80,  // 0x0104: LD (0x8000), A
+        0xC3, 0x00, 0x01,  // 0x0107: JP 0x0100
+    };
+
+    /// Selects the action buttons and then keeps copying the P1 register to 0xC000 and a counter
+    /// to 0xC001.
+    constexpr u8 JOYPAD_COPY_PROGRAM[] = {
+        0x3E, 0x10,        // 0x0100: LD A, 0x10
+        0xEA, 0x00, 0xFF,  // 0x0102: LD (0xFF00), A
+        0xFA, 0x00, 0xFF,  // 0x0105: LD A, (0xFF00)
+        0xEA, 0x00, 0xC0,  // 0x0108: LD (0xC000), A
+        0x04,              // 0x010B: INC B
+        0x78,              // 0x010C: LD A, B
+        0xEA, 0x01, 0xC0,  // 0x010D: LD (0xC001), A
+        0xC3, 0x05, 0x01,  // 0x0110: JP 0x0105
+    };
+
+    /// Writes `select` to the P1 register and then keeps adding P1 to a sum stored at 0xC000, so
+    /// that the state depends on every button held so far.
+    constexpr psh::Buffer<u8, 16> joypad_sum_program(u8 select) noexcept {
+        return {
+            0x3E, select,      // 0x0100: LD A, select
+            0xEA, 0x00, 0xFF,  // 0x0102: LD (0xFF00), A
+            0xFA, 0x00, 0xFF,  // 0x0105: LD A, (0xFF00)
+            0x80,              // 0x0108: ADD A, B
+            0x47,              // 0x0109: LD B, A
+            0xEA, 0x00, 0xC0,  // 0x010A: LD (0xC000), A
+            0xC3, 0x05, 0x01,  // 0x010D: JP 0x0105
+        };
+    }
+
+    /// Path of a file written by a test.
+    struct TestPath {
+        char buf[256] = {};
+    };
+
+    /// Path in the temporary directory for a file of a test with the given name, tagged with the
+    /// id of the process and with the count of paths made so far by it.
+    inline TestPath make_test_path(char const* name) noexcept {
+        static u32 path_count = 0;
+
+#if defined(_WIN32)
+        long const  pid = static_cast<long>(_getpid());
+        char const* dir = std::getenv("TEMP");
+#else
+        long const  pid = static_cast<long>(getpid());
+        char const* dir = std::getenv("TMPDIR");
+#endif
+        if ((dir == nullptr) || (dir[0] == '\0')) {
+            dir = "/tmp";
+        }
+
+        TestPath  path;
+        int const length = std::snprintf(
+            path.buf,
+            sizeof(path.buf),
+            "%s/mina_%ld_%u_%s",
+            dir,
+            pid,
+            path_count++,
+            name);
+        psh_assert((length > 0) && (static_cast<usize>(length) < sizeof(path.buf)));
+        return path;
+    }
+
+    /// Write a cartridge whose entry point, at 0x0100, holds the given program, and return its
+    /// path. The cartridge spans at least its whole header, with everything else zeroed. A title
+    /// byte other than zero is written to the first byte of the title, so that cartridges
+    /// running the same program still have distinct contents.
+    inline TestPath write_test_rom(
+        char const* name,
+        u8 const*   program,
+        usize       size,
+        u8          title = 0) noexcept {
+        constexpr usize ENTRY_POINT = 0x0100;
+        constexpr usize TITLE       = 0x0134;
+        constexpr usize HEADER_END  = 0x0150;
+
+        psh::Buffer<u8, 0x0200> rom = {};
+        psh_assert_msg(ENTRY_POINT + size <= rom.size(), "The program is too large");
+        std::memcpy(rom.buf + ENTRY_POINT, program, size);
+        if (title != 0) {
+            psh_assert_msg(ENTRY_POINT + size <= TITLE, "The program overlaps the title");
+            rom[TITLE] = title;
+        }
+
+        usize const    rom_size = psh_max(ENTRY_POINT + size, HEADER_END);
+        TestPath const path     = make_test_path(name);
+        FILE*          file     = std::fopen(path.buf, "wb");
+        psh_assert(file != nullptr);
+        psh_assert(std::fwrite(rom.buf, 1, rom_size, file) == rom_size);
+        psh_assert(std::fclose(file) == 0);
+        return path;
+    }
+
+    template <usize N>
+    TestPath write_test_rom(char const* name, u8 const (&program)[N], u8 title = 0) noexcept {
+        return write_test_rom(name, program, N, title);
+    }
+
+    template <usize N>
+    TestPath write_test_rom(
+        char const*               name,
+        psh::Buffer<u8, N> const& program,
+        u8                        title = 0) noexcept {
+        return write_test_rom(name, program.buf, N, title);
+    }
+}  // namespace mina
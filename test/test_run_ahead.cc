@@ -0,0 +1,138 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+///
+/// Description: Tests for the run-ahead of the emulation core.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/run_ahead.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+constexpr u32 FRAME_COUNT = 20;
+
+static SaveState expected;
+static SaveState presented;
+
+bool same_state(Core const& lhs, Core const& rhs) {
+    save_state(lhs, expected);
+    save_state(rhs, presented);
+    return std::memcmp(&expected, &presented, sizeof(SaveState)) == 0;
+}
+
+void presents_frames_ahead(Cartridge const& cart, psh::Arena* arena) {
+    constexpr u32 AHEAD = 2;
+
+    Core core;
+    init_core(core, cart);
+    Core reference;
+    init_core(reference, cart);
+    Core ahead;
+    init_core(ahead, cart);
+
+    RunAhead run_ahead;
+    init_run_ahead(run_ahead, arena, AHEAD);
+    for (u32 idx = 0; idx < AHEAD; ++idx) {
+        run_core_frame(ahead);
+    }
+
+    for (u32 frame = 0; frame < FRAME_COUNT; ++frame) {
+        Core const& shown = run_ahead_frame(run_ahead, core);
+        run_core_frame(reference);
+        run_core_frame(ahead);
+
+        // The core runs at the pace of the host, while the presented frames are ahead of it.
+        psh_assert(&shown != &core);
+        psh_assert(same_state(core, reference));
+        psh_assert(same_state(shown, ahead));
+        psh_assert(shown.frame_count == core.frame_count + AHEAD);
+    }
+
+    RunAheadStats const& stats = run_ahead.stats;
+    psh_assert(stats.host_frame_count == FRAME_COUNT);
+    psh_assert(stats.frame_seconds > 0.0 && stats.ahead_seconds > 0.0);
+    psh_assert(stats.max_host_seconds > 0.0);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void input_is_seen_ahead(Cartridge const& cart, psh::Arena* arena) {
+    Core core;
+    init_core(core, cart);
+
+    RunAhead run_ahead;
+    init_run_ahead(run_ahead, arena, 1);
+    for (u32 frame = 0; frame < FRAME_COUNT; ++frame) {
+        core.buttons = (frame % 2 == 0) ? BUTTON_A : u8{0};
+
+        // The buttons pressed in a host frame are already seen by the frame presented in it.
+        Core const& shown = run_ahead_frame(run_ahead, core);
+        u8 const    p1    = shown.cpu.mmap.fx_wram.buf[0];
+        psh_assert(p1 == ((frame % 2 == 0) ? 0xDE : 0xDF));
+    }
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void disabled_presents_core(Cartridge const& cart, psh::Arena* arena) {
+    Core core;
+    init_core(core, cart);
+
+    RunAhead run_ahead;
+    init_run_ahead(run_ahead, arena, 0);
+    psh_assert(run_ahead.shadow == nullptr);
+
+    Core const& shown = run_ahead_frame(run_ahead, core);
+    psh_assert(&shown == &core);
+    psh_assert(core.frame_count == 1);
+
+    RunAheadStats const mean = mean_run_ahead_stats(run_ahead.stats);
+    psh_assert(mean.host_frame_count == 1);
+    psh_assert(mean.save_seconds == 0.0 && mean.ahead_seconds == 0.0);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    TestPath const rom_path = write_test_rom("test_run_ahead.gb", JOYPAD_COPY_PROGRAM);
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_mebibytes(2));
+    psh::Arena cart_arena = memory_manager.make_arena(psh_kibibytes(32)).demand();
+    psh::Arena arena      = memory_manager.make_arena(psh_mebibytes(1)).demand();
+
+    Cartridge cart;
+    psh_assert(
+        init_cartridge(cart, &cart_arena, psh::StringView{rom_path.buf})
+        == psh::FileStatus::OK);
+
+    presents_frames_ahead(cart, &arena);
+    input_is_seen_ahead(cart, &arena);
+    disabled_presents_core(cart, &arena);
+
+    std::remove(rom_path.buf);
+    psh_info("Test passed.");
+}
@@ -0,0 +1,175 @@
+///                          Mina, Game Boy emulator
+///    Copyright (C) 2024 Luiz Gustavo Mugnaini Anselmo
+///
+///    This program is free software; you can redistribute it and/or modify
+///    it under the terms of the GNU General Public License as published by
+///    the Free Software Foundation; either version 2 of the License, or
+///    (at your option) any later version.
+///
+///    This program is distributed in the hope that it will be useful,
+///    but WITHOUT ANY WARRANTY; without even the implied warranty of
+///    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+///    GNU General Public License for more details.
+///
+///    You should have received a copy of the GNU General Public License along
+///    with this program; if not, write to the Free Software Foundation, Inc.,
+///    51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+///
+///
+/// Description: Tests for the core savestates.
+/// Author: Luiz G. Mugnaini A. <luizmugnaini@gmail.com>
+
+#include <mina/savestate.h>
+
+#include <psh/assert.h>
+#include <psh/log.h>
+#include <psh/memory_manager.h>
+#include <cstdio>
+#include <cstring>
+
+#include "test_rom.h"
+
+using namespace mina;
+
+static SaveState state;
+static SaveState expected;
+static SaveState restored;
+
+bool same_core_state(SaveState const& lhs, SaveState const& rhs) {
+    return std::memcmp(&lhs, &rhs, sizeof(SaveState)) == 0;
+}
+
+void round_trip(Cartridge const& cart) {
+    Core original;
+    init_core(original, cart);
+    run_core_cycles(original, 1000);
+    save_state(original, state);
+    psh_assert(state.header.size == sizeof(SaveState));
+    psh_assert(state.cycle_count == 1000);
+
+    run_core_cycles(original, 777);
+    save_state(original, expected);
+
+    // A fresh core resumes exactly where the state was saved.
+    Core copy;
+    init_core(copy, cart);
+    psh_assert(load_state(copy, state) == SaveStateStatus::OK);
+    psh_assert(copy.cycle_count == 1000);
+    run_core_cycles(copy, 777);
+    save_state(copy, restored);
+    psh_assert(same_core_state(restored, expected));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void held_buttons(Cartridge const& cart) {
+    Core original;
+    init_core(original, cart);
+    original.buttons = BUTTON_A | BUTTON_DOWN;
+    run_core_cycles(original, 100);
+    save_state(original, state);
+    psh_assert(state.buttons == (BUTTON_A | BUTTON_DOWN));
+
+    // The buttons held when saving are presented again, even if the core had others.
+    Core copy;
+    init_core(copy, cart);
+    copy.buttons = BUTTON_START;
+    run_core_cycles(copy, 10);
+    psh_assert(load_state(copy, state) == SaveStateStatus::OK);
+    psh_assert(copy.buttons == (BUTTON_A | BUTTON_DOWN));
+    psh_assert(copy.cpu.buttons == copy.buttons);
+
+    run_core_cycles(original, 50);
+    run_core_cycles(copy, 50);
+    save_state(original, expected);
+    save_state(copy, restored);
+    psh_assert(same_core_state(restored, expected));
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void rejected_blobs(Cartridge const& cart, Cartridge const& other_cart) {
+    Core core;
+    init_core(core, cart);
+    run_core_cycles(core, 100);
+    save_state(core, state);
+
+    Core target;
+    init_core(target, cart);
+    u8 const* blob = reinterpret_cast<u8 const*>(&state);
+
+    usize const header_size = sizeof(SaveStateHeader);
+    psh_assert(load_state(target, {blob, header_size - 1}) == SaveStateStatus::INVALID_SIZE);
+    psh_assert(load_state(target, {blob, sizeof(SaveState) - 1}) == SaveStateStatus::INVALID_SIZE);
+
+    state.header.magic = 0;
+    psh_assert(load_state(target, state) == SaveStateStatus::INVALID_MAGIC);
+    state.header.magic   = SAVESTATE_MAGIC;
+    state.header.version = SAVESTATE_VERSION + 1;
+    psh_assert(load_state(target, state) == SaveStateStatus::INVALID_VERSION);
+    state.header.version = SAVESTATE_VERSION;
+
+    Core other;
+    init_core(other, other_cart);
+    psh_assert(load_state(other, state) == SaveStateStatus::WRONG_CARTRIDGE);
+
+    // Rejected blobs leave the core untouched.
+    psh_assert(target.cycle_count == 0 && target.cpu.regfile.pc == 0x0100);
+    psh_assert(load_state(target, state) == SaveStateStatus::OK);
+    psh_assert(target.cycle_count == 100);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+void state_file(Cartridge const& cart, psh::Arena* arena) {
+    TestPath const        state_path = make_test_path("test_savestate.state");
+    psh::StringView const path{state_path.buf};
+
+    Core core;
+    init_core(core, cart);
+    run_core_cycles(core, 4321);
+    save_state(core, state);
+    psh_assert(write_state_file(state, path) == SaveStateStatus::OK);
+
+    Core loaded;
+    init_core(loaded, cart);
+    psh_assert(load_state_file(loaded, arena, path) == SaveStateStatus::OK);
+    save_state(loaded, restored);
+    psh_assert(same_core_state(restored, state));
+
+    SaveStateStatus const missing =
+        load_state_file(loaded, arena, psh::StringView{"missing.state"});
+    psh_assert(missing == SaveStateStatus::FAILED_TO_OPEN);
+    std::remove(state_path.buf);
+
+    psh_info_fmt("%s test passed.", __func__);
+}
+
+int main() {
+    // Both cartridges run the same program, only their titles tell them apart.
+    TestPath const rom_path = write_test_rom("test_savestate.gb", COUNTER_PROGRAM, 'A');
+    TestPath const other_rom_path =
+        write_test_rom("test_savestate_other.gb", COUNTER_PROGRAM, 'B');
+
+    psh::MemoryManager memory_manager;
+    memory_manager.init(psh_kibibytes(256));
+    psh::Arena arena       = memory_manager.make_arena(psh_kibibytes(32)).demand();
+    psh::Arena state_arena = memory_manager.make_arena(psh_kibibytes(128)).demand();
+
+    Cartridge cart;
+    Cartridge other_cart;
+    psh_assert(
+        init_cartridge(cart, &arena, psh::StringView{rom_path.buf}) == psh::FileStatus::OK);
+    psh_assert(
+        init_cartridge(other_cart, &arena, psh::StringView{other_rom_path.buf})
+        == psh::FileStatus::OK);
+
+    round_trip(cart);
+    held_buttons(cart);
+    rejected_blobs(cart, other_cart);
+    state_file(cart, &state_arena);
+
+    std::remove(rom_path.buf);
+    std::remove(other_rom_path.buf);
+    psh_info("Test passed.");
+}